@@ -0,0 +1,1694 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+#include "bench.h"
+#include "internal.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define BENCH_MAX_RESULTS 64
+#define BENCH_PING_SIZE 64
+#define BENCH_PING_ROUNDS 20'000
+#define BENCH_STREAM_CHUNK 65'536
+#define BENCH_STREAM_BYTES (1ull << 30)
+#define BENCH_VECTOR_HEADER 256
+#define BENCH_VECTOR_BODY 65'536
+#define BENCH_VECTOR_ROUNDS 20'000
+#define BENCH_DATAGRAM_SIZE 1'024
+#define BENCH_DATAGRAM_BURST 32
+#define BENCH_DATAGRAM_BURSTS 20'000
+#define BENCH_CHURN_SOCKETS 100'000
+#define BENCH_EVENT_CONNECTIONS 64
+#define BENCH_EVENT_ROUNDS 2'000
+#define BENCH_ACCEPT_THREADS 4
+#define BENCH_ACCEPT_CONNECTIONS 20'000
+#define BENCH_LOAD_FILES_SIZE 16'384
+#define BENCH_CHECKSUM_SIZE 65'536
+#define BENCH_CHECKSUM_ROUNDS 16'384
+#define BENCH_CHECKSUM_FILE_SIZE (16ull << 20)
+#define BENCH_SEND_FILE_SIZE (16ull << 20)
+#define BENCH_SEND_FILE_ROUNDS 32
+#define BENCH_WALK_DIRECTORIES 64
+#define BENCH_WALK_FILES 64
+#define BENCH_CACHE_FILES 64
+#define BENCH_CACHE_LOOKUPS 1'000'000
+#define BENCH_WRITER_THREADS 8
+#define BENCH_WRITER_RECORD 128
+#define BENCH_WRITER_DURABLE 250
+#define BENCH_WRITER_RECORDS 500'000
+#define BENCH_QUEUE_FILE_SIZE (64ull << 20)
+#define BENCH_QUEUE_CHUNK (256u << 10)
+#define BENCH_QUEUE_DEPTH 8
+#define BENCH_LOGGER_MESSAGES 200'000
+#define BENCH_MODULE_ROUNDS 2'000
+#define BENCH_ALLOC_REQUESTS 100'000
+#define BENCH_ALLOC_PER_REQUEST 64
+#define BENCH_LARGE_SIZE (256ull << 20)
+#define BENCH_LARGE_READS 16'000'000
+
+static benchResult results_s[BENCH_MAX_RESULTS];
+static uint32_t resultCount_s = 0;
+
+void benchLogFrameworkFail(const fwError error, const char* location, const int32_t line) {
+    fprintf(stderr, "Call in %s failed with %d at line %d\n", location, error, line);
+}
+
+uint64_t benchNow(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
+
+void benchSamplesCreate(benchSamples* samples_p, const uint64_t capacity) {
+    samples_p->values_p = malloc(capacity * sizeof(uint64_t));
+    samples_p->count = 0;
+    samples_p->capacity = samples_p->values_p != nullptr ? capacity : 0;
+}
+
+void benchSamplesAdd(benchSamples* samples_p, const uint64_t nanoseconds) {
+    if (samples_p->count < samples_p->capacity) {
+        samples_p->values_p[samples_p->count++] = nanoseconds;
+    }
+}
+
+static int benchCompare(const void* a_p, const void* b_p) {
+    const uint64_t a = *(const uint64_t*)a_p, b = *(const uint64_t*)b_p;
+    return (a > b) - (a < b);
+}
+
+void benchSamplesFinish(benchSamples* samples_p, benchResult* result_p) {
+    memset(&result_p->latency, 0, sizeof(result_p->latency));
+
+    if (samples_p->count != 0) {
+        qsort(samples_p->values_p, samples_p->count, sizeof(uint64_t), benchCompare);
+
+        uint64_t sum = 0;
+        for (uint64_t i = 0; i < samples_p->count; i++) {
+            sum += samples_p->values_p[i];
+        }
+
+        result_p->latency.count = samples_p->count;
+        result_p->latency.p50   = samples_p->values_p[samples_p->count * 50 / 100];
+        result_p->latency.p99   = samples_p->values_p[samples_p->count * 99 / 100];
+        result_p->latency.max   = samples_p->values_p[samples_p->count - 1];
+        result_p->latency.mean  = sum / samples_p->count;
+    }
+
+    free(samples_p->values_p);
+    samples_p->values_p = nullptr;
+    samples_p->count = samples_p->capacity = 0;
+}
+
+void benchRecord(const benchResult* result_p) {
+    const double seconds = (double)result_p->nanoseconds / 1e9;
+
+    // Logs from the framework go to stdout in debug builds, results stay readable on stderr
+    fprintf(stderr, "%-28s %10.0f op/s %10.1f MiB/s   p50 %8lu ns   p99 %8lu ns\n", result_p->name,
+            seconds > 0 ? (double)result_p->operations / seconds : 0.0,
+            seconds > 0 ? (double)result_p->bytes / seconds / 1'048'576.0 : 0.0,
+            (unsigned long)result_p->latency.p50, (unsigned long)result_p->latency.p99);
+
+    if (resultCount_s < BENCH_MAX_RESULTS) {
+        results_s[resultCount_s++] = *result_p;
+    }
+}
+
+fwError benchWriteJson(const char* filename_p) {
+    FILE* file = fopen(filename_p, "w");
+    if (file == nullptr) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    fwSystemConfiguration system = {};
+    fwGetSystemConfiguration(&system);
+
+#ifdef BUILD_DEBUG
+    const char* build = "debug";
+#else
+    const char* build = "release";
+#endif
+
+    fprintf(file, "{\n  \"benchmark\": \"lpafBench\",\n  \"build\": \"%s\",\n  \"cores\": %u,\n"
+            "  \"timestamp\": %ld,\n  \"results\": [", build, system.cores, (long)time(nullptr));
+
+    for (uint32_t i = 0; i < resultCount_s; i++) {
+        const benchResult* result = &results_s[i];
+        const double seconds = (double)result->nanoseconds / 1e9;
+
+        fprintf(file, "%s\n    {\"name\": \"%s\", \"operations\": %lu, \"bytes\": %lu, "
+                "\"seconds\": %.6f, \"operationsPerSecond\": %.1f, \"bytesPerSecond\": %.1f, "
+                "\"latencyNs\": {\"p50\": %lu, \"p99\": %lu, \"max\": %lu, \"mean\": %lu}}",
+                i == 0 ? "" : ",", result->name, (unsigned long)result->operations,
+                (unsigned long)result->bytes, seconds,
+                seconds > 0 ? (double)result->operations / seconds : 0.0,
+                seconds > 0 ? (double)result->bytes / seconds : 0.0,
+                (unsigned long)result->latency.p50, (unsigned long)result->latency.p99,
+                (unsigned long)result->latency.max, (unsigned long)result->latency.mean);
+    }
+
+    fprintf(file, "\n  ]\n}\n");
+    return fclose(file) == 0 ? fwErrorSuccess : fwErrorFileUnableToOpen;
+}
+
+/**
+ * @brief Ports are derived from the process ID so that a run does not trip over sockets of the
+ *        previous one that are still in TIME_WAIT.
+ */
+static void benchPort(char* port_p, const uint32_t offset) {
+    snprintf(port_p, 8, "%u", 20'000 + (uint32_t)getpid() % 20'000 + offset);
+}
+
+/**
+ * @brief fwSocketReceive does not report how much it read, the socket statistics do. Querying
+ *        them costs a few syscalls, so ping-pong rounds rely on loopback delivering a small
+ *        message in one piece and only the bulk transfer counts its bytes.
+ */
+static uint64_t benchReceived(const fwSocket socket) {
+    fwSocketStats stats;
+    fwSocketGetStats(socket, &stats);
+    return stats.bytesReceived;
+}
+
+struct benchStreamServer {
+    fwSocket listener;
+    uint64_t streamBytes;
+};
+
+static void* benchStreamServe(void* server_p) {
+    const struct benchStreamServer* server = server_p;
+
+    fwSocket socket;
+    BENCH(fwSocketAccept(server->listener, &socket, nullptr));
+
+    char* buffer = malloc(BENCH_STREAM_CHUNK);
+    for (uint32_t i = 0; i < BENCH_PING_ROUNDS; i++) {
+        fwSocketReceive(socket, buffer, BENCH_PING_SIZE);
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+    }
+
+    uint64_t received = benchReceived(socket);
+    const uint64_t target = received + server->streamBytes;
+    while (received < target) {
+        if (fwSocketReceive(socket, buffer, BENCH_STREAM_CHUNK) != fwErrorSuccess) {
+            break;
+        }
+        const uint64_t previous = received;
+        if ((received = benchReceived(socket)) == previous) { // the peer hung up
+            break;
+        }
+    }
+    fwSocketSend(socket, buffer, 1);
+
+    free(buffer);
+    fwSocketClose(socket);
+    return nullptr;
+}
+
+void benchUnitSocketStream(const fwSocketAddressFamily addressFamily) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    const bool local = addressFamily == fwSocketAddressFamilyLocal;
+    const char* name = local ? "unix" : "tcp";
+
+    char port[8], path[64];
+    benchPort(port, local ? 1 : 0);
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u.sock", (uint32_t)getpid());
+    const fwSocketAddress address = {.target_p = local ? path : "127.0.0.1", .port_p = port};
+
+    struct benchStreamServer server = {.streamBytes = BENCH_STREAM_BYTES};
+    BENCH(fwSocketCreate(&server.listener, addressFamily, fwSocketProtocolStream));
+    if (local) {
+        unlink(path);
+    }
+    BENCH(fwSocketBind(server.listener, &address));
+
+    pthread_t thread;
+    pthread_create(&thread, nullptr, benchStreamServe, &server);
+
+    // The listener only starts listening once the server thread is inside fwSocketAccept
+    fwSocket socket;
+    BENCH(fwSocketCreate(&socket, addressFamily, fwSocketProtocolStream));
+    for (uint32_t attempt = 0; fwSocketConnect(socket, &address) != fwErrorSuccess; attempt++) {
+        if (attempt == 1'000) {
+            fprintf(stderr, "Could not connect to the %s benchmark server\n", name);
+            exit(1);
+        }
+        usleep(1'000);
+    }
+
+    char* buffer = calloc(1, BENCH_STREAM_CHUNK);
+
+    benchResult pingPong = {};
+    snprintf(pingPong.name, sizeof(pingPong.name), "socket.%s.pingpong", name);
+    benchSamples samples;
+    benchSamplesCreate(&samples, BENCH_PING_ROUNDS);
+
+    uint64_t begin = benchNow();
+    for (uint32_t i = 0; i < BENCH_PING_ROUNDS; i++) {
+        const uint64_t roundBegin = benchNow();
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+        fwSocketReceive(socket, buffer, BENCH_PING_SIZE);
+        benchSamplesAdd(&samples, benchNow() - roundBegin);
+    }
+    pingPong.nanoseconds = benchNow() - begin;
+    pingPong.operations  = BENCH_PING_ROUNDS;
+    pingPong.bytes       = 2ull * BENCH_PING_ROUNDS * BENCH_PING_SIZE;
+    benchSamplesFinish(&samples, &pingPong);
+    benchRecord(&pingPong);
+
+    benchResult stream = {};
+    snprintf(stream.name, sizeof(stream.name), "socket.%s.stream", name);
+    benchSamplesCreate(&samples, BENCH_STREAM_BYTES / BENCH_STREAM_CHUNK);
+
+    begin = benchNow();
+    for (uint64_t sent = 0; sent < BENCH_STREAM_BYTES; sent += BENCH_STREAM_CHUNK) {
+        const uint64_t sendBegin = benchNow();
+        fwSocketSend(socket, buffer, BENCH_STREAM_CHUNK);
+        benchSamplesAdd(&samples, benchNow() - sendBegin);
+    }
+    fwSocketReceive(socket, buffer, 1); // the server has read everything
+    stream.nanoseconds = benchNow() - begin;
+    stream.operations  = BENCH_STREAM_BYTES / BENCH_STREAM_CHUNK;
+    stream.bytes       = BENCH_STREAM_BYTES;
+    benchSamplesFinish(&samples, &stream);
+    benchRecord(&stream);
+
+    pthread_join(thread, nullptr);
+    free(buffer);
+    fwSocketClose(socket);
+    fwSocketClose(server.listener);
+    if (local) {
+        unlink(path);
+    }
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+static void* benchVectorServe(void* listener_p) {
+    fwSocket socket;
+    BENCH(fwSocketAccept((fwSocket)listener_p, &socket, nullptr));
+
+    char* header = malloc(BENCH_VECTOR_HEADER);
+    char* body = malloc(BENCH_VECTOR_BODY);
+    const fwSocketBuffer buffers[] = {{header, BENCH_VECTOR_HEADER}, {body, BENCH_VECTOR_BODY}};
+    for (uint32_t mode = 0; mode < 2; mode++) {
+        for (uint32_t i = 0; i < BENCH_VECTOR_ROUNDS; i++) {
+            BENCH(fwSocketReceiveV(socket, buffers, 2, nullptr));
+        }
+        BENCH(fwSocketSend(socket, header, 1));
+    }
+
+    free(header);
+    free(body);
+    fwSocketClose(socket);
+    return nullptr;
+}
+
+void benchUnitSocketVector(void) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lpafBench-vector-%u.sock", (uint32_t)getpid());
+    const fwSocketAddress address = {.target_p = path, .port_p = ""};
+
+    fwSocket listener;
+    BENCH(fwSocketCreate(&listener, fwSocketAddressFamilyLocal, fwSocketProtocolStream));
+    unlink(path);
+    BENCH(fwSocketBind(listener, &address));
+
+    pthread_t thread;
+    pthread_create(&thread, nullptr, benchVectorServe, (void*)listener);
+
+    fwSocket socket;
+    BENCH(fwSocketCreate(&socket, fwSocketAddressFamilyLocal, fwSocketProtocolStream));
+    for (uint32_t attempt = 0; fwSocketConnect(socket, &address) != fwErrorSuccess; attempt++) {
+        if (attempt == 1'000) {
+            fprintf(stderr, "Could not connect to the vector benchmark server\n");
+            exit(1);
+        }
+        usleep(1'000);
+    }
+
+    // Responses made of a header and a body, first copied into one buffer, then sent from both
+    char* header = calloc(1, BENCH_VECTOR_HEADER);
+    char* body = calloc(1, BENCH_VECTOR_BODY);
+    char* joined = malloc(BENCH_VECTOR_HEADER + BENCH_VECTOR_BODY);
+    static const char* names_s[] = {"socket.vector.copy", "socket.vector.gather"};
+    for (uint32_t mode = 0; mode < 2; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, BENCH_VECTOR_ROUNDS);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t i = 0; i < BENCH_VECTOR_ROUNDS; i++) {
+            const uint64_t roundBegin = benchNow();
+            if (mode == 0) {
+                memcpy(joined, header, BENCH_VECTOR_HEADER);
+                memcpy(joined + BENCH_VECTOR_HEADER, body, BENCH_VECTOR_BODY);
+                const fwSocketBuffer buffer = {joined, BENCH_VECTOR_HEADER + BENCH_VECTOR_BODY};
+                BENCH(fwSocketSendV(socket, &buffer, 1, nullptr));
+            }
+            else {
+                const fwSocketBuffer buffers[] = {{header, BENCH_VECTOR_HEADER},
+                                                  {body, BENCH_VECTOR_BODY}};
+                BENCH(fwSocketSendV(socket, buffers, 2, nullptr));
+            }
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        BENCH(fwSocketReceive(socket, header, 1)); // the server has read everything
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_VECTOR_ROUNDS;
+        result.bytes       = result.operations * (BENCH_VECTOR_HEADER + BENCH_VECTOR_BODY);
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    pthread_join(thread, nullptr);
+    free(header);
+    free(body);
+    free(joined);
+    fwSocketClose(socket);
+    fwSocketClose(listener);
+    unlink(path);
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+static void* benchSendFileServe(void* listener_p) {
+    fwSocket socket;
+    BENCH(fwSocketAccept(*(fwSocket*)listener_p, &socket, nullptr));
+
+    // Every file is acknowledged, so that a round is timed until the data arrived
+    char* buffer = malloc(BENCH_STREAM_CHUNK);
+    uint64_t received = 0;
+    for (uint32_t round = 0; round < 2 * BENCH_SEND_FILE_ROUNDS; round++) {
+        const uint64_t target = received + BENCH_SEND_FILE_SIZE;
+        while (received < target) {
+            if (fwSocketReceive(socket, buffer, BENCH_STREAM_CHUNK) != fwErrorSuccess) {
+                break;
+            }
+            const uint64_t previous = received;
+            if ((received = benchReceived(socket)) == previous) { // the peer hung up
+                break;
+            }
+        }
+        fwSocketSend(socket, buffer, 1);
+    }
+
+    free(buffer);
+    fwSocketClose(socket);
+    return nullptr;
+}
+
+void benchUnitSocketSendFile(void) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    char port[8], path[64];
+    benchPort(port, 4);
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u.bin", (uint32_t)getpid());
+    const fwSocketAddress address = {.target_p = "127.0.0.1", .port_p = port};
+
+    FILE* output = fopen(path, "wb");
+    if (output == nullptr) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return;
+    }
+    char* content = malloc(BENCH_SEND_FILE_SIZE);
+    memset(content, 'S', BENCH_SEND_FILE_SIZE);
+    fwrite(content, 1, BENCH_SEND_FILE_SIZE, output);
+    fclose(output);
+    free(content);
+
+    fwSocket listener;
+    BENCH(fwSocketCreate(&listener, fwSocketAddressFamilyIPv4, fwSocketProtocolStream));
+    BENCH(fwSocketBind(listener, &address));
+
+    pthread_t thread;
+    pthread_create(&thread, nullptr, benchSendFileServe, &listener);
+
+    fwSocket socket;
+    BENCH(fwSocketCreate(&socket, fwSocketAddressFamilyIPv4, fwSocketProtocolStream));
+    for (uint32_t attempt = 0; fwSocketConnect(socket, &address) != fwErrorSuccess; attempt++) {
+        if (attempt == 1'000) {
+            fprintf(stderr, "Could not connect to the sendfile benchmark server\n");
+            exit(1);
+        }
+        usleep(1'000);
+    }
+
+    // Loading the file and sending it from memory is what serving a file took before
+    for (uint32_t copy = 0; copy < 2; copy++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), copy ? "socket.tcp.sendfile.copy" :
+                                                          "socket.tcp.sendfile");
+        benchSamples samples;
+        benchSamplesCreate(&samples, BENCH_SEND_FILE_ROUNDS);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t round = 0; round < BENCH_SEND_FILE_ROUNDS; round++) {
+            const uint64_t roundBegin = benchNow();
+            if (copy) {
+                void* buffer;
+                uint64_t size;
+                BENCH(fwLoadFileToMem(path, &buffer, &size));
+                for (uint64_t sent = 0; sent < size; sent += BENCH_STREAM_CHUNK) {
+                    fwSocketSend(socket, (uint8_t*)buffer + sent, BENCH_STREAM_CHUNK);
+                }
+                fwFree(buffer);
+            }
+            else {
+                fwFile file;
+                BENCH(fwFileOpen(path, fwFileOpenFlagNone, &file));
+                BENCH(fwSocketSendFile(socket, file, 0, 0, nullptr));
+                BENCH(fwFileClose(file));
+            }
+
+            char acknowledgement;
+            fwSocketReceive(socket, &acknowledgement, 1);
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_SEND_FILE_ROUNDS;
+        result.bytes       = BENCH_SEND_FILE_ROUNDS * BENCH_SEND_FILE_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    pthread_join(thread, nullptr);
+    fwSocketClose(socket);
+    fwSocketClose(listener);
+    unlink(path);
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+static void* benchDatagramServe(void* socket_p) {
+    const fwSocket socket = *(fwSocket*)socket_p;
+    char buffer[BENCH_DATAGRAM_SIZE];
+
+    for (uint32_t i = 0; i < BENCH_PING_ROUNDS; i++) {
+        fwSocketReceive(socket, buffer, sizeof(buffer));
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+    }
+
+    // Acknowledging every burst keeps the sender from overrunning the receive buffer, loopback
+    // does not drop datagrams otherwise
+    for (uint32_t burst = 0; burst < BENCH_DATAGRAM_BURSTS; burst++) {
+        for (uint32_t i = 0; i < BENCH_DATAGRAM_BURST; i++) {
+            fwSocketReceive(socket, buffer, sizeof(buffer));
+        }
+        fwSocketSend(socket, buffer, 1);
+    }
+    return nullptr;
+}
+
+void benchUnitSocketDatagram(void) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    char serverPort[8], clientPort[8];
+    benchPort(serverPort, 2);
+    benchPort(clientPort, 3);
+    const fwSocketAddress serverAddress = {.target_p = "127.0.0.1", .port_p = serverPort};
+    const fwSocketAddress clientAddress = {.target_p = "127.0.0.1", .port_p = clientPort};
+
+    // Both ends are bound and connected to each other, so plain send and receive work both ways
+    fwSocket server, client;
+    BENCH(fwSocketCreate(&server, fwSocketAddressFamilyIPv4, fwSocketProtocolDatagram));
+    BENCH(fwSocketCreate(&client, fwSocketAddressFamilyIPv4, fwSocketProtocolDatagram));
+    BENCH(fwSocketBind(server, &serverAddress));
+    BENCH(fwSocketBind(client, &clientAddress));
+    BENCH(fwSocketConnect(server, &clientAddress));
+    BENCH(fwSocketConnect(client, &serverAddress));
+
+    pthread_t thread;
+    pthread_create(&thread, nullptr, benchDatagramServe, &server);
+
+    char buffer[BENCH_DATAGRAM_SIZE] = {};
+
+    benchResult pingPong = {.name = "socket.udp.pingpong"};
+    benchSamples samples;
+    benchSamplesCreate(&samples, BENCH_PING_ROUNDS);
+
+    uint64_t begin = benchNow();
+    for (uint32_t i = 0; i < BENCH_PING_ROUNDS; i++) {
+        const uint64_t roundBegin = benchNow();
+        fwSocketSend(client, buffer, BENCH_PING_SIZE);
+        fwSocketReceive(client, buffer, sizeof(buffer));
+        benchSamplesAdd(&samples, benchNow() - roundBegin);
+    }
+    pingPong.nanoseconds = benchNow() - begin;
+    pingPong.operations  = BENCH_PING_ROUNDS;
+    pingPong.bytes       = 2ull * BENCH_PING_ROUNDS * BENCH_PING_SIZE;
+    benchSamplesFinish(&samples, &pingPong);
+    benchRecord(&pingPong);
+
+    benchResult stream = {.name = "socket.udp.stream"};
+    benchSamplesCreate(&samples, (uint64_t)BENCH_DATAGRAM_BURSTS * BENCH_DATAGRAM_BURST);
+
+    begin = benchNow();
+    for (uint32_t burst = 0; burst < BENCH_DATAGRAM_BURSTS; burst++) {
+        for (uint32_t i = 0; i < BENCH_DATAGRAM_BURST; i++) {
+            const uint64_t sendBegin = benchNow();
+            fwSocketSend(client, buffer, BENCH_DATAGRAM_SIZE);
+            benchSamplesAdd(&samples, benchNow() - sendBegin);
+        }
+        fwSocketReceive(client, buffer, sizeof(buffer));
+    }
+    stream.nanoseconds = benchNow() - begin;
+    stream.operations  = (uint64_t)BENCH_DATAGRAM_BURSTS * BENCH_DATAGRAM_BURST;
+    stream.bytes       = stream.operations * BENCH_DATAGRAM_SIZE;
+    benchSamplesFinish(&samples, &stream);
+    benchRecord(&stream);
+
+    pthread_join(thread, nullptr);
+    fwSocketClose(client);
+    fwSocketClose(server);
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+void benchUnitSocketChurn(void) {
+    benchResult result = {};
+    snprintf(result.name, sizeof(result.name), "socket.churn");
+    benchSamples samples;
+    benchSamplesCreate(&samples, BENCH_CHURN_SOCKETS);
+
+    // Short-lived sockets, the state of each is taken from and given back to the socket table
+    const uint64_t begin = benchNow();
+    for (uint32_t i = 0; i < BENCH_CHURN_SOCKETS; i++) {
+        const uint64_t roundBegin = benchNow();
+        fwSocket socket;
+        BENCH(fwSocketCreate(&socket, fwSocketAddressFamilyLocal, fwSocketProtocolDatagram));
+        BENCH(fwSocketClose(socket));
+        benchSamplesAdd(&samples, benchNow() - roundBegin);
+    }
+    result.nanoseconds = benchNow() - begin;
+    result.operations  = BENCH_CHURN_SOCKETS;
+    benchSamplesFinish(&samples, &result);
+    benchRecord(&result);
+}
+
+struct benchEventServer {
+    fwSocket listener;
+    fwEventLoop loop;
+    pthread_t threads[BENCH_EVENT_CONNECTIONS];
+};
+
+static void* benchEventServeConnection(void* socket_p) {
+    const fwSocket socket = (fwSocket)socket_p;
+    char buffer[BENCH_PING_SIZE];
+    for (uint32_t i = 0; i < BENCH_EVENT_ROUNDS; i++) {
+        fwSocketReceive(socket, buffer, BENCH_PING_SIZE);
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+    }
+    fwSocketClose(socket);
+    return nullptr;
+}
+
+/**
+ * @brief The baseline server, a blocking thread for every connection.
+ */
+static void* benchEventServeThreads(void* server_p) {
+    struct benchEventServer* server = server_p;
+    for (uint32_t i = 0; i < BENCH_EVENT_CONNECTIONS; i++) {
+        fwSocket socket;
+        BENCH(fwSocketAccept(server->listener, &socket, nullptr));
+        pthread_create(&server->threads[i], nullptr, benchEventServeConnection, (void*)socket);
+    }
+    for (uint32_t i = 0; i < BENCH_EVENT_CONNECTIONS; i++) {
+        pthread_join(server->threads[i], nullptr);
+    }
+    return nullptr;
+}
+
+static void benchEventEcho(fwEventLoop loop, fwSocket socket, uint32_t events, void* user_p) {
+    (void)loop;
+    (void)user_p;
+    if (events & (fwEventHangUp | fwEventError)) {
+        fwSocketClose(socket);
+        return;
+    }
+
+    char buffer[BENCH_PING_SIZE];
+    if (fwSocketReceive(socket, buffer, BENCH_PING_SIZE) == fwErrorSuccess) {
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+    }
+}
+
+static void benchEventAccept(fwEventLoop loop, fwSocket listener, uint32_t events, void* user_p) {
+    (void)events;
+    (void)user_p;
+    fwSocket socket;
+    while (fwSocketAccept(listener, &socket, nullptr) == fwErrorSuccess) {
+        BENCH(fwEventLoopAdd(loop, socket, fwEventRead, fwEventFlagNone, benchEventEcho, nullptr));
+    }
+}
+
+/**
+ * @brief The same server on one thread with an event loop.
+ */
+static void* benchEventServeLoop(void* server_p) {
+    struct benchEventServer* server = server_p;
+    BENCH(fwEventLoopAdd(server->loop, server->listener, fwEventAccept, fwEventFlagNone,
+                         benchEventAccept, nullptr));
+    BENCH(fwEventLoopRun(server->loop));
+    return nullptr;
+}
+
+struct benchEventClient {
+    uint32_t rounds;
+    uint32_t* open_p;
+};
+
+static void benchEventPing(fwEventLoop loop, fwSocket socket, uint32_t events, void* user_p) {
+    (void)events;
+    struct benchEventClient* client = user_p;
+    char buffer[BENCH_PING_SIZE] = {};
+    if (fwSocketReceive(socket, buffer, BENCH_PING_SIZE) != fwErrorSuccess) {
+        return;
+    }
+
+    if (++client->rounds < BENCH_EVENT_ROUNDS) {
+        fwSocketSend(socket, buffer, BENCH_PING_SIZE);
+        return;
+    }
+    fwSocketClose(socket);
+    if (--*client->open_p == 0) {
+        fwEventLoopStop(loop);
+    }
+}
+
+void benchUnitEventLoop(void) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    // Many connections with one message in flight each, served by threads, then by a loop on
+    // epoll and by one on io_uring
+    static const char* names_s[] = {"socket.event.threads", "socket.event.loop",
+                                    "socket.event.ring"};
+    for (uint32_t mode = 0; mode < 3; mode++) {
+        char port[8];
+        benchPort(port, mode == 2 ? 5 : 2 + mode); // 4 is taken by the sendfile server
+        const fwSocketAddress address = {.target_p = "127.0.0.1", .port_p = port};
+
+        struct benchEventServer server = {};
+        BENCH(fwSocketCreate(&server.listener, fwSocketAddressFamilyIPv4,
+                             fwSocketProtocolStream));
+        BENCH(fwSocketBind(server.listener, &address));
+        if (mode != 0) {
+            const fwEventLoopInfo info = {
+                .backend = mode == 2 ? fwEventBackendUring : fwEventBackendEpoll
+            };
+            BENCH(fwSocketSetNonBlocking(server.listener, true));
+            if (fwEventLoopCreate(&info, &server.loop) == fwErrorUnimplemented) {
+                fprintf(stderr, "Skipping %s, the kernel lacks io_uring support\n",
+                        names_s[mode]);
+                fwSocketClose(server.listener);
+                continue;
+            }
+        }
+
+        pthread_t thread;
+        pthread_create(&thread, nullptr, mode == 0 ? benchEventServeThreads : benchEventServeLoop,
+                       &server);
+
+        fwEventLoop loop;
+        BENCH(fwEventLoopCreate(nullptr, &loop));
+        struct benchEventClient clients[BENCH_EVENT_CONNECTIONS] = {};
+        uint32_t open = BENCH_EVENT_CONNECTIONS;
+        fwSocket sockets[BENCH_EVENT_CONNECTIONS];
+        for (uint32_t i = 0; i < BENCH_EVENT_CONNECTIONS; i++) {
+            BENCH(fwSocketCreate(&sockets[i], fwSocketAddressFamilyIPv4, fwSocketProtocolStream));
+            for (uint32_t attempt = 0; fwSocketConnect(sockets[i], &address) != fwErrorSuccess;
+                 attempt++) {
+                if (attempt == 1'000) {
+                    fprintf(stderr, "Could not connect to the event loop benchmark server\n");
+                    exit(1);
+                }
+                usleep(1'000);
+            }
+            BENCH(fwSocketSetNonBlocking(sockets[i], true));
+            clients[i].open_p = &open;
+            BENCH(fwEventLoopAdd(loop, sockets[i], fwEventRead, fwEventFlagNone, benchEventPing,
+                                 &clients[i]));
+        }
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        char buffer[BENCH_PING_SIZE] = {};
+        const uint64_t begin = benchNow();
+        for (uint32_t i = 0; i < BENCH_EVENT_CONNECTIONS; i++) {
+            fwSocketSend(sockets[i], buffer, BENCH_PING_SIZE);
+        }
+        BENCH(fwEventLoopRun(loop));
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = (uint64_t)BENCH_EVENT_CONNECTIONS * BENCH_EVENT_ROUNDS;
+        result.bytes       = 2 * result.operations * BENCH_PING_SIZE;
+        benchRecord(&result);
+
+        if (mode != 0) {
+            BENCH(fwEventLoopStop(server.loop));
+        }
+        pthread_join(thread, nullptr);
+        if (mode != 0) {
+            BENCH(fwEventLoopDestroy(server.loop));
+        }
+        BENCH(fwEventLoopDestroy(loop));
+        fwSocketClose(server.listener);
+    }
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+static _Atomic uint64_t benchAccepted_s;
+
+static void benchAcceptClose(fwEventLoop loop, fwSocket connection, uint32_t worker,
+                             void* user_p) {
+    (void)loop;
+    (void)worker;
+    (void)user_p;
+    fwSocketClose(connection);
+    benchAccepted_s++;
+}
+
+static void* benchAcceptConnect(void* address_p) {
+    const fwSocketAddress* address = address_p;
+    for (uint32_t i = 0; i < BENCH_ACCEPT_CONNECTIONS / BENCH_ACCEPT_THREADS; i++) {
+        fwSocket socket;
+        BENCH(fwSocketCreate(&socket, fwSocketAddressFamilyIPv4, fwSocketProtocolStream));
+        BENCH(fwSocketConnect(socket, address));
+        fwSocketClose(socket);
+    }
+    return nullptr;
+}
+
+void benchUnitServerAccept(void) {
+    BENCH(fwStartModule(fwModuleNetwork, 0));
+
+    // Short connections from several threads, accepted by one listener, then by one listener per
+    // core that the kernel steers connections to by the core they arrived on
+    static const char* names_s[] = {"socket.accept.single", "socket.accept.sharded"};
+    for (uint32_t mode = 0; mode < 2; mode++) {
+        char port[8];
+        benchPort(port, 6 + mode);
+        const fwSocketAddress address = {.target_p = "127.0.0.1", .port_p = port};
+
+        const fwServerInfo info = {
+            .address       = address,
+            .addressFamily = fwSocketAddressFamilyIPv4,
+            .workers       = mode == 0 ? 1 : 0,
+            .flags         = mode == 0 ? fwServerFlagNone :
+                             fwServerFlagPin | fwServerFlagIncomingCpu | fwServerFlagSteer,
+            .callback      = benchAcceptClose
+        };
+        fwServer server;
+        BENCH(fwServerCreate(&info, &server));
+        benchAccepted_s = 0;
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        const uint64_t begin = benchNow();
+        pthread_t threads[BENCH_ACCEPT_THREADS];
+        for (uint32_t i = 0; i < BENCH_ACCEPT_THREADS; i++) {
+            pthread_create(&threads[i], nullptr, benchAcceptConnect, (void*)&address);
+        }
+        for (uint32_t i = 0; i < BENCH_ACCEPT_THREADS; i++) {
+            pthread_join(threads[i], nullptr);
+        }
+        while (benchAccepted_s < BENCH_ACCEPT_CONNECTIONS) {
+            usleep(100);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_ACCEPT_CONNECTIONS;
+        benchRecord(&result);
+
+        BENCH(fwServerDestroy(server));
+    }
+
+    BENCH(fwStopModule(fwModuleNetwork));
+}
+
+void benchUnitLoadFile(void) {
+    static const uint64_t sizes_s[] = {4'096, 65'536, 1'048'576, 16'777'216};
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u.bin", (uint32_t)getpid());
+
+    for (uint32_t s = 0; s < sizeof(sizes_s) / sizeof(sizes_s[0]); s++) {
+        const uint64_t size = sizes_s[s];
+
+        FILE* file = fopen(path, "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "Could not create %s\n", path);
+            return;
+        }
+        char* content = malloc(size);
+        memset(content, 'L', size);
+        fwrite(content, 1, size, file);
+        fclose(file);
+        free(content);
+
+        // Reads the same amount of data for every size, but never fewer than a few files
+        uint64_t rounds = (256ull << 20) / size;
+        rounds = rounds > 10'000 ? 10'000 : rounds < 16 ? 16 : rounds;
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "file.load.%luk", (unsigned long)(size >> 10));
+        benchSamples samples;
+        benchSamplesCreate(&samples, rounds);
+
+        const uint64_t begin = benchNow();
+        for (uint64_t i = 0; i < rounds; i++) {
+            const uint64_t loadBegin = benchNow();
+            void* buffer;
+            uint64_t loaded;
+            BENCH(fwLoadFileToMem(path, &buffer, &loaded));
+            benchSamplesAdd(&samples, benchNow() - loadBegin);
+            fwFree(buffer);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = rounds;
+        result.bytes       = rounds * size;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+
+        // A mapping only costs something once it is read, so every page is touched
+        benchResult mapped = {};
+        snprintf(mapped.name, sizeof(mapped.name), "file.map.%luk", (unsigned long)(size >> 10));
+        benchSamplesCreate(&samples, rounds);
+
+        volatile uint8_t sink = 0;
+        const uint64_t mapBegin = benchNow();
+        for (uint64_t i = 0; i < rounds; i++) {
+            const uint64_t roundBegin = benchNow();
+            fwFileMapping mapping;
+            BENCH(fwMapFile(path, fwMapFileFlagSequential, &mapping));
+            for (uint64_t offset = 0; offset < mapping.size; offset += 4'096) {
+                sink += ((const uint8_t*)mapping.data_p)[offset];
+            }
+            BENCH(fwUnmapFile(&mapping));
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        mapped.nanoseconds = benchNow() - mapBegin;
+        mapped.operations  = rounds;
+        mapped.bytes       = rounds * size;
+        benchSamplesFinish(&samples, &mapped);
+        benchRecord(&mapped);
+    }
+
+    unlink(path);
+}
+
+void benchUnitChecksum(void) {
+    uint8_t* buffer = malloc(BENCH_CHECKSUM_FILE_SIZE);
+    for (uint64_t i = 0; i < BENCH_CHECKSUM_FILE_SIZE; i++) {
+        buffer[i] = (uint8_t)(i * 2'654'435'761u >> 13);
+    }
+
+    // The kernels on a buffer that stays in the cache, the portable CRC as the baseline
+    static const char* names_s[] = {"checksum.crc32c.software", "checksum.crc32c",
+                                    "checksum.xxhash64"};
+    for (uint32_t mode = 0; mode < 3; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, BENCH_CHECKSUM_ROUNDS);
+
+        volatile uint64_t sink = 0;
+        const uint64_t begin = benchNow();
+        for (uint32_t round = 0; round < BENCH_CHECKSUM_ROUNDS; round++) {
+            const uint64_t roundBegin = benchNow();
+            uint64_t value;
+            if (mode == 0) {
+                value = fwiChecksumCrc32cSoftware(0xFFFF'FFFF, buffer, BENCH_CHECKSUM_SIZE);
+            }
+            else {
+                BENCH(fwChecksumCompute(mode == 1 ? fwChecksumTypeCrc32c : fwChecksumTypeXxHash64,
+                                        buffer, BENCH_CHECKSUM_SIZE, &value));
+            }
+            sink += value;
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_CHECKSUM_ROUNDS;
+        result.bytes       = (uint64_t)BENCH_CHECKSUM_ROUNDS * BENCH_CHECKSUM_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u-checksum.bin", (uint32_t)getpid());
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not create %s\n", path);
+        free(buffer);
+        return;
+    }
+    fwrite(buffer, 1, BENCH_CHECKSUM_FILE_SIZE, file);
+    fclose(file);
+    free(buffer);
+
+    // Loading then summing the whole buffer against summing every piece as it arrives
+    static const char* loadNames_s[] = {"file.load.checksum.twopass", "file.load.checksum.fused"};
+    const uint32_t rounds = 32;
+    for (uint32_t mode = 0; mode < 2; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", loadNames_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, rounds);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t round = 0; round < rounds; round++) {
+            const uint64_t roundBegin = benchNow();
+            void* loaded;
+            uint64_t size, value;
+            if (mode == 0) {
+                BENCH(fwLoadFileToMem(path, &loaded, &size));
+                BENCH(fwChecksumCompute(fwChecksumTypeCrc32c, loaded, size, &value));
+            }
+            else {
+                BENCH(fwLoadFileToMemChecksum(path, fwChecksumTypeCrc32c, &loaded, &size,
+                                              &value));
+            }
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+            fwFree(loaded);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = rounds;
+        result.bytes       = rounds * BENCH_CHECKSUM_FILE_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    unlink(path);
+}
+
+void benchUnitLoadFiles(void) {
+    const uint32_t fileCount = 256;
+    const uint32_t rounds    = 32;
+
+    char* names = malloc((size_t)fileCount * 64);
+    const char** filenames = malloc(fileCount * sizeof(const char*));
+    fwLoadedFile* files = malloc(fileCount * sizeof(fwLoadedFile));
+    char content[BENCH_LOAD_FILES_SIZE];
+    memset(content, 'L', sizeof(content));
+
+    for (uint32_t i = 0; i < fileCount; i++) {
+        filenames[i] = names + (size_t)i * 64;
+        snprintf(names + (size_t)i * 64, 64, "/tmp/lpafBench-%u-%u.bin", (uint32_t)getpid(), i);
+        FILE* file = fopen(filenames[i], "wb");
+        if (file == nullptr) {
+            fprintf(stderr, "Could not create %s\n", filenames[i]);
+            break;
+        }
+        fwrite(content, 1, sizeof(content), file);
+        fclose(file);
+    }
+
+    // One after another with fwLoadFileToMem as the baseline, then every mode of fwLoadFiles
+    static const char* names_s[] = {"file.batch.serial", "file.batch.default",
+                                    "file.batch.packed", "file.batch.threadpool"};
+    static const uint32_t flags_s[] = {0, fwLoadFilesFlagNone, fwLoadFilesFlagPacked,
+                                       fwLoadFilesFlagThreadPool};
+
+    for (uint32_t mode = 0; mode < 4; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, rounds);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t round = 0; round < rounds; round++) {
+            const uint64_t roundBegin = benchNow();
+            if (mode == 0) {
+                for (uint32_t i = 0; i < fileCount; i++) {
+                    BENCH(fwLoadFileToMem(filenames[i], &files[i].buffer_p, &files[i].size));
+                }
+            }
+            else {
+                void* packed;
+                BENCH(fwLoadFiles(filenames, fileCount, flags_s[mode], files, &packed));
+                if (packed != nullptr) {
+                    fwFree(packed);
+                    for (uint32_t i = 0; i < fileCount; i++) {
+                        files[i].buffer_p = nullptr;
+                    }
+                }
+            }
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+
+            for (uint32_t i = 0; i < fileCount; i++) {
+                fwFree(files[i].buffer_p);
+            }
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = rounds;
+        result.bytes       = (uint64_t)rounds * fileCount * BENCH_LOAD_FILES_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    for (uint32_t i = 0; i < fileCount; i++) {
+        unlink(filenames[i]);
+    }
+    free(files);
+    free(filenames);
+    free(names);
+}
+
+void benchUnitFileQueue(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u.queue", (uint32_t)getpid());
+
+    FILE* file = fopen(path, "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "Could not create %s\n", path);
+        return;
+    }
+    char* content = calloc(1, BENCH_QUEUE_CHUNK);
+    for (uint64_t written = 0; written < BENCH_QUEUE_FILE_SIZE; written += BENCH_QUEUE_CHUNK) {
+        fwrite(content, 1, BENCH_QUEUE_CHUNK, file);
+    }
+    fclose(file);
+    free(content);
+
+    // Every read of a pass goes to its own slot of one buffer, which is registered with the queue
+    uint8_t* buffer = malloc(BENCH_QUEUE_CHUNK * BENCH_QUEUE_DEPTH);
+    const uint64_t chunks = BENCH_QUEUE_FILE_SIZE / BENCH_QUEUE_CHUNK;
+
+    for (uint32_t threadPool = 0; threadPool < 2; threadPool++) {
+        fwFile input;
+        fwFileQueue queue;
+        BENCH(fwFileOpen(path, fwFileOpenFlagNone, &input));
+        BENCH(fwFileQueueCreate(BENCH_QUEUE_DEPTH, threadPool ? fwFileQueueFlagThreadPool : 0,
+                                &queue));
+        const fwFileBuffer registered = {buffer, BENCH_QUEUE_CHUNK * BENCH_QUEUE_DEPTH};
+        fwFileQueueRegisterBuffers(queue, &registered, 1);
+        fwFileQueueRegisterFiles(queue, &input, 1);
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "file.queue.%s",
+                 threadPool ? "threadpool" : "default");
+        benchSamples samples;
+        benchSamplesCreate(&samples, chunks);
+        uint64_t* submittedAt = calloc(BENCH_QUEUE_DEPTH, sizeof(uint64_t));
+
+        const uint64_t begin = benchNow();
+        uint64_t next = 0, completed = 0;
+        while (completed < chunks) {
+            while (next < chunks && next - completed < BENCH_QUEUE_DEPTH) {
+                const uint64_t slot = next % BENCH_QUEUE_DEPTH;
+                const fwFileRead read = {.file     = input,
+                                         .buffer_p = buffer + slot * BENCH_QUEUE_CHUNK,
+                                         .offset   = next * BENCH_QUEUE_CHUNK,
+                                         .size     = BENCH_QUEUE_CHUNK,
+                                         .userData = slot};
+                uint32_t submitted = 0;
+                fwFileQueueSubmit(queue, &read, 1, &submitted);
+                if (submitted == 0) {
+                    break;
+                }
+                submittedAt[slot] = benchNow();
+                next++;
+            }
+
+            fwFileCompletion completions[BENCH_QUEUE_DEPTH];
+            uint32_t count = 0;
+            BENCH(fwFileQueueComplete(queue, completions, BENCH_QUEUE_DEPTH, 1, &count));
+            for (uint32_t i = 0; i < count; i++) {
+                benchSamplesAdd(&samples, benchNow() - submittedAt[completions[i].userData]);
+            }
+            completed += count;
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = chunks;
+        result.bytes       = BENCH_QUEUE_FILE_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+
+        free(submittedAt);
+        BENCH(fwFileQueueDestroy(queue));
+        BENCH(fwFileClose(input));
+    }
+
+    free(buffer);
+
+    // The stream hands out chunks in order and reads the next one while the current is consumed.
+    // Buffered reads come from the page cache here, direct reads always go to the device
+    for (uint32_t direct = 0; direct < 2; direct++) {
+        benchResult streamed = {};
+        snprintf(streamed.name, sizeof(streamed.name), direct ? "file.stream.direct" :
+                                                                "file.stream");
+        benchSamples samples;
+        benchSamplesCreate(&samples, chunks * 4);
+
+        const fwFileStreamInfo info = {.flags = direct ? fwFileStreamFlagDirect :
+                                                         fwFileStreamFlagNone};
+        volatile uint8_t sink = 0;
+        const uint64_t begin = benchNow();
+        fwFileStream stream;
+        BENCH(fwFileStreamOpen(path, &info, &stream));
+        while (true) {
+            const uint64_t nextBegin = benchNow();
+            const void* chunk;
+            uint64_t size;
+            BENCH(fwFileStreamNext(stream, &chunk, &size));
+            if (size == 0) {
+                break;
+            }
+            benchSamplesAdd(&samples, benchNow() - nextBegin);
+            for (uint64_t offset = 0; offset < size; offset += 4'096) {
+                sink += ((const uint8_t*)chunk)[offset];
+            }
+            streamed.operations++;
+            streamed.bytes += size;
+        }
+        BENCH(fwFileStreamClose(stream));
+        streamed.nanoseconds = benchNow() - begin;
+        benchSamplesFinish(&samples, &streamed);
+        benchRecord(&streamed);
+    }
+
+    unlink(path);
+}
+
+static _Atomic uint64_t benchWalkEntries_s;
+
+static void benchWalkReaddir(const char* path_p) {
+    DIR* directory = opendir(path_p);
+    if (directory == nullptr) {
+        return;
+    }
+
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != nullptr) {
+        if (entry->d_name[0] == '.') {
+            continue;
+        }
+
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s", path_p, entry->d_name);
+        struct stat stats;
+        if (lstat(path, &stats) == 0) {
+            if (S_ISDIR(stats.st_mode)) {
+                benchWalkReaddir(path);
+            }
+            else if (S_ISREG(stats.st_mode)) {
+                atomic_fetch_add(&benchWalkEntries_s, 1);
+            }
+        }
+    }
+    closedir(directory);
+}
+
+static bool benchWalkCount(fwWalkBatch* batch_p, void* user_p) {
+    (void)user_p;
+    atomic_fetch_add(&benchWalkEntries_s, batch_p->count);
+    return true;
+}
+
+void benchUnitWalkDirectory(void) {
+    const uint32_t rounds = 16;
+
+    char root[64];
+    snprintf(root, sizeof(root), "/tmp/lpafBench-%u-walk", (uint32_t)getpid());
+    mkdir(root, 0700);
+
+    char content[256];
+    memset(content, 'W', sizeof(content));
+    for (uint32_t d = 0; d < BENCH_WALK_DIRECTORIES; d++) {
+        char path[128];
+        snprintf(path, sizeof(path), "%s/%u", root, d);
+        mkdir(path, 0700);
+        for (uint32_t f = 0; f < BENCH_WALK_FILES; f++) {
+            snprintf(path, sizeof(path), "%s/%u/%u.bin", root, d, f);
+            FILE* file = fopen(path, "wb");
+            if (file != nullptr) {
+                fwrite(content, 1, sizeof(content), file);
+                fclose(file);
+            }
+        }
+    }
+
+    // readdir with a stat per entry as the baseline, then fwWalkDirectory on one and on all threads
+    static const char* names_s[] = {"file.walk.readdir", "file.walk.single", "file.walk.parallel",
+                                    "file.walk.load"};
+    static const uint32_t threads_s[] = {0, 1, 0, 0};
+
+    for (uint32_t mode = 0; mode < 4; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, rounds);
+
+        atomic_store(&benchWalkEntries_s, 0);
+        const uint64_t begin = benchNow();
+        for (uint32_t round = 0; round < rounds; round++) {
+            const uint64_t roundBegin = benchNow();
+            if (mode == 0) {
+                benchWalkReaddir(root);
+            }
+            else {
+                const fwWalkInfo info = {
+                    .flags    = mode == 3 ? fwWalkFlagLoad : fwWalkFlagNone,
+                    .threads  = threads_s[mode],
+                    .callback = benchWalkCount
+                };
+                BENCH(fwWalkDirectory(root, &info));
+            }
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = atomic_load(&benchWalkEntries_s);
+        result.bytes       = mode == 3 ? result.operations * sizeof(content) : 0;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    for (uint32_t d = 0; d < BENCH_WALK_DIRECTORIES; d++) {
+        char path[128];
+        for (uint32_t f = 0; f < BENCH_WALK_FILES; f++) {
+            snprintf(path, sizeof(path), "%s/%u/%u.bin", root, d, f);
+            unlink(path);
+        }
+        snprintf(path, sizeof(path), "%s/%u", root, d);
+        rmdir(path);
+    }
+    rmdir(root);
+}
+
+struct benchCacheThread {
+    pthread_t thread;
+    benchSamples samples;
+    const char* names_p;
+};
+
+static void* benchCacheLookUp(void* thread_p) {
+    struct benchCacheThread* thread = thread_p;
+
+    for (uint32_t i = 0; i < BENCH_CACHE_LOOKUPS; i++) {
+        const uint64_t begin = (i & 15) == 0 ? benchNow() : 0;
+        const void* data;
+        uint64_t size;
+        BENCH(fwFileCacheGet(thread->names_p + (i % BENCH_CACHE_FILES) * 64, &data, &size));
+        BENCH(fwFileCacheRelease(data));
+        if ((i & 15) == 0) {
+            benchSamplesAdd(&thread->samples, benchNow() - begin);
+        }
+    }
+    return nullptr;
+}
+
+void benchUnitFileCache(void) {
+    static const uint32_t threadCounts_s[] = {1, 4};
+
+    char* names = malloc(BENCH_CACHE_FILES * 64);
+    char content[BENCH_LOAD_FILES_SIZE];
+    memset(content, 'C', sizeof(content));
+    for (uint32_t i = 0; i < BENCH_CACHE_FILES; i++) {
+        snprintf(names + i * 64, 64, "/tmp/lpafBench-%u-cache-%u", (uint32_t)getpid(), i);
+        FILE* file = fopen(names + i * 64, "wb");
+        if (file != nullptr) {
+            fwrite(content, 1, sizeof(content), file);
+            fclose(file);
+        }
+    }
+
+    // Hits only, the first lookup of every file is a miss that is not worth measuring
+    for (uint32_t i = 0; i < BENCH_CACHE_FILES; i++) {
+        const void* data;
+        uint64_t size;
+        BENCH(fwFileCacheGet(names + i * 64, &data, &size));
+        BENCH(fwFileCacheRelease(data));
+    }
+
+    for (uint32_t c = 0; c < sizeof(threadCounts_s) / sizeof(threadCounts_s[0]); c++) {
+        const uint32_t threadCount = threadCounts_s[c];
+        struct benchCacheThread threads[4];
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "file.cache.hit.%ut", threadCount);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t i = 0; i < threadCount; i++) {
+            threads[i].names_p = names;
+            benchSamplesCreate(&threads[i].samples, BENCH_CACHE_LOOKUPS / 16 + 1);
+            pthread_create(&threads[i].thread, nullptr, benchCacheLookUp, &threads[i]);
+        }
+
+        benchSamples samples;
+        benchSamplesCreate(&samples, threadCount * (BENCH_CACHE_LOOKUPS / 16 + 1));
+        for (uint32_t i = 0; i < threadCount; i++) {
+            pthread_join(threads[i].thread, nullptr);
+            for (uint64_t s = 0; s < threads[i].samples.count; s++) {
+                benchSamplesAdd(&samples, threads[i].samples.values_p[s]);
+            }
+            free(threads[i].samples.values_p);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = (uint64_t)threadCount * BENCH_CACHE_LOOKUPS;
+        result.bytes       = result.operations * BENCH_LOAD_FILES_SIZE;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    BENCH(fwFileCacheClear());
+    for (uint32_t i = 0; i < BENCH_CACHE_FILES; i++) {
+        unlink(names + i * 64);
+    }
+    free(names);
+}
+
+struct benchWriterThread {
+    pthread_t thread;
+    benchSamples samples;
+    fwFileWriter writer;
+    int32_t fileDescriptor;
+    pthread_mutex_t* mutex_p;
+};
+
+/**
+ * @brief What a journal did before the writer existed, every record written and synced on its own
+ *        under a lock.
+ */
+static void* benchWriterSyncEach(void* thread_p) {
+    struct benchWriterThread* thread = thread_p;
+    char record[BENCH_WRITER_RECORD];
+    memset(record, 'J', sizeof(record));
+
+    for (uint32_t i = 0; i < BENCH_WRITER_DURABLE; i++) {
+        const uint64_t begin = benchNow();
+        pthread_mutex_lock(thread->mutex_p);
+        if (write(thread->fileDescriptor, record, sizeof(record)) != sizeof(record) ||
+            fdatasync(thread->fileDescriptor) != 0) {
+            fprintf(stderr, "Writing the sync benchmark file failed\n");
+        }
+        pthread_mutex_unlock(thread->mutex_p);
+        benchSamplesAdd(&thread->samples, benchNow() - begin);
+    }
+    return nullptr;
+}
+
+static void* benchWriterGroupCommit(void* thread_p) {
+    struct benchWriterThread* thread = thread_p;
+    char record[BENCH_WRITER_RECORD];
+    memset(record, 'J', sizeof(record));
+
+    for (uint32_t i = 0; i < BENCH_WRITER_DURABLE; i++) {
+        const uint64_t begin = benchNow();
+        uint64_t sequence;
+        BENCH(fwFileWriterAppend(thread->writer, record, sizeof(record), &sequence));
+        BENCH(fwFileWriterWait(thread->writer, sequence, true));
+        benchSamplesAdd(&thread->samples, benchNow() - begin);
+    }
+    return nullptr;
+}
+
+void benchUnitFileWriter(void) {
+    char path[64];
+    snprintf(path, sizeof(path), "/tmp/lpafBench-%u.journal", (uint32_t)getpid());
+
+    // Durable records from several threads, synced one by one and then through group commit
+    for (uint32_t grouped = 0; grouped < 2; grouped++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), grouped ? "file.writer.groupcommit" :
+                                                             "file.writer.synceach");
+
+        pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+        struct benchWriterThread threads[BENCH_WRITER_THREADS] = {};
+        fwFileWriter writer = 0;
+        int32_t fileDescriptor = -1;
+        if (grouped) {
+            const fwFileWriterInfo info = {.flags = fwFileWriterFlagTruncate};
+            BENCH(fwFileWriterOpen(path, &info, &writer));
+        }
+        else {
+            fileDescriptor = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+        }
+
+        const uint64_t begin = benchNow();
+        for (uint32_t i = 0; i < BENCH_WRITER_THREADS; i++) {
+            threads[i].writer         = writer;
+            threads[i].fileDescriptor = fileDescriptor;
+            threads[i].mutex_p        = &mutex;
+            benchSamplesCreate(&threads[i].samples, BENCH_WRITER_DURABLE);
+            pthread_create(&threads[i].thread, nullptr,
+                           grouped ? benchWriterGroupCommit : benchWriterSyncEach, &threads[i]);
+        }
+
+        benchSamples samples;
+        benchSamplesCreate(&samples, BENCH_WRITER_THREADS * BENCH_WRITER_DURABLE);
+        for (uint32_t i = 0; i < BENCH_WRITER_THREADS; i++) {
+            pthread_join(threads[i].thread, nullptr);
+            for (uint64_t s = 0; s < threads[i].samples.count; s++) {
+                benchSamplesAdd(&samples, threads[i].samples.values_p[s]);
+            }
+            free(threads[i].samples.values_p);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_WRITER_THREADS * BENCH_WRITER_DURABLE;
+        result.bytes       = result.operations * BENCH_WRITER_RECORD;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+
+        if (grouped) {
+            BENCH(fwFileWriterClose(writer));
+        }
+        else {
+            close(fileDescriptor);
+        }
+    }
+
+    // Appends without waiting only cost the copy, the writer merges them into large writes
+    benchResult appended = {.name = "file.writer.append"};
+    benchSamples samples;
+    benchSamplesCreate(&samples, BENCH_WRITER_RECORDS / 16);
+
+    const fwFileWriterInfo info = {.flags = fwFileWriterFlagTruncate};
+    fwFileWriter writer;
+    BENCH(fwFileWriterOpen(path, &info, &writer));
+    char record[BENCH_WRITER_RECORD];
+    memset(record, 'A', sizeof(record));
+
+    const uint64_t begin = benchNow();
+    for (uint32_t i = 0; i < BENCH_WRITER_RECORDS; i++) {
+        if ((i & 15) == 0) {
+            const uint64_t appendBegin = benchNow();
+            BENCH(fwFileWriterAppend(writer, record, sizeof(record), nullptr));
+            benchSamplesAdd(&samples, benchNow() - appendBegin);
+        }
+        else {
+            BENCH(fwFileWriterAppend(writer, record, sizeof(record), nullptr));
+        }
+    }
+    BENCH(fwFileWriterClose(writer)); // the data is on the device
+    appended.nanoseconds = benchNow() - begin;
+    appended.operations  = BENCH_WRITER_RECORDS;
+    appended.bytes       = (uint64_t)BENCH_WRITER_RECORDS * BENCH_WRITER_RECORD;
+    benchSamplesFinish(&samples, &appended);
+    benchRecord(&appended);
+
+    unlink(path);
+}
+
+struct benchLoggerThread {
+    pthread_t thread;
+    benchSamples samples;
+    uint32_t index;
+};
+
+static void* benchLoggerProduce(void* thread_p) {
+    struct benchLoggerThread* thread = thread_p;
+
+    // Timing every call would cost as much as the call itself, every 16th is plenty
+    for (uint32_t i = 0; i < BENCH_LOGGER_MESSAGES; i++) {
+        if ((i & 15) == 0) {
+            const uint64_t begin = benchNow();
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelBench, "Benchmark message %u from thread %u",
+                      i, thread->index);
+            benchSamplesAdd(&thread->samples, benchNow() - begin);
+        }
+        else {
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelBench, "Benchmark message %u from thread %u",
+                      i, thread->index);
+        }
+    }
+    return nullptr;
+}
+
+void benchUnitLogger(void) {
+    static const uint32_t threadCounts_s[] = {1, 2, 4, 8};
+
+    // Blocking measures what the flusher sustains instead of how fast messages can be dropped
+    BENCH(fwSetLogOverflowPolicy(fwLogOverflowPolicyBlock));
+
+    for (uint32_t c = 0; c < sizeof(threadCounts_s) / sizeof(threadCounts_s[0]); c++) {
+        const uint32_t threadCount = threadCounts_s[c];
+        struct benchLoggerThread threads[8];
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "logger.threads%u", threadCount);
+
+        const uint64_t begin = benchNow();
+        for (uint32_t t = 0; t < threadCount; t++) {
+            threads[t].index = t;
+            benchSamplesCreate(&threads[t].samples, BENCH_LOGGER_MESSAGES / 16 + 1);
+            pthread_create(&threads[t].thread, nullptr, benchLoggerProduce, &threads[t]);
+        }
+
+        benchSamples samples;
+        benchSamplesCreate(&samples, (uint64_t)threadCount * (BENCH_LOGGER_MESSAGES / 16 + 1));
+        for (uint32_t t = 0; t < threadCount; t++) {
+            pthread_join(threads[t].thread, nullptr);
+            for (uint64_t i = 0; i < threads[t].samples.count; i++) {
+                benchSamplesAdd(&samples, threads[t].samples.values_p[i]);
+            }
+            free(threads[t].samples.values_p);
+        }
+
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = (uint64_t)threadCount * BENCH_LOGGER_MESSAGES;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    BENCH(fwSetLogOverflowPolicy(fwLogOverflowPolicyDrop));
+}
+
+void benchUnitAllocator(void) {
+    fwArena arena;
+    fwPool pool;
+    const fwAllocator* arenaAllocator;
+    const fwAllocator* poolAllocator;
+    BENCH(fwArenaCreate(0, &arena));
+    BENCH(fwArenaGetAllocator(arena, &arenaAllocator));
+    BENCH(fwPoolCreate(0, &pool));
+    BENCH(fwPoolGetAllocator(pool, &poolAllocator));
+
+    // A request takes a handful of small buffers and gives all of them back at its end
+    static const char* names_s[] = {"alloc.malloc", "alloc.arena", "alloc.pool"};
+    for (uint32_t mode = 0; mode < 3; mode++) {
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        benchSamples samples;
+        benchSamplesCreate(&samples, BENCH_ALLOC_REQUESTS);
+
+        void* buffers[BENCH_ALLOC_PER_REQUEST];
+        uint64_t sizes[BENCH_ALLOC_PER_REQUEST];
+        const uint64_t begin = benchNow();
+        for (uint32_t request = 0; request < BENCH_ALLOC_REQUESTS; request++) {
+            const uint64_t roundBegin = benchNow();
+            for (uint32_t i = 0; i < BENCH_ALLOC_PER_REQUEST; i++) {
+                sizes[i] = 16 + (i * 2'654'435'761u >> 7) % 2'032;
+                if (mode == 0) {
+                    buffers[i] = malloc(sizes[i]);
+                }
+                else if (mode == 1) {
+                    buffers[i] = arenaAllocator->allocate(arenaAllocator->context_p, sizes[i], 16);
+                }
+                else {
+                    buffers[i] = poolAllocator->allocate(poolAllocator->context_p, sizes[i], 16);
+                }
+                *(volatile uint8_t*)buffers[i] = (uint8_t)i;
+            }
+
+            if (mode == 0) {
+                for (uint32_t i = 0; i < BENCH_ALLOC_PER_REQUEST; i++) {
+                    free(buffers[i]);
+                }
+            }
+            else if (mode == 1) {
+                BENCH(fwArenaReset(arena));
+            }
+            else {
+                for (uint32_t i = 0; i < BENCH_ALLOC_PER_REQUEST; i++) {
+                    poolAllocator->release(poolAllocator->context_p, buffers[i], sizes[i], 16);
+                }
+            }
+            benchSamplesAdd(&samples, benchNow() - roundBegin);
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = (uint64_t)BENCH_ALLOC_REQUESTS * BENCH_ALLOC_PER_REQUEST;
+        benchSamplesFinish(&samples, &result);
+        benchRecord(&result);
+    }
+
+    BENCH(fwPoolDestroy(pool));
+    BENCH(fwArenaDestroy(arena));
+}
+
+void benchUnitLargeBuffer(void) {
+    // Reads scattered over a buffer far larger than the TLB covers with normal pages
+    static const char* names_s[] = {"memory.scan.malloc", "memory.scan.large"};
+    for (uint32_t mode = 0; mode < 2; mode++) {
+        fwLargeBuffer large = {};
+        uint64_t* buffer;
+        if (mode == 0) {
+            buffer = malloc(BENCH_LARGE_SIZE);
+        }
+        else {
+            BENCH(fwAllocLarge(BENCH_LARGE_SIZE, nullptr, &large));
+            buffer = large.data_p;
+        }
+        memset(buffer, 1, BENCH_LARGE_SIZE);
+
+        benchResult result = {};
+        snprintf(result.name, sizeof(result.name), "%s", names_s[mode]);
+        uint64_t sink = 0;
+        uint64_t index = 0;
+        const uint64_t mask = BENCH_LARGE_SIZE / sizeof(uint64_t) - 1;
+        const uint64_t begin = benchNow();
+        for (uint32_t i = 0; i < BENCH_LARGE_READS; i++) {
+            index = (index * 6'364'136'223'846'793'005ull + 1'442'695'040'888'963'407ull) & mask;
+            sink += buffer[index];
+        }
+        result.nanoseconds = benchNow() - begin;
+        result.operations  = BENCH_LARGE_READS;
+        benchRecord(&result);
+        *(volatile uint64_t*)buffer = sink;
+
+        if (mode == 0) {
+            free(buffer);
+        }
+        else {
+            BENCH(fwFreeLarge(&large));
+        }
+    }
+}
+
+void benchUnitModule(void) {
+    benchResult result = {.name = "module.network.startstop"};
+    benchSamples samples;
+    benchSamplesCreate(&samples, BENCH_MODULE_ROUNDS);
+
+    const uint64_t begin = benchNow();
+    for (uint32_t i = 0; i < BENCH_MODULE_ROUNDS; i++) {
+        const uint64_t roundBegin = benchNow();
+        BENCH(fwStartModule(fwModuleNetwork, 0));
+        BENCH(fwStopModule(fwModuleNetwork));
+        benchSamplesAdd(&samples, benchNow() - roundBegin);
+    }
+    result.nanoseconds = benchNow() - begin;
+    result.operations  = BENCH_MODULE_ROUNDS;
+    benchSamplesFinish(&samples, &result);
+    benchRecord(&result);
+}
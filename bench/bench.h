@@ -0,0 +1,160 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+#ifndef LPAF_BENCH_H
+#define LPAF_BENCH_H
+
+#include "framework.h"
+
+#define BENCH(f) \
+    { fwError e = 0; if ((e = f) != 0) { benchLogFrameworkFail(e, __func__, __LINE__); } }
+
+/**
+ * @brief Outcome of one benchmark, latencies are in nanoseconds per operation.
+ * @param name Unique, dot-separated name that results are matched by between runs
+ * @param operations Number of timed operations
+ * @param bytes Payload moved by all operations, zero if the benchmark does not move data
+ * @param nanoseconds Wall time of all operations
+ */
+typedef struct benchResult {
+    char name[64];
+    uint64_t operations;
+    uint64_t bytes;
+    uint64_t nanoseconds;
+    fwProfileStats latency;
+} benchResult;
+
+/**
+ * @brief Collects per-operation latencies of a benchmark.
+ */
+typedef struct benchSamples {
+    uint64_t* values_p;
+    uint64_t count;
+    uint64_t capacity;
+} benchSamples;
+
+void benchLogFrameworkFail(
+    fwError error,
+    const char* location,
+    int32_t line);
+
+uint64_t benchNow(
+    void
+    );
+
+void benchSamplesCreate(
+    benchSamples* samples_p,
+    uint64_t capacity
+    );
+
+void benchSamplesAdd(
+    benchSamples* samples_p,
+    uint64_t nanoseconds
+    );
+
+/**
+ * @brief Sorts the samples into the latency of a result and frees them.
+ */
+void benchSamplesFinish(
+    benchSamples* samples_p,
+    benchResult* result_p
+    );
+
+/**
+ * @brief Prints a result and keeps it for @c benchWriteJson .
+ */
+void benchRecord(
+    const benchResult* result_p
+    );
+
+/**
+ * @brief Writes all recorded results as JSON, so that runs of different releases can be diffed.
+ */
+fwError benchWriteJson(
+    const char* filename_p
+    );
+
+void benchUnitSocketStream(
+    fwSocketAddressFamily addressFamily
+    );
+
+void benchUnitSocketVector(
+    void
+    );
+
+void benchUnitSocketSendFile(
+    void
+    );
+
+void benchUnitSocketDatagram(
+    void
+    );
+
+void benchUnitSocketChurn(
+    void
+    );
+
+void benchUnitEventLoop(
+    void
+    );
+
+void benchUnitServerAccept(
+    void
+    );
+
+void benchUnitLoadFile(
+    void
+    );
+
+void benchUnitChecksum(
+    void
+    );
+
+void benchUnitLoadFiles(
+    void
+    );
+
+void benchUnitWalkDirectory(
+    void
+    );
+
+void benchUnitFileCache(
+    void
+    );
+
+void benchUnitFileQueue(
+    void
+    );
+
+void benchUnitFileWriter(
+    void
+    );
+
+void benchUnitLogger(
+    void
+    );
+
+void benchUnitAllocator(
+    void
+    );
+
+void benchUnitLargeBuffer(
+    void
+    );
+
+void benchUnitModule(
+    void
+    );
+
+#endif //LPAF_BENCH_H
@@ -0,0 +1,51 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// Runs every benchmark and writes the results to the file given as the first argument, or to
+// lpafBench.json. Compare the files of two builds to spot regressions.
+
+#include <stdio.h>
+
+#include "framework.h"
+#include "bench.h"
+
+int main(int argc, char* argv[]) {
+    const char* output = argc > 1 ? argv[1] : "lpafBench.json";
+
+    benchUnitSocketStream(fwSocketAddressFamilyIPv4);
+    benchUnitSocketStream(fwSocketAddressFamilyLocal);
+    benchUnitSocketVector();
+    benchUnitSocketSendFile();
+    benchUnitSocketDatagram();
+    benchUnitSocketChurn();
+    benchUnitEventLoop();
+    benchUnitServerAccept();
+    benchUnitLoadFile();
+    benchUnitChecksum();
+    benchUnitLoadFiles();
+    benchUnitWalkDirectory();
+    benchUnitFileCache();
+    benchUnitFileQueue();
+    benchUnitFileWriter();
+    benchUnitLogger();
+    benchUnitAllocator();
+    benchUnitLargeBuffer();
+    benchUnitModule();
+
+    fwStopAllModules();
+
+    BENCH(benchWriteJson(output));
+    fprintf(stderr, "Results written to %s\n", output);
+    return 0;
+}
@@ -0,0 +1,419 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the platform independant allocator
+// interface and the arena and pool allocators that come with it
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framework.h"
+#include "internal.h"
+
+#define FWI_ARENA_DEFAULT_BLOCK (1ull << 20)
+#define FWI_POOL_DEFAULT_MAX 4'096
+#define FWI_POOL_LIMIT (1u << 20)
+#define FWI_POOL_MIN_SHIFT 4
+#define FWI_POOL_CLASSES 17
+
+/**
+ * @brief Size of the chunks a pool class is refilled with, or a single element if it is larger.
+ */
+#define FWI_POOL_CHUNK (64u << 10)
+
+/**
+ * @brief Header in front of every buffer from @c fwiAllocate , right before the buffer.
+ * @param allocator_p Allocator the buffer came from, nullptr for malloc
+ * @param size Size of the whole allocation, header and padding included
+ * @param padding Distance from the start of the allocation to the buffer
+ */
+struct fwiAllocation {
+    const fwAllocator* allocator_p;
+    uint64_t size;
+    uint32_t padding;
+    uint32_t alignment;
+};
+
+/**
+ * @brief A block of an arena, the data follows the header.
+ */
+struct fwiArenaBlock {
+    struct fwiArenaBlock* next;
+    uint64_t size;
+};
+
+/**
+ * @brief State behind an @c fwArena handle.
+ * @param current_p Block allocations are taken from, blocks after it are free
+ * @param offset Bytes of the current block in use
+ */
+struct fwiArena {
+    fwAllocator allocator;
+    struct fwiArenaBlock* first_p;
+    struct fwiArenaBlock* current_p;
+    uint64_t offset;
+    uint64_t blockSize;
+};
+
+/**
+ * @brief A free element of a pool class, the link is kept in the element itself.
+ */
+struct fwiPoolElement {
+    struct fwiPoolElement* next;
+};
+
+/**
+ * @brief One size class of a pool.
+ */
+struct fwiPoolClass {
+    alignas(64) pthread_mutex_t mutex;
+    struct fwiPoolElement* free_p;
+};
+
+/**
+ * @brief State behind an @c fwPool handle.
+ * @param chunks_p Every chunk taken from malloc, linked through their first bytes
+ */
+struct fwiPool {
+    fwAllocator allocator;
+    struct fwiPoolClass classes[FWI_POOL_CLASSES];
+    uint32_t classCount;
+    pthread_mutex_t chunkMutex;
+    void* chunks_p;
+};
+
+static thread_local const fwAllocator* threadAllocator_s = nullptr;
+
+void* fwiAllocate(const fwiLogDomain domain, const uint64_t size, uint64_t alignment) {
+    const fwAllocator* allocator = threadAllocator_s;
+    if (allocator == nullptr) {
+        allocator = atomic_load_explicit(&fwiGetState()->allocators[domain], memory_order_acquire);
+    }
+
+    // The header sits in the padding, which keeps the buffer at the requested alignment
+    alignment = alignment < 16 ? 16 : alignment;
+    const uint64_t padding = alignment < 32 ? 32 : alignment;
+    const uint64_t total = padding + size;
+
+    uint8_t* memory;
+    if (allocator != nullptr) {
+        memory = allocator->allocate(allocator->context_p, total, alignment);
+    }
+    else if (alignment <= 16) {
+        memory = malloc(total);
+    }
+    else {
+        memory = aligned_alloc(alignment, (total + alignment - 1) & ~(alignment - 1));
+    }
+    if (memory == nullptr) {
+        return nullptr;
+    }
+
+    struct fwiAllocation* header = (struct fwiAllocation*)(memory + padding) - 1;
+    header->allocator_p = allocator;
+    header->size        = total;
+    header->padding     = (uint32_t)padding;
+    header->alignment   = (uint32_t)alignment;
+    return memory + padding;
+}
+
+fwError fwFree(void* memory_p) {
+    if (memory_p == nullptr) {
+        return fwErrorSuccess;
+    }
+
+    const struct fwiAllocation* header = (struct fwiAllocation*)memory_p - 1;
+    const fwAllocator* allocator = header->allocator_p;
+    uint8_t* memory = (uint8_t*)memory_p - header->padding;
+
+    if (allocator == nullptr) {
+        free(memory);
+    }
+    else if (allocator->release != nullptr) {
+        allocator->release(allocator->context_p, memory, header->size, header->alignment);
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwSetAllocator(const fwAllocator* allocator_p) {
+    for (uint8_t domain = 0; domain < fwiLogDomainCount; domain++) {
+        atomic_store_explicit(&fwiGetState()->allocators[domain], allocator_p,
+                              memory_order_release);
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwSetModuleAllocator(const fwModule module, const fwAllocator* allocator_p) {
+    const fwiLogDomain domain = fwiLogDomainOf(module);
+    if (domain == fwiLogDomainCount) {
+        return fwErrorInvalidParameter;
+    }
+
+    atomic_store_explicit(&fwiGetState()->allocators[domain], allocator_p, memory_order_release);
+    return fwErrorSuccess;
+}
+
+fwError fwSetThreadAllocator(const fwAllocator* allocator_p) {
+    threadAllocator_s = allocator_p;
+    return fwErrorSuccess;
+}
+
+static uint64_t fwiArenaAlign(const struct fwiArenaBlock* block_p, const uint64_t offset,
+                              const uint64_t alignment) {
+    // The data only starts 16 byte aligned, larger alignments are made up for within the block
+    const uintptr_t data = (uintptr_t)(block_p + 1);
+    return ((data + offset + alignment - 1) & ~(uintptr_t)(alignment - 1)) - data;
+}
+
+static void* fwiArenaAllocate(void* arena_p, const uint64_t size, const uint64_t alignment) {
+    struct fwiArena* arena = arena_p;
+
+    if (arena->current_p != nullptr) {
+        const uint64_t offset = fwiArenaAlign(arena->current_p, arena->offset, alignment);
+        if (offset + size <= arena->current_p->size) {
+            arena->offset = offset + size;
+            return (uint8_t*)(arena->current_p + 1) + offset;
+        }
+    }
+
+    // Blocks kept from before the last reset are used again if they are large enough
+    struct fwiArenaBlock* block = arena->current_p != nullptr ? arena->current_p->next :
+                                                                arena->first_p;
+    struct fwiArenaBlock* previous = arena->current_p;
+    while (block != nullptr && block->size < size + alignment) {
+        previous = block;
+        block = block->next;
+    }
+
+    if (block == nullptr) {
+        const uint64_t blockSize = size + alignment > arena->blockSize ? size + alignment :
+                                                                         arena->blockSize;
+        if ((block = malloc(sizeof(struct fwiArenaBlock) + blockSize)) == nullptr) {
+            return nullptr;
+        }
+        block->size = blockSize;
+        block->next = nullptr;
+        if (previous != nullptr) {
+            previous->next = block;
+        }
+        else {
+            arena->first_p = block;
+        }
+    }
+
+    const uint64_t offset = fwiArenaAlign(block, 0, alignment);
+    arena->current_p = block;
+    arena->offset    = offset + size;
+    return (uint8_t*)(block + 1) + offset;
+}
+
+static void fwiArenaRelease(void* arena_p, void* memory_p, const uint64_t size,
+                            const uint64_t alignment) {
+    (void)alignment; // the padding in front of the allocation stays until the reset
+    struct fwiArena* arena = arena_p;
+
+    // Only the latest allocation can be taken back, everything else waits for the reset
+    if (arena->current_p == nullptr) {
+        return;
+    }
+    const uint8_t* data = (const uint8_t*)(arena->current_p + 1);
+    if ((uint8_t*)memory_p + size == data + arena->offset) {
+        arena->offset = (uint8_t*)memory_p - data;
+    }
+}
+
+fwError fwArenaCreate(const uint64_t blockSize, fwArena* arena_p) {
+    struct fwiArena* arena = calloc(1, sizeof(struct fwiArena));
+    if (arena == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+
+    arena->allocator = (fwAllocator){
+        .allocate  = fwiArenaAllocate,
+        .release   = fwiArenaRelease,
+        .context_p = arena
+    };
+    arena->blockSize = blockSize != 0 ? blockSize : FWI_ARENA_DEFAULT_BLOCK;
+
+    *arena_p = (uintptr_t)arena;
+    return fwErrorSuccess;
+}
+
+fwError fwArenaGetAllocator(const fwArena arena, const fwAllocator** allocator_pp) {
+    struct fwiArena* nativeArena = {(struct fwiArena*)arena};
+    if (nativeArena == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    *allocator_pp = &nativeArena->allocator;
+    return fwErrorSuccess;
+}
+
+fwError fwArenaReset(const fwArena arena) {
+    struct fwiArena* nativeArena = {(struct fwiArena*)arena};
+    if (nativeArena == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    nativeArena->current_p = nativeArena->first_p;
+    nativeArena->offset    = 0;
+    return fwErrorSuccess;
+}
+
+fwError fwArenaDestroy(const fwArena arena) {
+    struct fwiArena* nativeArena = {(struct fwiArena*)arena};
+    if (nativeArena == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiArenaBlock* block = nativeArena->first_p;
+    while (block != nullptr) {
+        struct fwiArenaBlock* next = block->next;
+        free(block);
+        block = next;
+    }
+    free(nativeArena);
+    return fwErrorSuccess;
+}
+
+static uint32_t fwiPoolClassOf(const uint64_t size) {
+    if (size <= 1u << FWI_POOL_MIN_SHIFT) {
+        return 0;
+    }
+    return 64 - __builtin_clzll(size - 1) - FWI_POOL_MIN_SHIFT;
+}
+
+static void* fwiPoolAllocate(void* pool_p, const uint64_t size, const uint64_t alignment) {
+    struct fwiPool* pool = pool_p;
+
+    // Elements are aligned to their size up to a cache line, anything else goes to malloc
+    const uint32_t index = fwiPoolClassOf(size);
+    const uint64_t elementSize = 1ull << (index + FWI_POOL_MIN_SHIFT);
+    if (index >= pool->classCount || alignment > (elementSize < 64 ? elementSize : 64)) {
+        return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    }
+
+    struct fwiPoolClass* class = &pool->classes[index];
+    pthread_mutex_lock(&class->mutex);
+    struct fwiPoolElement* element = class->free_p;
+    if (element != nullptr) {
+        class->free_p = element->next;
+        pthread_mutex_unlock(&class->mutex);
+        return element;
+    }
+    pthread_mutex_unlock(&class->mutex);
+
+    // Refill the class with a whole chunk, its first cache line links it into the chunk list
+    const uint64_t chunkSize = elementSize > FWI_POOL_CHUNK ? elementSize : FWI_POOL_CHUNK;
+    uint8_t* chunk = aligned_alloc(64, 64 + chunkSize);
+    if (chunk == nullptr) {
+        return nullptr;
+    }
+    pthread_mutex_lock(&pool->chunkMutex);
+    *(void**)chunk = pool->chunks_p;
+    pool->chunks_p = chunk;
+    pthread_mutex_unlock(&pool->chunkMutex);
+
+    uint8_t* elements = chunk + 64;
+    const uint64_t count = chunkSize / elementSize;
+    for (uint64_t i = 1; i + 1 < count; i++) {
+        ((struct fwiPoolElement*)(elements + i * elementSize))->next =
+            (struct fwiPoolElement*)(elements + (i + 1) * elementSize);
+    }
+
+    if (count > 1) {
+        struct fwiPoolElement* last = (struct fwiPoolElement*)(elements +
+                                                               (count - 1) * elementSize);
+        pthread_mutex_lock(&class->mutex);
+        last->next = class->free_p;
+        class->free_p = (struct fwiPoolElement*)(elements + elementSize);
+        pthread_mutex_unlock(&class->mutex);
+    }
+    return elements;
+}
+
+static void fwiPoolRelease(void* pool_p, void* memory_p, const uint64_t size,
+                           const uint64_t alignment) {
+    struct fwiPool* pool = pool_p;
+
+    const uint32_t index = fwiPoolClassOf(size);
+    const uint64_t elementSize = 1ull << (index + FWI_POOL_MIN_SHIFT);
+    if (index >= pool->classCount || alignment > (elementSize < 64 ? elementSize : 64)) {
+        free(memory_p);
+        return;
+    }
+
+    struct fwiPoolClass* class = &pool->classes[index];
+    struct fwiPoolElement* element = memory_p;
+    pthread_mutex_lock(&class->mutex);
+    element->next = class->free_p;
+    class->free_p = element;
+    pthread_mutex_unlock(&class->mutex);
+}
+
+fwError fwPoolCreate(const uint32_t maxSize, fwPool* pool_p) {
+    if (maxSize > FWI_POOL_LIMIT) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiPool* pool = aligned_alloc(alignof(struct fwiPool), sizeof(struct fwiPool));
+    if (pool == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    memset(pool, 0, sizeof(struct fwiPool));
+
+    pool->allocator = (fwAllocator){
+        .allocate  = fwiPoolAllocate,
+        .release   = fwiPoolRelease,
+        .context_p = pool
+    };
+    pool->classCount = fwiPoolClassOf(maxSize != 0 ? maxSize : FWI_POOL_DEFAULT_MAX) + 1;
+    for (uint32_t i = 0; i < FWI_POOL_CLASSES; i++) {
+        pthread_mutex_init(&pool->classes[i].mutex, nullptr);
+    }
+    pthread_mutex_init(&pool->chunkMutex, nullptr);
+
+    *pool_p = (uintptr_t)pool;
+    return fwErrorSuccess;
+}
+
+fwError fwPoolGetAllocator(const fwPool pool, const fwAllocator** allocator_pp) {
+    struct fwiPool* nativePool = {(struct fwiPool*)pool};
+    if (nativePool == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    *allocator_pp = &nativePool->allocator;
+    return fwErrorSuccess;
+}
+
+fwError fwPoolDestroy(const fwPool pool) {
+    struct fwiPool* nativePool = {(struct fwiPool*)pool};
+    if (nativePool == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    void* chunk = nativePool->chunks_p;
+    while (chunk != nullptr) {
+        void* next = *(void**)chunk;
+        free(chunk);
+        chunk = next;
+    }
+    for (uint32_t i = 0; i < FWI_POOL_CLASSES; i++) {
+        pthread_mutex_destroy(&nativePool->classes[i].mutex);
+    }
+    pthread_mutex_destroy(&nativePool->chunkMutex);
+    free(nativePool);
+    return fwErrorSuccess;
+}
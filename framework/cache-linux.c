@@ -0,0 +1,560 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific, process-wide file
+// cache, which learns about changed files through inotify
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+/**
+ * @brief Number of independently locked parts of the cache and the hash buckets of each.
+ */
+#define FWI_FILE_CACHE_SHARDS 16
+#define FWI_FILE_CACHE_BUCKETS 256
+#define FWI_FILE_CACHE_DEFAULT_BUDGET (64ull << 20)
+
+/**
+ * @brief Changes that make a cached file stale. Replacing a file by renaming another over it
+ *        shows up as a change of the link count.
+ */
+#define FWI_FILE_CACHE_EVENTS (IN_MODIFY | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE_SELF | \
+                               IN_MOVE_SELF)
+
+/**
+ * @brief Header in front of the contents handed out by the cache. The cache holds one reference
+ *        for as long as the file is cached, every caller of @c fwFileCacheGet holds another.
+ * @param watch inotify watch of the file, shared by every path that leads to the same file
+ * @param lastUsed Profiler ticks of the last hit, the smallest is evicted first
+ * @param next Next file in the same hash bucket
+ */
+struct fwiCachedFile {
+    alignas(16) _Atomic uint32_t references;
+    int32_t watch;
+    uint64_t hash;
+    uint64_t size;
+    _Atomic uint64_t lastUsed;
+    struct fwiCachedFile* next;
+    char* filename_p;
+};
+
+/**
+ * @brief One independently locked part of the cache, a path always maps to the same shard.
+ */
+struct fwiFileCacheShard {
+    alignas(64) pthread_rwlock_t lock;
+    struct fwiCachedFile* buckets[FWI_FILE_CACHE_BUCKETS];
+    _Atomic uint64_t hits;
+    _Atomic uint64_t misses;
+    uint64_t files;
+};
+
+static struct fwiFileCacheShard cacheShards_s[FWI_FILE_CACHE_SHARDS];
+static pthread_once_t cacheShardsOnce_s = PTHREAD_ONCE_INIT;
+
+static pthread_mutex_t cacheMutex_s = PTHREAD_MUTEX_INITIALIZER; // Starting and stopping only
+static _Atomic bool cacheIsUp_s = false;
+static int32_t cacheNotify_s = -1;
+static int32_t cacheStop_s = -1;
+static pthread_t cacheWatcher_s;
+
+static _Atomic uint64_t cacheBudget_s = FWI_FILE_CACHE_DEFAULT_BUDGET;
+static _Atomic uint64_t cacheBytes_s = 0;
+static _Atomic uint64_t cacheEvictions_s = 0;
+static _Atomic uint64_t cacheInvalidations_s = 0;
+
+/**
+ * @brief Counts handled change events, a load that sees it change may have missed an event for
+ *        its own file and does not cache what it read.
+ */
+static _Atomic uint64_t cacheGeneration_s = 0;
+
+static void fwiFileCacheInitShards(void) {
+    for (uint32_t i = 0; i < FWI_FILE_CACHE_SHARDS; i++) {
+        pthread_rwlock_init(&cacheShards_s[i].lock, nullptr);
+    }
+}
+
+static uint64_t fwiFileCacheHash(const char* filename_p) {
+    uint64_t hash = 14'695'981'039'346'656'037ull; // FNV-1a
+    for (; *filename_p != '\0'; filename_p++) {
+        hash = (hash ^ (uint8_t)*filename_p) * 1'099'511'628'211ull;
+    }
+    return hash;
+}
+
+static void fwiFileCacheUnreference(struct fwiCachedFile* file_p) {
+    if (atomic_fetch_sub_explicit(&file_p->references, 1, memory_order_acq_rel) == 1) {
+        free(file_p->filename_p);
+        free(file_p);
+    }
+}
+
+/**
+ * @brief Checks whether any cached file still uses a watch, callers hold no shard lock.
+ */
+static bool fwiFileCacheWatchInUse(const int32_t watch) {
+    for (uint32_t s = 0; s < FWI_FILE_CACHE_SHARDS; s++) {
+        struct fwiFileCacheShard* shard = &cacheShards_s[s];
+        bool found = false;
+
+        pthread_rwlock_rdlock(&shard->lock);
+        for (uint32_t b = 0; b < FWI_FILE_CACHE_BUCKETS && !found; b++) {
+            for (struct fwiCachedFile* file = shard->buckets[b]; file != nullptr && !found;
+                 file = file->next) {
+                found = file->watch == watch;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+
+        if (found) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @brief Drops every cached file that uses a watch.
+ */
+static void fwiFileCacheInvalidate(const int32_t watch) {
+    atomic_fetch_add_explicit(&cacheGeneration_s, 1, memory_order_acq_rel);
+
+    for (uint32_t s = 0; s < FWI_FILE_CACHE_SHARDS; s++) {
+        struct fwiFileCacheShard* shard = &cacheShards_s[s];
+        struct fwiCachedFile* dropped = nullptr;
+
+        pthread_rwlock_wrlock(&shard->lock);
+        for (uint32_t b = 0; b < FWI_FILE_CACHE_BUCKETS; b++) {
+            struct fwiCachedFile** link = &shard->buckets[b];
+            while (*link != nullptr) {
+                struct fwiCachedFile* file = *link;
+                if (file->watch != watch) {
+                    link = &file->next;
+                    continue;
+                }
+                *link = file->next;
+                file->next = dropped;
+                dropped = file;
+                shard->files--;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+
+        // Freed outside the lock, the last reference may be held by somebody else anyway
+        while (dropped != nullptr) {
+            struct fwiCachedFile* file = dropped;
+            dropped = file->next;
+            atomic_fetch_sub_explicit(&cacheBytes_s, file->size, memory_order_relaxed);
+            atomic_fetch_add_explicit(&cacheInvalidations_s, 1, memory_order_relaxed);
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelDebug, "%s changed and left the file cache",
+                      file->filename_p);
+            fwiFileCacheUnreference(file);
+        }
+    }
+}
+
+/**
+ * @brief Drops every cached file.
+ * @param counter_p Counter to add the dropped files to, may be nullptr
+ */
+static void fwiFileCacheDropAll(_Atomic uint64_t* counter_p) {
+    for (uint32_t s = 0; s < FWI_FILE_CACHE_SHARDS; s++) {
+        struct fwiFileCacheShard* shard = &cacheShards_s[s];
+        struct fwiCachedFile* dropped = nullptr;
+
+        pthread_rwlock_wrlock(&shard->lock);
+        for (uint32_t b = 0; b < FWI_FILE_CACHE_BUCKETS; b++) {
+            while (shard->buckets[b] != nullptr) {
+                struct fwiCachedFile* file = shard->buckets[b];
+                shard->buckets[b] = file->next;
+                file->next = dropped;
+                dropped = file;
+            }
+        }
+        shard->files = 0;
+        pthread_rwlock_unlock(&shard->lock);
+
+        while (dropped != nullptr) {
+            struct fwiCachedFile* file = dropped;
+            dropped = file->next;
+            atomic_fetch_sub_explicit(&cacheBytes_s, file->size, memory_order_relaxed);
+            if (counter_p != nullptr) {
+                atomic_fetch_add_explicit(counter_p, 1, memory_order_relaxed);
+            }
+            fwiFileCacheUnreference(file);
+        }
+    }
+}
+
+static void* fwiFileCacheWatch(void* unused_p) {
+    (void)unused_p;
+
+    alignas(struct inotify_event) char events[4'096];
+    struct pollfd descriptors[2] = {{.fd = cacheNotify_s, .events = POLLIN},
+                                    {.fd = cacheStop_s, .events = POLLIN}};
+
+    while (true) {
+        if (poll(descriptors, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            FWI_LOG_ERRNO;
+            break;
+        }
+        if (descriptors[1].revents != 0) {
+            break;
+        }
+
+        const ssize_t length = read(cacheNotify_s, events, sizeof(events));
+        if (length <= 0) {
+            continue;
+        }
+
+        for (ssize_t offset = 0; offset < length;) {
+            const struct inotify_event* event = (const struct inotify_event*)(events + offset);
+            offset += sizeof(struct inotify_event) + event->len;
+
+            // An overflowed queue lost events, only dropping everything is safe then
+            if (event->mask & IN_Q_OVERFLOW) {
+                atomic_fetch_add_explicit(&cacheGeneration_s, 1, memory_order_acq_rel);
+                fwiFileCacheDropAll(&cacheInvalidations_s);
+                continue;
+            }
+
+            if (event->mask & (FWI_FILE_CACHE_EVENTS | IN_IGNORED)) {
+                fwiFileCacheInvalidate(event->wd);
+                if (!(event->mask & IN_IGNORED)) {
+                    inotify_rm_watch(cacheNotify_s, event->wd);
+                }
+            }
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Starts watching for changes, files are only cached while this runs.
+ */
+static bool fwiFileCacheStart(void) {
+    pthread_once(&cacheShardsOnce_s, fwiFileCacheInitShards);
+    if (atomic_load_explicit(&cacheIsUp_s, memory_order_acquire)) {
+        return true;
+    }
+
+    pthread_mutex_lock(&cacheMutex_s);
+    if (!atomic_load_explicit(&cacheIsUp_s, memory_order_relaxed)) {
+        cacheNotify_s = inotify_init1(IN_CLOEXEC);
+        cacheStop_s   = eventfd(0, EFD_CLOEXEC);
+
+        if (cacheNotify_s == -1 || cacheStop_s == -1 ||
+            pthread_create(&cacheWatcher_s, nullptr, fwiFileCacheWatch, nullptr) != 0) {
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelWarning,
+                      "Can not watch files for changes, the file cache is disabled");
+            if (cacheNotify_s != -1) {
+                close(cacheNotify_s);
+            }
+            if (cacheStop_s != -1) {
+                close(cacheStop_s);
+            }
+            cacheNotify_s = cacheStop_s = -1;
+        }
+        else {
+            atomic_store_explicit(&cacheIsUp_s, true, memory_order_release);
+        }
+    }
+    pthread_mutex_unlock(&cacheMutex_s);
+
+    return atomic_load_explicit(&cacheIsUp_s, memory_order_acquire);
+}
+
+/**
+ * @brief Loads a file behind a fresh header holding one reference.
+ */
+static fwError fwiFileCacheLoad(const char* filename_p, struct fwiCachedFile** file_pp) {
+    const int32_t fileDescriptor = open(filename_p, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor == -1) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats)) {
+        close(fileDescriptor);
+        return fwErrorFileStats;
+    }
+
+    struct fwiCachedFile* file = malloc(sizeof(struct fwiCachedFile) + fileStats.st_size);
+    char* filename = strdup(filename_p);
+    if (file == nullptr || filename == nullptr) {
+        free(filename);
+        free(file);
+        close(fileDescriptor);
+        return fwErrorOutOfMemory;
+    }
+
+    uint64_t done = 0;
+    while (done < (uint64_t)fileStats.st_size) {
+        const ssize_t result = pread(fileDescriptor, (uint8_t*)(file + 1) + done,
+                                     fileStats.st_size - done, (off_t)done);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result == -1) {
+            free(filename);
+            free(file);
+            close(fileDescriptor);
+            return fwErrorFileRead;
+        }
+        if (result == 0) { // the file shrank
+            break;
+        }
+        done += result;
+    }
+    close(fileDescriptor);
+
+    atomic_init(&file->references, 1);
+    atomic_init(&file->lastUsed, fwiProfileTicks());
+    file->watch      = -1;
+    file->hash       = fwiFileCacheHash(filename_p);
+    file->size       = done;
+    file->next       = nullptr;
+    file->filename_p = filename;
+
+    *file_pp = file;
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Drops the least recently used files until the cache fits its budget.
+ */
+static void fwiFileCacheEvict(void) {
+    while (atomic_load_explicit(&cacheBytes_s, memory_order_relaxed) >
+           atomic_load_explicit(&cacheBudget_s, memory_order_relaxed)) {
+        uint64_t oldestUse = UINT64_MAX;
+        uint64_t oldestHash = 0;
+        uint32_t oldestShard = 0;
+        char* oldestName = nullptr;
+
+        // Only the key of the oldest file is kept, it may be freed once the lock is let go
+        for (uint32_t s = 0; s < FWI_FILE_CACHE_SHARDS; s++) {
+            const struct fwiCachedFile* candidate = nullptr;
+            pthread_rwlock_rdlock(&cacheShards_s[s].lock);
+            for (uint32_t b = 0; b < FWI_FILE_CACHE_BUCKETS; b++) {
+                for (struct fwiCachedFile* file = cacheShards_s[s].buckets[b]; file != nullptr;
+                     file = file->next) {
+                    const uint64_t lastUsed = atomic_load_explicit(&file->lastUsed,
+                                                                   memory_order_relaxed);
+                    if (lastUsed < oldestUse) {
+                        candidate = file;
+                        oldestUse = lastUsed;
+                    }
+                }
+            }
+            if (candidate != nullptr) {
+                free(oldestName);
+                oldestName  = strdup(candidate->filename_p);
+                oldestHash  = candidate->hash;
+                oldestShard = s;
+            }
+            pthread_rwlock_unlock(&cacheShards_s[s].lock);
+        }
+        if (oldestName == nullptr) {
+            return;
+        }
+
+        // Another thread may have dropped it in the meantime, it is only unlinked if still there.
+        // A file that was used or loaded again since is no longer the oldest and stays.
+        struct fwiFileCacheShard* shard = &cacheShards_s[oldestShard];
+        struct fwiCachedFile* oldest = nullptr;
+        pthread_rwlock_wrlock(&shard->lock);
+        for (struct fwiCachedFile** link = &shard->buckets[oldestHash % FWI_FILE_CACHE_BUCKETS];
+             *link != nullptr; link = &(*link)->next) {
+            struct fwiCachedFile* file = *link;
+            if (file->hash == oldestHash && strcmp(file->filename_p, oldestName) == 0) {
+                if (atomic_load_explicit(&file->lastUsed, memory_order_relaxed) == oldestUse) {
+                    *link = file->next;
+                    shard->files--;
+                    oldest = file;
+                }
+                break;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        free(oldestName);
+
+        if (oldest != nullptr) {
+            const int32_t watch = oldest->watch;
+            atomic_fetch_sub_explicit(&cacheBytes_s, oldest->size, memory_order_relaxed);
+            atomic_fetch_add_explicit(&cacheEvictions_s, 1, memory_order_relaxed);
+            fwiFileCacheUnreference(oldest);
+
+            if (!fwiFileCacheWatchInUse(watch)) {
+                inotify_rm_watch(cacheNotify_s, watch);
+            }
+        }
+    }
+}
+
+fwError fwFileCacheGet(const char* filename_p, const void** data_pp, uint64_t* size_p) {
+    const bool caching = fwiFileCacheStart();
+    const uint64_t hash = fwiFileCacheHash(filename_p);
+    struct fwiFileCacheShard* shard = &cacheShards_s[(hash >> 32) % FWI_FILE_CACHE_SHARDS];
+    const uint32_t bucket = hash % FWI_FILE_CACHE_BUCKETS;
+
+    if (caching) {
+        pthread_rwlock_rdlock(&shard->lock);
+        for (struct fwiCachedFile* file = shard->buckets[bucket]; file != nullptr;
+             file = file->next) {
+            if (file->hash == hash && strcmp(file->filename_p, filename_p) == 0) {
+                atomic_fetch_add_explicit(&file->references, 1, memory_order_relaxed);
+                atomic_store_explicit(&file->lastUsed, fwiProfileTicks(), memory_order_relaxed);
+                pthread_rwlock_unlock(&shard->lock);
+
+                atomic_fetch_add_explicit(&shard->hits, 1, memory_order_relaxed);
+                *data_pp = file + 1;
+                *size_p  = file->size;
+                return fwErrorSuccess;
+            }
+        }
+        pthread_rwlock_unlock(&shard->lock);
+        atomic_fetch_add_explicit(&shard->misses, 1, memory_order_relaxed);
+    }
+
+    // Watching starts before reading, so a change during the read is never missed
+    const uint64_t generation = atomic_load_explicit(&cacheGeneration_s, memory_order_acquire);
+    const int32_t watch = caching ? inotify_add_watch(cacheNotify_s, filename_p,
+                                                      FWI_FILE_CACHE_EVENTS) : -1;
+
+    struct fwiCachedFile* file;
+    const fwError ret = fwiFileCacheLoad(filename_p, &file);
+    if (ret != fwErrorSuccess) {
+        // inotify hands out one watch per inode, a cached hard link may still rely on it
+        if (watch != -1 && !fwiFileCacheWatchInUse(watch)) {
+            inotify_rm_watch(cacheNotify_s, watch);
+        }
+        return ret;
+    }
+    file->watch = watch;
+
+    if (watch != -1 && file->size <= atomic_load_explicit(&cacheBudget_s, memory_order_relaxed)) {
+        pthread_rwlock_wrlock(&shard->lock);
+
+        struct fwiCachedFile* existing = shard->buckets[bucket];
+        while (existing != nullptr &&
+               (existing->hash != hash || strcmp(existing->filename_p, filename_p) != 0)) {
+            existing = existing->next;
+        }
+
+        // Another thread loaded the same file first, its copy is shared instead
+        if (existing != nullptr) {
+            atomic_fetch_add_explicit(&existing->references, 1, memory_order_relaxed);
+            pthread_rwlock_unlock(&shard->lock);
+            fwiFileCacheUnreference(file);
+            *data_pp = existing + 1;
+            *size_p  = existing->size;
+            return fwErrorSuccess;
+        }
+
+        if (atomic_load_explicit(&cacheGeneration_s, memory_order_acquire) == generation) {
+            atomic_fetch_add_explicit(&file->references, 1, memory_order_relaxed);
+            file->next = shard->buckets[bucket];
+            shard->buckets[bucket] = file;
+            shard->files++;
+            atomic_fetch_add_explicit(&cacheBytes_s, file->size, memory_order_relaxed);
+        }
+        pthread_rwlock_unlock(&shard->lock);
+
+        fwiFileCacheEvict();
+    }
+
+    *data_pp = file + 1;
+    *size_p  = file->size;
+    return fwErrorSuccess;
+}
+
+fwError fwFileCacheRelease(const void* data_p) {
+    if (data_p == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    fwiFileCacheUnreference((struct fwiCachedFile*)data_p - 1);
+    return fwErrorSuccess;
+}
+
+fwError fwFileCacheSetBudget(const uint64_t bytes) {
+    atomic_store_explicit(&cacheBudget_s, bytes, memory_order_relaxed);
+    pthread_once(&cacheShardsOnce_s, fwiFileCacheInitShards);
+    fwiFileCacheEvict();
+    return fwErrorSuccess;
+}
+
+fwError fwFileCacheGetStats(fwFileCacheStats* stats_p) {
+    pthread_once(&cacheShardsOnce_s, fwiFileCacheInitShards);
+    memset(stats_p, 0, sizeof(fwFileCacheStats));
+
+    for (uint32_t s = 0; s < FWI_FILE_CACHE_SHARDS; s++) {
+        stats_p->hits   += atomic_load_explicit(&cacheShards_s[s].hits, memory_order_relaxed);
+        stats_p->misses += atomic_load_explicit(&cacheShards_s[s].misses, memory_order_relaxed);
+
+        pthread_rwlock_rdlock(&cacheShards_s[s].lock);
+        stats_p->files += cacheShards_s[s].files;
+        pthread_rwlock_unlock(&cacheShards_s[s].lock);
+    }
+
+    stats_p->evictions     = atomic_load_explicit(&cacheEvictions_s, memory_order_relaxed);
+    stats_p->invalidations = atomic_load_explicit(&cacheInvalidations_s, memory_order_relaxed);
+    stats_p->bytes         = atomic_load_explicit(&cacheBytes_s, memory_order_relaxed);
+    return fwErrorSuccess;
+}
+
+fwError fwFileCacheClear(void) {
+    pthread_once(&cacheShardsOnce_s, fwiFileCacheInitShards);
+
+    pthread_mutex_lock(&cacheMutex_s);
+    if (atomic_load_explicit(&cacheIsUp_s, memory_order_relaxed)) {
+        const uint64_t stop = 1;
+        if (write(cacheStop_s, &stop, sizeof(stop)) != sizeof(stop)) {
+            FWI_LOG_ERRNO;
+        }
+        pthread_join(cacheWatcher_s, nullptr);
+        atomic_store_explicit(&cacheIsUp_s, false, memory_order_release);
+    }
+
+    fwiFileCacheDropAll(nullptr);
+
+    // Closing the inotify instance removes all of its watches
+    if (cacheNotify_s != -1) {
+        close(cacheNotify_s);
+        close(cacheStop_s);
+        cacheNotify_s = cacheStop_s = -1;
+    }
+    pthread_mutex_unlock(&cacheMutex_s);
+
+    return fwErrorSuccess;
+}
+
+#endif // PLATFORM_LINUX
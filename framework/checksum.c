@@ -0,0 +1,399 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the platform independant checksums, the
+// processor specific variants are picked at run time
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#if defined(PLATFORM_LINUX)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+#include "framework.h"
+#include "internal.h"
+
+/**
+ * @brief Reversed CRC-32C polynomial.
+ */
+#define FWI_CRC32C_POLYNOMIAL 0x82F6'3B78u
+
+/**
+ * @brief Bytes per lane when three independent CRCs are run side by side to hide the latency of
+ *        the CRC instruction, the lanes are merged with precomputed shifts afterwards.
+ */
+#define FWI_CRC32C_LANE 1'024
+
+#define FWI_XXH64_PRIME1 0x9E37'79B1'85EB'CA87ull
+#define FWI_XXH64_PRIME2 0xC2B2'AE3D'27D4'EB4Full
+#define FWI_XXH64_PRIME3 0x1656'67B1'9E37'79F9ull
+#define FWI_XXH64_PRIME4 0x85EB'CA77'C2B2'AE63ull
+#define FWI_XXH64_PRIME5 0x27D4'EB2F'1656'67C5ull
+
+#if defined(__aarch64__) && defined(__clang__)
+#define FWI_TARGET_CRC __attribute__((target("crc")))
+#elif defined(__aarch64__)
+#define FWI_TARGET_CRC __attribute__((target("+crc")))
+#endif
+
+typedef uint32_t (*fwiCrc32cFunction)(uint32_t crc, const uint8_t* data_p, size_t size);
+
+static pthread_once_t checksumOnce_s = PTHREAD_ONCE_INIT;
+static fwiCrc32cFunction checksumCrc32c_s = fwiChecksumCrc32cSoftware;
+static uint32_t checksumTable_s[8][256];
+
+// Multiplication by x^(8 * lane) and x^(16 * lane) modulo the polynomial, one table per byte
+static uint32_t checksumShiftLane_s[4][256];
+static uint32_t checksumShiftTwoLanes_s[4][256];
+
+static uint64_t fwiReadLittle64(const uint8_t* data_p) {
+    uint64_t value;
+    memcpy(&value, data_p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap64(value);
+#endif
+    return value;
+}
+
+static uint32_t fwiReadLittle32(const uint8_t* data_p) {
+    uint32_t value;
+    memcpy(&value, data_p, sizeof(value));
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+    value = __builtin_bswap32(value);
+#endif
+    return value;
+}
+
+/**
+ * @brief Multiplies two polynomials modulo the CRC-32C polynomial, both in reversed bit order.
+ */
+static uint32_t fwiCrc32cMultiply(uint32_t a, uint32_t b) {
+    uint32_t product = 0;
+    for (uint32_t bit = 1u << 31; bit != 0; bit >>= 1) {
+        if (a & bit) {
+            product ^= b;
+        }
+        b = b & 1 ? (b >> 1) ^ FWI_CRC32C_POLYNOMIAL : b >> 1;
+    }
+    return product;
+}
+
+/**
+ * @brief Computes x^(8 * bytes) modulo the polynomial by repeated squaring.
+ */
+static uint32_t fwiCrc32cPower(uint64_t bytes) {
+    uint32_t power = 1u << 31;   // x^0
+    uint32_t square = 1u << 23;  // x^8, one byte
+    for (; bytes != 0; bytes >>= 1) {
+        if (bytes & 1) {
+            power = fwiCrc32cMultiply(square, power);
+        }
+        square = fwiCrc32cMultiply(square, square);
+    }
+    return power;
+}
+
+/**
+ * @brief Tabulates the multiplication by a constant, it is linear so each byte is looked up on
+ *        its own.
+ */
+static void fwiCrc32cTabulateShift(uint32_t table_p[4][256], const uint32_t factor) {
+    for (uint32_t byte = 0; byte < 4; byte++) {
+        for (uint32_t value = 0; value < 256; value++) {
+            table_p[byte][value] = fwiCrc32cMultiply(factor, value << (byte * 8));
+        }
+    }
+}
+
+static uint32_t fwiCrc32cShift(const uint32_t table_p[4][256], const uint32_t crc) {
+    return table_p[0][crc & 0xFF] ^ table_p[1][(crc >> 8) & 0xFF] ^
+           table_p[2][(crc >> 16) & 0xFF] ^ table_p[3][crc >> 24];
+}
+
+uint32_t fwiChecksumCrc32cSoftware(uint32_t crc, const uint8_t* data_p, size_t size) {
+    // Slicing by eight, one lookup per byte but eight of them independent of each other
+    for (; size >= 8; size -= 8, data_p += 8) {
+        const uint64_t word = fwiReadLittle64(data_p) ^ crc;
+        crc = checksumTable_s[7][word & 0xFF] ^ checksumTable_s[6][(word >> 8) & 0xFF] ^
+              checksumTable_s[5][(word >> 16) & 0xFF] ^ checksumTable_s[4][(word >> 24) & 0xFF] ^
+              checksumTable_s[3][(word >> 32) & 0xFF] ^ checksumTable_s[2][(word >> 40) & 0xFF] ^
+              checksumTable_s[1][(word >> 48) & 0xFF] ^ checksumTable_s[0][word >> 56];
+    }
+    for (; size != 0; size--, data_p++) {
+        crc = checksumTable_s[0][(crc ^ *data_p) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t fwiChecksumCrc32cSse42(uint32_t crc, const uint8_t* data_p, size_t size) {
+    for (; size != 0 && ((uintptr_t)data_p & 7); size--, data_p++) {
+        crc = _mm_crc32_u8(crc, *data_p);
+    }
+
+    for (; size >= 3 * FWI_CRC32C_LANE; size -= 3 * FWI_CRC32C_LANE,
+                                        data_p += 3 * FWI_CRC32C_LANE) {
+        uint64_t first = crc, second = 0, third = 0;
+        for (uint32_t i = 0; i < FWI_CRC32C_LANE; i += 8) {
+            first  = _mm_crc32_u64(first, fwiReadLittle64(data_p + i));
+            second = _mm_crc32_u64(second, fwiReadLittle64(data_p + FWI_CRC32C_LANE + i));
+            third  = _mm_crc32_u64(third, fwiReadLittle64(data_p + 2 * FWI_CRC32C_LANE + i));
+        }
+        crc = fwiCrc32cShift(checksumShiftTwoLanes_s, (uint32_t)first) ^
+              fwiCrc32cShift(checksumShiftLane_s, (uint32_t)second) ^ (uint32_t)third;
+    }
+
+    uint64_t wide = crc;
+    for (; size >= 8; size -= 8, data_p += 8) {
+        wide = _mm_crc32_u64(wide, fwiReadLittle64(data_p));
+    }
+    crc = (uint32_t)wide;
+    for (; size != 0; size--, data_p++) {
+        crc = _mm_crc32_u8(crc, *data_p);
+    }
+    return crc;
+}
+#elif defined(__aarch64__)
+FWI_TARGET_CRC
+static uint32_t fwiChecksumCrc32cArm(uint32_t crc, const uint8_t* data_p, size_t size) {
+    for (; size != 0 && ((uintptr_t)data_p & 7); size--, data_p++) {
+        crc = __crc32cb(crc, *data_p);
+    }
+
+    for (; size >= 3 * FWI_CRC32C_LANE; size -= 3 * FWI_CRC32C_LANE,
+                                        data_p += 3 * FWI_CRC32C_LANE) {
+        uint32_t first = crc, second = 0, third = 0;
+        for (uint32_t i = 0; i < FWI_CRC32C_LANE; i += 8) {
+            first  = __crc32cd(first, fwiReadLittle64(data_p + i));
+            second = __crc32cd(second, fwiReadLittle64(data_p + FWI_CRC32C_LANE + i));
+            third  = __crc32cd(third, fwiReadLittle64(data_p + 2 * FWI_CRC32C_LANE + i));
+        }
+        crc = fwiCrc32cShift(checksumShiftTwoLanes_s, first) ^
+              fwiCrc32cShift(checksumShiftLane_s, second) ^ third;
+    }
+
+    for (; size >= 8; size -= 8, data_p += 8) {
+        crc = __crc32cd(crc, fwiReadLittle64(data_p));
+    }
+    for (; size != 0; size--, data_p++) {
+        crc = __crc32cb(crc, *data_p);
+    }
+    return crc;
+}
+#endif
+
+static void fwiChecksumInit(void) {
+    for (uint32_t value = 0; value < 256; value++) {
+        uint32_t crc = value;
+        for (uint32_t bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ FWI_CRC32C_POLYNOMIAL : crc >> 1;
+        }
+        checksumTable_s[0][value] = crc;
+    }
+    for (uint32_t value = 0; value < 256; value++) {
+        for (uint32_t slice = 1; slice < 8; slice++) {
+            const uint32_t previous = checksumTable_s[slice - 1][value];
+            checksumTable_s[slice][value] = checksumTable_s[0][previous & 0xFF] ^ (previous >> 8);
+        }
+    }
+
+    fwiCrc32cTabulateShift(checksumShiftLane_s, fwiCrc32cPower(FWI_CRC32C_LANE));
+    fwiCrc32cTabulateShift(checksumShiftTwoLanes_s, fwiCrc32cPower(2 * FWI_CRC32C_LANE));
+
+#if defined(__x86_64__)
+    if (__builtin_cpu_supports("sse4.2")) {
+        checksumCrc32c_s = fwiChecksumCrc32cSse42;
+    }
+#elif defined(__aarch64__) && defined(PLATFORM_LINUX)
+    if (getauxval(AT_HWCAP) & HWCAP_CRC32) {
+        checksumCrc32c_s = fwiChecksumCrc32cArm;
+    }
+#elif defined(__aarch64__) && defined(PLATFORM_MACOS)
+    checksumCrc32c_s = fwiChecksumCrc32cArm; // every Apple processor has it
+#endif
+}
+
+static uint64_t fwiXxHash64Round(uint64_t accumulator, const uint64_t input) {
+    accumulator += input * FWI_XXH64_PRIME2;
+    accumulator  = (accumulator << 31) | (accumulator >> 33);
+    return accumulator * FWI_XXH64_PRIME1;
+}
+
+static uint64_t fwiXxHash64Merge(uint64_t hash, const uint64_t accumulator) {
+    hash ^= fwiXxHash64Round(0, accumulator);
+    return hash * FWI_XXH64_PRIME1 + FWI_XXH64_PRIME4;
+}
+
+/**
+ * @brief Runs the four accumulators over every full 32 byte stripe.
+ * @return Number of bytes consumed
+ */
+static size_t fwiXxHash64Stripes(uint64_t state_p[4], const uint8_t* data_p, const size_t size) {
+    uint64_t first = state_p[0], second = state_p[1], third = state_p[2], fourth = state_p[3];
+
+    size_t offset = 0;
+    for (; offset + 32 <= size; offset += 32) {
+        first  = fwiXxHash64Round(first, fwiReadLittle64(data_p + offset));
+        second = fwiXxHash64Round(second, fwiReadLittle64(data_p + offset + 8));
+        third  = fwiXxHash64Round(third, fwiReadLittle64(data_p + offset + 16));
+        fourth = fwiXxHash64Round(fourth, fwiReadLittle64(data_p + offset + 24));
+    }
+
+    state_p[0] = first;
+    state_p[1] = second;
+    state_p[2] = third;
+    state_p[3] = fourth;
+    return offset;
+}
+
+static uint64_t fwiXxHash64Finish(const fwChecksum* checksum_p) {
+    const uint64_t* state = checksum_p->state;
+    uint64_t hash;
+
+    if (checksum_p->length >= 32) {
+        hash = ((state[0] << 1) | (state[0] >> 63)) + ((state[1] << 7) | (state[1] >> 57)) +
+               ((state[2] << 12) | (state[2] >> 52)) + ((state[3] << 18) | (state[3] >> 46));
+        for (uint32_t i = 0; i < 4; i++) {
+            hash = fwiXxHash64Merge(hash, state[i]);
+        }
+    }
+    else {
+        hash = FWI_XXH64_PRIME5; // the third accumulator still holds the seed
+    }
+    hash += checksum_p->length;
+
+    const uint8_t* tail = checksum_p->pending;
+    uint32_t left = checksum_p->pendingSize;
+    for (; left >= 8; left -= 8, tail += 8) {
+        hash ^= fwiXxHash64Round(0, fwiReadLittle64(tail));
+        hash  = ((hash << 27) | (hash >> 37)) * FWI_XXH64_PRIME1 + FWI_XXH64_PRIME4;
+    }
+    if (left >= 4) {
+        hash ^= fwiReadLittle32(tail) * FWI_XXH64_PRIME1;
+        hash  = ((hash << 23) | (hash >> 41)) * FWI_XXH64_PRIME2 + FWI_XXH64_PRIME3;
+        left -= 4;
+        tail += 4;
+    }
+    for (; left != 0; left--, tail++) {
+        hash ^= *tail * FWI_XXH64_PRIME5;
+        hash  = ((hash << 11) | (hash >> 53)) * FWI_XXH64_PRIME1;
+    }
+
+    hash ^= hash >> 33;
+    hash *= FWI_XXH64_PRIME2;
+    hash ^= hash >> 29;
+    hash *= FWI_XXH64_PRIME3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+fwError fwChecksumBegin(fwChecksum* checksum_p, const fwChecksumType type) {
+    pthread_once(&checksumOnce_s, fwiChecksumInit);
+
+    *checksum_p = (fwChecksum){.type = type};
+    switch (type) {
+        case fwChecksumTypeNone: {
+            break;
+        }
+        case fwChecksumTypeCrc32c: {
+            checksum_p->state[0] = 0xFFFF'FFFF;
+            break;
+        }
+        case fwChecksumTypeXxHash64: {
+            checksum_p->state[0] = FWI_XXH64_PRIME1 + FWI_XXH64_PRIME2;
+            checksum_p->state[1] = FWI_XXH64_PRIME2;
+            checksum_p->state[2] = 0;
+            checksum_p->state[3] = 0 - FWI_XXH64_PRIME1;
+            break;
+        }
+        default: {
+            return fwErrorInvalidParameter;
+        }
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwChecksumUpdate(fwChecksum* checksum_p, const void* data_p, uint64_t size) {
+    const uint8_t* data = data_p;
+    checksum_p->length += size;
+
+    switch (checksum_p->type) {
+        case fwChecksumTypeCrc32c: {
+            checksum_p->state[0] = checksumCrc32c_s((uint32_t)checksum_p->state[0], data, size);
+            break;
+        }
+        case fwChecksumTypeXxHash64: {
+            // Top up a partial stripe from an earlier update first
+            if (checksum_p->pendingSize != 0) {
+                const uint32_t fill = 32 - checksum_p->pendingSize < size ?
+                                      32 - checksum_p->pendingSize : (uint32_t)size;
+                memcpy(checksum_p->pending + checksum_p->pendingSize, data, fill);
+                checksum_p->pendingSize += fill;
+                data += fill;
+                size -= fill;
+                if (checksum_p->pendingSize < 32) {
+                    break;
+                }
+                fwiXxHash64Stripes(checksum_p->state, checksum_p->pending, 32);
+                checksum_p->pendingSize = 0;
+            }
+
+            const size_t consumed = fwiXxHash64Stripes(checksum_p->state, data, size);
+            memcpy(checksum_p->pending, data + consumed, size - consumed);
+            checksum_p->pendingSize = (uint32_t)(size - consumed);
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwChecksumEnd(const fwChecksum* checksum_p, uint64_t* value_p) {
+    switch (checksum_p->type) {
+        case fwChecksumTypeCrc32c: {
+            *value_p = (uint32_t)checksum_p->state[0] ^ 0xFFFF'FFFFu;
+            break;
+        }
+        case fwChecksumTypeXxHash64: {
+            *value_p = fwiXxHash64Finish(checksum_p);
+            break;
+        }
+        default: {
+            *value_p = 0;
+            break;
+        }
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwChecksumCompute(const fwChecksumType type, const void* data_p, const uint64_t size,
+                          uint64_t* value_p) {
+    fwChecksum checksum;
+    const fwError ret = fwChecksumBegin(&checksum, type);
+    if (ret != fwErrorSuccess) {
+        return ret;
+    }
+
+    fwChecksumUpdate(&checksum, data_p, size);
+    return fwChecksumEnd(&checksum, value_p);
+}
@@ -0,0 +1,1353 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific event loop, which
+// waits for sockets through epoll, or through io_uring with the socket calls routed to its queues
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+
+/**
+ * @brief Events taken from the kernel per wait, and the registrations a loop starts out with.
+ */
+#define FWI_EVENT_LOOP_BATCH 256
+#define FWI_EVENT_LOOP_INITIAL_SLOTS 64
+
+/**
+ * @brief Marks the eventfd that wakes a loop up in the epoll user data.
+ */
+#define FWI_EVENT_LOOP_WAKE UINT64_MAX
+
+/**
+ * @brief Defaults of an io_uring loop, and the most buffers the 16 bit buffer ids can tell apart.
+ */
+#define FWI_EVENT_RING_ENTRIES 1'024
+#define FWI_EVENT_RING_SOCKETS 4'096
+#define FWI_EVENT_RING_BUFFER_SIZE 4'096
+#define FWI_EVENT_RING_BUFFERS 2'048
+#define FWI_EVENT_RING_MAX_BUFFERS 32'768
+
+/**
+ * @brief Largest piece a send is queued in, the length of an operation is 32 bit.
+ */
+#define FWI_EVENT_RING_MAX_SEND (1u << 30)
+
+/**
+ * @brief Bounds how long destroying an io_uring loop waits for its sends, in rounds of
+ *        milliseconds.
+ */
+#define FWI_EVENT_RING_SETTLE_ATTEMPTS 100
+#define FWI_EVENT_RING_SETTLE_WAIT 10
+
+/**
+ * @brief Ends a list of received buffers.
+ */
+#define FWI_EVENT_RING_NO_CHUNK UINT16_MAX
+
+/**
+ * @brief Operation an io_uring completion belongs to, kept in the low bits of its user data
+ *        below the registration slot, with the generation in the upper half.
+ */
+typedef enum fwiEventOperation : uint32_t {
+    fwiEventOperationAccept,
+    fwiEventOperationReceive,
+    fwiEventOperationSend,
+    fwiEventOperationWritable,
+    fwiEventOperationWake,
+    fwiEventOperationCancel
+} fwiEventOperation;
+
+#define FWI_EVENT_OPERATION_BITS 4
+
+/**
+ * @brief Copy of data queued with @c fwSocketSend on an io_uring loop.
+ */
+struct fwiEventSend {
+    struct fwiEventSend* next_p;
+    uint32_t size;
+    uint8_t data[];
+};
+
+/**
+ * @brief A socket watched by a loop.
+ * @param generation Changes whenever the registration is dropped, events that were already
+ *                   taken from the kernel for an earlier socket in the slot no longer match it
+ * @param nextFree Index of the next free registration while this one is free
+ * @param ready Events gathered from completions for the next callback, io_uring only like every
+ *              field below
+ * @param chunkHead First received buffer not yet taken, linked on through the loop
+ * @param chunkOffset Bytes already taken from the first buffer
+ * @param sendHead_p Queued sends in order, the first @c sendsStaged are with the kernel or
+ *                   staged for it, @c sendPending_p is the first that waits behind them
+ * @param linkSqe_p Staged entry of the last send, while @c linkBatch matches the loop it was not
+ *                  submitted yet and the next send can be linked behind it
+ * @param draining The socket was removed with sends left, the slot is kept until they finished
+ * @param acceptFlags Connections accepted for a listener take over its blocking mode
+ * @param writable The socket was writable once, which waits for connections still being set up
+ */
+struct fwiEventRegistration {
+    fwSocket socket;
+    fwEventCallback callback;
+    void* user_p;
+    uint32_t events;
+    uint32_t flags;
+    uint32_t generation;
+    uint32_t nextFree;
+    int32_t fileDescriptor;
+
+    uint32_t ready;
+    int32_t acceptFlags;
+    bool queued, armed, receiving, accepting, writable, starved, ended, failed, draining;
+    int32_t error;
+    uint16_t chunkHead;
+    uint16_t chunkTail;
+    uint32_t chunkOffset;
+    int32_t* accepted_p;
+    uint32_t acceptedHead;
+    uint32_t acceptedCount;
+    uint32_t acceptedCapacity;
+    struct fwiEventSend* sendHead_p;
+    struct fwiEventSend* sendPending_p;
+    struct fwiEventSend* sendTail_p;
+    uint32_t sendsStaged;
+    struct io_uring_sqe* linkSqe_p;
+    uint64_t linkBatch;
+};
+
+/**
+ * @brief State behind an @c fwEventLoop handle.
+ * @param wake eventfd that @c fwEventLoopStop writes to, watched like a socket
+ * @param batch Counts submissions, entries staged under an older count belong to the kernel
+ * @param bufferRing_p Ring the kernel takes receive buffers from, shared with it
+ * @param chunkNext_p Links received buffers into the list of their socket, by buffer id
+ * @param chunkLength_p Bytes received into each buffer
+ * @param held Buffers taken out of the ring and not yet given back
+ * @param ready_p Slots with events for the callbacks, each listed once per round
+ * @param starved Registrations that stopped receiving because the ring ran out of buffers
+ * @param sendsStaged Sends with the kernel over all registrations
+ * @param settling The loop is going away and cancelled everything it had with the kernel
+ */
+struct fwiEventLoop {
+    int32_t epoll;
+    int32_t wake;
+    _Atomic bool stop;
+    struct fwiEventRegistration* registrations_p;
+    uint32_t capacity;
+    uint32_t freeHead;
+
+    bool uring;
+    struct fwiUring ring;
+    uint64_t batch;
+    struct io_uring_buf_ring* bufferRing_p;
+    size_t bufferRingSize;
+    fwLargeBuffer buffers;
+    uint32_t bufferSize;
+    uint32_t bufferCount;
+    uint16_t bufferTail;
+    uint16_t* chunkNext_p;
+    uint32_t* chunkLength_p;
+    uint32_t held;
+    uint32_t* ready_p;
+    uint32_t readyCount;
+    uint32_t starved;
+    uint32_t sendsStaged;
+    bool settling;
+
+    struct epoll_event events[FWI_EVENT_LOOP_BATCH];
+};
+
+static uint32_t fwiEventLoopNative(const uint32_t events, const uint32_t flags) {
+    uint32_t native = EPOLLRDHUP;
+    if (events & (fwEventAccept | fwEventRead)) {
+        native |= EPOLLIN;
+    }
+    if (events & fwEventWrite) {
+        native |= EPOLLOUT;
+    }
+    if (flags & fwEventFlagEdgeTriggered) {
+        native |= EPOLLET;
+    }
+    if (flags & fwEventFlagOneShot) {
+        native |= EPOLLONESHOT;
+    }
+    return native;
+}
+
+static uint64_t fwiEventLoopData(const struct fwiEventLoop* loop_p, const uint32_t slot) {
+    return (uint64_t)loop_p->registrations_p[slot].generation << 32 | slot;
+}
+
+static uint64_t fwiEventRingData(const struct fwiEventLoop* loop_p, const uint32_t slot,
+                                 const fwiEventOperation operation) {
+    return (uint64_t)loop_p->registrations_p[slot].generation << 32 |
+           slot << FWI_EVENT_OPERATION_BITS | operation;
+}
+
+/**
+ * @brief Hands out a submission queue entry, submitting what is staged early if the queue is full.
+ * @return The entry, nullptr if the kernel does not take any
+ */
+static struct io_uring_sqe* fwiEventRingSqe(struct fwiEventLoop* loop_p) {
+    struct io_uring_sqe* sqe = fwiUringGetSqe(&loop_p->ring);
+    if (sqe == nullptr) {
+        fwiUringSubmit(&loop_p->ring, 0);
+        loop_p->batch++;
+        sqe = fwiUringGetSqe(&loop_p->ring);
+    }
+    return sqe;
+}
+
+/**
+ * @brief Gives a receive buffer back to the kernel.
+ */
+static void fwiEventRingRecycle(struct fwiEventLoop* loop_p, const uint16_t buffer) {
+    struct io_uring_buf* entry = &loop_p->bufferRing_p->bufs[loop_p->bufferTail &
+                                                             (loop_p->bufferCount - 1)];
+    entry->addr = (uint64_t)(uintptr_t)((uint8_t*)loop_p->buffers.data_p +
+                                        (uint64_t)buffer * loop_p->bufferSize);
+    entry->len  = loop_p->bufferSize;
+    entry->bid  = buffer;
+    loop_p->bufferTail++;
+    loop_p->held--;
+
+    // The tail shares the first entry, the kernel must see the entry before the tail moves past it
+    atomic_store_explicit((_Atomic uint16_t*)&loop_p->bufferRing_p->tail, loop_p->bufferTail,
+                          memory_order_release);
+}
+
+/**
+ * @brief Adds events for the next callback of a registration.
+ */
+static void fwiEventRingReady(struct fwiEventLoop* loop_p, const uint32_t slot,
+                              const uint32_t events) {
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+    registration->ready |= events;
+    if (!registration->queued) {
+        registration->queued = true;
+        loop_p->ready_p[loop_p->readyCount++] = slot;
+    }
+}
+
+/**
+ * @brief What a registration is still ready for, reported again unless it is edge-triggered.
+ */
+static uint32_t fwiEventRingLevel(const struct fwiEventRegistration* registration_p) {
+    uint32_t events = fwEventNone;
+    if (registration_p->events & fwEventRead && (registration_p->chunkHead !=
+        FWI_EVENT_RING_NO_CHUNK || registration_p->ended || registration_p->error != 0)) {
+        events |= fwEventRead;
+    }
+    if (registration_p->events & fwEventAccept &&
+        registration_p->acceptedHead != registration_p->acceptedCount) {
+        events |= fwEventAccept;
+    }
+    if (registration_p->events & fwEventWrite && registration_p->writable &&
+        registration_p->sendHead_p == nullptr) {
+        events |= fwEventWrite;
+    }
+    if (registration_p->ended) {
+        events |= fwEventHangUp;
+    }
+    return events;
+}
+
+/**
+ * @brief Starts receiving into the buffers of the loop until the kernel stops it.
+ */
+static void fwiEventRingReceive(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_RECV;
+    sqe->fd        = (int32_t)slot;
+    sqe->flags     = IOSQE_FIXED_FILE | IOSQE_BUFFER_SELECT;
+    sqe->ioprio    = IORING_RECV_MULTISHOT;
+    sqe->buf_group = 0;
+    sqe->user_data = fwiEventRingData(loop_p, slot, fwiEventOperationReceive);
+    loop_p->registrations_p[slot].receiving = true;
+}
+
+/**
+ * @brief Starts accepting connections until the kernel stops it.
+ */
+static void fwiEventRingAccept(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode       = IORING_OP_ACCEPT;
+    sqe->fd           = (int32_t)slot;
+    sqe->flags        = IOSQE_FIXED_FILE;
+    sqe->ioprio       = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = loop_p->registrations_p[slot].acceptFlags;
+    sqe->user_data    = fwiEventRingData(loop_p, slot, fwiEventOperationAccept);
+    loop_p->registrations_p[slot].accepting = true;
+}
+
+/**
+ * @brief Waits once for a socket to become writable, from then on sends are queued and it counts
+ *        as writable whenever the queue is empty.
+ */
+static void fwiEventRingWritable(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = (int32_t)slot;
+    sqe->flags         = IOSQE_FIXED_FILE;
+    sqe->poll32_events = POLLOUT;
+    sqe->user_data     = fwiEventRingData(loop_p, slot, fwiEventOperationWritable);
+}
+
+/**
+ * @brief Watches the eventfd of @c fwEventLoopStop .
+ */
+static void fwiEventRingWake(struct fwiEventLoop* loop_p) {
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode        = IORING_OP_POLL_ADD;
+    sqe->fd            = loop_p->wake;
+    sqe->poll32_events = POLLIN;
+    sqe->len           = IORING_POLL_ADD_MULTI;
+    sqe->user_data     = fwiEventOperationWake;
+}
+
+static void fwiEventRingCancel(struct fwiEventLoop* loop_p, const uint32_t slot,
+                               const fwiEventOperation operation) {
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe == nullptr) {
+        return;
+    }
+    sqe->opcode    = IORING_OP_ASYNC_CANCEL;
+    sqe->addr      = fwiEventRingData(loop_p, slot, operation);
+    sqe->user_data = fwiEventOperationCancel;
+}
+
+/**
+ * @brief Stages the queued sends of a registration that are not with the kernel yet, each linked
+ *        behind the one before. A chain is only extended until it is submitted, later sends wait
+ *        for it to complete, so they can not overtake a send the kernel is still working on.
+ * @note A link always joins the next entry of the ring. Once anything else was staged behind the
+ *       last send, the chain can not be extended either and the sends wait the same way.
+ */
+static void fwiEventRingFlush(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+
+    while (registration->sendPending_p != nullptr) {
+        const struct fwiUring* ring = &loop_p->ring;
+        const bool linkable = registration->linkSqe_p != nullptr &&
+                              registration->linkBatch == loop_p->batch &&
+                              registration->linkSqe_p ==
+                              &ring->sqes_p[(ring->sqTail - 1) & ring->sqMask];
+        if (registration->sendsStaged != 0 && !linkable) {
+            return;
+        }
+
+        struct io_uring_sqe* sqe = fwiUringGetSqe(&loop_p->ring);
+        if (sqe == nullptr) {
+            // Submitting now would break the chain, it is continued once the chain completes
+            if (registration->sendsStaged != 0 || (sqe = fwiEventRingSqe(loop_p)) == nullptr) {
+                return;
+            }
+        }
+
+        const struct fwiEventSend* send = registration->sendPending_p;
+        sqe->opcode    = IORING_OP_SEND;
+        sqe->fd        = (int32_t)slot;
+        sqe->flags     = IOSQE_FIXED_FILE;
+        sqe->addr      = (uint64_t)(uintptr_t)send->data;
+        sqe->len       = send->size;
+        sqe->msg_flags = MSG_NOSIGNAL | MSG_WAITALL;
+        sqe->user_data = fwiEventRingData(loop_p, slot, fwiEventOperationSend);
+
+        if (registration->sendsStaged != 0) {
+            registration->linkSqe_p->flags |= IOSQE_IO_LINK;
+        }
+        registration->linkSqe_p     = sqe;
+        registration->linkBatch     = loop_p->batch;
+        registration->sendPending_p = send->next_p;
+        registration->sendsStaged++;
+        loop_p->sendsStaged++;
+    }
+}
+
+/**
+ * @brief Takes a free registration, doubling the table when every one is in use. The table of an
+ *        io_uring loop has the size of its file table and does not grow.
+ * @return Index of the registration, UINT32_MAX when out of memory
+ */
+static uint32_t fwiEventLoopAllocate(struct fwiEventLoop* loop_p) {
+    if (loop_p->freeHead == UINT32_MAX) {
+        if (loop_p->uring) {
+            return UINT32_MAX;
+        }
+
+        const uint32_t capacity = loop_p->capacity == 0 ? FWI_EVENT_LOOP_INITIAL_SLOTS :
+                                                          loop_p->capacity * 2;
+        struct fwiEventRegistration* registrations = realloc(
+            loop_p->registrations_p, capacity * sizeof(struct fwiEventRegistration));
+        if (registrations == nullptr) {
+            return UINT32_MAX;
+        }
+
+        for (uint32_t i = loop_p->capacity; i < capacity; i++) {
+            registrations[i] = (struct fwiEventRegistration){
+                .generation = 0,
+                .nextFree   = i + 1 < capacity ? i + 1 : UINT32_MAX
+            };
+        }
+        loop_p->registrations_p = registrations;
+        loop_p->freeHead        = loop_p->capacity;
+        loop_p->capacity        = capacity;
+    }
+
+    const uint32_t slot = loop_p->freeHead;
+    loop_p->freeHead = loop_p->registrations_p[slot].nextFree;
+    return slot;
+}
+
+/**
+ * @brief Drops a registration of an io_uring loop for good, its slot in the file table is cleared.
+ */
+static void fwiEventRingRelease(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    const int32_t none = -1;
+    const struct io_uring_files_update update = {.offset = slot,
+                                                 .fds    = (uint64_t)(uintptr_t)&none};
+    fwiUringRegister(&loop_p->ring, IORING_REGISTER_FILES_UPDATE, &update, 1);
+
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+    registration->generation++;
+    registration->socket   = 0;
+    registration->draining = false;
+    registration->nextFree = loop_p->freeHead;
+    loop_p->freeHead       = slot;
+}
+
+/**
+ * @brief Restarts receiving on the registrations that ran out of buffers, once some came back.
+ */
+static void fwiEventRingRestart(struct fwiEventLoop* loop_p) {
+    for (uint32_t i = 0; i < loop_p->capacity && loop_p->starved != 0; i++) {
+        struct fwiEventRegistration* registration = &loop_p->registrations_p[i];
+        if (registration->starved) {
+            registration->starved = false;
+            loop_p->starved--;
+            fwiEventRingReceive(loop_p, i);
+        }
+    }
+}
+
+/**
+ * @brief Sets up the ring of an io_uring loop along with its file table and receive buffers.
+ */
+static fwError fwiEventRingCreate(struct fwiEventLoop* loop_p, const fwEventLoopInfo* info_p) {
+    const uint32_t sockets = info_p->maxSockets != 0 ? info_p->maxSockets :
+                                                       FWI_EVENT_RING_SOCKETS;
+    const uint32_t size    = info_p->bufferSize != 0 ? info_p->bufferSize :
+                                                       FWI_EVENT_RING_BUFFER_SIZE;
+    const uint32_t count   = info_p->bufferCount != 0 ? info_p->bufferCount :
+                                                        FWI_EVENT_RING_BUFFERS;
+    if (sockets >= 1u << (32 - FWI_EVENT_OPERATION_BITS) || count > FWI_EVENT_RING_MAX_BUFFERS ||
+        (count & (count - 1)) != 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Cooperative task running leaves completions to the next wait instead of interrupting the
+    // thread for each of them, it came with Linux 5.19
+    fwError result = fwiUringCreate(&loop_p->ring, FWI_EVENT_RING_ENTRIES,
+                                    IORING_SETUP_COOP_TASKRUN);
+    if (result == fwErrorUnimplemented) {
+        result = fwiUringCreate(&loop_p->ring, FWI_EVENT_RING_ENTRIES, 0);
+    }
+    if (result != fwErrorSuccess) {
+        return result;
+    }
+    loop_p->uring = true;
+
+    // Starts out empty, sockets are put in as they are added
+    const struct io_uring_rsrc_register files = {.nr    = sockets,
+                                                 .flags = IORING_RSRC_REGISTER_SPARSE};
+    if (fwiUringRegister(&loop_p->ring, IORING_REGISTER_FILES2, &files, sizeof(files)) < 0) {
+        return fwErrorUnimplemented;
+    }
+
+    // A slot can be listed again while its earlier entry is still being worked through
+    loop_p->registrations_p = calloc(sockets, sizeof(struct fwiEventRegistration));
+    loop_p->ready_p         = malloc(2 * (size_t)sockets * sizeof(uint32_t));
+    loop_p->chunkNext_p     = malloc(count * sizeof(uint16_t));
+    loop_p->chunkLength_p   = malloc(count * sizeof(uint32_t));
+    if (loop_p->registrations_p == nullptr || loop_p->ready_p == nullptr ||
+        loop_p->chunkNext_p == nullptr || loop_p->chunkLength_p == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    for (uint32_t i = 0; i < sockets; i++) {
+        loop_p->registrations_p[i].nextFree = i + 1 < sockets ? i + 1 : UINT32_MAX;
+    }
+    loop_p->capacity = sockets;
+    loop_p->freeHead = 0;
+
+    // One mapping for every buffer, on huge pages where the kernel has them
+    if (fwAllocLarge((uint64_t)count * size, nullptr, &loop_p->buffers) != fwErrorSuccess) {
+        return fwErrorOutOfMemory;
+    }
+    loop_p->bufferRingSize = count * sizeof(struct io_uring_buf);
+    loop_p->bufferRing_p   = mmap(nullptr, loop_p->bufferRingSize, PROT_READ | PROT_WRITE,
+                                  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (loop_p->bufferRing_p == MAP_FAILED) {
+        loop_p->bufferRing_p = nullptr;
+        return fwErrorOutOfMemory;
+    }
+
+    // Provided buffer rings came with Linux 5.19, receiving into them repeatedly with 6.0
+    const struct io_uring_buf_reg registration = {
+        .ring_addr    = (uint64_t)(uintptr_t)loop_p->bufferRing_p,
+        .ring_entries = count,
+        .bgid         = 0
+    };
+    if (fwiUringRegister(&loop_p->ring, IORING_REGISTER_PBUF_RING, &registration, 1) < 0) {
+        return fwErrorUnimplemented;
+    }
+
+    loop_p->bufferSize = size;
+    loop_p->bufferCount = count;
+    loop_p->held = count;
+    for (uint32_t i = 0; i < count; i++) {
+        fwiEventRingRecycle(loop_p, (uint16_t)i);
+    }
+    fwiEventRingWake(loop_p);
+    return fwErrorSuccess;
+}
+
+fwError fwEventLoopCreate(const fwEventLoopInfo* info_p, fwEventLoop* loop_p) {
+    const fwEventBackend backend = info_p != nullptr ? info_p->backend : fwEventBackendEpoll;
+    if (backend > fwEventBackendUring) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiEventLoop* loop = calloc(1, sizeof(struct fwiEventLoop));
+    if (loop == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    loop->freeHead = UINT32_MAX;
+
+    loop->wake = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (loop->wake == -1) {
+        FWI_LOG_ERRNO;
+        fwEventLoopDestroy((uintptr_t)loop);
+        return fwErrorOutOfMemory;
+    }
+
+    if (backend == fwEventBackendUring) {
+        const fwError result = fwiEventRingCreate(loop, info_p);
+        if (result != fwErrorSuccess) {
+            fwEventLoopDestroy((uintptr_t)loop);
+            return result;
+        }
+    }
+    else {
+        loop->epoll = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event wake = {.events = EPOLLIN, .data.u64 = FWI_EVENT_LOOP_WAKE};
+        if (loop->epoll == -1 || epoll_ctl(loop->epoll, EPOLL_CTL_ADD, loop->wake, &wake) == -1) {
+            FWI_LOG_ERRNO;
+            fwEventLoopDestroy((uintptr_t)loop);
+            return fwErrorOutOfMemory;
+        }
+    }
+
+    *loop_p = (uintptr_t)loop;
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "New event loop (ID: %lX) was created on %s",
+              (unsigned long)*loop_p, loop->uring ? "io_uring" : "epoll");
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Puts a socket into the file table of an io_uring loop and starts what it waits for.
+ */
+static fwError fwiEventRingAdd(struct fwiEventLoop* loop_p, const uint32_t slot,
+                               const struct fwiNativeSocketState* nativeSocket_p) {
+    const int32_t fileDescriptor = nativeSocket_p->fileDescriptor;
+    const struct io_uring_files_update update = {.offset = slot,
+                                                 .fds = (uint64_t)(uintptr_t)&fileDescriptor};
+    if (fwiUringRegister(&loop_p->ring, IORING_REGISTER_FILES_UPDATE, &update, 1) < 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+    if (registration->events & fwEventAccept) {
+        fwiEventRingAccept(loop_p, slot);
+    }
+    if (registration->events & fwEventRead) {
+        fwiEventRingReceive(loop_p, slot);
+    }
+    if (registration->events & fwEventWrite) {
+        fwiEventRingWritable(loop_p, slot);
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwEventLoopAdd(const fwEventLoop loop, const fwSocket sfdop, const uint32_t events,
+                       const uint32_t flags, const fwEventCallback callback, void* user_p) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeLoop == nullptr || nativeSocket == nullptr || callback == nullptr ||
+        nativeSocket->eventLoop != 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    if (events & fwEventAccept) {
+        const fwError listening = fwiSocketListen(nativeSocket);
+        if (listening != fwErrorSuccess) {
+            return listening == fwErrorSocketNotBound ? fwErrorSocketListen : listening;
+        }
+    }
+
+    const uint32_t slot = fwiEventLoopAllocate(nativeLoop);
+    if (slot == UINT32_MAX) {
+        return fwErrorOutOfMemory;
+    }
+
+    // Everything but what outlives the socket in the slot starts over
+    struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+    *registration = (struct fwiEventRegistration){
+        .socket           = sfdop,
+        .callback         = callback,
+        .user_p           = user_p,
+        .events           = events,
+        .flags            = flags,
+        .acceptFlags      = SOCK_CLOEXEC | (nativeSocket->nonBlocking ? SOCK_NONBLOCK : 0),
+        .generation       = registration->generation,
+        .fileDescriptor   = nativeSocket->fileDescriptor,
+        .armed            = true,
+        .chunkHead        = FWI_EVENT_RING_NO_CHUNK,
+        .chunkTail        = FWI_EVENT_RING_NO_CHUNK,
+        .accepted_p       = registration->accepted_p,
+        .acceptedCapacity = registration->acceptedCapacity
+    };
+
+    if (nativeLoop->uring) {
+        const fwError result = fwiEventRingAdd(nativeLoop, slot, nativeSocket);
+        if (result != fwErrorSuccess) {
+            registration->socket   = 0;
+            registration->nextFree = nativeLoop->freeHead;
+            nativeLoop->freeHead   = slot;
+            return result;
+        }
+    }
+    else {
+        struct epoll_event event = {.events   = fwiEventLoopNative(events, flags),
+                                    .data.u64 = fwiEventLoopData(nativeLoop, slot)};
+        if (epoll_ctl(nativeLoop->epoll, EPOLL_CTL_ADD, nativeSocket->fileDescriptor,
+                      &event) == -1) {
+            FWI_LOG_ERRNO;
+            registration->socket   = 0;
+            registration->nextFree = nativeLoop->freeHead;
+            nativeLoop->freeHead   = slot;
+            return errno == ENOMEM || errno == ENOSPC ? fwErrorOutOfMemory :
+                                                        fwErrorInvalidParameter;
+        }
+    }
+
+    nativeSocket->eventLoop = loop;
+    nativeSocket->eventSlot = slot;
+    nativeSocket->uring     = nativeLoop->uring;
+    return fwErrorSuccess;
+}
+
+fwError fwEventLoopModify(const fwEventLoop loop, const fwSocket sfdop, const uint32_t events,
+                          const uint32_t flags) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    const struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeLoop == nullptr || nativeSocket == nullptr || nativeSocket->eventLoop != loop) {
+        return fwErrorInvalidParameter;
+    }
+
+    const uint32_t slot = nativeSocket->eventSlot;
+    struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+    registration->events = events;
+
+    if (nativeLoop->uring) {
+        registration->flags = flags;
+        registration->armed = true;
+        if (events & fwEventAccept && !registration->accepting) {
+            fwiEventRingAccept(nativeLoop, slot);
+        }
+        if (events & fwEventWrite && !registration->writable) {
+            fwiEventRingWritable(nativeLoop, slot);
+        }
+        if (events & fwEventRead && !registration->receiving && !registration->starved &&
+            !registration->ended && registration->error == 0) {
+            fwiEventRingReceive(nativeLoop, slot);
+        }
+
+        // Like epoll, whatever the socket is ready for now is reported again
+        const uint32_t ready = fwiEventRingLevel(registration) | registration->ready;
+        if (ready != fwEventNone) {
+            fwiEventRingReady(nativeLoop, slot, ready);
+        }
+        return fwErrorSuccess;
+    }
+
+    struct epoll_event event = {.events   = fwiEventLoopNative(events, flags),
+                                .data.u64 = fwiEventLoopData(nativeLoop, slot)};
+    if (epoll_ctl(nativeLoop->epoll, EPOLL_CTL_MOD, nativeSocket->fileDescriptor, &event) == -1) {
+        FWI_LOG_ERRNO;
+        return fwErrorInvalidParameter;
+    }
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Stops what an io_uring loop does for a registration and gives back what it holds. Sends
+ *        that are queued still go out, the slot is kept until they did.
+ */
+static void fwiEventRingForget(struct fwiEventLoop* loop_p, const uint32_t slot) {
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+    if (registration->receiving) {
+        fwiEventRingCancel(loop_p, slot, fwiEventOperationReceive);
+    }
+    if (registration->accepting) {
+        fwiEventRingCancel(loop_p, slot, fwiEventOperationAccept);
+    }
+    if (registration->events & fwEventWrite && !registration->writable) {
+        fwiEventRingCancel(loop_p, slot, fwiEventOperationWritable);
+    }
+    if (registration->starved) {
+        registration->starved = false;
+        loop_p->starved--;
+    }
+
+    const bool recycled = registration->chunkHead != FWI_EVENT_RING_NO_CHUNK;
+    for (uint16_t chunk = registration->chunkHead; chunk != FWI_EVENT_RING_NO_CHUNK;) {
+        const uint16_t next = loop_p->chunkNext_p[chunk];
+        fwiEventRingRecycle(loop_p, chunk);
+        chunk = next;
+    }
+    for (uint32_t i = registration->acceptedHead; i < registration->acceptedCount; i++) {
+        close(registration->accepted_p[i]);
+    }
+
+    registration->socket       = 0;
+    registration->ready        = fwEventNone;
+    registration->chunkHead    = FWI_EVENT_RING_NO_CHUNK;
+    registration->acceptedHead = registration->acceptedCount = 0;
+    if (registration->sendHead_p == nullptr) {
+        fwiEventRingRelease(loop_p, slot);
+    }
+    else {
+        registration->draining = true;
+    }
+
+    if (recycled && loop_p->starved != 0) {
+        fwiEventRingRestart(loop_p);
+    }
+}
+
+void fwiEventLoopForget(struct fwiNativeSocketState* nativeSocket_p) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)nativeSocket_p->eventLoop};
+    const uint32_t slot = nativeSocket_p->eventSlot;
+
+    if (nativeLoop->uring) {
+        fwiEventRingForget(nativeLoop, slot);
+    }
+    else {
+        epoll_ctl(nativeLoop->epoll, EPOLL_CTL_DEL, nativeSocket_p->fileDescriptor, nullptr);
+
+        struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+        registration->generation++;
+        registration->socket   = 0;
+        registration->nextFree = nativeLoop->freeHead;
+        nativeLoop->freeHead   = slot;
+    }
+
+    nativeSocket_p->eventLoop = 0;
+    nativeSocket_p->eventSlot = 0;
+    nativeSocket_p->uring     = false;
+}
+
+fwError fwEventLoopRemove(const fwEventLoop loop, const fwSocket sfdop) {
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (loop == 0 || nativeSocket == nullptr || nativeSocket->eventLoop != loop) {
+        return fwErrorInvalidParameter;
+    }
+
+    fwiEventLoopForget(nativeSocket);
+    return fwErrorSuccess;
+}
+
+fwError fwiEventLoopAccept(struct fwiNativeSocketState* nativeSocket_p,
+                           int32_t* fileDescriptor_p) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)nativeSocket_p->eventLoop};
+    const uint32_t slot = nativeSocket_p->eventSlot;
+    struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+
+    if (registration->acceptedHead == registration->acceptedCount) {
+        // Accepting stops on errors such as running out of descriptors, asking again restarts it
+        if (registration->error != 0) {
+            registration->error = 0;
+            fwiEventRingAccept(nativeLoop, slot);
+            return fwErrorSocketAccept;
+        }
+        return fwErrorSocketWouldBlock;
+    }
+
+    *fileDescriptor_p = registration->accepted_p[registration->acceptedHead++];
+    if (registration->acceptedHead == registration->acceptedCount) {
+        registration->acceptedHead = registration->acceptedCount = 0;
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwiEventLoopReceive(struct fwiNativeSocketState* nativeSocket_p, void* buffer_p,
+                            const size_t size, size_t* received_p) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)nativeSocket_p->eventLoop};
+    struct fwiEventRegistration* registration =
+        &nativeLoop->registrations_p[nativeSocket_p->eventSlot];
+
+    size_t received = 0;
+    bool recycled = false;
+    while (received < size && registration->chunkHead != FWI_EVENT_RING_NO_CHUNK) {
+        const uint16_t chunk = registration->chunkHead;
+        const uint32_t left = nativeLoop->chunkLength_p[chunk] - registration->chunkOffset;
+        const size_t part = left < size - received ? left : size - received;
+        memcpy((uint8_t*)buffer_p + received,
+               (uint8_t*)nativeLoop->buffers.data_p + (uint64_t)chunk * nativeLoop->bufferSize +
+               registration->chunkOffset, part);
+        received += part;
+        registration->chunkOffset += part;
+
+        if (registration->chunkOffset == nativeLoop->chunkLength_p[chunk]) {
+            registration->chunkHead   = nativeLoop->chunkNext_p[chunk];
+            registration->chunkOffset = 0;
+            fwiEventRingRecycle(nativeLoop, chunk);
+            recycled = true;
+        }
+    }
+    if (recycled && nativeLoop->starved != 0) {
+        fwiEventRingRestart(nativeLoop);
+    }
+
+    *received_p = received;
+    if (received != 0 || size == 0 || registration->ended) {
+        return fwErrorSuccess;
+    }
+    return registration->error != 0 ? fwErrorSocketReceive : fwErrorSocketWouldBlock;
+}
+
+fwError fwiEventLoopSend(struct fwiNativeSocketState* nativeSocket_p,
+                         const fwSocketBuffer* buffers_p, const uint32_t count) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)nativeSocket_p->eventLoop};
+    const uint32_t slot = nativeSocket_p->eventSlot;
+    struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+    if (registration->failed) {
+        return fwErrorSocketSend;
+    }
+
+    size_t size = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        size += buffers_p[i].size;
+    }
+
+    // Pieces are filled from the buffers in order, one piece may span several of them
+    uint32_t buffer = 0;
+    size_t bufferOffset = 0;
+    for (size_t offset = 0; offset < size || size == 0;) {
+        const uint32_t piece = size - offset > FWI_EVENT_RING_MAX_SEND ? FWI_EVENT_RING_MAX_SEND :
+                                                                         (uint32_t)(size - offset);
+        struct fwiEventSend* send = fwiAllocate(fwiLogDomainNetwork,
+                                                sizeof(struct fwiEventSend) + piece, 16);
+        if (send == nullptr) {
+            return fwErrorOutOfMemory;
+        }
+        send->next_p = nullptr;
+        send->size   = piece;
+        for (uint32_t copied = 0; copied < piece;) {
+            const size_t left = buffers_p[buffer].size - bufferOffset;
+            const size_t part = left < piece - copied ? left : piece - copied;
+            memcpy(send->data + copied, (const uint8_t*)buffers_p[buffer].data_p + bufferOffset,
+                   part);
+            copied += part;
+            bufferOffset += part;
+            if (bufferOffset == buffers_p[buffer].size) {
+                buffer++;
+                bufferOffset = 0;
+            }
+        }
+
+        if (registration->sendTail_p == nullptr) {
+            registration->sendHead_p = send;
+        }
+        else {
+            registration->sendTail_p->next_p = send;
+        }
+        registration->sendTail_p = send;
+        if (registration->sendPending_p == nullptr) {
+            registration->sendPending_p = send;
+        }
+
+        offset += piece;
+        if (size == 0) {
+            break;
+        }
+    }
+
+    fwiEventRingFlush(nativeLoop, slot);
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Applies one completion of an io_uring loop to its registration.
+ */
+static void fwiEventRingComplete(struct fwiEventLoop* loop_p, const struct io_uring_cqe* cqe_p) {
+    const fwiEventOperation operation = cqe_p->user_data & ((1u << FWI_EVENT_OPERATION_BITS) - 1);
+    const uint32_t slot = (uint32_t)cqe_p->user_data >> FWI_EVENT_OPERATION_BITS;
+    const bool more = cqe_p->flags & IORING_CQE_F_MORE;
+    const int32_t result = cqe_p->res;
+
+    if (operation == fwiEventOperationWake) {
+        uint64_t value;
+        while (read(loop_p->wake, &value, sizeof(value)) == -1 && errno == EINTR) {}
+        if (!more) {
+            fwiEventRingWake(loop_p);
+        }
+        return;
+    }
+    if (operation == fwiEventOperationCancel) {
+        return;
+    }
+
+    // Operations of a socket that was removed can still complete, also after the slot was reused
+    struct fwiEventRegistration* registration = &loop_p->registrations_p[slot];
+    const bool current = registration->generation == (uint32_t)(cqe_p->user_data >> 32);
+    const bool live = current && registration->socket != 0;
+
+    switch (operation) {
+        case fwiEventOperationReceive: {
+            if (cqe_p->flags & IORING_CQE_F_BUFFER) {
+                const uint16_t buffer = cqe_p->flags >> IORING_CQE_BUFFER_SHIFT;
+                loop_p->held++;
+                if (!live || result <= 0) {
+                    fwiEventRingRecycle(loop_p, buffer);
+                }
+                else {
+                    loop_p->chunkLength_p[buffer] = (uint32_t)result;
+                    loop_p->chunkNext_p[buffer]   = FWI_EVENT_RING_NO_CHUNK;
+                    if (registration->chunkHead == FWI_EVENT_RING_NO_CHUNK) {
+                        registration->chunkHead = buffer;
+                    }
+                    else {
+                        loop_p->chunkNext_p[registration->chunkTail] = buffer;
+                    }
+                    registration->chunkTail = buffer;
+                }
+            }
+            if (!live) {
+                break;
+            }
+            if (!more) {
+                registration->receiving = false;
+            }
+
+            if (result > 0) {
+                fwiEventRingReady(loop_p, slot, fwEventRead);
+                if (!more) {
+                    fwiEventRingReceive(loop_p, slot);
+                }
+            }
+            else if (result == 0) {
+                registration->ended = true;
+                fwiEventRingReady(loop_p, slot, fwEventRead | fwEventHangUp);
+            }
+            else if (result == -ENOBUFS) {
+                // Buffers may have come back since the kernel gave up, then it can go on at once
+                if (loop_p->held < loop_p->bufferCount) {
+                    fwiEventRingReceive(loop_p, slot);
+                }
+                else {
+                    registration->starved = true;
+                    loop_p->starved++;
+                }
+            }
+            else if (result != -ECANCELED) {
+                registration->error = result;
+                fwiEventRingReady(loop_p, slot, fwEventRead | fwEventError);
+            }
+            break;
+        }
+        case fwiEventOperationAccept: {
+            if (!live) {
+                if (result >= 0) {
+                    close(result);
+                }
+                break;
+            }
+            if (!more) {
+                registration->accepting = false;
+            }
+
+            if (result >= 0) {
+                if (registration->acceptedCount == registration->acceptedCapacity) {
+                    const uint32_t capacity = registration->acceptedCapacity == 0 ? 16 :
+                                              registration->acceptedCapacity * 2;
+                    int32_t* accepted = realloc(registration->accepted_p,
+                                                capacity * sizeof(int32_t));
+                    if (accepted == nullptr) {
+                        close(result);
+                        break;
+                    }
+                    registration->accepted_p       = accepted;
+                    registration->acceptedCapacity = capacity;
+                }
+                registration->accepted_p[registration->acceptedCount++] = result;
+                fwiEventRingReady(loop_p, slot, fwEventAccept);
+                if (!more) {
+                    fwiEventRingAccept(loop_p, slot);
+                }
+            }
+            else if (result != -ECANCELED) {
+                registration->error = result;
+                fwiEventRingReady(loop_p, slot, fwEventAccept | fwEventError);
+            }
+            break;
+        }
+        case fwiEventOperationWritable: {
+            if (!live || registration->writable || result == -ECANCELED) {
+                break;
+            }
+            registration->writable = true;
+
+            uint32_t events = fwEventWrite;
+            if (result < 0 || result & POLLERR) {
+                events |= fwEventError;
+            }
+            if (result > 0 && result & POLLHUP) {
+                events |= fwEventHangUp;
+            }
+            fwiEventRingReady(loop_p, slot, events);
+            break;
+        }
+        case fwiEventOperationSend: {
+            // Sends of a registration complete in order, even when a link failed
+            struct fwiEventSend* send = registration->sendHead_p;
+            registration->sendHead_p = send->next_p;
+            if (registration->sendHead_p == nullptr) {
+                registration->sendTail_p = nullptr;
+            }
+            registration->sendsStaged--;
+            loop_p->sendsStaged--;
+
+            // Cancelled sends only go without a failure when the loop is going away anyway
+            if (result < 0 ? result != -ECANCELED || !loop_p->settling :
+                             (uint32_t)result < send->size) {
+                registration->failed = true;
+                if (live) {
+                    fwiEventRingReady(loop_p, slot, fwEventError);
+                }
+            }
+            fwFree(send);
+
+            if (registration->sendsStaged != 0) {
+                break;
+            }
+            registration->linkSqe_p = nullptr;
+            if (registration->failed) {
+                while (registration->sendHead_p != nullptr) {
+                    send = registration->sendHead_p;
+                    registration->sendHead_p = send->next_p;
+                    fwFree(send);
+                }
+                registration->sendPending_p = registration->sendTail_p = nullptr;
+            }
+            fwiEventRingFlush(loop_p, slot);
+
+            if (registration->sendHead_p == nullptr) {
+                if (registration->draining) {
+                    fwiEventRingRelease(loop_p, slot);
+                }
+                else if (live && registration->writable && registration->events & fwEventWrite) {
+                    fwiEventRingReady(loop_p, slot, fwEventWrite);
+                }
+            }
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+}
+
+/**
+ * @brief One round of an io_uring loop: submit, wait, apply the completions, run the callbacks.
+ */
+static uint32_t fwiEventRingRunOnce(const fwEventLoop loop, const int32_t timeout) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+
+    // Callbacks that are due from the last round do not wait for anything new
+    const int32_t result = fwiUringWait(&nativeLoop->ring,
+                                        nativeLoop->readyCount != 0 ? 0 : timeout);
+    nativeLoop->batch++;
+    if (result < 0 && result != -ETIME && result != -EINTR) {
+        errno = -result;
+        FWI_LOG_ERRNO;
+    }
+
+    struct io_uring_cqe* cqe;
+    while ((cqe = fwiUringPeekCqe(&nativeLoop->ring)) != nullptr) {
+        fwiEventRingComplete(nativeLoop, cqe);
+        fwiUringCqeSeen(&nativeLoop->ring);
+    }
+
+    // Only what is listed now, callbacks list their sockets again for the next round
+    const uint32_t count = nativeLoop->readyCount;
+    uint32_t handled = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        const uint32_t slot = nativeLoop->ready_p[i];
+        struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+        registration->queued = false;
+
+        const uint32_t events = registration->ready &
+                                (registration->events | fwEventHangUp | fwEventError);
+        if (registration->socket == 0 || !registration->armed || events == fwEventNone) {
+            continue;
+        }
+        registration->ready &= ~events;
+        if (registration->flags & fwEventFlagOneShot) {
+            registration->armed = false;
+        }
+        if (events & (fwEventWrite | fwEventError | fwEventHangUp)) {
+            fwiSocketSettleConnect(fwiSocketResolve(registration->socket));
+        }
+
+        // The table never moves here, the registration is looked at again afterwards
+        registration->callback(loop, registration->socket, events, registration->user_p);
+        handled++;
+
+        if (registration->socket != 0 && registration->armed &&
+            !(registration->flags & fwEventFlagEdgeTriggered)) {
+            const uint32_t level = fwiEventRingLevel(registration);
+            if (level != fwEventNone) {
+                fwiEventRingReady(nativeLoop, slot, level);
+            }
+        }
+    }
+
+    nativeLoop->readyCount -= count;
+    memmove(nativeLoop->ready_p, nativeLoop->ready_p + count,
+            nativeLoop->readyCount * sizeof(uint32_t));
+    return handled;
+}
+
+fwError fwEventLoopRunOnce(const fwEventLoop loop, const int32_t timeout, uint32_t* handled_p) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    if (handled_p != nullptr) {
+        *handled_p = 0;
+    }
+    if (nativeLoop == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    if (nativeLoop->uring) {
+        const uint32_t handled = fwiEventRingRunOnce(loop, timeout);
+        if (handled_p != nullptr) {
+            *handled_p = handled;
+        }
+        return fwErrorSuccess;
+    }
+
+    const int32_t count = epoll_wait(nativeLoop->epoll, nativeLoop->events, FWI_EVENT_LOOP_BATCH,
+                                     timeout);
+    if (count == -1) {
+        if (errno != EINTR) {
+            FWI_LOG_ERRNO;
+        }
+        return fwErrorSuccess;
+    }
+
+    uint32_t handled = 0;
+    for (int32_t i = 0; i < count; i++) {
+        const struct epoll_event* event = &nativeLoop->events[i];
+        if (event->data.u64 == FWI_EVENT_LOOP_WAKE) {
+            uint64_t value;
+            while (read(nativeLoop->wake, &value, sizeof(value)) == -1 && errno == EINTR) {}
+            continue;
+        }
+
+        // Callbacks earlier in the batch may have removed the socket or even reused the slot
+        const uint32_t slot = (uint32_t)event->data.u64;
+        const struct fwiEventRegistration* registration = &nativeLoop->registrations_p[slot];
+        if (registration->generation != (uint32_t)(event->data.u64 >> 32) ||
+            registration->socket == 0) {
+            continue;
+        }
+
+        uint32_t events = fwEventNone;
+        if (event->events & EPOLLIN) {
+            events |= registration->events & fwEventAccept ? fwEventAccept : fwEventRead;
+        }
+        if (event->events & EPOLLOUT) {
+            events |= fwEventWrite;
+        }
+        if (event->events & (EPOLLHUP | EPOLLRDHUP)) {
+            events |= fwEventHangUp;
+        }
+        if (event->events & EPOLLERR) {
+            events |= fwEventError;
+        }
+
+        // A connect that was underway has ended once the socket is writable or failed
+        if (events & (fwEventWrite | fwEventError | fwEventHangUp)) {
+            fwiSocketSettleConnect(fwiSocketResolve(registration->socket));
+        }
+
+        // The table can move when the callback adds sockets, so nothing of it is used afterwards
+        registration->callback(loop, registration->socket, events, registration->user_p);
+        handled++;
+    }
+
+    if (handled_p != nullptr) {
+        *handled_p = handled;
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwEventLoopRun(const fwEventLoop loop) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    if (nativeLoop == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    while (!atomic_load_explicit(&nativeLoop->stop, memory_order_acquire)) {
+        fwEventLoopRunOnce(loop, -1, nullptr);
+    }
+
+    // Ready for another run
+    atomic_store_explicit(&nativeLoop->stop, false, memory_order_relaxed);
+    return fwErrorSuccess;
+}
+
+fwError fwEventLoopStop(const fwEventLoop loop) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    if (nativeLoop == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Only async-signal-safe calls from here on
+    atomic_store_explicit(&nativeLoop->stop, true, memory_order_release);
+    const uint64_t value = 1;
+    while (write(nativeLoop->wake, &value, sizeof(value)) == -1 && errno == EINTR) {}
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Cancels everything an io_uring loop has with the kernel and waits for the sends, whose
+ *        copies the kernel may still read from, before the loop goes away.
+ */
+static void fwiEventRingSettle(struct fwiEventLoop* loop_p) {
+    loop_p->settling = true;
+    struct io_uring_sqe* sqe = fwiEventRingSqe(loop_p);
+    if (sqe != nullptr) {
+        sqe->opcode       = IORING_OP_ASYNC_CANCEL;
+        sqe->cancel_flags = IORING_ASYNC_CANCEL_ANY | IORING_ASYNC_CANCEL_ALL;
+        sqe->user_data    = fwiEventOperationCancel;
+    }
+
+    for (uint32_t attempt = 0; attempt < FWI_EVENT_RING_SETTLE_ATTEMPTS; attempt++) {
+        fwiUringWait(&loop_p->ring, loop_p->sendsStaged != 0 ? FWI_EVENT_RING_SETTLE_WAIT : 0);
+        loop_p->batch++;
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = fwiUringPeekCqe(&loop_p->ring)) != nullptr) {
+            fwiEventRingComplete(loop_p, cqe);
+            fwiUringCqeSeen(&loop_p->ring);
+        }
+        if (loop_p->sendsStaged == 0) {
+            return;
+        }
+    }
+}
+
+fwError fwEventLoopDestroy(const fwEventLoop loop) {
+    struct fwiEventLoop* nativeLoop = {(struct fwiEventLoop*)loop};
+    if (nativeLoop == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Sockets that are still registered forget the loop, they stay open
+    for (uint32_t i = 0; i < nativeLoop->capacity; i++) {
+        struct fwiEventRegistration* registration = &nativeLoop->registrations_p[i];
+        struct fwiNativeSocketState* nativeSocket = registration->socket != 0 ?
+                                                    fwiSocketResolve(registration->socket) :
+                                                    nullptr;
+        if (nativeSocket != nullptr && nativeSocket->eventLoop == loop) {
+            nativeSocket->eventLoop = 0;
+            nativeSocket->uring     = false;
+        }
+        if (nativeLoop->uring && registration->socket != 0) {
+            fwiEventRingForget(nativeLoop, i);
+        }
+    }
+
+    if (nativeLoop->uring) {
+        fwiEventRingSettle(nativeLoop);
+        fwiUringDestroy(&nativeLoop->ring);
+        for (uint32_t i = 0; i < nativeLoop->capacity; i++) {
+            struct fwiEventRegistration* registration = &nativeLoop->registrations_p[i];
+            while (registration->sendHead_p != nullptr) {
+                struct fwiEventSend* send = registration->sendHead_p;
+                registration->sendHead_p = send->next_p;
+                fwFree(send);
+            }
+            free(registration->accepted_p);
+        }
+    }
+    if (nativeLoop->bufferRing_p != nullptr) {
+        munmap(nativeLoop->bufferRing_p, nativeLoop->bufferRingSize);
+    }
+    if (nativeLoop->buffers.data_p != nullptr) {
+        fwFreeLarge(&nativeLoop->buffers);
+    }
+
+    if (nativeLoop->epoll > 0) {
+        close(nativeLoop->epoll);
+    }
+    if (nativeLoop->wake > 0) {
+        close(nativeLoop->wake);
+    }
+    free(nativeLoop->registrations_p);
+    free(nativeLoop->ready_p);
+    free(nativeLoop->chunkNext_p);
+    free(nativeLoop->chunkLength_p);
+    free(nativeLoop);
+
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Event loop (ID: %lX) was destroyed",
+              (unsigned long)loop);
+    return fwErrorSuccess;
+}
+
+#endif // PLATFORM_LINUX
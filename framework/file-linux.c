@@ -0,0 +1,1010 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for Linux-specific, exposed symbols of the
+// file handle and asynchronous file read API
+
+#ifdef PLATFORM_LINUX
+
+// O_DIRECT and statx are GNU extensions
+#define _GNU_SOURCE
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <linux/stat.h>
+
+/**
+ * @brief Upper bound for the worker threads of a queue that can not use io_uring.
+ */
+#define FWI_FILE_QUEUE_MAX_WORKERS 16
+
+/**
+ * @brief Alignment of direct reads when the kernel is too old to report it, the page size covers
+ *        the logical block size of every common device.
+ */
+#define FWI_FILE_DIRECT_ALIGNMENT 4'096
+
+/**
+ * @brief Submission queue size for batch loads, and the largest single read they issue.
+ */
+#define FWI_LOAD_FILES_RING_ENTRIES 128
+#define FWI_LOAD_FILES_MAX_READ (1u << 30)
+
+/**
+ * @brief Alignment of files within a packed batch load.
+ */
+#define FWI_LOAD_FILES_PACKED_ALIGNMENT 64
+
+/**
+ * @brief A read of an io_uring queue, short reads are continued from @c done on.
+ * @param nextFree Next unused slot while this one is unused
+ */
+struct fwiFileQueueSlot {
+    fwFileRead read;
+    uint64_t done;
+    uint32_t nextFree;
+};
+
+/**
+ * @brief State behind an @c fwFileQueue handle.
+ * @param slots_p Reads in flight on io_uring, a slot's index is the user data of its entry
+ * @param files_p Descriptors of the registered files, their index is the registered index
+ * @param pending_p Reads not yet picked up by a worker, a ring of @c depth entries
+ * @param completed_p Completions not yet collected, a ring of @c depth entries
+ */
+struct fwiFileQueue {
+    bool uring;
+    struct fwiUring ring;
+    uint32_t depth;
+    uint32_t inFlight;
+    struct fwiFileQueueSlot* slots_p;
+    uint32_t freeSlot;
+
+    int32_t* files_p;
+    uint32_t fileCount;
+    fwFileBuffer* buffers_p;
+    uint32_t bufferCount;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workAvailable;
+    pthread_cond_t workDone;
+    fwFileRead* pending_p;
+    uint32_t pendingHead;
+    uint32_t pendingCount;
+    fwFileCompletion* completed_p;
+    uint32_t completedHead;
+    uint32_t completedCount;
+    pthread_t* workers_p;
+    uint32_t workerCount;
+    bool stopping;
+};
+
+fwError fwFileOpen(const char* filename_p, const uint32_t flags, fwFile* file_p) {
+    int32_t fileDescriptor = -1;
+    uint32_t alignment = 1;
+
+    if (flags & fwFileOpenFlagDirect) {
+        fileDescriptor = open(filename_p, O_RDONLY | O_CLOEXEC | O_DIRECT);
+        if (fileDescriptor == -1 && errno != EINVAL) {
+            return fwErrorFileUnableToOpen;
+        }
+    }
+
+    if (fileDescriptor != -1) {
+        alignment = FWI_FILE_DIRECT_ALIGNMENT;
+
+#ifdef STATX_DIOALIGN
+        // Since Linux 6.1 the file system tells, a zero alignment means it can not do direct reads
+        // of this file even though the open went through
+        struct statx stats;
+        if (statx(fileDescriptor, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stats) == 0 &&
+            (stats.stx_mask & STATX_DIOALIGN)) {
+            alignment = stats.stx_dio_offset_align > stats.stx_dio_mem_align ?
+                        stats.stx_dio_offset_align : stats.stx_dio_mem_align;
+            if (alignment == 0) {
+                close(fileDescriptor);
+                fileDescriptor = -1;
+                alignment = 1;
+            }
+        }
+#endif
+    }
+
+    // File systems like tmpfs reject direct access, the page cache is still better than failing
+    if (fileDescriptor == -1) {
+        if (flags & fwFileOpenFlagDirect) {
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo,
+                      "%s does not support direct access, it is read through the page cache",
+                      filename_p);
+        }
+        fileDescriptor = open(filename_p, O_RDONLY | O_CLOEXEC);
+        if (fileDescriptor == -1) {
+            return fwErrorFileUnableToOpen;
+        }
+    }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats)) {
+        close(fileDescriptor);
+        return fwErrorFileStats;
+    }
+
+    struct fwiNativeFileState* nativeFile = malloc(sizeof(struct fwiNativeFileState));
+    if (nativeFile == nullptr) {
+        close(fileDescriptor);
+        return fwErrorOutOfMemory;
+    }
+
+    nativeFile->fileDescriptor = fileDescriptor;
+    nativeFile->alignment      = alignment;
+    nativeFile->size           = fileStats.st_size;
+
+    *file_p = (uintptr_t)nativeFile;
+    return fwErrorSuccess;
+}
+
+fwError fwFileGetSize(const fwFile file, uint64_t* size_p) {
+    const struct fwiNativeFileState* nativeFile = {(struct fwiNativeFileState*)file};
+    if (nativeFile == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    *size_p = nativeFile->size;
+    return fwErrorSuccess;
+}
+
+fwError fwFileGetAlignment(const fwFile file, uint32_t* alignment_p) {
+    const struct fwiNativeFileState* nativeFile = {(struct fwiNativeFileState*)file};
+    if (nativeFile == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    *alignment_p = nativeFile->alignment;
+    return fwErrorSuccess;
+}
+
+fwError fwFileClose(const fwFile file) {
+    struct fwiNativeFileState* nativeFile = {(struct fwiNativeFileState*)file};
+    if (nativeFile == nullptr || close(nativeFile->fileDescriptor) == -1) {
+        return fwErrorInvalidParameter;
+    }
+
+    free(nativeFile);
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Reads a whole range, unlike a single pread which may stop short.
+ * @param alignment A direct read only returns an unaligned size at the end of the file, another
+ *                  read from there would fail on the unaligned offset
+ * @return Bytes read, or -1 with errno set
+ */
+static ssize_t fwiReadFully(const int32_t fileDescriptor, void* buffer_p, const size_t size,
+                            const uint64_t offset, const uint32_t alignment) {
+    size_t done = 0;
+    while (done < size) {
+        const ssize_t result = pread(fileDescriptor, (uint8_t*)buffer_p + done, size - done,
+                                     (off_t)(offset + done));
+        if (result == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return -1;
+        }
+        if (result == 0) { // end of file
+            break;
+        }
+        done += result;
+        if (result % alignment != 0) {
+            break;
+        }
+    }
+    return (ssize_t)done;
+}
+
+static void* fwiFileQueueWork(void* queue_p) {
+    struct fwiFileQueue* queue = queue_p;
+
+    pthread_mutex_lock(&queue->mutex);
+    while (true) {
+        while (!queue->stopping && queue->pendingCount == 0) {
+            pthread_cond_wait(&queue->workAvailable, &queue->mutex);
+        }
+        if (queue->pendingCount == 0) {
+            break;
+        }
+
+        const fwFileRead read = queue->pending_p[queue->pendingHead];
+        queue->pendingHead = (queue->pendingHead + 1) % queue->depth;
+        queue->pendingCount--;
+        pthread_mutex_unlock(&queue->mutex);
+
+        const struct fwiNativeFileState* nativeFile = {(struct fwiNativeFileState*)read.file};
+        const ssize_t result = fwiReadFully(nativeFile->fileDescriptor, read.buffer_p, read.size,
+                                            read.offset, nativeFile->alignment);
+
+        pthread_mutex_lock(&queue->mutex);
+        fwFileCompletion* completion = &queue->completed_p[
+            (queue->completedHead + queue->completedCount) % queue->depth];
+        completion->userData = read.userData;
+        completion->bytes    = result < 0 ? 0 : (uint64_t)result;
+        completion->error    = result < 0 ? fwErrorFileRead : fwErrorSuccess;
+        queue->completedCount++;
+        pthread_cond_signal(&queue->workDone);
+    }
+    pthread_mutex_unlock(&queue->mutex);
+
+    return nullptr;
+}
+
+/**
+ * @brief Starts the worker threads for a queue that can not use io_uring.
+ */
+static fwError fwiFileQueueStartWorkers(struct fwiFileQueue* queue_p) {
+    queue_p->pending_p   = calloc(queue_p->depth, sizeof(fwFileRead));
+    queue_p->completed_p = calloc(queue_p->depth, sizeof(fwFileCompletion));
+
+    fwSystemConfiguration system = {};
+    fwGetSystemConfiguration(&system);
+    uint32_t workerCount = system.cores < 2 ? 2 : system.cores;
+    workerCount = workerCount > FWI_FILE_QUEUE_MAX_WORKERS ? FWI_FILE_QUEUE_MAX_WORKERS :
+                                                             workerCount;
+    workerCount = workerCount > queue_p->depth ? queue_p->depth : workerCount;
+    queue_p->workers_p = calloc(workerCount, sizeof(pthread_t));
+
+    if (queue_p->pending_p == nullptr || queue_p->completed_p == nullptr ||
+        queue_p->workers_p == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+
+    pthread_mutex_init(&queue_p->mutex, nullptr);
+    pthread_cond_init(&queue_p->workAvailable, nullptr);
+    pthread_cond_init(&queue_p->workDone, nullptr);
+
+    for (; queue_p->workerCount < workerCount; queue_p->workerCount++) {
+        if (pthread_create(&queue_p->workers_p[queue_p->workerCount], nullptr, fwiFileQueueWork,
+                           queue_p) != 0) {
+            break;
+        }
+    }
+
+    return queue_p->workerCount != 0 ? fwErrorSuccess : fwErrorOutOfMemory;
+}
+
+static void fwiFileQueueStopWorkers(struct fwiFileQueue* queue_p) {
+    if (queue_p->workerCount != 0) {
+        pthread_mutex_lock(&queue_p->mutex);
+        queue_p->stopping = true;
+        pthread_cond_broadcast(&queue_p->workAvailable);
+        pthread_mutex_unlock(&queue_p->mutex);
+
+        for (uint32_t i = 0; i < queue_p->workerCount; i++) {
+            pthread_join(queue_p->workers_p[i], nullptr);
+        }
+
+        pthread_cond_destroy(&queue_p->workDone);
+        pthread_cond_destroy(&queue_p->workAvailable);
+        pthread_mutex_destroy(&queue_p->mutex);
+    }
+
+    free(queue_p->workers_p);
+    free(queue_p->completed_p);
+    free(queue_p->pending_p);
+}
+
+fwError fwFileQueueCreate(const uint32_t depth, const uint32_t flags, fwFileQueue* queue_p) {
+    if (depth == 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiFileQueue* queue = calloc(1, sizeof(struct fwiFileQueue));
+    if (queue == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    queue->depth = depth;
+
+    if (!(flags & fwFileQueueFlagThreadPool)) {
+        fwError result = fwiUringCreate(&queue->ring, depth, 0);
+        if (result == fwErrorSuccess &&
+            (queue->slots_p = malloc(depth * sizeof(struct fwiFileQueueSlot))) == nullptr) {
+            fwiUringDestroy(&queue->ring);
+            result = fwErrorOutOfMemory;
+        }
+        queue->uring = result == fwErrorSuccess;
+        for (uint32_t i = 0; queue->uring && i < depth; i++) {
+            queue->slots_p[i].nextFree = i + 1;
+        }
+        if (!queue->uring) {
+            FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo,
+                      "io_uring is not available (%d), file reads fall back to worker threads",
+                      result);
+        }
+    }
+
+    if (!queue->uring) {
+        const fwError result = fwiFileQueueStartWorkers(queue);
+        if (result != fwErrorSuccess) {
+            fwiFileQueueStopWorkers(queue);
+            free(queue);
+            return result;
+        }
+    }
+
+    *queue_p = (uintptr_t)queue;
+    return fwErrorSuccess;
+}
+
+fwError fwFileQueueDestroy(const fwFileQueue queue) {
+    struct fwiFileQueue* nativeQueue = {(struct fwiFileQueue*)queue};
+    if (nativeQueue == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Reads in flight still write into buffers of the caller and must not outlive the queue
+    fwFileCompletion completions[64];
+    while (nativeQueue->inFlight != 0) {
+        uint32_t count;
+        if (fwFileQueueComplete(queue, completions, 64, 1, &count) != fwErrorSuccess) {
+            break;
+        }
+    }
+
+    if (nativeQueue->uring) {
+        fwiUringDestroy(&nativeQueue->ring);
+    }
+    else {
+        fwiFileQueueStopWorkers(nativeQueue);
+    }
+
+    free(nativeQueue->slots_p);
+    free(nativeQueue->files_p);
+    free(nativeQueue->buffers_p);
+    free(nativeQueue);
+    return fwErrorSuccess;
+}
+
+fwError fwFileQueueRegisterFiles(const fwFileQueue queue, const fwFile* files_p,
+                                 const uint32_t count) {
+    struct fwiFileQueue* nativeQueue = {(struct fwiFileQueue*)queue};
+    if (nativeQueue == nullptr || nativeQueue->inFlight != 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    int32_t* descriptors = nullptr;
+    if (files_p != nullptr && count != 0) {
+        if ((descriptors = malloc(count * sizeof(int32_t))) == nullptr) {
+            return fwErrorOutOfMemory;
+        }
+        for (uint32_t i = 0; i < count; i++) {
+            if (files_p[i] == 0) {
+                free(descriptors);
+                return fwErrorInvalidParameter;
+            }
+            descriptors[i] = ((struct fwiNativeFileState*)files_p[i])->fileDescriptor;
+        }
+    }
+
+    if (nativeQueue->uring) {
+        if (nativeQueue->fileCount != 0) {
+            fwiUringRegister(&nativeQueue->ring, IORING_UNREGISTER_FILES, nullptr, 0);
+        }
+        if (descriptors != nullptr &&
+            fwiUringRegister(&nativeQueue->ring, IORING_REGISTER_FILES, descriptors, count) < 0) {
+            free(descriptors);
+            descriptors = nullptr;
+        }
+    }
+
+    free(nativeQueue->files_p);
+    nativeQueue->files_p   = descriptors;
+    nativeQueue->fileCount = descriptors != nullptr ? count : 0;
+
+    return files_p == nullptr || descriptors != nullptr ? fwErrorSuccess : fwErrorInvalidParameter;
+}
+
+fwError fwFileQueueRegisterBuffers(const fwFileQueue queue, const fwFileBuffer* buffers_p,
+                                   const uint32_t count) {
+    struct fwiFileQueue* nativeQueue = {(struct fwiFileQueue*)queue};
+    if (nativeQueue == nullptr || nativeQueue->inFlight != 0) {
+        return fwErrorInvalidParameter;
+    }
+
+    fwFileBuffer* buffers = nullptr;
+    if (buffers_p != nullptr && count != 0) {
+        if ((buffers = malloc(count * sizeof(fwFileBuffer))) == nullptr) {
+            return fwErrorOutOfMemory;
+        }
+        memcpy(buffers, buffers_p, count * sizeof(fwFileBuffer));
+    }
+
+    if (nativeQueue->uring) {
+        if (nativeQueue->bufferCount != 0) {
+            fwiUringRegister(&nativeQueue->ring, IORING_UNREGISTER_BUFFERS, nullptr, 0);
+        }
+
+        if (buffers != nullptr) {
+            struct iovec* vectors = malloc(count * sizeof(struct iovec));
+            int32_t result = -ENOMEM;
+            if (vectors != nullptr) {
+                for (uint32_t i = 0; i < count; i++) {
+                    vectors[i].iov_base = buffers[i].data_p;
+                    vectors[i].iov_len  = buffers[i].size;
+                }
+                result = fwiUringRegister(&nativeQueue->ring, IORING_REGISTER_BUFFERS, vectors,
+                                          count);
+                free(vectors);
+            }
+
+            // Usually the locked memory limit, reads still work, just without the registration
+            if (result < 0) {
+                FWI_LOG_A(fwiLogDomainBase, fwiLogLevelWarning,
+                          "Could not register %u buffers with io_uring (%d)", count, result);
+                free(buffers);
+                free(nativeQueue->buffers_p);
+                nativeQueue->buffers_p   = nullptr;
+                nativeQueue->bufferCount = 0;
+                return fwErrorInvalidParameter;
+            }
+        }
+    }
+
+    free(nativeQueue->buffers_p);
+    nativeQueue->buffers_p   = buffers;
+    nativeQueue->bufferCount = buffers != nullptr ? count : 0;
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Fills a submission queue entry for what is left of the read in a slot, using registered
+ *        files and buffers when the read allows it.
+ */
+static void fwiFileQueuePrepareRead(const struct fwiFileQueue* queue_p, struct io_uring_sqe* sqe_p,
+                                    const uint32_t slot) {
+    const fwFileRead* read_p = &queue_p->slots_p[slot].read;
+    const uint64_t done = queue_p->slots_p[slot].done;
+    const int32_t fileDescriptor = ((struct fwiNativeFileState*)read_p->file)->fileDescriptor;
+
+    sqe_p->opcode    = IORING_OP_READ;
+    sqe_p->fd        = fileDescriptor;
+    sqe_p->addr      = (uintptr_t)read_p->buffer_p + done;
+    sqe_p->len       = (uint32_t)(read_p->size - done);
+    sqe_p->off       = read_p->offset + done;
+    sqe_p->user_data = slot;
+
+    for (uint32_t i = 0; i < queue_p->fileCount; i++) {
+        if (queue_p->files_p[i] == fileDescriptor) {
+            sqe_p->fd     = (int32_t)i;
+            sqe_p->flags |= IOSQE_FIXED_FILE;
+            break;
+        }
+    }
+
+    const uintptr_t begin = (uintptr_t)read_p->buffer_p;
+    for (uint32_t i = 0; i < queue_p->bufferCount; i++) {
+        const uintptr_t bufferBegin = (uintptr_t)queue_p->buffers_p[i].data_p;
+        if (begin >= bufferBegin &&
+            begin + read_p->size <= bufferBegin + queue_p->buffers_p[i].size) {
+            sqe_p->opcode    = IORING_OP_READ_FIXED;
+            sqe_p->buf_index = (uint16_t)i;
+            break;
+        }
+    }
+}
+
+fwError fwFileQueueSubmit(const fwFileQueue queue, const fwFileRead* reads_p,
+                          const uint32_t count, uint32_t* submitted_p) {
+    struct fwiFileQueue* nativeQueue = {(struct fwiFileQueue*)queue};
+    if (nativeQueue == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    uint32_t submitted = 0;
+    fwError ret = fwErrorSuccess;
+
+    if (nativeQueue->uring) {
+        for (; submitted < count && nativeQueue->inFlight + submitted < nativeQueue->depth;
+             submitted++) {
+            struct io_uring_sqe* sqe = fwiUringGetSqe(&nativeQueue->ring);
+            if (sqe == nullptr) {
+                break;
+            }
+            const uint32_t slot = nativeQueue->freeSlot;
+            nativeQueue->freeSlot = nativeQueue->slots_p[slot].nextFree;
+            nativeQueue->slots_p[slot].read = reads_p[submitted];
+            nativeQueue->slots_p[slot].done = 0;
+            fwiFileQueuePrepareRead(nativeQueue, sqe, slot);
+        }
+
+        // Entries the kernel did not take yet stay in the ring and go with the next call
+        const int32_t result = fwiUringSubmit(&nativeQueue->ring, 0);
+        if (result < 0 && result != -EAGAIN && result != -EBUSY) {
+            ret = fwErrorFileRead;
+        }
+    }
+    else {
+        pthread_mutex_lock(&nativeQueue->mutex);
+        for (; submitted < count && nativeQueue->inFlight + submitted < nativeQueue->depth;
+             submitted++) {
+            nativeQueue->pending_p[(nativeQueue->pendingHead + nativeQueue->pendingCount) %
+                                   nativeQueue->depth] = reads_p[submitted];
+            nativeQueue->pendingCount++;
+        }
+        pthread_cond_broadcast(&nativeQueue->workAvailable);
+        pthread_mutex_unlock(&nativeQueue->mutex);
+    }
+
+    nativeQueue->inFlight += submitted;
+    if (submitted_p != nullptr) {
+        *submitted_p = submitted;
+    }
+    return ret;
+}
+
+fwError fwFileQueueComplete(const fwFileQueue queue, fwFileCompletion* completions_p,
+                            const uint32_t capacity, uint32_t minimum, uint32_t* count_p) {
+    struct fwiFileQueue* nativeQueue = {(struct fwiFileQueue*)queue};
+    if (nativeQueue == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    minimum = minimum > capacity ? capacity : minimum;
+    minimum = minimum > nativeQueue->inFlight ? nativeQueue->inFlight : minimum;
+
+    uint32_t count = 0;
+    fwError ret = fwErrorSuccess;
+
+    if (nativeQueue->uring) {
+        bool continued = false;
+        while (true) {
+            struct io_uring_cqe* cqe;
+            while (count < capacity && (cqe = fwiUringPeekCqe(&nativeQueue->ring)) != nullptr) {
+                const uint32_t slot = (uint32_t)cqe->user_data;
+                const int32_t result = cqe->res;
+                fwiUringCqeSeen(&nativeQueue->ring);
+
+                // Short reads are continued like the worker threads do, only the end of the file
+                // or an error completes a read early, on direct files a partial block marks the end
+                struct fwiFileQueueSlot* entry = &nativeQueue->slots_p[slot];
+                const uint32_t alignment =
+                    ((struct fwiNativeFileState*)entry->read.file)->alignment;
+                if (result > 0) {
+                    entry->done += (uint64_t)result;
+                }
+                if (result > 0 && entry->done < entry->read.size && result % alignment == 0) {
+                    // The read's own entry was consumed, so the ring has room for the rest
+                    fwiFileQueuePrepareRead(nativeQueue, fwiUringGetSqe(&nativeQueue->ring), slot);
+                    continued = true;
+                    continue;
+                }
+
+                completions_p[count].userData = entry->read.userData;
+                completions_p[count].bytes    = result < 0 ? 0 : entry->done;
+                completions_p[count].error    = result < 0 ? fwErrorFileRead : fwErrorSuccess;
+                entry->nextFree       = nativeQueue->freeSlot;
+                nativeQueue->freeSlot = slot;
+                count++;
+            }
+
+            if (count >= minimum) {
+                if (continued && fwiUringSubmit(&nativeQueue->ring, 0) < 0) {
+                    ret = fwErrorFileRead;
+                }
+                break;
+            }
+            if (fwiUringSubmit(&nativeQueue->ring, minimum - count) < 0) {
+                ret = fwErrorFileRead;
+                break;
+            }
+        }
+    }
+    else {
+        pthread_mutex_lock(&nativeQueue->mutex);
+        while (nativeQueue->completedCount < minimum) {
+            pthread_cond_wait(&nativeQueue->workDone, &nativeQueue->mutex);
+        }
+        for (; count < capacity && nativeQueue->completedCount != 0; count++) {
+            completions_p[count] = nativeQueue->completed_p[nativeQueue->completedHead];
+            nativeQueue->completedHead = (nativeQueue->completedHead + 1) % nativeQueue->depth;
+            nativeQueue->completedCount--;
+        }
+        pthread_mutex_unlock(&nativeQueue->mutex);
+    }
+
+    nativeQueue->inFlight -= count;
+    *count_p = count;
+    return ret;
+}
+
+/**
+ * @brief Progress of one file of a batch load.
+ * @param done Bytes read so far
+ */
+struct fwiLoadFile {
+    const char* filename_p;
+    uint8_t* buffer_p;
+    uint64_t size;
+    uint64_t done;
+    struct statx stats;
+    int32_t fileDescriptor;
+    fwError error;
+};
+
+/**
+ * @brief Phases of a batch load, sizes must be known for every file before a packed allocation.
+ */
+typedef enum fwiLoadFilesPhase : uint8_t {
+    fwiLoadFilesPhaseSize,
+    fwiLoadFilesPhaseRead
+} fwiLoadFilesPhase;
+
+/**
+ * @brief Shared state of a batch load, worked on by either io_uring or worker threads.
+ * @param next Next file a worker thread picks up
+ */
+struct fwiLoadFiles {
+    struct fwiLoadFile* files_p;
+    uint32_t count;
+    fwiLoadFilesPhase phase;
+    _Atomic uint32_t next;
+};
+
+/**
+ * @brief Kind of an io_uring operation of a batch load, kept in the low bits of its user data.
+ */
+typedef enum fwiLoadFilesOperation : uint8_t {
+    fwiLoadFilesOperationOpen,
+    fwiLoadFilesOperationStat,
+    fwiLoadFilesOperationRead
+} fwiLoadFilesOperation;
+
+static void fwiLoadFilesPrepareRead(struct io_uring_sqe* sqe_p, const struct fwiLoadFile* file_p,
+                                    const uint32_t index) {
+    const uint64_t left = file_p->size - file_p->done;
+
+    sqe_p->opcode    = IORING_OP_READ;
+    sqe_p->fd        = file_p->fileDescriptor;
+    sqe_p->addr      = (uintptr_t)(file_p->buffer_p + file_p->done);
+    sqe_p->len       = left > FWI_LOAD_FILES_MAX_READ ? FWI_LOAD_FILES_MAX_READ : (uint32_t)left;
+    sqe_p->off       = file_p->done;
+    sqe_p->user_data = (uint64_t)index << 2 | fwiLoadFilesOperationRead;
+}
+
+/**
+ * @brief Maps why a file could not be sized by its path to the error of the file.
+ */
+static fwError fwiLoadFilesStatError(const int32_t error) {
+    switch (error) {
+        case ENOENT:
+        case ENOTDIR:
+        case EACCES:
+        case ELOOP:
+        case ENAMETOOLONG: {
+            return fwErrorFileUnableToOpen;
+        }
+        default: {
+            return fwErrorFileStats;
+        }
+    }
+}
+
+/**
+ * @brief Runs one phase of a batch load through io_uring. Sizing issues a statx per file, reading
+ *        opens a file, reads it until it is complete and closes it again.
+ * @note At most as many files as the ring has entries are open at once. An open that runs into
+ *       the limit on open files while others of the batch are still open is retried once one of
+ *       them is closed, and fewer are kept open from then on.
+ */
+static fwError fwiLoadFilesUring(struct fwiUring* ring_p, struct fwiLoadFiles* load_p,
+                                 const fwiLoadFilesPhase phase) {
+    uint32_t next = 0, inFlight = 0, limit = FWI_LOAD_FILES_RING_ENTRIES, opened = 0;
+    uint32_t retries[FWI_LOAD_FILES_RING_ENTRIES], retryCount = 0;
+    bool unsupported = false;
+
+    while (((next < load_p->count || retryCount != 0) && !unsupported) || inFlight != 0) {
+        while (!unsupported && inFlight < limit && (next < load_p->count || retryCount != 0)) {
+            const uint32_t index = retryCount != 0 ? retries[--retryCount] : next++;
+            struct fwiLoadFile* file = &load_p->files_p[index];
+            struct io_uring_sqe* sqe;
+
+            if (phase == fwiLoadFilesPhaseSize) {
+                sqe = fwiUringGetSqe(ring_p);
+                sqe->opcode       = IORING_OP_STATX;
+                sqe->fd           = AT_FDCWD;
+                sqe->addr         = (uintptr_t)file->filename_p;
+                sqe->len          = STATX_SIZE;
+                sqe->off          = (uintptr_t)&file->stats;
+                sqe->user_data    = (uint64_t)index << 2 | fwiLoadFilesOperationStat;
+            }
+            else {
+                if (file->error != fwErrorSuccess || file->size == 0) {
+                    continue;
+                }
+                sqe = fwiUringGetSqe(ring_p);
+                sqe->opcode       = IORING_OP_OPENAT;
+                sqe->fd           = AT_FDCWD;
+                sqe->addr         = (uintptr_t)file->filename_p;
+                sqe->open_flags   = O_RDONLY | O_CLOEXEC;
+                sqe->user_data    = (uint64_t)index << 2 | fwiLoadFilesOperationOpen;
+            }
+            inFlight++;
+        }
+
+        if (fwiUringSubmit(ring_p, inFlight != 0 ? 1 : 0) < 0) {
+            return fwErrorFileRead;
+        }
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = fwiUringPeekCqe(ring_p)) != nullptr) {
+            struct fwiLoadFile* file = &load_p->files_p[cqe->user_data >> 2];
+            const int32_t result = cqe->res;
+            const uint32_t index = (uint32_t)(cqe->user_data >> 2);
+
+            switch ((fwiLoadFilesOperation)(cqe->user_data & 3)) {
+                case fwiLoadFilesOperationOpen: {
+                    // The threads that take over open the file again
+                    if (result == -EINVAL) {
+                        unsupported = true;
+                        break;
+                    }
+                    if ((result == -EMFILE || result == -ENFILE) && opened != 0) {
+                        limit = opened;
+                        retries[retryCount++] = index;
+                        break;
+                    }
+                    if (result < 0) {
+                        file->error = fwErrorFileUnableToOpen;
+                        break;
+                    }
+                    file->fileDescriptor = result;
+                    opened++;
+                    fwiLoadFilesPrepareRead(fwiUringGetSqe(ring_p), file, index);
+                    inFlight++;
+                    break;
+                }
+                case fwiLoadFilesOperationStat: {
+                    unsupported |= result == -EINVAL;
+                    file->size = file->stats.stx_size;
+                    if (result < 0) {
+                        file->error = fwiLoadFilesStatError(-result);
+                    }
+                    break;
+                }
+                case fwiLoadFilesOperationRead: {
+                    bool more = false;
+                    if (result < 0) {
+                        file->error = fwErrorFileRead;
+                    }
+                    else if (result == 0) { // the file shrank since it was sized
+                        file->size = file->done;
+                    }
+                    else {
+                        file->done += result;
+                        more = file->done < file->size;
+                    }
+
+                    // Large files and short reads take another round, the slot is reused,
+                    // otherwise the file makes room for the next one
+                    if (more) {
+                        fwiLoadFilesPrepareRead(fwiUringGetSqe(ring_p), file, index);
+                        inFlight++;
+                    }
+                    else {
+                        close(file->fileDescriptor);
+                        file->fileDescriptor = -1;
+                        opened--;
+                    }
+                    break;
+                }
+            }
+
+            fwiUringCqeSeen(ring_p);
+            inFlight--;
+        }
+    }
+
+    return unsupported ? fwErrorUnimplemented : fwErrorSuccess;
+}
+
+static void* fwiLoadFilesWork(void* load_p) {
+    struct fwiLoadFiles* load = load_p;
+
+    uint32_t index;
+    while ((index = atomic_fetch_add(&load->next, 1)) < load->count) {
+        struct fwiLoadFile* file = &load->files_p[index];
+
+        if (load->phase == fwiLoadFilesPhaseSize) {
+            struct stat fileStats;
+            if (stat(file->filename_p, &fileStats)) {
+                file->error = fwiLoadFilesStatError(errno);
+                continue;
+            }
+            file->size = fileStats.st_size;
+        }
+        else if (file->error == fwErrorSuccess && file->size != 0) {
+            // Only open while it is read, so a batch is not bound by the limit on open files
+            const int32_t fileDescriptor = open(file->filename_p, O_RDONLY | O_CLOEXEC);
+            if (fileDescriptor == -1) {
+                file->error = fwErrorFileUnableToOpen;
+                continue;
+            }
+
+            const ssize_t result = fwiReadFully(fileDescriptor, file->buffer_p, file->size, 0, 1);
+            if (result < 0) {
+                file->error = fwErrorFileRead;
+            }
+            else {
+                file->done = file->size = result;
+            }
+            close(fileDescriptor);
+        }
+    }
+
+    return nullptr;
+}
+
+/**
+ * @brief Runs one phase of a batch load on worker threads.
+ */
+static void fwiLoadFilesPool(struct fwiLoadFiles* load_p, const fwiLoadFilesPhase phase) {
+    fwSystemConfiguration system = {};
+    fwGetSystemConfiguration(&system);
+
+    // Mostly waiting on the disk, so twice the cores keeps more requests in the device queue
+    uint32_t workerCount = system.cores < 1 ? 2 : system.cores * 2;
+    workerCount = workerCount > 32 ? 32 : workerCount;
+    workerCount = workerCount > load_p->count ? load_p->count : workerCount;
+
+    pthread_t workers[32];
+    uint32_t started = 0;
+    load_p->phase = phase;
+    atomic_store(&load_p->next, 0);
+    for (; started < workerCount; started++) {
+        if (pthread_create(&workers[started], nullptr, fwiLoadFilesWork, load_p) != 0) {
+            break;
+        }
+    }
+
+    // Without any thread the caller does the work itself
+    if (started == 0) {
+        fwiLoadFilesWork(load_p);
+    }
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i], nullptr);
+    }
+}
+
+fwError fwLoadFiles(const char* const* filenames_p, const uint32_t count, const uint32_t flags,
+                    fwLoadedFile* files_p, void** packed_pp) {
+    FW_PROFILE_SCOPE(fwiProfileZoneLoadFiles);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    if (packed_pp != nullptr) {
+        *packed_pp = nullptr;
+    }
+    if ((flags & fwLoadFilesFlagPacked) && packed_pp == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiLoadFiles load = {.count = count};
+    if ((load.files_p = calloc(count, sizeof(struct fwiLoadFile))) == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        load.files_p[i].filename_p     = filenames_p[i];
+        load.files_p[i].fileDescriptor = -1;
+    }
+
+    struct fwiUring ring;
+    bool uring = false;
+    if (!(flags & fwLoadFilesFlagThreadPool) && count != 0 &&
+        fwiUringCreate(&ring, FWI_LOAD_FILES_RING_ENTRIES, 0) == fwErrorSuccess) {
+        uring = fwiLoadFilesUring(&ring, &load, fwiLoadFilesPhaseSize) == fwErrorSuccess;
+
+        // Some kernels have io_uring but not its open and statx, so start over on threads
+        if (!uring) {
+            fwiUringDestroy(&ring);
+            for (uint32_t i = 0; i < count; i++) {
+                load.files_p[i] = (struct fwiLoadFile){.filename_p = filenames_p[i],
+                                                       .fileDescriptor = -1};
+            }
+        }
+    }
+    if (!uring && count != 0) {
+        fwiLoadFilesPool(&load, fwiLoadFilesPhaseSize);
+    }
+
+    fwError ret = fwErrorSuccess;
+    uint8_t* packed = nullptr;
+    if (flags & fwLoadFilesFlagPacked) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            total += (load.files_p[i].size + FWI_LOAD_FILES_PACKED_ALIGNMENT - 1) &
+                     ~(uint64_t)(FWI_LOAD_FILES_PACKED_ALIGNMENT - 1);
+        }
+        packed = fwiAllocate(fwiLogDomainBase, total, FWI_LOAD_FILES_PACKED_ALIGNMENT);
+        if (packed == nullptr) {
+            ret = fwErrorOutOfMemory;
+        }
+
+        uint64_t offset = 0;
+        for (uint32_t i = 0; packed != nullptr && i < count; i++) {
+            load.files_p[i].buffer_p = packed + offset;
+            offset += (load.files_p[i].size + FWI_LOAD_FILES_PACKED_ALIGNMENT - 1) &
+                      ~(uint64_t)(FWI_LOAD_FILES_PACKED_ALIGNMENT - 1);
+        }
+    }
+    else {
+        for (uint32_t i = 0; i < count; i++) {
+            struct fwiLoadFile* file = &load.files_p[i];
+            if (file->error == fwErrorSuccess && file->size != 0 &&
+                (file->buffer_p = fwiAllocate(fwiLogDomainBase, file->size, 16)) == nullptr) {
+                file->error = fwErrorOutOfMemory;
+            }
+        }
+    }
+
+    if (ret == fwErrorSuccess && count != 0) {
+        if (!uring || fwiLoadFilesUring(&ring, &load, fwiLoadFilesPhaseRead) != fwErrorSuccess) {
+            fwiLoadFilesPool(&load, fwiLoadFilesPhaseRead);
+        }
+    }
+    if (uring) {
+        fwiUringDestroy(&ring);
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        struct fwiLoadFile* file = &load.files_p[i];
+        if (file->fileDescriptor >= 0) { // left open when io_uring gave up during the reads
+            close(file->fileDescriptor);
+        }
+
+        if (ret == fwErrorOutOfMemory) {
+            file->error = fwErrorOutOfMemory;
+        }
+        if (file->error != fwErrorSuccess || file->size == 0) {
+            if (packed == nullptr) {
+                fwFree(file->buffer_p);
+            }
+            file->buffer_p = nullptr;
+        }
+        if (file->error != fwErrorSuccess) {
+            file->size = 0;
+        }
+
+        files_p[i].buffer_p = file->buffer_p;
+        files_p[i].size     = file->size;
+        files_p[i].error    = file->error;
+        if (ret == fwErrorSuccess) {
+            ret = file->error;
+        }
+    }
+
+    if (packed_pp != nullptr) {
+        *packed_pp = packed;
+    }
+
+    free(load.files_p);
+    fwiTraceEnd(fwiTraceTypeFileLoad, traceBegin, count, 0);
+    return ret;
+}
+
+#endif // PLATFORM_LINUX
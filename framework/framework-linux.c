@@ -16,6 +16,9 @@
 
 #ifdef PLATFORM_LINUX
 
+// accept4 is a GNU extension
+#define _GNU_SOURCE
+
 #include "internal.h"
 #include "linux.h"
 
@@ -25,28 +28,266 @@
 #include <unistd.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <netdb.h>
+#include <poll.h>
+#include <pthread.h>
+#include <signal.h>
 #include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/mman.h>
+#include <sys/sendfile.h>
 #include <sys/socket.h>
 #include <sys/stat.h>
+#include <sys/uio.h>
 #include <sys/un.h>
 
-struct fwiNativeSocketState {
-    char* targetAddress;
-    int32_t addressFamily;
-    int32_t protocol;
-    int32_t fileDescriptor;
-    bool connected, bound;
+/**
+ * @brief Slots per slab of the socket table and the most slabs it grows to. Slabs are never freed,
+ *        so a stale handle always points at valid memory and is caught by its generation.
+ */
+#define FWI_SOCKET_SLAB_SLOTS 1'024
+#define FWI_SOCKET_MAX_SLABS 16'384
+
+/**
+ * @brief Bits of a socket handle that hold the slot index, the generation of the slot takes the
+ *        bits above them.
+ */
+#define FWI_SOCKET_INDEX_BITS 24
+#define FWI_SOCKET_GENERATION_MASK ((uint32_t)(UINTPTR_MAX >> FWI_SOCKET_INDEX_BITS))
+
+/**
+ * @brief A slot of the socket table, on cache lines of its own so that sockets used by different
+ *        threads do not share lines.
+ * @param generation Changes every time the slot is freed, handles of earlier sockets stop
+ *                   matching it. Never zero, so no handle is zero either.
+ * @param nextFree Index of the next free slot while this one is free
+ */
+struct fwiSocketSlot {
+    alignas(64) struct fwiNativeSocketState state;
+    char address[FWI_SOCKET_ADDRESS_SIZE];
+    _Atomic uint32_t generation;
+    uint32_t nextFree;
 };
 
+static struct fwiSocketSlot* _Atomic socketSlabs_s[FWI_SOCKET_MAX_SLABS];
+static pthread_mutex_t socketTableMutex_s = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t socketSlabCount_s = 0;
+static uint32_t socketFreeHead_s = UINT32_MAX;
+
+/**
+ * @brief Largest transfer of a single sendfile call, and the bounce buffer used when the kernel
+ *        can not send from a file directly.
+ */
+#define FWI_SOCKET_SEND_FILE_MAX 0x7fff'f000
+#define FWI_SOCKET_SEND_FILE_BOUNCE (256u << 10)
+
+/**
+ * @brief Most buffers a vectored call hands to the kernel at once, larger arrays take several
+ *        system calls.
+ */
+#define FWI_SOCKET_VECTOR_WINDOW 64
+
+/**
+ * @brief Piece size of loads that compute a checksum, small enough to still be in the second
+ *        level cache when it is summed.
+ */
+#define FWI_LOAD_FILE_CHECKSUM_CHUNK (256u << 10)
+
+/**
+ * @brief Adds to a counter of the calling thread, which no other thread writes.
+ */
+static void fwiSocketThreadAdd(_Atomic uint64_t* counter_p, const uint64_t value) {
+    atomic_store_explicit(counter_p, atomic_load_explicit(counter_p, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+}
+
+/**
+ * @brief Returns the latency histograms of a socket, allocating them on its first call.
+ * @return nullptr when out of memory
+ */
+static struct fwiHistogram* fwiSocketLatency(struct fwiNativeSocketState* nativeSocket_p) {
+    struct fwiHistogram* latency = atomic_load_explicit(&nativeSocket_p->latency_p,
+                                                        memory_order_acquire);
+    if (latency != nullptr) {
+        return latency;
+    }
+
+    // Two threads may race on the first call, the loser uses the winner's
+    struct fwiHistogram* expected = nullptr;
+    if ((latency = calloc(2, sizeof(struct fwiHistogram))) == nullptr ||
+        atomic_compare_exchange_strong_explicit(&nativeSocket_p->latency_p, &expected, latency,
+                                                memory_order_acq_rel, memory_order_acquire)) {
+        return latency;
+    }
+    free(latency);
+    return expected;
+}
+
+/**
+ * @brief Counts a finished send or receive call on the socket and on the counters of the calling
+ *        thread, which are summed into the process-wide statistics when they are read.
+ * @param result[in] Return value of the call, errno is inspected if it is -1
+ */
+static void fwiSocketCount(struct fwiNativeSocketState* nativeSocket_p,
+                           const fwiSocketDirection direction, const size_t requested,
+                           const ssize_t result, const uint64_t ticks) {
+    const bool wouldBlock = result == -1 && (errno == EAGAIN || errno == EWOULDBLOCK);
+    const bool shortTransfer = result != -1 && (size_t)result < requested;
+
+    struct fwiSocketCounters* counters = &nativeSocket_p->counters;
+    struct fwiHistogram* latency = fwiSocketLatency(nativeSocket_p);
+    atomic_fetch_add_explicit(&counters->calls[direction], 1, memory_order_relaxed);
+    if (latency != nullptr) {
+        fwiHistogramRecordShared(&latency[direction], ticks);
+    }
+    if (result == -1) {
+        atomic_fetch_add_explicit(wouldBlock ? &counters->wouldBlock : &counters->errors, 1,
+                                  memory_order_relaxed);
+    }
+    else {
+        atomic_fetch_add_explicit(&counters->bytes[direction], result, memory_order_relaxed);
+    }
+    if (shortTransfer) {
+        atomic_fetch_add_explicit(&counters->shortTransfers[direction], 1, memory_order_relaxed);
+    }
+
+    struct fwiSocketThread* thread = fwiAcquireSocketThread();
+    if (thread == nullptr) {
+        return;
+    }
+    fwiSocketThreadAdd(&thread->counters.calls[direction], 1);
+    fwiHistogramRecord(&thread->latency[direction], ticks);
+    if (result == -1) {
+        fwiSocketThreadAdd(wouldBlock ? &thread->counters.wouldBlock : &thread->counters.errors,
+                           1);
+    }
+    else {
+        fwiSocketThreadAdd(&thread->counters.bytes[direction], result);
+        fwiSocketThreadAdd(&thread->counters.shortTransfers[direction], shortTransfer);
+    }
+}
+
+static struct fwiSocketSlot* fwiSocketSlotAt(const uint32_t index) {
+    struct fwiSocketSlot* slab = atomic_load_explicit(
+        &socketSlabs_s[index / FWI_SOCKET_SLAB_SLOTS], memory_order_acquire);
+    return slab == nullptr ? nullptr : &slab[index % FWI_SOCKET_SLAB_SLOTS];
+}
+
+/**
+ * @brief Takes a free slot of the socket table, growing it by a slab when every slot is in use.
+ * @param sfdop_p[out] Handle of the slot
+ * @return The zeroed state of the slot, nullptr when out of memory or slots
+ */
+static struct fwiNativeSocketState* fwiSocketAllocate(fwSocket* sfdop_p) {
+    pthread_mutex_lock(&socketTableMutex_s);
+
+    if (socketFreeHead_s == UINT32_MAX) {
+        struct fwiSocketSlot* slab = nullptr;
+        if (socketSlabCount_s < FWI_SOCKET_MAX_SLABS &&
+            (uint64_t)(socketSlabCount_s + 1) * FWI_SOCKET_SLAB_SLOTS <=
+            1ull << FWI_SOCKET_INDEX_BITS) {
+            slab = aligned_alloc(alignof(struct fwiSocketSlot),
+                                 FWI_SOCKET_SLAB_SLOTS * sizeof(struct fwiSocketSlot));
+        }
+        if (slab == nullptr) {
+            pthread_mutex_unlock(&socketTableMutex_s);
+            return nullptr;
+        }
+
+        // Chained so that the lowest index is handed out first
+        const uint32_t first = socketSlabCount_s * FWI_SOCKET_SLAB_SLOTS;
+        for (uint32_t i = 0; i < FWI_SOCKET_SLAB_SLOTS; i++) {
+            atomic_init(&slab[i].generation, 1);
+            atomic_init(&slab[i].state.latency_p, nullptr);
+            slab[i].nextFree = i + 1 < FWI_SOCKET_SLAB_SLOTS ? first + i + 1 : UINT32_MAX;
+        }
+        atomic_store_explicit(&socketSlabs_s[socketSlabCount_s], slab, memory_order_release);
+        socketSlabCount_s++;
+        socketFreeHead_s = first;
+    }
+
+    // Freed slots are reused first, their lines are the most likely to still be cached
+    const uint32_t index = socketFreeHead_s;
+    struct fwiSocketSlot* slot = fwiSocketSlotAt(index);
+    socketFreeHead_s = slot->nextFree;
+    pthread_mutex_unlock(&socketTableMutex_s);
+
+    // The histograms of the previous socket are kept, a stale handle may still be reading them
+    struct fwiHistogram* latency = atomic_load_explicit(&slot->state.latency_p,
+                                                        memory_order_relaxed);
+    memset(&slot->state, 0, sizeof(slot->state));
+    memset(slot->address, 0, sizeof(slot->address));
+    slot->state.targetAddress = slot->address;
+    if (latency != nullptr) {
+        memset(latency, 0, 2 * sizeof(struct fwiHistogram));
+        atomic_store_explicit(&slot->state.latency_p, latency, memory_order_relaxed);
+    }
+
+    const uint32_t generation = atomic_load_explicit(&slot->generation, memory_order_relaxed) &
+                                FWI_SOCKET_GENERATION_MASK;
+    *sfdop_p = (fwSocket)generation << FWI_SOCKET_INDEX_BITS | index;
+    return &slot->state;
+}
+
+/**
+ * @brief Puts a slot back into the free list, its handle stops resolving right away.
+ */
+static void fwiSocketFree(const fwSocket sfdop) {
+    const uint32_t index = sfdop & ((1u << FWI_SOCKET_INDEX_BITS) - 1);
+    struct fwiSocketSlot* slot = fwiSocketSlotAt(index);
+    if (slot == nullptr) {
+        return;
+    }
+
+    uint32_t generation = atomic_load_explicit(&slot->generation, memory_order_relaxed) + 1;
+    generation = (generation & FWI_SOCKET_GENERATION_MASK) == 0 ? generation + 1 : generation;
+    atomic_store_explicit(&slot->generation, generation, memory_order_release);
+
+    pthread_mutex_lock(&socketTableMutex_s);
+    slot->nextFree = socketFreeHead_s;
+    socketFreeHead_s = index;
+    pthread_mutex_unlock(&socketTableMutex_s);
+}
+
+struct fwiNativeSocketState* fwiSocketResolve(const fwSocket sfdop) {
+    const uint32_t index = sfdop & ((1u << FWI_SOCKET_INDEX_BITS) - 1);
+    const uint32_t generation = (uint32_t)(sfdop >> FWI_SOCKET_INDEX_BITS) &
+                                FWI_SOCKET_GENERATION_MASK;
+    if (generation == 0 || index / FWI_SOCKET_SLAB_SLOTS >= FWI_SOCKET_MAX_SLABS) {
+        return nullptr;
+    }
+
+    struct fwiSocketSlot* slot = fwiSocketSlotAt(index);
+    if (slot == nullptr || (atomic_load_explicit(&slot->generation, memory_order_acquire) &
+                            FWI_SOCKET_GENERATION_MASK) != generation) {
+        return nullptr;
+    }
+    return &slot->state;
+}
+
+static void fwiSocketCountInterrupt(struct fwiNativeSocketState* nativeSocket_p) {
+    atomic_fetch_add_explicit(&nativeSocket_p->counters.interrupted, 1, memory_order_relaxed);
+
+    struct fwiSocketThread* thread = fwiAcquireSocketThread();
+    if (thread != nullptr) {
+        fwiSocketThreadAdd(&thread->counters.interrupted, 1);
+    }
+}
+
 fwError fwGetSystemConfiguration(fwSystemConfiguration* res_p) {
     res_p->cores  = sysconf(_SC_NPROCESSORS_ONLN);
     // TODO: figure out why only first memory bank is counted
     res_p->memory = sysconf(_SC_PHYS_PAGES) * sysconf(_SC_AVPHYS_PAGES) / 1048576; // 1024^2, to MiB
+    fwiReadHugePages(&res_p->hugePageSize, &res_p->hugePages);
     return fwErrorSuccess;
 }
 
 fwError fwLoadFileToMem(const char* filename_p, void** buffer_pp, uint64_t* fileSize_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneLoadFile);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
     FILE* file = fopen(filename_p, "rb");
     if (!(uintptr_t)file) {
         return fwErrorFileUnableToOpen;
@@ -56,37 +297,227 @@ fwError fwLoadFileToMem(const char* filename_p, void** buffer_pp, uint64_t* file
 
     struct stat fileStats;
     if (fstat(fileDescriptor, &fileStats)) { // -1 on error
+        fclose(file);
         return fwErrorFileStats;
     }
 
     *fileSize_p = fileStats.st_size;
-    *buffer_pp = malloc(*fileSize_p);
+    *buffer_pp = fwiAllocate(fwiLogDomainBase, *fileSize_p, 16);
     if (!(uintptr_t)*buffer_pp) {
+        fclose(file);
+        return fwErrorOutOfMemory;
+    }
+
+    const size_t read = fread(*buffer_pp, 1, *fileSize_p, file);
+    fclose(file);
+    if (read != *fileSize_p) {
+        fwFree(*buffer_pp);
+        *buffer_pp = nullptr;
+        return fwErrorFileRead;
+    }
+
+    fwiTraceEnd(fwiTraceTypeFileLoad, traceBegin, 0, *fileSize_p);
+    return fwErrorSuccess;
+}
+
+fwError fwLoadFileToMemChecksum(const char* filename_p, const fwChecksumType type,
+                                void** buffer_pp, uint64_t* fileSize_p, uint64_t* checksum_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneLoadFile);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    fwChecksum checksum;
+    if (fwChecksumBegin(&checksum, type) != fwErrorSuccess) {
+        return fwErrorInvalidParameter;
+    }
+
+    const int32_t fileDescriptor = open(filename_p, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor == -1) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats)) {
+        close(fileDescriptor);
+        return fwErrorFileStats;
+    }
+    posix_fadvise(fileDescriptor, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const uint64_t size = fileStats.st_size;
+    uint8_t* buffer = fwiAllocate(fwiLogDomainBase, size, 16);
+    if (buffer == nullptr) {
+        close(fileDescriptor);
         return fwErrorOutOfMemory;
     }
 
-    fread(*buffer_pp, 1, *fileSize_p, file);
+    uint64_t done = 0;
+    while (done < size) {
+        const uint64_t left = size - done;
+        const ssize_t result = read(fileDescriptor, buffer + done,
+                                    left > FWI_LOAD_FILE_CHECKSUM_CHUNK ?
+                                    FWI_LOAD_FILE_CHECKSUM_CHUNK : left);
+        if (result == -1 && errno == EINTR) {
+            continue;
+        }
+        if (result == -1 || result == 0) { // an early end means the file shrank since it was sized
+            close(fileDescriptor);
+            fwFree(buffer);
+            return fwErrorFileRead;
+        }
+
+        fwChecksumUpdate(&checksum, buffer + done, result);
+        done += result;
+    }
+    close(fileDescriptor);
+
+    fwChecksumEnd(&checksum, checksum_p);
+    *buffer_pp  = buffer;
+    *fileSize_p = size;
+
+    fwiTraceEnd(fwiTraceTypeFileLoad, traceBegin, 0, size);
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Size of a PMD-level huge page, which file-backed huge pages need as alignment.
+ */
+#define FWI_HUGE_PAGE_SIZE (2ull << 20)
+
+/**
+ * @brief Maps a file at an address aligned to @c FWI_HUGE_PAGE_SIZE by reserving a larger range
+ *        first and mapping over part of it.
+ * @return The mapping or @c MAP_FAILED
+ */
+static void* fwiMapFileAligned(const int32_t fileDescriptor, const uint64_t size,
+                               const int32_t flags) {
+    const uint64_t reservedSize = size + FWI_HUGE_PAGE_SIZE;
+    uint8_t* reserved = mmap(nullptr, reservedSize, PROT_NONE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (reserved == MAP_FAILED) {
+        return MAP_FAILED;
+    }
+
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)reserved + FWI_HUGE_PAGE_SIZE - 1) &
+                                  ~(uintptr_t)(FWI_HUGE_PAGE_SIZE - 1));
+    void* mapping = mmap(aligned, size, PROT_READ, flags | MAP_FIXED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        munmap(reserved, reservedSize);
+        return MAP_FAILED;
+    }
+
+    // Give back what is left of the reservation on either side
+    const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    const uint64_t mappedSize = (size + pageSize - 1) & ~(pageSize - 1);
+    if (aligned != reserved) {
+        munmap(reserved, aligned - reserved);
+    }
+    if (aligned + mappedSize < reserved + reservedSize) {
+        munmap(aligned + mappedSize, reserved + reservedSize - (aligned + mappedSize));
+    }
+
+    return mapping;
+}
+
+fwError fwMapFile(const char* filename_p, const uint32_t flags, fwFileMapping* mapping_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneMapFile);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    if ((flags & fwMapFileFlagSequential) && (flags & fwMapFileFlagRandom)) {
+        return fwErrorInvalidParameter;
+    }
+
+    const int32_t fileDescriptor = open(filename_p, O_RDONLY | O_CLOEXEC);
+    if (fileDescriptor == -1) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats)) {
+        close(fileDescriptor);
+        return fwErrorFileStats;
+    }
+
+    mapping_p->data_p = nullptr;
+    mapping_p->size   = fileStats.st_size;
+    if (mapping_p->size == 0) { // mmap refuses empty ranges
+        close(fileDescriptor);
+        return fwErrorSuccess;
+    }
+
+    int32_t mapFlags = MAP_SHARED;
+    if (flags & fwMapFileFlagPopulate) {
+        mapFlags |= MAP_POPULATE;
+    }
+
+    void* mapping = MAP_FAILED;
+    if ((flags & fwMapFileFlagHugePages) && mapping_p->size >= FWI_HUGE_PAGE_SIZE) {
+        mapping = fwiMapFileAligned(fileDescriptor, mapping_p->size, mapFlags);
+    }
+    if (mapping == MAP_FAILED) {
+        mapping = mmap(nullptr, mapping_p->size, PROT_READ, mapFlags, fileDescriptor, 0);
+    }
+    const int32_t mapError = errno; // close and the log both may change it
+
+    // The mapping keeps its own reference to the file
+    close(fileDescriptor);
+
+    if (mapping == MAP_FAILED) {
+        errno = mapError;
+        FWI_LOG_ERRNO;
+        return mapError == ENOMEM ? fwErrorOutOfMemory : fwErrorFileMap;
+    }
+
+    // Hints are best effort, a kernel that does not know one still maps the file fine
+    if (flags & fwMapFileFlagSequential) {
+        madvise(mapping, mapping_p->size, MADV_SEQUENTIAL);
+    }
+    if (flags & fwMapFileFlagRandom) {
+        madvise(mapping, mapping_p->size, MADV_RANDOM);
+    }
+    if (flags & fwMapFileFlagWillNeed) {
+        madvise(mapping, mapping_p->size, MADV_WILLNEED);
+    }
+#ifdef MADV_HUGEPAGE
+    if (flags & fwMapFileFlagHugePages) {
+        madvise(mapping, mapping_p->size, MADV_HUGEPAGE);
+    }
+#endif
+
+    mapping_p->data_p = mapping;
+    fwiTraceEnd(fwiTraceTypeFileMap, traceBegin, 0, mapping_p->size);
+    return fwErrorSuccess;
+}
+
+fwError fwUnmapFile(fwFileMapping* mapping_p) {
+    if (mapping_p->data_p == nullptr) {
+        mapping_p->size = 0;
+        return fwErrorSuccess;
+    }
+
+    if (munmap((void*)mapping_p->data_p, mapping_p->size) == -1) {
+        return fwErrorInvalidParameter;
+    }
+
+    mapping_p->data_p = nullptr;
+    mapping_p->size   = 0;
     return fwErrorSuccess;
 }
 
-fwError fwSocketCreate(const fwSocketAddressFamily addressFamily, const fwSocketProtocol protocol,
-                       fwSocket* sfdop_p) {
-    int32_t realAddressFamily, realProtocol, targetAddressSize;
+fwError fwSocketCreate(fwSocket* sfdop_p, const fwSocketAddressFamily addressFamily,
+                       const fwSocketProtocol protocol) {
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+    int32_t realAddressFamily, realProtocol;
 
     switch (addressFamily) {
         case fwSocketAddressFamilyLocal: {
             realAddressFamily = AF_LOCAL;
-            targetAddressSize = 108;
             break;
         }
         case fwSocketAddressFamilyIPv4: {
             realAddressFamily = AF_INET;
-            targetAddressSize = INET_ADDRSTRLEN;
             break;
         }
         case fwSocketAddressFamilyIPv6: {
             realAddressFamily = AF_INET6;
-            targetAddressSize = INET6_ADDRSTRLEN;
             break;
         }
         default: {
@@ -112,84 +543,198 @@ fwError fwSocketCreate(const fwSocketAddressFamily addressFamily, const fwSocket
         }
     }
 
-    struct fwiNativeSocketState* nativeSocket;
-
-    // This memory is not leaked, is it put into the hands of the user in the form of an unsigned
-    // long, which is then reinterpreted. Freed in fwSocketClose
-    if ((nativeSocket = malloc(sizeof(struct fwiNativeSocketState) + targetAddressSize)) == nullptr) {
+    // The state lives in the socket table until fwSocketClose, the handle names its slot
+    struct fwiNativeSocketState* nativeSocket = fwiSocketAllocate(sfdop_p);
+    if (nativeSocket == nullptr) {
         return fwErrorOutOfMemory;
     }
     // Can you spot the difference which cost me a whole week to debug?
     //if ((nativeSocket = malloc(sizeof(struct fwiNativeSocketState)) + targetAddressSize) == nullptr) {
 
-    memset(nativeSocket, 0, sizeof(struct fwiNativeSocketState) + targetAddressSize);
-    nativeSocket->targetAddress = (char*)&nativeSocket->targetAddress +
-                                     sizeof(struct fwiNativeSocketState);
-
     nativeSocket->protocol       = realProtocol;
     nativeSocket->addressFamily  = realAddressFamily;
     if ((nativeSocket->fileDescriptor = socket(realAddressFamily, realProtocol, 0)) == -1) {
         FWI_LOG_ERRNO;
+        fwiSocketFree(*sfdop_p);
+        *sfdop_p = 0;
+        return fwErrorSocketCreate;
     }
 
-    *sfdop_p = (uintptr_t)nativeSocket;
+    atomic_fetch_add_explicit(&fwiGetState()->openSockets, 1, memory_order_relaxed);
+    fwiTraceEnd(fwiTraceTypeSocketCreate, traceBegin, *sfdop_p, fwErrorSuccess);
 
-    fwiLogA(fwiLogLevelInfo, "New socket (ID: %X) was created", nativeSocket);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "New socket (ID: %lX) was created",
+              (unsigned long)*sfdop_p);
+    return fwErrorSuccess;
+}
+
+void fwiSocketSettleConnect(struct fwiNativeSocketState* nativeSocket_p) {
+    if (nativeSocket_p == nullptr || !nativeSocket_p->connecting ||
+        nativeSocket_p->connectError != EINPROGRESS) {
+        return;
+    }
+
+    int32_t error = 0;
+    socklen_t size = sizeof(error);
+    if (getsockopt(nativeSocket_p->fileDescriptor, SOL_SOCKET, SO_ERROR, &error, &size) == -1) {
+        error = errno;
+    }
+    nativeSocket_p->connectError = error;
+    nativeSocket_p->connected    = error == 0;
+}
+
+/**
+ * @brief Reports how a non-blocking connect that was underway ended, checking the socket itself
+ *        if no event loop did so yet.
+ */
+static fwError fwiSocketConnectResult(const fwSocket sfdop,
+                                      struct fwiNativeSocketState* nativeSocket_p) {
+    if (nativeSocket_p->connectError == EINPROGRESS) {
+        struct pollfd descriptor = {.fd = nativeSocket_p->fileDescriptor, .events = POLLOUT};
+        if (poll(&descriptor, 1, 0) != 1) {
+            return fwErrorSocketWouldBlock;
+        }
+        fwiSocketSettleConnect(nativeSocket_p);
+    }
+    nativeSocket_p->connecting = false;
+
+    if (nativeSocket_p->connectError != 0) {
+        errno = nativeSocket_p->connectError;
+        FWI_LOG_ERRNO;
+        return fwErrorSocketConnection;
+    }
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Socket (ID: %lX) connected to %s",
+              (unsigned long)sfdop, nativeSocket_p->targetAddress);
     return fwErrorSuccess;
 }
 
 fwError fwSocketConnect(const fwSocket sfdop, const fwSocketAddress* connectInfo_p) {
-    struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketConnect);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
 
-    struct addrinfo hint      = {};
-    struct addrinfo* res      = {};
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
 
-    hint.ai_family            = nativeSocket->addressFamily;
-    hint.ai_socktype          = nativeSocket->protocol;
+    // Called again while a non-blocking connect is underway, it tells how that one ended
+    if (nativeSocket->connecting) {
+        const fwError result = fwiSocketConnectResult(sfdop, nativeSocket);
+        if (result != fwErrorSocketWouldBlock) {
+            fwiTraceEnd(fwiTraceTypeSocketConnect, traceBegin, sfdop, result);
+        }
+        return result;
+    }
 
-    if (getaddrinfo(connectInfo_p->target_p, connectInfo_p->port_p, &hint, &res)) {
-        freeaddrinfo(res);
-        return fwErrorSocketTargetName;
+    // A non-blocking connect that is underway is settled through the event loop, not retried here
+    bool pending = false;
+
+    // Local sockets are addressed by path, which name resolution does not know about
+    if (nativeSocket->addressFamily == AF_LOCAL) {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_LOCAL;
+        strncpy(address.sun_path, connectInfo_p->target_p, sizeof(address.sun_path) - 1);
+
+        if (connect(nativeSocket->fileDescriptor, (struct sockaddr*)&address,
+                    sizeof(address)) == -1) {
+            // Local connections are never underway, a full backlog has to be tried again
+            const fwError error = nativeSocket->nonBlocking && errno == EAGAIN ?
+                                  fwErrorSocketWouldBlock : fwErrorSocketConnection;
+            if (error == fwErrorSocketConnection) {
+                FWI_LOG_ERRNO;
+            }
+            fwiTraceEnd(fwiTraceTypeSocketConnect, traceBegin, sfdop, error);
+            return error;
+        }
     }
+    else {
+        struct addrinfo hint      = {};
+        struct addrinfo* res      = {};
 
-    const struct addrinfo *it = res;
-    do {
-        if (connect(nativeSocket->fileDescriptor, it->ai_addr, sizeof(struct sockaddr_in)) == -1) {
-            FWI_LOG_ERRNO;
-            close(sfdop);
-            it = it->ai_next;
-            continue;
+        hint.ai_family            = nativeSocket->addressFamily;
+        hint.ai_socktype          = nativeSocket->protocol;
+
+        if (getaddrinfo(connectInfo_p->target_p, connectInfo_p->port_p, &hint, &res)) {
+            return fwErrorSocketTargetName;
         }
-        break;
-    } while (it != nullptr);
 
-    if (it == nullptr) {
+        const struct addrinfo *it = res;
+        do {
+            if (connect(nativeSocket->fileDescriptor, it->ai_addr, it->ai_addrlen) == -1) {
+                if (nativeSocket->nonBlocking && errno == EINPROGRESS) {
+                    pending = true;
+                    break;
+                }
+                FWI_LOG_ERRNO;
+                it = it->ai_next;
+                continue;
+            }
+            break;
+        } while (it != nullptr);
+
         freeaddrinfo(res);
-        return fwErrorSocketConnection;
+        if (it == nullptr) {
+            fwiTraceEnd(fwiTraceTypeSocketConnect, traceBegin, sfdop, fwErrorSocketConnection);
+            return fwErrorSocketConnection;
+        }
     }
 
-    nativeSocket->connected = true;
+    // Only connected once the event loop or the next call saw the connection established
+    nativeSocket->connected    = !pending;
+    nativeSocket->connecting   = pending;
+    nativeSocket->connectError = pending ? EINPROGRESS : 0;
     nativeSocket->bound = true;
-    strncpy(nativeSocket->targetAddress, connectInfo_p->target_p, 108);
+    strncpy(nativeSocket->targetAddress, connectInfo_p->target_p,
+            FWI_SOCKET_ADDRESS_SIZE - 1);
+
+    if (pending) {
+        fwiTraceEnd(fwiTraceTypeSocketConnect, traceBegin, sfdop, fwErrorSocketWouldBlock);
+        FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Socket (ID: %lX) is connecting to %s",
+                  (unsigned long)sfdop, connectInfo_p->target_p);
+        return fwErrorSocketWouldBlock;
+    }
 
-    fwiLogA(fwiLogLevelInfo, "Socket (ID: %X) connected to %s", nativeSocket, connectInfo_p->target_p);
+    fwiTraceEnd(fwiTraceTypeSocketConnect, traceBegin, sfdop, fwErrorSuccess);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Socket (ID: %lX) connected to %s",
+              (unsigned long)sfdop, connectInfo_p->target_p);
     return fwErrorSuccess;
 }
 
 fwError fwSocketBind(const fwSocket sfdop, const struct fwSocketAddress* localAddress) {
-    struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
 
     switch (nativeSocket->addressFamily) {
-        case AF_INET6:
         case AF_INET: {
             struct sockaddr_in address = {};
-            address.sin_family = nativeSocket->addressFamily;
+            address.sin_family = AF_INET;
             address.sin_port = htons(atoi(localAddress->port_p));
 
-            if (strcmp(localAddress->target_p, FW_SOCKET_ADDRESS_ANY)) {
+            if (strcmp(localAddress->target_p, FW_SOCKET_ADDRESS_ANY) == 0) {
                 address.sin_addr.s_addr = INADDR_ANY;
-            } else {
-                inet_pton(nativeSocket->addressFamily, localAddress->target_p, &address.sin_addr);
+            } else if (inet_pton(AF_INET, localAddress->target_p, &address.sin_addr) != 1) {
+                return fwErrorSocketBind;
+            }
+
+            if (bind(nativeSocket->fileDescriptor, (struct sockaddr*)&address,
+                sizeof(address)) == -1) {
+                FWI_LOG_ERRNO;
+                return fwErrorSocketBind;
+            }
+
+            break;
+        }
+        case AF_INET6: {
+            struct sockaddr_in6 address = {};
+            address.sin6_family = AF_INET6;
+            address.sin6_port = htons(atoi(localAddress->port_p));
+
+            if (strcmp(localAddress->target_p, FW_SOCKET_ADDRESS_ANY) == 0) {
+                address.sin6_addr = in6addr_any;
+            } else if (inet_pton(AF_INET6, localAddress->target_p, &address.sin6_addr) != 1) {
+                return fwErrorSocketBind;
             }
 
             if (bind(nativeSocket->fileDescriptor, (struct sockaddr*)&address,
@@ -219,24 +764,67 @@ fwError fwSocketBind(const fwSocket sfdop, const struct fwSocketAddress* localAd
     }
 
     nativeSocket->bound = true;
-    fwiLogA(fwiLogLevelInfo, "Socket (ID: %X) was bound to %s", nativeSocket, localAddress->target_p);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Socket (ID: %lX) was bound to %s",
+              (unsigned long)sfdop, localAddress->target_p);
     return fwErrorSuccess;
 }
 
-fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignAddress) {
-    const struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
-
-    if (nativeSocket->bound == false) {
+fwError fwiSocketListen(struct fwiNativeSocketState* nativeSocket_p) {
+    if (nativeSocket_p->listening) {
+        return fwErrorSuccess;
+    }
+    if (nativeSocket_p->bound == false) {
         return fwErrorSocketNotBound;
     }
 
-    if (listen(nativeSocket->fileDescriptor, 128) == -1) {
+    // The kernel caps the backlog at net.core.somaxconn
+    if (listen(nativeSocket_p->fileDescriptor, SOMAXCONN) == -1) {
         FWI_LOG_ERRNO;
         return fwErrorSocketListen;
     }
+    nativeSocket_p->listening = true;
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Takes a connection off a listening socket, out of those an io_uring event loop already
+ *        accepted if one watches the socket.
+ * @return Descriptor of the connection, -1 with errno set on failure
+ */
+static int32_t fwiSocketAcceptNative(struct fwiNativeSocketState* nativeSocket_p,
+                                     struct sockaddr* address_p, socklen_t* size_p,
+                                     const int32_t flags) {
+    if (!nativeSocket_p->uring) {
+        return accept4(nativeSocket_p->fileDescriptor, address_p, size_p, flags);
+    }
+
+    int32_t fileDescriptor;
+    const fwError queued = fwiEventLoopAccept(nativeSocket_p, &fileDescriptor);
+    if (queued != fwErrorSuccess) {
+        errno = queued == fwErrorSocketWouldBlock ? EAGAIN : ECONNABORTED;
+        return -1;
+    }
+    getpeername(fileDescriptor, address_p, size_p);
+    return fileDescriptor;
+}
+
+fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignAddress) {
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketAccept);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
 
-    // ReSharper disable once CppDFAMemoryLeak
-    struct fwiNativeSocketState* newNativeSocket = malloc(sizeof(struct fwiNativeSocketState));
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    const fwError listening = fwiSocketListen(nativeSocket);
+    if (listening != fwErrorSuccess) {
+        return listening;
+    }
+    const int32_t acceptFlags = nativeSocket->nonBlocking ? SOCK_NONBLOCK : 0;
+
+    fwSocket newHandle;
+    struct fwiNativeSocketState* newNativeSocket = fwiSocketAllocate(&newHandle);
     if (newNativeSocket == nullptr) {
         return fwErrorOutOfMemory;
     }
@@ -250,9 +838,11 @@ fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignA
             newNativeSocket->bound          = true;
             newNativeSocket->protocol       = nativeSocket->protocol;
             newNativeSocket->addressFamily  = nativeSocket->addressFamily;
-            newNativeSocket->fileDescriptor = accept(nativeSocket->fileDescriptor,
-                                                       (struct sockaddr*)&address, &sockSize);
-            inet_ntop(AF_INET, &address.sin_addr, nativeSocket->targetAddress, INET_ADDRSTRLEN);
+            newNativeSocket->fileDescriptor = fwiSocketAcceptNative(nativeSocket,
+                                                                    (struct sockaddr*)&address,
+                                                                    &sockSize, acceptFlags);
+            inet_ntop(AF_INET, &address.sin_addr, newNativeSocket->targetAddress,
+                      INET_ADDRSTRLEN);
 
             if (foreignAddress != nullptr) {
                 strncpy(foreignAddress, newNativeSocket->targetAddress, INET_ADDRSTRLEN);
@@ -268,9 +858,11 @@ fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignA
             newNativeSocket->bound          = true;
             newNativeSocket->protocol       = nativeSocket->protocol;
             newNativeSocket->addressFamily  = nativeSocket->addressFamily;
-            newNativeSocket->fileDescriptor = accept(nativeSocket->fileDescriptor,
-                                                       (struct sockaddr*)&address, &sockSize);
-            inet_ntop(AF_INET6, &address.sin6_addr, nativeSocket->targetAddress, INET6_ADDRSTRLEN);
+            newNativeSocket->fileDescriptor = fwiSocketAcceptNative(nativeSocket,
+                                                                    (struct sockaddr*)&address,
+                                                                    &sockSize, acceptFlags);
+            inet_ntop(AF_INET6, &address.sin6_addr, newNativeSocket->targetAddress,
+                      INET6_ADDRSTRLEN);
 
             if (foreignAddress != nullptr) {
                 strncpy(foreignAddress, newNativeSocket->targetAddress, INET6_ADDRSTRLEN);
@@ -286,9 +878,17 @@ fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignA
             newNativeSocket->bound          = true;
             newNativeSocket->protocol       = nativeSocket->protocol;
             newNativeSocket->addressFamily  = nativeSocket->addressFamily;
-            newNativeSocket->fileDescriptor = accept(nativeSocket->fileDescriptor,
-                                                       (struct sockaddr*)&address, &sockSize);
-            inet_ntop(AF_INET, &address.sun_path, nativeSocket->targetAddress, 108);
+            newNativeSocket->fileDescriptor = fwiSocketAcceptNative(nativeSocket,
+                                                                    (struct sockaddr*)&address,
+                                                                    &sockSize, acceptFlags);
+            // Unnamed peers leave the path empty, and a full path is not terminated
+            const size_t pathSize = sockSize > offsetof(struct sockaddr_un, sun_path) ?
+                                    sockSize - offsetof(struct sockaddr_un, sun_path) : 0;
+            size_t copied = pathSize < sizeof(address.sun_path) ? pathSize :
+                                                                   sizeof(address.sun_path);
+            copied = copied < FWI_SOCKET_ADDRESS_SIZE - 1 ? copied : FWI_SOCKET_ADDRESS_SIZE - 1;
+            memcpy(newNativeSocket->targetAddress, address.sun_path, copied);
+            newNativeSocket->targetAddress[copied] = '\0';
 
             if (foreignAddress != nullptr) {
                 strncpy(foreignAddress, newNativeSocket->targetAddress, 108);
@@ -297,62 +897,541 @@ fwError fwSocketAccept(const fwSocket sfdop, fwSocket* newSocket, char* foreignA
             break;
         }
         default: {
+            fwiSocketFree(newHandle);
             return fwErrorGoodJob;
         }
     }
 
     if (newNativeSocket->fileDescriptor == -1) {
-        FWI_LOG_ERRNO;
-        free(newNativeSocket);
-        return fwErrorSocketAccept;
+        const bool wouldBlock = errno == EAGAIN || errno == EWOULDBLOCK;
+        if (!wouldBlock) {
+            FWI_LOG_ERRNO;
+        }
+        fwiSocketFree(newHandle);
+        return wouldBlock ? fwErrorSocketWouldBlock : fwErrorSocketAccept;
     }
 
-    *newSocket = (uintptr_t)newNativeSocket;
+    newNativeSocket->nonBlocking = nativeSocket->nonBlocking;
+    *newSocket = newHandle;
+    atomic_fetch_add_explicit(&fwiGetState()->openSockets, 1, memory_order_relaxed);
+    fwiTraceEnd(fwiTraceTypeSocketAccept, traceBegin, *newSocket, fwErrorSuccess);
 
     return fwErrorSuccess;
 }
 
 fwError fwSocketSend(const fwSocket sfdop, const void* data, const size_t ammount) {
-    struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketSend);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    const uint64_t begin = fwiProfileTicks();
+    if (nativeSocket->uring) {
+        // Queued whole, the data goes out with the next wait of the loop
+        const fwSocketBuffer buffer = {.data_p = (void*)data, .size = ammount};
+        const fwError queued = fwiEventLoopSend(nativeSocket, &buffer, 1);
+        if (queued != fwErrorSuccess) {
+            errno = ENOBUFS;
+        }
+        fwiSocketCount(nativeSocket, fwiSocketDirectionSend, ammount,
+                       queued == fwErrorSuccess ? (ssize_t)ammount : -1,
+                       fwiProfileTicks() - begin);
+        if (queued == fwErrorSuccess) {
+            fwiTraceEnd(fwiTraceTypeSocketSend, traceBegin, sfdop, ammount);
+        }
+        return queued;
+    }
+
+    // A peer that went away has to show up as an error, not as SIGPIPE killing the process
+    ssize_t written;
+    while ((written = send(nativeSocket->fileDescriptor, data, ammount, MSG_NOSIGNAL)) == -1 &&
+           errno == EINTR) {
+        fwiSocketCountInterrupt(nativeSocket);
+    }
+    fwiSocketCount(nativeSocket, fwiSocketDirectionSend, ammount, written,
+                   fwiProfileTicks() - begin);
 
-    const size_t written = write(nativeSocket->fileDescriptor, data, ammount);
     if (written == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return fwErrorSocketWouldBlock;
+        }
         FWI_LOG_ERRNO;
         return fwErrorSocketSend;
     }
-    fwiLogA(fwiLogLevelDebug, "Socket (ID: %X) sent %d bytes", nativeSocket, written);
+    fwiTraceEnd(fwiTraceTypeSocketSend, traceBegin, sfdop, written);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelDebug, "Socket (ID: %lX) sent %ld bytes",
+              (unsigned long)sfdop, (long)written);
     return fwErrorSuccess;
 }
 
+/**
+ * @brief Reads the part of a file that a bounce buffer send passes on next, the read is widened to
+ *        the alignment of the file.
+ * @return Bytes readable from @c *data_pp , 0 at the end of the file, or -1 with errno set
+ */
+static ssize_t fwiSocketSendFileRead(const struct fwiNativeFileState* nativeFile_p,
+                                     uint8_t* buffer_p, const uint64_t position,
+                                     const uint64_t size, const uint8_t** data_pp) {
+    const uint64_t alignment = nativeFile_p->alignment;
+    const uint64_t readBegin = position - position % alignment;
+    uint64_t readSize = (position - readBegin + size + alignment - 1) / alignment * alignment;
+    readSize = readSize > FWI_SOCKET_SEND_FILE_BOUNCE ? FWI_SOCKET_SEND_FILE_BOUNCE : readSize;
+
+    ssize_t result;
+    while ((result = pread(nativeFile_p->fileDescriptor, buffer_p, readSize, readBegin)) == -1 &&
+           errno == EINTR) {}
+    if (result == -1) {
+        return -1;
+    }
+
+    *data_pp = buffer_p + (position - readBegin);
+    const uint64_t available = (uint64_t)result > position - readBegin ?
+                               (uint64_t)result - (position - readBegin) : 0;
+    return (ssize_t)(available > size ? size : available);
+}
+
+/**
+ * @brief sendfile has no MSG_NOSIGNAL, so SIGPIPE is blocked around it and a signal it raised
+ *        is taken back. A peer that went away then shows up as an error instead of killing the
+ *        process.
+ */
+static ssize_t fwiSocketSendFileNative(const int32_t socketDescriptor,
+                                       const int32_t fileDescriptor, off_t* position_p,
+                                       const size_t size) {
+    sigset_t pipeSignal, previous, pending;
+    sigemptyset(&pipeSignal);
+    sigaddset(&pipeSignal, SIGPIPE);
+    sigpending(&pending);
+    const bool wasPending = sigismember(&pending, SIGPIPE);
+    pthread_sigmask(SIG_BLOCK, &pipeSignal, &previous);
+
+    // The signal is raised even when part of the data went out before the peer was found gone
+    const ssize_t sent = sendfile(socketDescriptor, fileDescriptor, position_p, size);
+    const int32_t sendError = errno;
+    if (!wasPending && sigpending(&pending) == 0 && sigismember(&pending, SIGPIPE)) {
+        const struct timespec immediately = {};
+        while (sigtimedwait(&pipeSignal, nullptr, &immediately) == -1 && errno == EINTR) {}
+    }
+
+    pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+    errno = sendError;
+    return sent;
+}
+
+fwError fwSocketSendFile(const fwSocket sfdop, const fwFile file, const uint64_t offset,
+                         const uint64_t length, uint64_t* sent_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketSendFile);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    const struct fwiNativeFileState* nativeFile = {(struct fwiNativeFileState*)file};
+    if (sent_p != nullptr) {
+        *sent_p = 0;
+    }
+    if (nativeSocket == nullptr || nativeFile == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+    if (nativeSocket->uring) {
+        return fwErrorUnimplemented;
+    }
+
+    // Up to the end of the file as it is now, it may have grown since it was opened
+    uint64_t end = offset + length;
+    if (length == 0) {
+        struct stat fileStats;
+        if (fstat(nativeFile->fileDescriptor, &fileStats)) {
+            return fwErrorFileStats;
+        }
+        end = fileStats.st_size;
+    }
+
+    off_t position = (off_t)offset;
+    uint8_t* bounce = nullptr;
+    bool direct = true;
+    fwError ret = fwErrorSuccess;
+
+    while ((uint64_t)position < end) {
+        const uint64_t left = end - position;
+        const size_t size = left > FWI_SOCKET_SEND_FILE_MAX ? FWI_SOCKET_SEND_FILE_MAX : left;
+        const uint64_t begin = fwiProfileTicks();
+        ssize_t sent;
+
+        if (direct) {
+            // Short transfers move position along, the loop picks up from there
+            sent = fwiSocketSendFileNative(nativeSocket->fileDescriptor, nativeFile->fileDescriptor,
+                                           &position, size);
+            if (sent == -1 && (errno == EINVAL || errno == ENOSYS)) {
+                direct = false;
+                continue;
+            }
+        }
+        else {
+            if (bounce == nullptr &&
+                (bounce = fwiAllocate(fwiLogDomainNetwork, FWI_SOCKET_SEND_FILE_BOUNCE,
+                                      4'096)) == nullptr) {
+                ret = fwErrorOutOfMemory;
+                break;
+            }
+
+            const uint8_t* data;
+            const ssize_t readable = fwiSocketSendFileRead(nativeFile, bounce, position, size,
+                                                           &data);
+            if (readable == -1) {
+                FWI_LOG_ERRNO;
+                ret = fwErrorFileRead;
+                break;
+            }
+            if (readable == 0) { // the file ended early
+                break;
+            }
+
+            // Whatever the socket does not take is read again on the next round
+            sent = send(nativeSocket->fileDescriptor, data, readable, MSG_NOSIGNAL);
+            if (sent > 0) {
+                position += sent;
+            }
+        }
+
+        if (sent == -1 && errno == EINTR) {
+            fwiSocketCountInterrupt(nativeSocket);
+            continue;
+        }
+        fwiSocketCount(nativeSocket, fwiSocketDirectionSend, size, sent,
+                       fwiProfileTicks() - begin);
+
+        if (sent == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ret = fwErrorSocketWouldBlock;
+            }
+            else {
+                FWI_LOG_ERRNO;
+                ret = fwErrorSocketSend;
+            }
+            break;
+        }
+        if (sent == 0) { // the file ended early
+            break;
+        }
+    }
+
+    fwFree(bounce);
+    if (sent_p != nullptr) {
+        *sent_p = position - offset;
+    }
+
+    fwiTraceEnd(fwiTraceTypeSocketSendFile, traceBegin, sfdop, position - offset);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelDebug, "Socket (ID: %lX) sent %lu bytes of a file",
+              (unsigned long)sfdop, (unsigned long)(position - offset));
+    return ret;
+}
+
 fwError fwSocketReceive(const fwSocket sfdop, void* buffer, const size_t ammount) {
-    struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketReceive);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    const uint64_t begin = fwiProfileTicks();
+    ssize_t readden; // grammar 100
+    if (nativeSocket->uring) {
+        size_t received;
+        const fwError taken = fwiEventLoopReceive(nativeSocket, buffer, ammount, &received);
+        readden = taken == fwErrorSuccess ? (ssize_t)received : -1;
+        errno   = taken == fwErrorSocketWouldBlock ? EAGAIN : EIO;
+    }
+    else {
+        while ((readden = read(nativeSocket->fileDescriptor, buffer, ammount)) == -1 &&
+               errno == EINTR) {
+            fwiSocketCountInterrupt(nativeSocket);
+        }
+    }
+    fwiSocketCount(nativeSocket, fwiSocketDirectionReceive, ammount, readden,
+                   fwiProfileTicks() - begin);
 
-    const size_t readden = read(nativeSocket->fileDescriptor, buffer, ammount); // grammar 100
     if (readden == -1) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return fwErrorSocketWouldBlock;
+        }
         FWI_LOG_ERRNO;
         return fwErrorSocketReceive;
     }
-    fwiLogA(fwiLogLevelDebug, "Socket (ID: %X) received %d bytes", nativeSocket, readden);
+    fwiTraceEnd(fwiTraceTypeSocketReceive, traceBegin, sfdop, readden);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelDebug, "Socket (ID: %lX) received %ld bytes",
+              (unsigned long)sfdop, (long)readden);
     return fwErrorSuccess;
 }
 
+/**
+ * @brief Moves a position in an array of buffers forward, past any buffers that are empty.
+ */
+static void fwiSocketVectorAdvance(const fwSocketBuffer* buffers_p, const uint32_t count,
+                                   uint32_t* first_p, size_t* offset_p, size_t bytes) {
+    while (*first_p < count) {
+        const size_t left = buffers_p[*first_p].size - *offset_p;
+        if (bytes < left) {
+            *offset_p += bytes;
+            return;
+        }
+        bytes -= left;
+        (*first_p)++;
+        *offset_p = 0;
+    }
+}
+
+/**
+ * @brief Fills a window of iovecs with what is left of the buffers from a position on.
+ * @return Number of iovecs filled
+ */
+static uint32_t fwiSocketVectorWindow(const fwSocketBuffer* buffers_p, const uint32_t count,
+                                      const uint32_t first, const size_t offset,
+                                      struct iovec* window_p, size_t* size_p) {
+    uint32_t used = 0;
+    *size_p = 0;
+    for (uint32_t i = first; i < count && used < FWI_SOCKET_VECTOR_WINDOW; i++) {
+        const size_t skip = i == first ? offset : 0;
+        window_p[used].iov_base = (uint8_t*)buffers_p[i].data_p + skip;
+        window_p[used].iov_len  = buffers_p[i].size - skip;
+        *size_p += window_p[used].iov_len;
+        used++;
+    }
+    return used;
+}
+
+fwError fwSocketSendV(const fwSocket sfdop, const fwSocketBuffer* buffers_p, const uint32_t count,
+                      size_t* sent_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketSendV);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (sent_p != nullptr) {
+        *sent_p = 0;
+    }
+    if (nativeSocket == nullptr || (buffers_p == nullptr && count != 0)) {
+        return fwErrorInvalidParameter;
+    }
+
+    size_t sent = 0;
+    fwError ret = fwErrorSuccess;
+    if (nativeSocket->uring) {
+        // Gathered into one queued copy, the loop sends it with its next wait
+        size_t size = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            size += buffers_p[i].size;
+        }
+        const uint64_t begin = fwiProfileTicks();
+        ret = fwiEventLoopSend(nativeSocket, buffers_p, count);
+        if (ret != fwErrorSuccess) {
+            errno = ENOBUFS;
+        }
+        sent = ret == fwErrorSuccess ? size : 0;
+        fwiSocketCount(nativeSocket, fwiSocketDirectionSend, size,
+                       ret == fwErrorSuccess ? (ssize_t)size : -1, fwiProfileTicks() - begin);
+    }
+    else {
+        uint32_t first = 0;
+        size_t offset = 0;
+        fwiSocketVectorAdvance(buffers_p, count, &first, &offset, 0);
+
+        while (first < count) {
+            struct iovec window[FWI_SOCKET_VECTOR_WINDOW];
+            size_t size;
+            const uint32_t used = fwiSocketVectorWindow(buffers_p, count, first, offset, window,
+                                                        &size);
+            const struct msghdr message = {.msg_iov = window, .msg_iovlen = used};
+
+            // A peer that went away has to show up as an error, not as SIGPIPE killing the process
+            const uint64_t begin = fwiProfileTicks();
+            const ssize_t written = sendmsg(nativeSocket->fileDescriptor, &message, MSG_NOSIGNAL);
+            if (written == -1 && errno == EINTR) {
+                fwiSocketCountInterrupt(nativeSocket);
+                continue;
+            }
+            fwiSocketCount(nativeSocket, fwiSocketDirectionSend, size, written,
+                           fwiProfileTicks() - begin);
+
+            if (written == -1) {
+                if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                    ret = fwErrorSocketWouldBlock;
+                }
+                else {
+                    FWI_LOG_ERRNO;
+                    ret = fwErrorSocketSend;
+                }
+                break;
+            }
+            sent += written;
+            fwiSocketVectorAdvance(buffers_p, count, &first, &offset, written);
+        }
+    }
+
+    if (sent_p != nullptr) {
+        *sent_p = sent;
+    }
+    fwiTraceEnd(fwiTraceTypeSocketSendV, traceBegin, sfdop, sent);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelDebug,
+              "Socket (ID: %lX) sent %lu bytes from %u buffers", (unsigned long)sfdop,
+              (unsigned long)sent, count);
+    return ret;
+}
+
+fwError fwSocketReceiveV(const fwSocket sfdop, const fwSocketBuffer* buffers_p,
+                         const uint32_t count, size_t* received_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneSocketReceiveV);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (received_p != nullptr) {
+        *received_p = 0;
+    }
+    if (nativeSocket == nullptr || (buffers_p == nullptr && count != 0)) {
+        return fwErrorInvalidParameter;
+    }
+
+    size_t received = 0;
+    fwError ret = fwErrorSuccess;
+    uint32_t first = 0;
+    size_t offset = 0;
+    fwiSocketVectorAdvance(buffers_p, count, &first, &offset, 0);
+
+    while (first < count) {
+        const uint64_t begin = fwiProfileTicks();
+        size_t size;
+        ssize_t readden;
+        if (nativeSocket->uring) {
+            // Copied out of the chunks the loop has received, one buffer at a time
+            size = buffers_p[first].size - offset;
+            size_t taken;
+            const fwError result = fwiEventLoopReceive(nativeSocket,
+                                                       (uint8_t*)buffers_p[first].data_p + offset,
+                                                       size, &taken);
+            readden = result == fwErrorSuccess ? (ssize_t)taken : -1;
+            errno   = result == fwErrorSocketWouldBlock ? EAGAIN : EIO;
+        }
+        else {
+            struct iovec window[FWI_SOCKET_VECTOR_WINDOW];
+            const uint32_t used = fwiSocketVectorWindow(buffers_p, count, first, offset, window,
+                                                        &size);
+            readden = readv(nativeSocket->fileDescriptor, window, (int32_t)used);
+            if (readden == -1 && errno == EINTR) {
+                fwiSocketCountInterrupt(nativeSocket);
+                continue;
+            }
+        }
+        fwiSocketCount(nativeSocket, fwiSocketDirectionReceive, size, readden,
+                       fwiProfileTicks() - begin);
+
+        if (readden == -1) {
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                ret = fwErrorSocketWouldBlock;
+            }
+            else {
+                FWI_LOG_ERRNO;
+                ret = fwErrorSocketReceive;
+            }
+            break;
+        }
+        if (readden == 0) { // the peer closed the connection
+            break;
+        }
+        received += readden;
+        fwiSocketVectorAdvance(buffers_p, count, &first, &offset, readden);
+    }
+
+    if (received_p != nullptr) {
+        *received_p = received;
+    }
+    fwiTraceEnd(fwiTraceTypeSocketReceiveV, traceBegin, sfdop, received);
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelDebug,
+              "Socket (ID: %lX) received %lu bytes into %u buffers", (unsigned long)sfdop,
+              (unsigned long)received, count);
+    return ret;
+}
+
 fwError fwSocketClose(const fwSocket sfdop) {
-    struct fwiNativeSocketState* nativeSocket = {(struct fwiNativeSocketState*)sfdop};
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
 
+    if (nativeSocket->eventLoop != 0) {
+        fwiEventLoopForget(nativeSocket);
+    }
     if (close(nativeSocket->fileDescriptor) == -1) {
         return fwErrorInvalidParameter;
     }
 
-    free(nativeSocket);
+    fwiSocketFree(sfdop);
+    atomic_fetch_sub_explicit(&fwiGetState()->openSockets, 1, memory_order_relaxed);
+    fwiTraceEnd(fwiTraceTypeSocketClose, traceBegin, sfdop, fwErrorSuccess);
+
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Socket (ID: %lX) was closed",
+              (unsigned long)sfdop);
+    return fwErrorSuccess;
+}
+
+fwError fwSocketSetNonBlocking(const fwSocket sfdop, const bool nonBlocking) {
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    const int32_t flags = fcntl(nativeSocket->fileDescriptor, F_GETFL);
+    if (flags == -1 || fcntl(nativeSocket->fileDescriptor, F_SETFL,
+                             nonBlocking ? flags | O_NONBLOCK : flags & ~O_NONBLOCK) == -1) {
+        FWI_LOG_ERRNO;
+        return fwErrorInvalidParameter;
+    }
+
+    nativeSocket->nonBlocking = nonBlocking;
+    return fwErrorSuccess;
+}
+
+fwError fwSocketGetStats(const fwSocket sfdop, fwSocketStats* stats_p) {
+    struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(sfdop);
+    if (nativeSocket == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    memset(stats_p, 0, sizeof(fwSocketStats));
+    fwiSocketStatsOf(&nativeSocket->counters,
+                     atomic_load_explicit(&nativeSocket->latency_p, memory_order_acquire), stats_p);
+
+    int32_t size;
+    socklen_t length = sizeof(size);
+    if (getsockopt(nativeSocket->fileDescriptor, SOL_SOCKET, SO_SNDBUF, &size, &length) == 0) {
+        stats_p->sendBufferSize = size;
+    }
+    length = sizeof(size);
+    if (getsockopt(nativeSocket->fileDescriptor, SOL_SOCKET, SO_RCVBUF, &size, &length) == 0) {
+        stats_p->receiveBufferSize = size;
+    }
+
+    if (nativeSocket->protocol == SOCK_STREAM && nativeSocket->addressFamily != AF_LOCAL) {
+        struct tcp_info info = {};
+        length = sizeof(info);
+        if (getsockopt(nativeSocket->fileDescriptor, IPPROTO_TCP, TCP_INFO, &info, &length) == 0) {
+            stats_p->roundTripTime         = info.tcpi_rtt;
+            stats_p->roundTripTimeVariance = info.tcpi_rttvar;
+            stats_p->retransmits           = info.tcpi_total_retrans;
+            stats_p->lost                  = info.tcpi_lost;
+            stats_p->congestionWindow      = info.tcpi_snd_cwnd;
+        }
+    }
 
-    fwiLogA(fwiLogLevelInfo, "Socket (ID: %X) was closed", sfdop);
     return fwErrorSuccess;
 }
 
 void fwiLogErrno(const char* location, const int32_t line) {
     const int32_t err = errno;
-    fwiLogA(fwiLogLevelError, "System call failure with code %d at line %d in function %s", err,
-            line, location);
+    FWI_LOG_A(fwiLogDomainBase, fwiLogLevelError,
+              "System call failure with code %d at line %d in function %s", err, line, location);
 }
 
 #endif // PLATFORM_LINUX
@@ -14,34 +14,54 @@
 
 // This implementation file contains implementations for platform independant, exposed symbols
 
+#include <stdlib.h>
+#include <string.h>
+
 #include "framework.h"
 #include "internal.h"
 
 fwError fwStartModule(const fwModule module, const uint32_t flags) {
+    FW_PROFILE_SCOPE(fwiProfileZoneStartModule);
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
     if (!fwiGetState()->baseIsUp) {
         fwiStartNativeModuleBase();
     }
 
+    fwError ret = fwErrorSuccess;
     switch (module) {
         case fwModuleWindow: {
-            return fwiStartNativeModuleWindow();
+            ret = fwiStartNativeModuleWindow();
+            break;
         }
         case fwModuleRender: {
-            return fwiStartNativeModuleRenderer();
+            ret = fwiStartNativeModuleRenderer();
+            break;
         }
         case fwModuleNetwork: {
-            return fwiStartNativeModuleNetwork();
+            ret = fwiStartNativeModuleNetwork();
+            break;
         }
         case fwModuleMultimedia: {
-            return fwiStartNativeModuleMultimedia();
+            ret = fwiStartNativeModuleMultimedia();
+            break;
         }
         default: {
             return fwErrorInvalidParameter;
         }
     }
+
+    if (ret == fwErrorSuccess) {
+        fwiGetState()->activeModules |= module;
+    }
+
+    fwiTraceEnd(fwiTraceTypeModuleStart, traceBegin, module, ret);
+    return ret;
 }
 
 fwError fwStopModule(const enum fwModule module) {
+    const uint64_t traceBegin = FWI_TRACE_BEGIN();
+
     bool fail = false;
     fwError ret = 0;
     switch (module) {
@@ -66,6 +86,11 @@ fwError fwStopModule(const enum fwModule module) {
         }
     }
 
+    if (!fail) {
+        fwiGetState()->activeModules &= ~module;
+        fwiTraceEnd(fwiTraceTypeModuleStop, traceBegin, module, ret);
+    }
+
     if (!fwiGetState()->baseIsUp) {
         fwiStopNativeModuleBase();
     }
@@ -78,19 +103,210 @@ fwError fwStopModule(const enum fwModule module) {
 }
 
 void fwStopAllModules(void) {
+    if (atomic_load_explicit(&fwiGetState()->profilingIsUp, memory_order_relaxed)) {
+        fwProfileDump();
+    }
+
     if (fwiGetState()->activeModules & fwModuleWindow) {
-        fwiStopNativeModuleWindow();
+        fwStopModule(fwModuleWindow);
     }
     if (fwiGetState()->activeModules & fwModuleNetwork) {
-        fwiStopNativeModuleNetwork();
+        fwStopModule(fwModuleNetwork);
     }
     if (fwiGetState()->activeModules & fwModuleMultimedia) {
-        fwiStopNativeModuleMultimedia();
+        fwStopModule(fwModuleMultimedia);
     }
     if (fwiGetState()->activeModules & fwModuleRender) {
-        fwiStopNativeModuleRenderer();
+        fwStopModule(fwModuleRender);
+    }
+    if (atomic_load_explicit(&fwiGetState()->tracingIsUp, memory_order_relaxed)) {
+        fwTraceStop();
     }
+    fwFileCacheClear();
     if (fwiGetState()->baseIsUp) {
         fwiStopNativeModuleBase();
     }
 }
+
+fwError fwSetLogLevel(const fwLogLevel level) {
+    if (level > fwLogLevelBench) {
+        return fwErrorInvalidParameter;
+    }
+
+    for (uint8_t domain = 0; domain < fwiLogDomainCount; domain++) {
+        atomic_store_explicit(&fwiGetState()->logThresholds[domain], level, memory_order_relaxed);
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwSetModuleLogLevel(const fwModule module, const fwLogLevel level) {
+    const fwiLogDomain domain = fwiLogDomainOf(module);
+    if (domain == fwiLogDomainCount || level > fwLogLevelBench) {
+        return fwErrorInvalidParameter;
+    }
+
+    atomic_store_explicit(&fwiGetState()->logThresholds[domain], level, memory_order_relaxed);
+    return fwErrorSuccess;
+}
+
+fwError fwSetLogOverflowPolicy(const fwLogOverflowPolicy policy) {
+    switch (policy) {
+        case fwLogOverflowPolicyDrop:
+        case fwLogOverflowPolicyBlock: {
+            atomic_store_explicit(&fwiGetState()->logOverflowPolicy, policy, memory_order_relaxed);
+            return fwErrorSuccess;
+        }
+        default: {
+            return fwErrorInvalidParameter;
+        }
+    }
+}
+
+fwError fwSetLogMode(const fwLogMode mode) {
+    switch (mode) {
+        case fwLogModeText:
+        case fwLogModeBinary: {
+            atomic_store_explicit(&fwiGetState()->logMode, mode, memory_order_relaxed);
+            return fwErrorSuccess;
+        }
+        default: {
+            return fwErrorInvalidParameter;
+        }
+    }
+}
+
+uint64_t fwGetLogDroppedCount(void) {
+    return atomic_load_explicit(&fwiGetState()->logDropped, memory_order_relaxed);
+}
+
+fwError fwSetLogFileInfo(const struct fwLogFileInfo* info_p) {
+    struct fwiState* state = fwiGetState();
+
+    const char* directory = info_p->directory_p != nullptr ? info_p->directory_p : "";
+    if (strlen(directory) >= sizeof(state->logDirectory)) {
+        return fwErrorInvalidParameter;
+    }
+
+    pthread_mutex_lock(&state->loggerMutex);
+    strcpy(state->logDirectory, directory);
+    state->logSegmentSize      = info_p->segmentSize;
+    state->logRotationInterval = info_p->rotationInterval;
+    state->logSyncInterval     = info_p->syncInterval;
+    pthread_mutex_unlock(&state->loggerMutex);
+
+    return fwErrorSuccess;
+}
+
+void fwiSocketStatsOf(const struct fwiSocketCounters* counters_p,
+                      const struct fwiHistogram* latency_p, struct fwSocketStats* stats_p) {
+    stats_p->bytesSent     = atomic_load_explicit(&counters_p->bytes[fwiSocketDirectionSend],
+                                                  memory_order_relaxed);
+    stats_p->bytesReceived = atomic_load_explicit(&counters_p->bytes[fwiSocketDirectionReceive],
+                                                  memory_order_relaxed);
+    stats_p->sendCalls     = atomic_load_explicit(&counters_p->calls[fwiSocketDirectionSend],
+                                                  memory_order_relaxed);
+    stats_p->receiveCalls  = atomic_load_explicit(&counters_p->calls[fwiSocketDirectionReceive],
+                                                  memory_order_relaxed);
+    stats_p->shortSends    = atomic_load_explicit(
+        &counters_p->shortTransfers[fwiSocketDirectionSend], memory_order_relaxed);
+    stats_p->shortReceives = atomic_load_explicit(
+        &counters_p->shortTransfers[fwiSocketDirectionReceive], memory_order_relaxed);
+    stats_p->wouldBlock    = atomic_load_explicit(&counters_p->wouldBlock, memory_order_relaxed);
+    stats_p->interrupted   = atomic_load_explicit(&counters_p->interrupted, memory_order_relaxed);
+    stats_p->errors        = atomic_load_explicit(&counters_p->errors, memory_order_relaxed);
+
+    if (latency_p != nullptr) {
+        fwiProfileStatsOf(&latency_p[fwiSocketDirectionSend], &stats_p->sendLatency);
+        fwiProfileStatsOf(&latency_p[fwiSocketDirectionReceive], &stats_p->receiveLatency);
+    }
+}
+
+static pthread_key_t socketThreadKey_s;
+static pthread_once_t socketThreadKeyOnce_s = PTHREAD_ONCE_INIT;
+static thread_local struct fwiSocketThread* socketThread_s = nullptr;
+
+static void fwiReleaseSocketThread(void* thread_p) {
+    atomic_store_explicit(&((struct fwiSocketThread*)thread_p)->owned, false,
+                          memory_order_release);
+}
+
+static void fwiCreateSocketThreadKey(void) {
+    pthread_key_create(&socketThreadKey_s, fwiReleaseSocketThread);
+}
+
+struct fwiSocketThread* fwiAcquireSocketThread(void) {
+    if (socketThread_s != nullptr) {
+        return socketThread_s;
+    }
+
+    pthread_once(&socketThreadKeyOnce_s, fwiCreateSocketThreadKey);
+
+    struct fwiSocketThread* thread = atomic_load_explicit(&fwiGetState()->socketThreads,
+                                                          memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&thread->owned, &expected, true)) {
+            break;
+        }
+    }
+
+    if (thread == nullptr) {
+        thread = calloc(1, sizeof(struct fwiSocketThread));
+        if (thread == nullptr) {
+            return nullptr;
+        }
+        atomic_store_explicit(&thread->owned, true, memory_order_relaxed);
+
+        struct fwiSocketThread* head = atomic_load_explicit(&fwiGetState()->socketThreads,
+                                                            memory_order_relaxed);
+        do {
+            thread->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&fwiGetState()->socketThreads, &head,
+                                                        thread, memory_order_release,
+                                                        memory_order_relaxed));
+    }
+
+    pthread_setspecific(socketThreadKey_s, thread);
+    socketThread_s = thread;
+    return thread;
+}
+
+static void fwiSocketCounterMerge(_Atomic uint64_t* into_p, const _Atomic uint64_t* from_p) {
+    atomic_store_explicit(into_p, atomic_load_explicit(into_p, memory_order_relaxed) +
+                          atomic_load_explicit(from_p, memory_order_relaxed), memory_order_relaxed);
+}
+
+/**
+ * @brief Adds counters to others that are not written concurrently.
+ */
+static void fwiSocketCountersMerge(struct fwiSocketCounters* into_p,
+                                   const struct fwiSocketCounters* from_p) {
+    for (uint32_t i = 0; i < 2; i++) {
+        fwiSocketCounterMerge(&into_p->bytes[i], &from_p->bytes[i]);
+        fwiSocketCounterMerge(&into_p->calls[i], &from_p->calls[i]);
+        fwiSocketCounterMerge(&into_p->shortTransfers[i], &from_p->shortTransfers[i]);
+    }
+    fwiSocketCounterMerge(&into_p->wouldBlock, &from_p->wouldBlock);
+    fwiSocketCounterMerge(&into_p->interrupted, &from_p->interrupted);
+    fwiSocketCounterMerge(&into_p->errors, &from_p->errors);
+}
+
+fwError fwSocketGetGlobalStats(fwSocketStats* stats_p) {
+    struct fwiSocketCounters counters = {};
+    struct fwiHistogram latency[2] = {};
+
+    struct fwiSocketThread* thread = atomic_load_explicit(&fwiGetState()->socketThreads,
+                                                          memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        fwiSocketCountersMerge(&counters, &thread->counters);
+        fwiHistogramMerge(&latency[fwiSocketDirectionSend],
+                          &thread->latency[fwiSocketDirectionSend]);
+        fwiHistogramMerge(&latency[fwiSocketDirectionReceive],
+                          &thread->latency[fwiSocketDirectionReceive]);
+    }
+
+    memset(stats_p, 0, sizeof(fwSocketStats));
+    fwiSocketStatsOf(&counters, latency, stats_p);
+    stats_p->openSockets = atomic_load_explicit(&fwiGetState()->openSockets, memory_order_relaxed);
+    return fwErrorSuccess;
+}
@@ -32,7 +32,11 @@ typedef enum fwError : uint8_t {
 
     fwErrorFileUnableToOpen /*! Unable to open or correctly open the requested file */,
     fwErrorFileStats /*! Failed to retrieve file information */,
+    fwErrorFileMap /*! The file could not be mapped into memory */,
+    fwErrorFileRead /*! Failed to read from the file */,
+    fwErrorFileWrite /*! Failed to write to or sync the file */,
 
+    fwErrorSocketCreate /*! The system refused to create the socket */,
     fwErrorSocketAddressInUse /*! This local address is already being used by another socket */,
     fwErrorSocketTargetName /*! Failed to resolve host / domain name */,
     fwErrorSocketConnection /*! Failed to connect to the specified target */,
@@ -42,6 +46,7 @@ typedef enum fwError : uint8_t {
     fwErrorSocketListen /*! Failed to put a socket into the listening state */,
     fwErrorSocketAccept /*! Failed to accept a new connection */,
     fwErrorSocketNotBound /*! Could not listen on the socket since it was not bound */,
+    fwErrorSocketWouldBlock /*! The socket is non-blocking or timed out and could not go on */,
 
     fwErrorWindowConnect /*! Could not connect to the wayland server */,
 
@@ -99,10 +104,15 @@ void fwStopAllModules(
  * @param memory Physical memory in @b MebbiByte
  * @param cores Online cores per socket
  * @param sockets Sockets with processors installed
+ * @param hugePageSize Size of the default explicit huge pages in bytes, zero if there are none
+ * @param hugePages Explicit huge pages that are free, these are reserved by the administrator
+ *                  and can back @c fwAllocLarge
  * @note Used as param for @c fwGetSystemConfiguration.
  */
 typedef struct fwSystemConfiguration {
     uint64_t memory;
+    uint64_t hugePageSize;
+    uint32_t hugePages;
     uint16_t cores;
     uint8_t sockets;
 } fwSystemConfiguration;
@@ -114,6 +124,324 @@ fwError fwGetSystemConfiguration(
     struct fwSystemConfiguration* res_p
     );
 
+/**
+ * @brief A source of memory for the buffers the framework hands out, for example the contents of
+ *        loaded files.
+ * @param allocate Returns at least @c size bytes aligned to @c alignment , a power of two, or
+ *                 nullptr when out of memory
+ * @param release Gives back memory returned by @c allocate , with the same size and alignment,
+ *                may be nullptr if memory is never given back one by one
+ * @param context_p Passed to both functions
+ * @note Used as parameter for @c fwSetAllocator . The framework keeps a pointer to the allocator,
+ *       it has to stay valid until every buffer allocated through it is released.
+ */
+typedef struct fwAllocator {
+    void* (*allocate)(void* context_p, uint64_t size, uint64_t alignment);
+    void (*release)(void* context_p, void* memory_p, uint64_t size, uint64_t alignment);
+    void* context_p;
+} fwAllocator;
+
+/**
+ * @brief Sets the allocator used by every module, overriding earlier calls to
+ *        @c fwSetModuleAllocator .
+ * @param allocator_p[in] The allocator, nullptr for the C library's @c malloc
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatIndepImp
+fwError fwSetAllocator(
+    const fwAllocator* allocator_p
+    );
+
+/**
+ * @brief Sets the allocator used by a single module. File loading belongs to no module and uses
+ *        the one set with @c fwSetAllocator .
+ * @note The network module allocates the data queued on io_uring event loops and the bounce
+ *       buffer of @c fwSocketSendFile through it, the other modules do not allocate buffers yet.
+ * @param module[in] The module
+ * @param allocator_p[in] The allocator, nullptr for the C library's @c malloc
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The module was not valid
+ */ // PlatIndepImp
+fwError fwSetModuleAllocator(
+    fwModule module,
+    const fwAllocator* allocator_p
+    );
+
+/**
+ * @brief Sets the allocator used by every call made on the calling thread, ahead of the ones set
+ *        for the process and the modules. Meant for arenas that live as long as one request.
+ * @param allocator_p[in] The allocator, nullptr to go back to the process-wide ones
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatIndepImp
+fwError fwSetThreadAllocator(
+    const fwAllocator* allocator_p
+    );
+
+/**
+ * @brief Releases a buffer handed out by the framework through the allocator it came from.
+ * @param memory_p[in] The buffer, nullptr is ignored
+ * @return @c fwErrorSuccess No error occured
+ * @note Buffers of the framework carry a small header in front of them, they must not be passed
+ *       to @c free() .
+ */ // PlatIndepImp
+fwError fwFree(
+    void* memory_p
+    );
+
+/**
+ * @brief Identifier for an arena, a bump allocator that is reset as a whole.
+ */
+typedef uintptr_t fwArena;
+
+/**
+ * @brief Creates an arena. Allocating moves a pointer forward, releasing does nothing unless it is
+ *        the latest allocation, and resetting takes back everything at once.
+ * @param blockSize[in] Size of the blocks the arena takes from @c malloc , 1 MiB if zero. Larger
+ *                      allocations get a block of their own.
+ * @param arena_p[out] The arena
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note An arena is not thread-safe, give each thread its own. Destroy it with
+ *       @c fwArenaDestroy .
+ */ // PlatIndepImp
+fwError fwArenaCreate(
+    uint64_t blockSize,
+    fwArena* arena_p
+    );
+
+/**
+ * @brief Gets the allocator that allocates from an arena, valid until the arena is destroyed.
+ */ // PlatIndepImp
+fwError fwArenaGetAllocator(
+    fwArena arena,
+    const fwAllocator** allocator_pp
+    );
+
+/**
+ * @brief Takes back everything allocated from an arena, its blocks are kept for reuse.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The arena passed was not valid
+ * @note Takes constant time no matter how much was allocated. Buffers from the arena must not be
+ *       used afterwards, there is no need to release them.
+ */ // PlatIndepImp
+fwError fwArenaReset(
+    fwArena arena
+    );
+
+/**
+ * @brief Destroys an arena and gives its blocks back to @c malloc .
+ */ // PlatIndepImp
+fwError fwArenaDestroy(
+    fwArena arena
+    );
+
+/**
+ * @brief Identifier for a pool, an allocator with one free list per size class.
+ */
+typedef uintptr_t fwPool;
+
+/**
+ * @brief Creates a pool. Sizes are rounded up to the next power of two from 16 bytes up to
+ *        @c maxSize , each class is refilled in chunks and released memory goes back to its class.
+ * @param maxSize[in] Largest size served from a class, 4 KiB if zero. Larger allocations go to
+ *                    @c malloc .
+ * @param pool_p[out] The pool
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The largest size is above 1 MiB
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note A pool can be shared between threads. Destroy it with @c fwPoolDestroy .
+ */ // PlatIndepImp
+fwError fwPoolCreate(
+    uint32_t maxSize,
+    fwPool* pool_p
+    );
+
+/**
+ * @brief Gets the allocator that allocates from a pool, valid until the pool is destroyed.
+ */ // PlatIndepImp
+fwError fwPoolGetAllocator(
+    fwPool pool,
+    const fwAllocator** allocator_pp
+    );
+
+/**
+ * @brief Destroys a pool together with everything allocated from it.
+ */ // PlatIndepImp
+fwError fwPoolDestroy(
+    fwPool pool
+    );
+
+/**
+ * @brief Kinds of pages a large buffer can be backed by, from the fewest TLB misses to the most.
+ * @note Used as parameter for @c fwLargeBuffer .
+ */
+typedef enum fwLargePages : uint8_t {
+    fwLargePagesNormal /*! Ordinary pages of the processor */,
+    fwLargePagesTransparent /*! Ordinary pages the kernel was asked to merge into transparent huge
+                                pages, it does so as long as it finds free contiguous memory */,
+    fwLargePagesHuge /*! Explicit huge pages from the pool reserved by the administrator */
+} fwLargePages;
+
+/**
+ * @brief Options for allocating a large buffer, can be combined.
+ * @note Used as parameter for @c fwLargeBufferInfo .
+ */
+typedef enum fwLargeFlags : uint32_t {
+    fwLargeFlagNone          = 0,
+    fwLargeFlagNoHuge        = 0b0000'0001 /*! Skip explicit huge pages */,
+    fwLargeFlagNoTransparent = 0b0000'0010 /*! Skip transparent huge pages */,
+    fwLargeFlagPopulate      = 0b0000'0100 /*! Fault every page in before returning, so the first
+                                               pass over the buffer does not */,
+    fwLargeFlagStrictNode    = 0b0000'1000 /*! Fail pages that do not fit on the NUMA node instead
+                                               of taking them from another one, explicit huge pages
+                                               are skipped since they are not reserved per node */
+} fwLargeFlags;
+
+/**
+ * @brief Describes how to allocate a large buffer.
+ * @param flags Combination of @c fwLargeFlags
+ * @param node NUMA node to place the memory on, -1 for the node of the thread that touches it
+ *             first
+ * @note Used as parameter for @c fwAllocLarge .
+ */
+typedef struct fwLargeBufferInfo {
+    uint32_t flags;
+    int32_t node;
+} fwLargeBufferInfo;
+
+/**
+ * @brief A buffer allocated with @c fwAllocLarge .
+ * @param data_p Start of the buffer, aligned to the size of a huge page when it is one page or
+ *               longer
+ * @param size Size of the mapping, the requested size rounded up to whole pages
+ * @param pages The kind of pages that back the buffer
+ */
+typedef struct fwLargeBuffer {
+    void* data_p;
+    uint64_t size;
+    fwLargePages pages;
+} fwLargeBuffer;
+
+/**
+ * @brief Maps a large buffer straight from the kernel. Explicit huge pages are tried first, then
+ *        transparent huge pages, then normal pages, and the buffer reports which one it got.
+ * @param size[in] Size in bytes. Below the size of a huge page only normal pages are used.
+ * @param info_p[in] Options, nullptr for the defaults
+ * @param buffer_p[out] The buffer
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The size was zero or the node does not exist
+ * @return @c fwErrorOutOfMemory Mapping failed
+ * @note The buffer is zeroed. Release it with @c fwFreeLarge .
+ */ // PlatDepImp
+fwError fwAllocLarge(
+    uint64_t size,
+    const fwLargeBufferInfo* info_p,
+    fwLargeBuffer* buffer_p
+    );
+
+/**
+ * @brief Unmaps a buffer allocated with @c fwAllocLarge .
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The buffer was not valid
+ */ // PlatDepImp
+fwError fwFreeLarge(
+    const fwLargeBuffer* buffer_p
+    );
+
+/**
+ * @brief Gets an allocator that backs buffers of a huge page or more with @c fwAllocLarge and
+ *        smaller ones with @c malloc .
+ * @note Meant for loading large files, set it with @c fwSetThreadAllocator or
+ *       @c fwSetAllocator , the contents of the files are then released with @c fwFree as usual.
+ *       The allocator uses the defaults of @c fwLargeBufferInfo and is valid for the lifetime of
+ *       the process.
+ */ // PlatDepImp
+fwError fwGetLargeAllocator(
+    const fwAllocator** allocator_pp
+    );
+
+/**
+ * @brief Checksum algorithms.
+ * @note Used as parameter for @c fwChecksumBegin .
+ */
+typedef enum fwChecksumType : uint8_t {
+    fwChecksumTypeNone /*! No checksum, always zero */,
+    fwChecksumTypeCrc32c /*! CRC-32C (Castagnoli), as used by iSCSI, ext4 and SCTP, computed with
+                             the CRC instructions of the processor where it has them */,
+    fwChecksumTypeXxHash64 /*! XXH64 with a seed of zero, a fast hash that is not cryptographically
+                               secure */
+} fwChecksumType;
+
+/**
+ * @brief A checksum that is computed piece by piece.
+ * @param state Intermediate value of the algorithm
+ * @param length Bytes fed in so far
+ * @param pending Bytes that do not yet fill a full block of the algorithm
+ * @param pendingSize Number of valid bytes in @c pending
+ * @param type Algorithm, one of @c fwChecksumType
+ * @note Used as parameter for @c fwChecksumBegin , @c fwChecksumUpdate and @c fwChecksumEnd . The
+ *       fields are internal to the implementation.
+ */
+typedef struct fwChecksum {
+    uint64_t state[4];
+    uint64_t length;
+    uint8_t pending[32];
+    uint32_t pendingSize;
+    fwChecksumType type;
+} fwChecksum;
+
+/**
+ * @brief Starts computing a checksum.
+ * @param checksum_p[out] The checksum
+ * @param type[in] Algorithm to use
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The algorithm is not known
+ * @note The implementation is chosen once per process from the features of the processor.
+ */ // PlatIndepImp
+fwError fwChecksumBegin(
+    fwChecksum* checksum_p,
+    fwChecksumType type
+    );
+
+/**
+ * @brief Feeds data into a checksum, the result is the same no matter how the data is split.
+ * @param checksum_p[in,out] The checksum
+ * @param data_p[in] The data
+ * @param size[in] Size of the data in bytes
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatIndepImp
+fwError fwChecksumUpdate(
+    fwChecksum* checksum_p,
+    const void* data_p,
+    uint64_t size
+    );
+
+/**
+ * @brief Finishes a checksum, it can be updated further and finished again afterwards.
+ * @param checksum_p[in] The checksum
+ * @param value_p[out] The checksum of everything fed in, CRC-32C only uses the lower 32 bits
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatIndepImp
+fwError fwChecksumEnd(
+    const fwChecksum* checksum_p,
+    uint64_t* value_p
+    );
+
+/**
+ * @brief Computes the checksum of a buffer in one go.
+ * @param type[in] Algorithm to use
+ * @param data_p[in] The data, for example a received message
+ * @param size[in] Size of the data in bytes
+ * @param value_p[out] The checksum, see @c fwChecksumEnd
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The algorithm is not known
+ */ // PlatIndepImp
+fwError fwChecksumCompute(
+    fwChecksumType type,
+    const void* data_p,
+    uint64_t size,
+    uint64_t* value_p
+    );
+
 /**
  * @brief Loads an entire file into an allocated memory buffer.
  * @param filename_p[in] Name of, or path to, the file
@@ -125,15 +453,989 @@ fwError fwGetSystemConfiguration(
  *         or the file not existing
  * @return @c fwErrorOutOfMemory The file does not fit into free memory
  * @return @c fwErrorFileStats An I/O error occurs at syscall
- * @note This function will allocate using malloc, when the buffer becomes unused it should be
- *       released with @c free().
+ * @return @c fwErrorFileRead Reading the file failed or it ended early
+ * @note The buffer comes from the allocator set with @c fwSetAllocator or
+ *       @c fwSetThreadAllocator , when it becomes unused it should be released with @c fwFree .
+ */ // PlatDepImp
+fwError fwLoadFileToMem(
+    const char* filename_p,
+    void** buffer_pp,
+    uint64_t* fileSize_p
+    );
+
+/**
+ * @brief Loads an entire file like @c fwLoadFileToMem and computes its checksum on the way. The
+ *        file is read in pieces that fit into the processor's cache and each piece is summed right
+ *        after it arrives, instead of reading the whole buffer a second time afterwards.
+ * @param filename_p[in] Name of, or path to, the file
+ * @param type[in] Checksum algorithm
+ * @param buffer_pp[out] See @c fwLoadFileToMem
+ * @param fileSize_p[out] Size of the file and the buffer in bytes
+ * @param checksum_p[out] Checksum of the contents, see @c fwChecksumEnd
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The algorithm is not known
+ * @return @c fwErrorFileUnableToOpen The file could not be opened, due to either permissions
+ *         or the file not existing
+ * @return @c fwErrorOutOfMemory The file does not fit into free memory
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorFileRead Reading the file failed or it ended early
+ * @note Release the buffer with @c fwFree .
+ */ // PlatDepImp
+fwError fwLoadFileToMemChecksum(
+    const char* filename_p,
+    fwChecksumType type,
+    void** buffer_pp,
+    uint64_t* fileSize_p,
+    uint64_t* checksum_p
+    );
+
+/**
+ * @brief Options for loading several files at once, can be combined.
+ * @note Used as parameter for @c fwLoadFiles .
+ */
+typedef enum fwLoadFilesFlags : uint32_t {
+    fwLoadFilesFlagNone       = 0,
+    fwLoadFilesFlagPacked     = 0b0000'0001 /*! Put all files into one allocation instead of one
+                                                allocation per file */,
+    fwLoadFilesFlagThreadPool = 0b0000'0010 /*! Use worker threads even if the kernel's
+                                                asynchronous I/O is available */
+} fwLoadFilesFlags;
+
+/**
+ * @brief A file loaded by @c fwLoadFiles .
+ * @param buffer_p The contents, nullptr if the file is empty or could not be loaded
+ * @param size Size of the file in bytes
+ * @param error Outcome for this file, see @c fwLoadFileToMem for the possible values
+ * @note Used as parameter for @c fwLoadFiles .
+ */
+typedef struct fwLoadedFile {
+    void* buffer_p;
+    uint64_t size;
+    fwError error;
+} fwLoadedFile;
+
+/**
+ * @brief Loads many files into memory at once. Opening, sizing and reading are all issued
+ *        concurrently, through io_uring on Linux or through worker threads sized from the number of
+ *        cores.
+ * @param filenames_p[in] Names of, or paths to, the files
+ * @param count[in] Number of files
+ * @param flags[in] Combination of @c fwLoadFilesFlags
+ * @param files_p[out] One entry per file, in the order of @c filenames_p
+ * @param packed_pp[out] With @c fwLoadFilesFlagPacked , the allocation holding every file, may be
+ *                       nullptr otherwise
+ * @return @c fwErrorSuccess Every file was loaded
+ * @return @c fwErrorOutOfMemory The packed allocation failed, no file was loaded
+ * @return The error of the first file that failed, the others are loaded regardless
+ * @note Without @c fwLoadFilesFlagPacked , every buffer is released on its own with @c fwFree .
+ *       With it, only the allocation returned through @c packed_pp is released with @c fwFree .
+ */ // PlatDepImp
+fwError fwLoadFiles(
+    const char* const* filenames_p,
+    uint32_t count,
+    uint32_t flags,
+    fwLoadedFile* files_p,
+    void** packed_pp
+    );
+
+/**
+ * @brief Hints on how a mapped file will be used, can be combined.
+ * @note Used as parameter for @c fwMapFile .
+ */
+typedef enum fwMapFileFlags : uint32_t {
+    fwMapFileFlagNone       = 0,
+    fwMapFileFlagSequential = 0b0000'0001 /*! Read front to back, pages are read ahead aggressively
+                                              and dropped soon after */,
+    fwMapFileFlagRandom     = 0b0000'0010 /*! Read in no particular order, read-ahead is
+                                              disabled */,
+    fwMapFileFlagWillNeed   = 0b0000'0100 /*! Start reading the whole file in the background */,
+    fwMapFileFlagPopulate   = 0b0000'1000 /*! Read the whole file before returning, no page faults
+                                              afterwards */,
+    fwMapFileFlagHugePages  = 0b0001'0000 /*! Align the mapping for huge pages and ask for them,
+                                              ignored where the file system does not support it */
+} fwMapFileFlags;
+
+/**
+ * @brief A read-only view of a file's contents.
+ * @param data_p First byte of the file, nullptr for empty files
+ * @param size Size of the file in bytes
+ * @note Used as parameter for @c fwMapFile and @c fwUnmapFile .
+ */
+typedef struct fwFileMapping {
+    const void* data_p;
+    uint64_t size;
+} fwFileMapping;
+
+/**
+ * @brief Maps an entire file into memory for reading, without copying it.
+ * @param filename_p[in] Name of, or path to, the file
+ * @param flags[in] Combination of @c fwMapFileFlags
+ * @param mapping_p[out] The mapping
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter Both sequential and random access were requested
+ * @return @c fwErrorFileUnableToOpen The file could not be opened, due to either permissions
+ *         or the file not existing
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorFileMap The file can not be mapped, for example because it is a pipe
+ * @note Pages are only read when first touched, unless @c fwMapFileFlagPopulate is given, and are
+ *       shared with the page cache instead of counting twice against memory. Changes made to the
+ *       file by others while it is mapped are visible through the mapping, truncating it makes
+ *       accesses past the new end fault. Release the mapping with @c fwUnmapFile .
+ */ // PlatDepImp
+fwError fwMapFile(
+    const char* filename_p,
+    uint32_t flags,
+    fwFileMapping* mapping_p
+    );
+
+/**
+ * @brief Releases a mapping created by @c fwMapFile .
+ * @param mapping_p[in,out] The mapping, reset to an empty one
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The mapping was not created by @c fwMapFile
+ */ // PlatDepImp
+fwError fwUnmapFile(
+    fwFileMapping* mapping_p
+    );
+
+/**
+ * @brief Identifier for an open file, zero is never a valid file.
+ */
+typedef uintptr_t fwFile;
+
+/**
+ * @brief Flags for opening a file.
+ * @note Used as parameter for @c fwFileOpen .
+ */
+typedef enum fwFileOpenFlags : uint32_t {
+    fwFileOpenFlagNone   = 0,
+    fwFileOpenFlagDirect = 0b0000'0001 /*! Read around the page cache, for single passes over
+                                           files larger than the working set */
+} fwFileOpenFlags;
+
+/**
+ * @brief Opens a file for reading.
+ * @param filename_p[in] Name of, or path to, the file
+ * @param flags[in] Combination of @c fwFileOpenFlags
+ * @param file_p[out] The file
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileUnableToOpen The file could not be opened, due to either permissions
+ *         or the file not existing
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note Close the file with @c fwFileClose .
+ */ // PlatDepImp
+fwError fwFileOpen(
+    const char* filename_p,
+    uint32_t flags,
+    fwFile* file_p
+    );
+
+/**
+ * @brief Gets the alignment that buffers, offsets and sizes of reads from a file must have.
+ * @param file[in] The file
+ * @param alignment_p[out] The alignment in bytes, 1 unless the file was opened with
+ *                         @c fwFileOpenFlagDirect
+ * @return @c fwErrorSuccess No error occured
+ * @note A file opened with @c fwFileOpenFlagDirect on a file system that does not support direct
+ *       access is read through the page cache instead, which this tells apart by an alignment of 1.
+ *       A read at the end of the file may ask for more than is left, as long as it is aligned.
+ */ // PlatDepImp
+fwError fwFileGetAlignment(
+    fwFile file,
+    uint32_t* alignment_p
+    );
+
+/**
+ * @brief Retrieves the size a file had when it was opened.
+ */ // PlatDepImp
+fwError fwFileGetSize(
+    fwFile file,
+    uint64_t* size_p
+    );
+
+/**
+ * @brief Closes a file.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The file passed was not valid
+ * @note Reads on the file that are still in flight must complete first.
+ */ // PlatDepImp
+fwError fwFileClose(
+    fwFile file
+    );
+
+/**
+ * @brief Identifier for a queue of asynchronous file reads.
+ */
+typedef uintptr_t fwFileQueue;
+
+/**
+ * @brief Behaviour of a file queue.
+ * @note Used as parameter for @c fwFileQueueCreate .
+ */
+typedef enum fwFileQueueFlags : uint32_t {
+    fwFileQueueFlagNone       = 0,
+    fwFileQueueFlagThreadPool = 0b0000'0001 /*! Perform reads on worker threads even if the
+                                                kernel's asynchronous I/O is available */
+} fwFileQueueFlags;
+
+/**
+ * @brief A read of a range of a file into a buffer of the caller.
+ * @param file The file to read from
+ * @param buffer_p Destination, must stay valid until the read completes
+ * @param offset Offset into the file in bytes
+ * @param size Number of bytes to read
+ * @param userData Returned with the completion of this read
+ * @note Used as parameter for @c fwFileQueueSubmit .
+ */
+typedef struct fwFileRead {
+    fwFile file;
+    void* buffer_p;
+    uint64_t offset;
+    uint32_t size;
+    uint64_t userData;
+} fwFileRead;
+
+/**
+ * @brief Outcome of a read.
+ * @param userData As given in the @c fwFileRead
+ * @param bytes Bytes read, fewer than requested only at the end of the file
+ * @param error @c fwErrorSuccess or @c fwErrorFileRead
+ * @note Used as parameter for @c fwFileQueueComplete .
+ */
+typedef struct fwFileCompletion {
+    uint64_t userData;
+    uint64_t bytes;
+    fwError error;
+} fwFileCompletion;
+
+/**
+ * @brief A memory area that reads can go to, see @c fwFileQueueRegisterBuffers .
+ */
+typedef struct fwFileBuffer {
+    void* data_p;
+    uint64_t size;
+} fwFileBuffer;
+
+/**
+ * @brief Creates a queue for asynchronous file reads. On Linux reads go through io_uring, or
+ *        through a pool of worker threads where it is unavailable.
+ * @param depth[in] Maximum number of reads in flight
+ * @param flags[in] Combination of @c fwFileQueueFlags
+ * @param queue_p[out] The queue
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The depth was zero
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note A queue must only be used by one thread at a time.
+ */ // PlatDepImp
+fwError fwFileQueueCreate(
+    uint32_t depth,
+    uint32_t flags,
+    fwFileQueue* queue_p
+    );
+
+/**
+ * @brief Waits for every read in flight and destroys the queue.
+ */ // PlatDepImp
+fwError fwFileQueueDestroy(
+    fwFileQueue queue
+    );
+
+/**
+ * @brief Registers files with the queue so that reads from them skip the per-read file lookup.
+ * @param files_p[in] The files, replaces any previous registration, nullptr to unregister
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter Reads are in flight, or a file was not valid
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note Reads from registered files use the registration automatically.
+ */ // PlatDepImp
+fwError fwFileQueueRegisterFiles(
+    fwFileQueue queue,
+    const fwFile* files_p,
+    uint32_t count
+    );
+
+/**
+ * @brief Registers buffers with the queue so that the kernel does not have to pin the pages of
+ *        every read.
+ * @param buffers_p[in] The buffers, replaces any previous registration, nullptr to unregister
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter Reads are in flight, or the buffers can not be registered
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note Reads whose destination lies within a registered buffer use the registration
+ *       automatically.
+ */ // PlatDepImp
+fwError fwFileQueueRegisterBuffers(
+    fwFileQueue queue,
+    const fwFileBuffer* buffers_p,
+    uint32_t count
+    );
+
+/**
+ * @brief Starts a batch of reads with a single system call.
+ * @param reads_p[in] The reads
+ * @param count[in] Number of reads
+ * @param submitted_p[out] Number of reads that were started, fewer than @c count if the queue
+ *                         reached its depth, may be nullptr
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileRead The reads could not be handed to the kernel
+ */ // PlatDepImp
+fwError fwFileQueueSubmit(
+    fwFileQueue queue,
+    const fwFileRead* reads_p,
+    uint32_t count,
+    uint32_t* submitted_p
+    );
+
+/**
+ * @brief Collects completed reads.
+ * @param completions_p[out] Receives the completions
+ * @param capacity[in] Maximum number of completions to collect
+ * @param minimum[in] Number of completions to wait for, zero to only poll, never waits for more
+ *                    than are in flight
+ * @param count_p[out] Number of completions collected
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileRead Waiting for completions failed
+ */ // PlatDepImp
+fwError fwFileQueueComplete(
+    fwFileQueue queue,
+    fwFileCompletion* completions_p,
+    uint32_t capacity,
+    uint32_t minimum,
+    uint32_t* count_p
+    );
+
+/**
+ * @brief Identifier for a file that is read front to back in chunks.
+ */
+typedef uintptr_t fwFileStream;
+
+/**
+ * @brief Flags for a file stream.
+ * @note Used as parameter for @c fwFileStreamOpen .
+ */
+typedef enum fwFileStreamFlags : uint32_t {
+    fwFileStreamFlagNone   = 0,
+    fwFileStreamFlagDirect = 0b0000'0001 /*! Read around the page cache, so that a scan does not
+                                             evict the working set, see @c fwFileOpenFlagDirect */
+} fwFileStreamFlags;
+
+/**
+ * @brief Configuration of a file stream, zeroed fields take the default.
+ * @param chunkSize Size of the chunks handed out in bytes, 1 MiB by default. Rounded up to the
+ *                  alignment of the file with @c fwFileStreamFlagDirect
+ * @param buffers Number of chunks held at once, one is with the caller while the others are read
+ *                ahead, 2 by default and 4 with @c fwFileStreamFlagDirect , since the kernel does
+ *                not read ahead for direct access
+ * @param flags Combination of @c fwFileStreamFlags
+ * @param checksum Checksum computed over every chunk as it is handed out, none by default, see
+ *                 @c fwFileStreamGetChecksum
+ * @note Used as parameter for @c fwFileStreamOpen .
+ */
+typedef struct fwFileStreamInfo {
+    uint32_t chunkSize;
+    uint32_t buffers;
+    uint32_t flags;
+    fwChecksumType checksum;
+} fwFileStreamInfo;
+
+/**
+ * @brief Opens a file for reading in fixed-size chunks with constant memory use, no matter how
+ *        large the file is.
+ * @param filename_p[in] Name of, or path to, the file
+ * @param info_p[in] Configuration, may be nullptr for the defaults
+ * @param stream_p[out] The stream
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileUnableToOpen The file could not be opened, due to either permissions
+ *         or the file not existing
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorOutOfMemory The buffers could not be allocated
+ * @note Reading starts right away, while the caller works on one chunk the next ones are already
+ *       being read. Close the stream with @c fwFileStreamClose .
+ */ // PlatIndepImp
+fwError fwFileStreamOpen(
+    const char* filename_p,
+    const fwFileStreamInfo* info_p,
+    fwFileStream* stream_p
+    );
+
+/**
+ * @brief Hands out the next chunk of the file, waiting for it if it has not been read yet.
+ * @param chunk_pp[out] The chunk, valid until the next call or until the stream is closed
+ * @param size_p[out] Size of the chunk, equal to the chunk size except for the last chunk, zero
+ *                    once the end of the file is reached
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileRead Reading the chunk failed
+ */ // PlatIndepImp
+fwError fwFileStreamNext(
+    fwFileStream stream,
+    const void** chunk_pp,
+    uint64_t* size_p
+    );
+
+/**
+ * @brief Gets the checksum of every chunk handed out so far, the whole file once
+ *        @c fwFileStreamNext has reported the end.
+ * @param stream[in] The stream
+ * @param value_p[out] The checksum, see @c fwChecksumEnd
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The stream passed was not valid
+ * @note Each chunk is summed right before it is handed out, which also brings it into the cache
+ *       for the caller.
+ */ // PlatIndepImp
+fwError fwFileStreamGetChecksum(
+    fwFileStream stream,
+    uint64_t* value_p
+    );
+
+/**
+ * @brief Closes a file stream, waiting for reads still in flight.
+ */ // PlatIndepImp
+fwError fwFileStreamClose(
+    fwFileStream stream
+    );
+
+/**
+ * @brief Identifier for a file that is appended to in the background.
+ */
+typedef uintptr_t fwFileWriter;
+
+/**
+ * @brief Flags for a file writer.
+ * @note Used as parameter for @c fwFileWriterOpen .
+ */
+typedef enum fwFileWriterFlags : uint32_t {
+    fwFileWriterFlagNone     = 0,
+    fwFileWriterFlagTruncate = 0b0000'0001 /*! Empty the file first instead of appending to it */
+} fwFileWriterFlags;
+
+/**
+ * @brief Configuration of a file writer, zeroed fields take the default.
+ * @param flags Combination of @c fwFileWriterFlags
+ * @param batchSize Most bytes written by a single system call, 1 MiB by default
+ * @note Used as parameter for @c fwFileWriterOpen .
+ */
+typedef struct fwFileWriterInfo {
+    uint32_t flags;
+    uint32_t batchSize;
+} fwFileWriterInfo;
+
+/**
+ * @brief Opens a file for appending through a background thread, which merges appends into large
+ *        writes and the sync requests of all callers into one @c fdatasync .
+ * @param filename_p[in] Name of, or path to, the file, it is created if it does not exist
+ * @param info_p[in] Configuration, may be nullptr for the defaults
+ * @param writer_p[out] The writer
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileUnableToOpen The file could not be opened or created
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorOutOfMemory Allocation failed or the thread could not be started
+ * @note Close the writer with @c fwFileWriterClose .
+ */ // PlatDepImp
+fwError fwFileWriterOpen(
+    const char* filename_p,
+    const fwFileWriterInfo* info_p,
+    fwFileWriter* writer_p
+    );
+
+/**
+ * @brief Queues data to be appended to the file, without waiting for it to be written.
+ * @param writer[in] The writer
+ * @param data_p[in] Data to append, it is copied so the buffer can be reused right away
+ * @param size[in] Number of bytes to append
+ * @param sequence_p[out] Position in the file right after the data, pass it to
+ *                        @c fwFileWriterWait , may be nullptr
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorOutOfMemory The copy could not be allocated
+ * @return @c fwErrorFileWrite An earlier write or sync failed, the writer takes no more data
+ * @note Safe to call from any number of threads at once. Data of one call is never interleaved
+ *       with that of another, calls that do not overlap in time land in the file in call order.
+ */ // PlatDepImp
+fwError fwFileWriterAppend(
+    fwFileWriter writer,
+    const void* data_p,
+    uint64_t size,
+    uint64_t* sequence_p
+    );
+
+/**
+ * @brief Waits until the file holds everything up to a sequence number.
+ * @param writer[in] The writer
+ * @param sequence[in] Sequence number returned by @c fwFileWriterAppend
+ * @param durable[in] Also wait until the data was synced to the storage device. Callers that ask
+ *                    for this at about the same time share a single sync
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileWrite Writing or syncing failed
+ */ // PlatDepImp
+fwError fwFileWriterWait(
+    fwFileWriter writer,
+    uint64_t sequence,
+    bool durable
+    );
+
+/**
+ * @brief Writes out and syncs everything queued, then closes the writer.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The writer passed was not valid
+ * @return @c fwErrorFileWrite Writing or syncing failed at some point, data may be missing
+ */ // PlatDepImp
+fwError fwFileWriterClose(
+    fwFileWriter writer
+    );
+
+/**
+ * @brief Statistics of the file cache.
+ * @param hits Lookups answered from the cache
+ * @param misses Lookups that had to load the file
+ * @param evictions Files dropped to stay within the memory budget
+ * @param invalidations Files dropped because they changed on disk
+ * @param files Number of files currently cached
+ * @param bytes Size of all files currently cached
+ * @note Used as parameter for @c fwFileCacheGetStats .
+ */
+typedef struct fwFileCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    uint64_t invalidations;
+    uint64_t files;
+    uint64_t bytes;
+} fwFileCacheStats;
+
+/**
+ * @brief Gets the contents of a file from the process-wide file cache, loading it on a miss.
+ * @param filename_p[in] Name of, or path to, the file, the cache is keyed by this exact string
+ * @param data_pp[out] The contents, read-only and shared with every other caller
+ * @param size_p[out] Size of the file in bytes
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileUnableToOpen The file could not be opened, due to either permissions
+ *         or the file not existing
+ * @return @c fwErrorFileStats An I/O error occurs at syscall
+ * @return @c fwErrorFileRead Reading the file failed
+ * @return @c fwErrorOutOfMemory Allocation failed
+ * @note Every successful call must be paired with @c fwFileCacheRelease . Files are dropped from
+ *       the cache as soon as they change on disk, callers that still hold the old contents keep
+ *       them until they release them. Hits only take a shared lock on one of several shards.
+ */ // PlatDepImp
+fwError fwFileCacheGet(
+    const char* filename_p,
+    const void** data_pp,
+    uint64_t* size_p
+    );
+
+/**
+ * @brief Gives back contents handed out by @c fwFileCacheGet .
+ * @param data_p[in] The contents
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter nullptr was passed
+ */ // PlatDepImp
+fwError fwFileCacheRelease(
+    const void* data_p
+    );
+
+/**
+ * @brief Sets how much memory the cached files may take, least recently used files are dropped
+ *        until they fit. 64 MiB by default.
+ * @param bytes[in] The budget in bytes, files larger than it are never cached
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatDepImp
+fwError fwFileCacheSetBudget(
+    uint64_t bytes
+    );
+
+/**
+ * @brief Retrieves the statistics of the file cache.
+ * @param stats_p[out] The statistics
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatDepImp
+fwError fwFileCacheGetStats(
+    fwFileCacheStats* stats_p
+    );
+
+/**
+ * @brief Drops every cached file and stops watching for changes.
+ * @return @c fwErrorSuccess No error occured
+ * @note Contents that callers still hold stay valid until they are released.
  */ // PlatDepImp
-fwError fwLoadFileToMem(
-    const char* filename_p,
-    void** buffer_pp,
-    uint64_t* fileSize_p
+fwError fwFileCacheClear(
+    void
+    );
+
+/**
+ * @brief Kind of an entry found while walking a directory.
+ * @note Used as parameter for @c fwWalkBatch .
+ */
+typedef enum fwWalkType : uint8_t {
+    fwWalkTypeFile /*! A regular file */,
+    fwWalkTypeDirectory /*! A directory */,
+    fwWalkTypeLink /*! A symbolic link, never followed */,
+    fwWalkTypeOther /*! Anything else, for example pipes, sockets and devices */
+} fwWalkType;
+
+/**
+ * @brief Options for walking a directory, can be combined.
+ * @note Used as parameter for @c fwWalkInfo .
+ */
+typedef enum fwWalkFlags : uint32_t {
+    fwWalkFlagNone        = 0,
+    fwWalkFlagHidden      = 0b0000'0001 /*! Include entries whose name starts with a dot, hidden
+                                            directories are not entered otherwise */,
+    fwWalkFlagDirectories = 0b0000'0010 /*! Report directories as well, not only files */,
+    fwWalkFlagOther       = 0b0000'0100 /*! Report links and other special files as well */,
+    fwWalkFlagLoad        = 0b0000'1000 /*! Load every reported file before its batch is handed
+                                            out, on the thread that found it */
+} fwWalkFlags;
+
+/**
+ * @brief Entries found in one directory, handed out by @c fwWalkDirectory .
+ * @param directory_p Path of the directory the entries are in
+ * @param paths_p Path of every entry, the directory followed by the name, can be passed to
+ *                @c fwLoadFiles as is
+ * @param types_p Kind of every entry, one of @c fwWalkType
+ * @param files_p With @c fwWalkFlagLoad , the contents of every entry, nullptr otherwise. Entries
+ *                that are not files are empty. Buffers are released once the callback returns,
+ *                unless it takes them over by setting their pointer to nullptr, it then releases
+ *                them with @c fwFree .
+ * @param count Number of entries
+ * @param depth Depth of the directory, zero for the one the walk started at
+ * @note Used as parameter for @c fwWalkCallback . Paths are only valid during the callback.
+ */
+typedef struct fwWalkBatch {
+    const char* directory_p;
+    const char* const* paths_p;
+    const uint8_t* types_p;
+    fwLoadedFile* files_p;
+    uint32_t count;
+    uint32_t depth;
+} fwWalkBatch;
+
+/**
+ * @brief Decides whether an entry is reported, directories that are rejected are not entered.
+ * @param name_p[in] Name of the entry within its directory
+ * @param type[in] Kind of the entry
+ * @param depth[in] Depth of the directory the entry is in
+ * @param user_p[in] @c user_p of @c fwWalkInfo
+ * @return false to skip the entry
+ */
+typedef bool (*fwWalkFilter)(const char* name_p, fwWalkType type, uint32_t depth, void* user_p);
+
+/**
+ * @brief Receives the entries found while walking a directory.
+ * @param batch_p[in,out] The entries
+ * @param user_p[in] @c user_p of @c fwWalkInfo
+ * @return false to end the walk early
+ */
+typedef bool (*fwWalkCallback)(fwWalkBatch* batch_p, void* user_p);
+
+/**
+ * @brief Describes how to walk a directory.
+ * @param flags Combination of @c fwWalkFlags
+ * @param maxDepth Number of directory levels to read, one for only the directory the walk starts
+ *                 at and zero for no limit
+ * @param threads Number of threads walking, the calling thread included. Zero picks one from the
+ *                number of cores, one walks on the calling thread alone.
+ * @param extension_p Only report files whose name ends with this, nullptr for every file
+ * @param filter Called for every entry that passed the other checks, may be nullptr
+ * @param callback Receives the entries
+ * @param user_p Passed on to @c filter and @c callback
+ * @note Used as parameter for @c fwWalkDirectory .
+ */
+typedef struct fwWalkInfo {
+    uint32_t flags;
+    uint32_t maxDepth;
+    uint32_t threads;
+    const char* extension_p;
+    fwWalkFilter filter;
+    fwWalkCallback callback;
+    void* user_p;
+} fwWalkInfo;
+
+/**
+ * @brief Walks a directory and every directory below it, handing out the entries in batches.
+ *        Entries are read many at a time and their kind is taken from the directory itself, so
+ *        entries are only examined one by one on file systems that do not record it.
+ * @param directory_p[in] Path of the directory to walk
+ * @param info_p[in] Description of the walk
+ * @return @c fwErrorSuccess Every directory was walked
+ * @return @c fwErrorInvalidParameter No callback was given
+ * @return @c fwErrorFileUnableToOpen The directory could not be opened
+ * @return @c fwErrorFileStats A directory below could not be opened or read, the walk went on
+ *         with the others
+ * @return @c fwErrorOutOfMemory Allocation failed, the walk ended early
+ * @note Directories are spread over several threads, so the callback and the filter are called
+ *       concurrently and batches arrive in no particular order. Each batch holds entries of one
+ *       directory, a large directory is handed out in several batches.
+ */ // PlatDepImp
+fwError fwWalkDirectory(
+    const char* directory_p,
+    const fwWalkInfo* info_p
+    );
+
+/**
+ * @brief Severity of log messages, ordered from least to most verbose.
+ * @note Used as parameter for @c fwSetLogLevel and @c fwSetModuleLogLevel.
+ */
+typedef enum fwLogLevel : uint8_t {
+    fwLogLevelError /*! Failures */,
+    fwLogLevelWarning /*! Unexpected but recoverable situations */,
+    fwLogLevelInfo /*! Lifecycle events like modules starting or sockets connecting */,
+    fwLogLevelDebug /*! Per-call details, for example every send and receive */,
+    fwLogLevelBench /*! Runtime benchmarking */
+} fwLogLevel;
+
+/**
+ * @brief Sets the most verbose level that is logged, for all modules at once.
+ * @param level[in] Messages more verbose than this level are discarded
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The level was not a valid level
+ * @note Overrides thresholds previously set with @c fwSetModuleLogLevel . Levels above the one
+ *       selected with the @c LPAF_LOG_LEVEL CMake option are compiled out and can not be
+ *       enabled at runtime.
+ */ // PlatIndepImp
+fwError fwSetLogLevel(
+    fwLogLevel level
+    );
+
+/**
+ * @brief Sets the most verbose level that is logged by a single module.
+ * @param module[in] The module whose messages are filtered
+ * @param level[in] Messages of the module more verbose than this level are discarded
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The module or level was not valid
+ * @note A filtered message costs one predictable branch, its arguments are not evaluated.
+ */ // PlatIndepImp
+fwError fwSetModuleLogLevel(
+    fwModule module,
+    fwLogLevel level
+    );
+
+/**
+ * @brief Decides what happens to a log message when the logging thread's ring buffer is full.
+ * @note Used as parameter for @c fwSetLogOverflowPolicy.
+ */
+typedef enum fwLogOverflowPolicy : uint8_t {
+    fwLogOverflowPolicyDrop /*! Discard the message and count it, the caller never waits */,
+    fwLogOverflowPolicyBlock /*! Wait until the background flusher has made room */
+} fwLogOverflowPolicy;
+
+/**
+ * @brief Sets the policy applied when a thread logs faster than the framework can write out.
+ * @param policy[in] The new policy, the default is @c fwLogOverflowPolicyDrop
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The policy was not a valid policy
+ * @note Every thread logs into its own lock-free ring which is drained by a background thread.
+ *       With the drop policy a full ring costs the caller nothing, the number of lost messages is
+ *       reported in the log once there is room again and can be queried with
+ *       @c fwGetLogDroppedCount .
+ */ // PlatIndepImp
+fwError fwSetLogOverflowPolicy(
+    fwLogOverflowPolicy policy
+    );
+
+/**
+ * @brief Retrieves the number of log messages that were dropped because a ring buffer was full.
+ * @return Total number of dropped messages since the program started
+ */ // PlatIndepImp
+uint64_t fwGetLogDroppedCount(
+    void
+    );
+
+/**
+ * @brief Decides how much work a log call does on the calling thread.
+ * @note Used as parameter for @c fwSetLogMode.
+ */
+typedef enum fwLogMode : uint8_t {
+    fwLogModeText /*! Messages are formatted by the caller and written as text */,
+    fwLogModeBinary /*! Only the raw arguments are recorded, formatting is deferred */
+} fwLogMode;
+
+/**
+ * @brief Sets the log mode, the default is @c fwLogModeText .
+ * @param mode[in] The new mode
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The mode was not a valid mode
+ * @note In binary mode a log call only copies a timestamp, the address of the format string and
+ *       the raw argument bytes. Debug builds format the messages on the logging thread, release
+ *       builds write binary log segments (@c .lpbl) that are turned back into text with the
+ *       @c lpafLogDecoder tool.
+ */ // PlatIndepImp
+fwError fwSetLogMode(
+    fwLogMode mode
+    );
+
+/**
+ * @brief Describes where and how release builds write their log files.
+ * @param directory_p Directory in which log segments are created, created if it does not exist
+ * @param segmentSize Size in bytes each segment is preallocated to, a new segment is started once
+ *                    the current one is full, a single larger record grows the current one
+ * @param rotationInterval Seconds after which a new segment is started regardless of its fill
+ * @param syncInterval Milliseconds between two syncs of the written log data to disk
+ * @note Zero values select the defaults, these are @c "log" , 16 MiB, one hour and one second.
+ * @note Used as parameter for @c fwSetLogFileInfo.
+ */
+typedef struct fwLogFileInfo {
+    const char* directory_p;
+    uint64_t segmentSize;
+    uint32_t rotationInterval;
+    uint32_t syncInterval;
+} fwLogFileInfo;
+
+/**
+ * @brief Configures the log file sink used by release builds.
+ * @param info_p[in] Location, size and timing of the log segments
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The directory path is too long
+ * @note Log files are written through memory mappings of preallocated segments, so writing a
+ *       message never costs a system call. Takes effect when the next segment is started, call it
+ *       before starting the first module to have all segments follow it.
+ */ // PlatIndepImp
+fwError fwSetLogFileInfo(
+    const struct fwLogFileInfo* info_p
+    );
+
+/**
+ * @brief Identifier of a profiling zone, a named section of code whose latency is measured.
+ */
+typedef uint16_t fwProfileZone;
+
+/**
+ * @brief Latency statistics of a profiling zone, all durations in nanoseconds.
+ * @param count Number of times the zone was passed
+ * @param p50 Median duration
+ * @param p99 99th percentile duration
+ * @param max Longest duration
+ * @param mean Average duration
+ * @note Percentiles come from log-linear histograms and are accurate to about 12%.
+ * @note Used as parameter for @c fwProfileGetStats.
+ */
+typedef struct fwProfileStats {
+    uint64_t count;
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t max;
+    uint64_t mean;
+} fwProfileStats;
+
+/**
+ * @brief Turns the collection of profiling data on or off, it is off by default.
+ * @param enable[in] If zones should be measured
+ * @note The framework instruments its own hot paths (module start, file loads, socket connect,
+ *       accept, send and receive) with zones as well, their data is collected alongside the
+ *       application's zones.
+ */ // PlatIndepImp
+void fwProfileEnable(
+    bool enable
+    );
+
+/**
+ * @brief Registers a new profiling zone.
+ * @param name_p[in] Name under which the zone is reported, truncated to 47 characters
+ * @param zone_p[out] Identifier of the new zone
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorOutOfMemory The maximum number of zones is reached
+ */ // PlatIndepImp
+fwError fwProfileZoneCreate(
+    const char* name_p,
+    fwProfileZone* zone_p
+    );
+
+/**
+ * @brief Marks the beginning of a pass through a zone.
+ * @return Timestamp that has to be passed to @c fwProfileEnd , read from the time stamp counter
+ */ // PlatIndepImp
+uint64_t fwProfileBegin(
+    void
+    );
+
+/**
+ * @brief Marks the end of a pass through a zone and records its duration.
+ * @param zone[in] The zone that was passed
+ * @param begin[in] Timestamp returned by the matching @c fwProfileBegin
+ * @note The duration goes into a histogram owned by the calling thread, no locks or shared cache
+ *       lines are involved.
+ */ // PlatIndepImp
+void fwProfileEnd(
+    fwProfileZone zone,
+    uint64_t begin
+    );
+
+/**
+ * @brief State of a zone that is closed automatically, see @c FW_PROFILE_SCOPE .
+ */
+typedef struct fwProfileScope {
+    uint64_t begin;
+    fwProfileZone zone;
+} fwProfileScope;
+
+/**
+ * @brief Closes a scoped zone, called automatically when a @c FW_PROFILE_SCOPE goes out of scope.
+ */ // PlatIndepImp
+void fwProfileScopeEnd(
+    fwProfileScope* scope_p
+    );
+
+#define FW_PROFILE_CONCAT_(a, b) a##b
+#define FW_PROFILE_CONCAT(a, b) FW_PROFILE_CONCAT_(a, b)
+
+/**
+ * @brief Measures the rest of the enclosing block as a pass through @c zone , every path out of
+ *        the block ends the zone.
+ */
+#define FW_PROFILE_SCOPE(zone) \
+    __attribute__((cleanup(fwProfileScopeEnd))) \
+    fwProfileScope FW_PROFILE_CONCAT(fwProfileScope_, __LINE__) = {fwProfileBegin(), (zone)}
+
+/**
+ * @brief Retrieves the statistics of a zone, merged over all threads.
+ * @param zone[in] The zone
+ * @param stats_p[out] The statistics
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The zone does not exist
+ */ // PlatIndepImp
+fwError fwProfileGetStats(
+    fwProfileZone zone,
+    struct fwProfileStats* stats_p
+    );
+
+/**
+ * @brief Writes the statistics of every zone that was passed at least once to the log, using the
+ *        benchmark log level.
+ * @note Called by @c fwStopAllModules if profiling is enabled.
+ */ // PlatIndepImp
+void fwProfileDump(
+    void
+    );
+
+/**
+ * @brief Starts recording framework events for a timeline view.
+ * @param filename_p[in] File the trace is written to by @c fwTraceStop , in the Chrome trace event
+ *                       format which can be opened with Perfetto or chrome://tracing
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The file name is too long
+ * @note Recorded are module start and stop, socket creation, connects, accepts, sends, receives
+ *       and closes with their byte counts, file loads and, while profiling is enabled, every pass
+ *       through a profiling zone. Events are kept in per-thread memory until the trace is
+ *       written. While tracing is off, an instrumented call pays a single branch.
+ */ // PlatIndepImp
+fwError fwTraceStart(
+    const char* filename_p
+    );
+
+/**
+ * @brief Stops recording and writes the trace file.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorFileUnableToOpen The trace file could not be written
+ * @note Called by @c fwStopAllModules if tracing is active.
+ */ // PlatIndepImp
+fwError fwTraceStop(
+    void
     );
 
+/**
+ * @brief Identifier for a socket, zero is never a valid socket.
+ * @note Identifiers carry a generation, once a socket is closed its identifier is rejected with
+ *       @c fwErrorInvalidParameter even after the framework hands out the same slot again.
+ */
 typedef uintptr_t fwSocket;
 
 /**
@@ -164,6 +1466,9 @@ typedef enum fwSocketProtocol : uint8_t {
  * @return @c fwErrorSuccess No error occured
  * @return @c fwErrorInvalidParameter A value that does not correspond to an enumerated identifier
  *                                    was passed to @c sockCrtInf
+ * @return @c fwErrorSocketCreate The system could not create the socket, for example because the
+ *         process ran out of file descriptors
+ * @return @c fwErrorOutOfMemory The socket table could not grow
  * @note See @c fwSocketAddressFamily for address families and @c fwSocketProtocol for protocols.
  */ // PlatDepImp
 fwError fwSocketCreate(
@@ -198,6 +1503,12 @@ typedef struct fwSocketAddress {
  * @return @c fwErrorSuccess No error occured
  * @return @c fwErrorSocketTargetName Could not resolve the name of the target to an IP address
  * @return @c fwErrorSocketConnection Could not connect to the target
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and the connection is still being
+ *         established, the socket becomes writable once it is, or reports an error if it failed.
+ *         Calling again then returns @c fwErrorSuccess or @c fwErrorSocketConnection with the
+ *         outcome, and @c fwErrorSocketWouldBlock while it is still underway, the address is
+ *         ignored. Local sockets are not connected at all when the peer's backlog is full, call
+ *         again.
  * @return @c fwErrorInvalidParameter Invalid enumerations in @c createInfo_p
  */ // PlatDepImp
 fwError fwSocketConnect(
@@ -228,6 +1539,10 @@ fwError fwSocketBind(
  *                                  connection was not bound
  * @return @c fwErrorSocketListen The system call, marking the socket as listening, failed
  * @return @c fwErrorSocketAccept Failed to accept the new connection
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and no connection is waiting, or
+ *         an io_uring event loop watches it and has not accepted one yet
+ * @note The socket starts listening on the first call. Connections accepted by a non-blocking
+ *       socket are non-blocking as well.
  * @note The reason why using one socket to accept the connection and then spawning another, is to
  *       re-use the old socket to accept more connections. Each new socket spawned is the connected
  *       state, such that it can immediatly be used to interact with the peer.
@@ -249,8 +1564,15 @@ fwError fwSocketAccept(
  * @param ammount[in] Number of bytes that are supposed to be sent
  * @return @c fwErrorSuccess No error occured
  * @return @c fwErrorSocketSend Failed to send data
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and its send buffer is full
+ * @return @c fwErrorOutOfMemory An io_uring event loop watches the socket and could not queue the
+ *         data
  * @note Passing an identifier to a socket that is not connected or one that operates over a
  *       connection-less protocol will cause failure.
+ * @note A single call may send only part of the data and still succeed, use @c fwSocketSendV to
+ *       learn how much was sent.
+ * @note On a socket watched by an io_uring event loop the data is queued, a send that fails later
+ *       is reported as @c fwEventError and makes the following calls fail.
  */ // PlatDepImp
 fwError fwSocketSend(
     fwSocket sfdop,
@@ -258,6 +1580,33 @@ fwError fwSocketSend(
     size_t ammount
     );
 
+/**
+ * @brief Sends part of a file over a connected socket without copying it through userspace.
+ * @param sfdop[in] Socket that is supposed to send the data
+ * @param file[in] File to send from, see @c fwFileOpen
+ * @param offset[in] Position in the file of the first byte to send
+ * @param length[in] Number of bytes to send, zero sends everything up to the end of the file
+ * @param sent_p[out] Number of bytes sent, may be nullptr
+ * @return @c fwErrorSuccess Everything was sent, or the file ended before @c length was reached
+ * @return @c fwErrorInvalidParameter The socket or file passed was not valid
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and its send buffer is full, call
+ *         again from @c offset plus @c sent_p once it is writable
+ * @return @c fwErrorSocketSend Failed to send data
+ * @return @c fwErrorFileRead Failed to read from the file
+ * @return @c fwErrorUnimplemented An io_uring event loop watches the socket, the file would
+ *         overtake the data it has queued
+ * @note Partial transfers are continued until everything was sent. Files the kernel can not send
+ *       from directly, such as those opened with @c fwFileOpenFlagDirect on some file systems, are
+ *       sent through a bounce buffer instead.
+ */ // PlatDepImp
+fwError fwSocketSendFile(
+    fwSocket sfdop,
+    fwFile file,
+    uint64_t offset,
+    uint64_t length,
+    uint64_t* sent_p
+    );
+
 /**
  * @brief Receives data over a connected socket.
  * @param sfdop[in] Socket that is supposed the receive the data
@@ -265,6 +1614,8 @@ fwError fwSocketSend(
  * @param ammount[in] Maximum ammount of bytes the call is allowed to write to @c buffer
  * @return @c fwErrorSuccess No error occured
  * @return @c fwErrorSocketReceive Failed to receive data
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and nothing has arrived, or an
+ *         io_uring event loop watches it and has not received anything yet
  * @note Passing an identifier to a socket that is not connected or one that operates over a
  *       connection-less protocol will cause failure.
  */ // PlatDepImp
@@ -274,6 +1625,65 @@ fwError fwSocketReceive(
     size_t ammount
     );
 
+/**
+ * @brief One of several buffers that a vectored call sends from or receives into.
+ * @param data_p Start of the buffer
+ * @param size Size of the buffer in bytes, may be zero
+ * @note Used as parameter for @c fwSocketSendV and @c fwSocketReceiveV .
+ */
+typedef struct fwSocketBuffer {
+    void* data_p;
+    size_t size;
+} fwSocketBuffer;
+
+/**
+ * @brief Sends the contents of several buffers in order over a connected socket, without copying
+ *        them into one first.
+ * @param sfdop[in] Socket that is supposed to send the data
+ * @param buffers_p[in] Buffers to send, their data is not changed
+ * @param count[in] Number of buffers
+ * @param sent_p[out] Number of bytes sent, may be nullptr
+ * @return @c fwErrorSuccess Everything was sent
+ * @return @c fwErrorInvalidParameter The socket passed was not valid
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking and its send buffer filled up,
+ *         @c sent_p tells how far the data got, call again with the rest once it is writable
+ * @return @c fwErrorSocketSend Failed to send data, @c sent_p tells how much was sent before
+ * @return @c fwErrorOutOfMemory An io_uring event loop watches the socket and could not queue the
+ *         data
+ * @note Unlike @c fwSocketSend , partial transfers are continued until everything was sent.
+ * @note On a socket watched by an io_uring event loop the buffers are gathered into one queued
+ *       copy, see @c fwSocketSend .
+ */ // PlatDepImp
+fwError fwSocketSendV(
+    fwSocket sfdop,
+    const fwSocketBuffer* buffers_p,
+    uint32_t count,
+    size_t* sent_p
+    );
+
+/**
+ * @brief Receives data over a connected socket into several buffers, filling them in order.
+ * @param sfdop[in] Socket that is supposed the receive the data
+ * @param buffers_p[in] Destination buffers
+ * @param count[in] Number of buffers
+ * @param received_p[out] Number of bytes received, may be nullptr
+ * @return @c fwErrorSuccess Every buffer was filled, or the peer closed the connection, in which
+ *         case @c received_p is short of their total size
+ * @return @c fwErrorInvalidParameter The socket passed was not valid
+ * @return @c fwErrorSocketWouldBlock The socket is non-blocking, or watched by an io_uring event
+ *         loop, and ran out of data before the buffers were filled, @c received_p tells how much
+ *         was received
+ * @return @c fwErrorSocketReceive Failed to receive data, @c received_p tells how much was
+ *         received before
+ * @note Blocking sockets wait until every buffer is filled, which suits messages of known size.
+ */ // PlatDepImp
+fwError fwSocketReceiveV(
+    fwSocket sfdop,
+    const fwSocketBuffer* buffers_p,
+    uint32_t count,
+    size_t* received_p
+    );
+
 /**
  * @brief Closes the specified socket.
  * @param sfdop[in] Socket to be closed
@@ -282,11 +1692,359 @@ fwError fwSocketReceive(
  * @note Closing a socket wont make its locally bound address immediatly accessable again since the
  *       kernel still holds information about it. Only after approximatly 2 minutes, the data is
  *       released.
+ * @note A socket that is watched by an event loop is removed from it, see @c fwEventLoopRemove .
  */ // PlatDepImp
 fwError fwSocketClose(
     fwSocket sfdop
     );
 
+/**
+ * @brief Switches a socket between blocking and non-blocking calls. Non-blocking calls that can
+ *        not go on right away return @c fwErrorSocketWouldBlock instead of waiting.
+ * @param sfdop[in] Socket to switch
+ * @param nonBlocking[in] True for non-blocking calls, sockets start out blocking
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The socket passed was not valid
+ * @note Needed for sockets that are watched by an event loop.
+ */ // PlatDepImp
+fwError fwSocketSetNonBlocking(
+    fwSocket sfdop,
+    bool nonBlocking
+    );
+
+/**
+ * @brief Traffic statistics of a socket or of all sockets.
+ * @param bytesSent Bytes handed to the kernel by @c fwSocketSend and @c fwSocketSendV
+ * @param bytesReceived Bytes returned by @c fwSocketReceive and @c fwSocketReceiveV
+ * @param sendCalls Number of sends, a vectored call counts every system call it makes
+ * @param receiveCalls Number of receives, a vectored call counts every system call it makes
+ * @param shortSends Sends that transferred fewer bytes than requested
+ * @param shortReceives Receives that returned fewer bytes than the buffer could hold
+ * @param wouldBlock Calls that failed because the operation would have blocked or timed out
+ * @param interrupted Calls interrupted by a signal, these are retried
+ * @param errors Calls that failed for any other reason
+ * @param sendLatency Duration of send calls in nanoseconds
+ * @param receiveLatency Duration of receive calls in nanoseconds
+ * @param roundTripTime Smoothed round trip time in microseconds, TCP only
+ * @param roundTripTimeVariance Round trip time variance in microseconds, TCP only
+ * @param retransmits Segments retransmitted over the lifetime of the connection, TCP only
+ * @param lost Segments currently considered lost, TCP only
+ * @param congestionWindow Send congestion window in segments, TCP only
+ * @param sendBufferSize Kernel send buffer size in bytes
+ * @param receiveBufferSize Kernel receive buffer size in bytes
+ * @param openSockets Number of sockets currently open, only set by @c fwSocketGetGlobalStats
+ * @note Used as parameter for @c fwSocketGetStats and @c fwSocketGetGlobalStats .
+ */
+typedef struct fwSocketStats {
+    uint64_t bytesSent;
+    uint64_t bytesReceived;
+    uint64_t sendCalls;
+    uint64_t receiveCalls;
+    uint64_t shortSends;
+    uint64_t shortReceives;
+    uint64_t wouldBlock;
+    uint64_t interrupted;
+    uint64_t errors;
+    fwProfileStats sendLatency;
+    fwProfileStats receiveLatency;
+    uint32_t roundTripTime;
+    uint32_t roundTripTimeVariance;
+    uint32_t retransmits;
+    uint32_t lost;
+    uint32_t congestionWindow;
+    uint32_t sendBufferSize;
+    uint32_t receiveBufferSize;
+    uint32_t openSockets;
+} fwSocketStats;
+
+/**
+ * @brief Retrieves the traffic statistics of a socket along with what the kernel knows about its
+ *        connection.
+ * @param sfdop[in] Socket to query
+ * @param stats_p[out] Statistics of the socket
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The socket passed was not valid
+ */ // PlatDepImp
+fwError fwSocketGetStats(
+    fwSocket sfdop,
+    fwSocketStats* stats_p
+    );
+
+/**
+ * @brief Retrieves the traffic statistics summed over every socket the process has created,
+ *        including closed ones.
+ * @param stats_p[out] Statistics of all sockets, the per-connection TCP and buffer size fields
+ *                     are zero
+ * @return @c fwErrorSuccess No error occured
+ */ // PlatIndepImp
+fwError fwSocketGetGlobalStats(
+    fwSocketStats* stats_p
+    );
+
+/**
+ * @brief Identifier for an event loop, which waits for many sockets at once on one thread.
+ */
+typedef uintptr_t fwEventLoop;
+
+/**
+ * @brief Readiness of a socket, can be combined.
+ * @note Used as parameter for @c fwEventLoopAdd and @c fwEventCallback .
+ */
+typedef enum fwEvent : uint32_t {
+    fwEventNone    = 0,
+    fwEventAccept  = 0b0000'0001 /*! A listening socket has a connection waiting, see
+                                     @c fwSocketAccept */,
+    fwEventRead    = 0b0000'0010 /*! Data has arrived or the peer closed its side */,
+    fwEventWrite   = 0b0000'0100 /*! The send buffer has room, or a pending connection finished */,
+    fwEventHangUp  = 0b0000'1000 /*! The peer closed the connection, always reported */,
+    fwEventError   = 0b0001'0000 /*! The socket has an error pending, always reported */
+} fwEvent;
+
+/**
+ * @brief Options for watching a socket, can be combined.
+ * @note Used as parameter for @c fwEventLoopAdd .
+ */
+typedef enum fwEventFlags : uint32_t {
+    fwEventFlagNone          = 0,
+    fwEventFlagEdgeTriggered = 0b0000'0001 /*! Report readiness only when it changes. The callback
+                                               has to read, write or accept until the call returns
+                                               @c fwErrorSocketWouldBlock , or it is not called
+                                               again for what is left. */,
+    fwEventFlagOneShot       = 0b0000'0010 /*! Stop watching after one report until the socket is
+                                               armed again with @c fwEventLoopModify */
+} fwEventFlags;
+
+/**
+ * @brief How an event loop waits for its sockets.
+ * @note Used as parameter for @c fwEventLoopInfo .
+ */
+typedef enum fwEventBackend : uint32_t {
+    fwEventBackendEpoll /*! Waits for readiness with epoll, the socket calls made in the callbacks
+                            go straight to the kernel */,
+    fwEventBackendUring /*! Waits for completions with io_uring, which needs Linux 6.0. Connections
+                            are accepted and data is received ahead of time into buffers that the
+                            kernel takes from a pool of the loop, @c fwSocketAccept and
+                            @c fwSocketReceive hand out what has arrived and never block.
+                            @c fwSocketSend copies the data into a queue, sends to one socket are
+                            linked so they go out in order, and everything queued is submitted
+                            with the next wait of the loop. The sockets are registered with the
+                            ring, so the kernel does not look them up for every operation. */
+} fwEventBackend;
+
+/**
+ * @brief Optional settings of an event loop, zero picks the default.
+ * @param backend How the loop waits, epoll if not set
+ * @param maxSockets Most sockets an io_uring loop watches at once, 4096 by default
+ * @param bufferSize Size of each receive buffer of an io_uring loop, 4 KiB by default
+ * @param bufferCount Number of receive buffers of an io_uring loop, a power of two up to 32768,
+ *                    2048 by default. Buffers are given back once @c fwSocketReceive has taken
+ *                    everything out of them, a loop that runs out stops receiving until then.
+ * @note Used as parameter for @c fwEventLoopCreate .
+ */
+typedef struct fwEventLoopInfo {
+    fwEventBackend backend;
+    uint32_t maxSockets;
+    uint32_t bufferSize;
+    uint32_t bufferCount;
+} fwEventLoopInfo;
+
+/**
+ * @brief Called by the event loop when a socket it watches is ready.
+ * @param loop The loop that runs the callback
+ * @param sfdop The socket
+ * @param events Combination of @c fwEvent that the socket is ready for
+ * @param user_p Passed to @c fwEventLoopAdd
+ * @note The callback may add, modify, remove and close sockets of its own loop, events still
+ *       pending for a socket that was removed are dropped.
+ */
+typedef void (*fwEventCallback)(fwEventLoop loop, fwSocket sfdop, uint32_t events, void* user_p);
+
+/**
+ * @brief Creates an event loop.
+ * @param info_p[in] Settings of the loop, may be nullptr for an epoll loop
+ * @param loop_p[out] The loop
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorOutOfMemory The loop could not be created
+ * @return @c fwErrorInvalidParameter A setting in @c info_p is out of range
+ * @return @c fwErrorUnimplemented The kernel lacks what the backend needs, fall back to epoll
+ * @note A loop belongs to the thread that runs it, every function except @c fwEventLoopStop must
+ *       be called from there. To use several cores, give each thread a loop of its own. Sockets on
+ *       an io_uring loop are also only sent on, received from and closed there.
+ */ // PlatDepImp
+fwError fwEventLoopCreate(
+    const fwEventLoopInfo* info_p,
+    fwEventLoop* loop_p
+    );
+
+/**
+ * @brief Starts watching a socket. Listening sockets are put into the listening state if they are
+ *        not yet.
+ * @param loop[in] The loop
+ * @param sfdop[in] Socket to watch, should be non-blocking, see @c fwSocketSetNonBlocking
+ * @param events[in] Combination of @c fwEvent to wait for
+ * @param flags[in] Combination of @c fwEventFlags
+ * @param callback[in] Called whenever the socket is ready
+ * @param user_p[in] Passed to the callback
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter A parameter was not valid or the socket is already watched by
+ *         a loop
+ * @return @c fwErrorSocketListen The socket was to be accepted from but could not listen
+ * @return @c fwErrorOutOfMemory Out of memory
+ */ // PlatDepImp
+fwError fwEventLoopAdd(
+    fwEventLoop loop,
+    fwSocket sfdop,
+    uint32_t events,
+    uint32_t flags,
+    fwEventCallback callback,
+    void* user_p
+    );
+
+/**
+ * @brief Changes what a watched socket is waited for, also arms a one-shot socket again.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The socket is not watched by the loop
+ */ // PlatDepImp
+fwError fwEventLoopModify(
+    fwEventLoop loop,
+    fwSocket sfdop,
+    uint32_t events,
+    uint32_t flags
+    );
+
+/**
+ * @brief Stops watching a socket. Data an io_uring loop has queued for it is still sent, what it
+ *        received and was not taken yet is dropped.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The socket is not watched by the loop
+ */ // PlatDepImp
+fwError fwEventLoopRemove(
+    fwEventLoop loop,
+    fwSocket sfdop
+    );
+
+/**
+ * @brief Waits once for sockets to become ready and runs their callbacks.
+ * @param loop[in] The loop
+ * @param timeout[in] Longest wait in milliseconds, zero to only look, -1 to wait without limit
+ * @param handled_p[out] Number of callbacks run, may be nullptr
+ * @return @c fwErrorSuccess No error occured, also when the wait timed out
+ * @return @c fwErrorInvalidParameter The loop passed was not valid
+ */ // PlatDepImp
+fwError fwEventLoopRunOnce(
+    fwEventLoop loop,
+    int32_t timeout,
+    uint32_t* handled_p
+    );
+
+/**
+ * @brief Runs a loop on the calling thread until @c fwEventLoopStop is called.
+ * @return @c fwErrorSuccess The loop was stopped
+ * @return @c fwErrorInvalidParameter The loop passed was not valid
+ */ // PlatDepImp
+fwError fwEventLoopRun(
+    fwEventLoop loop
+    );
+
+/**
+ * @brief Makes @c fwEventLoopRun return once the callbacks that are running finish.
+ * @note Can be called from any thread and from signal handlers.
+ */ // PlatDepImp
+fwError fwEventLoopStop(
+    fwEventLoop loop
+    );
+
+/**
+ * @brief Destroys a loop, the sockets it watches stay open.
+ * @note Must not be called while the loop runs. Data an io_uring loop still has queued is dropped,
+ *       run the loop until its sockets were written to if that matters.
+ */ // PlatDepImp
+fwError fwEventLoopDestroy(
+    fwEventLoop loop
+    );
+
+/**
+ * @brief Identifier for a server, which accepts connections on several threads, each with a
+ *        listening socket and an event loop of its own.
+ */
+typedef uintptr_t fwServer;
+
+/**
+ * @brief Options of a server, can be combined.
+ * @note Used as parameter for @c fwServerInfo .
+ */
+typedef enum fwServerFlags : uint32_t {
+    fwServerFlagNone        = 0,
+    fwServerFlagPin         = 0b0000'0001 /*! Pin each worker thread to a core of its own */,
+    fwServerFlagIncomingCpu = 0b0000'0010 /*! Mark each listener with the core of its worker, so
+                                              the kernel prefers it for connections that arrive
+                                              on that core */,
+    fwServerFlagSteer       = 0b0000'0100 /*! Pick the listener of a connection with a BPF program
+                                              by the core it arrived on, which keeps every
+                                              connection on one core when the workers are
+                                              pinned, ignored with more workers than cores */
+} fwServerFlags;
+
+/**
+ * @brief Called on the worker thread that accepted a connection.
+ * @param loop Event loop of the worker, to add the connection to
+ * @param sfdop The connection, non-blocking, owned by the callee
+ * @param worker Index of the worker, below the worker count of the server
+ * @param user_p Passed in @c fwServerInfo
+ */
+typedef void (*fwServerCallback)(fwEventLoop loop, fwSocket sfdop, uint32_t worker, void* user_p);
+
+/**
+ * @brief Settings of a server.
+ * @param address Local address to listen on, shared by every worker
+ * @param addressFamily IPv4 or IPv6
+ * @param workers Number of worker threads, zero for one per core
+ * @param flags Combination of @c fwServerFlags
+ * @param loop Settings of the event loop of each worker
+ * @param callback Called for each accepted connection
+ * @param user_p Passed to the callback
+ * @note Used as parameter for @c fwServerCreate .
+ */
+typedef struct fwServerInfo {
+    fwSocketAddress address;
+    fwSocketAddressFamily addressFamily;
+    uint32_t workers;
+    uint32_t flags;
+    fwEventLoopInfo loop;
+    fwServerCallback callback;
+    void* user_p;
+} fwServerInfo;
+
+/**
+ * @brief Starts a server. Every worker has a listening socket bound to the same address with
+ *        SO_REUSEPORT, so the kernel spreads the connections over their accept queues instead of
+ *        all of them waiting in one.
+ * @param info_p[in] Settings of the server
+ * @param server_p[out] The server
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter A setting is not valid
+ * @return @c fwErrorSocketBind The address could not be bound
+ * @return @c fwErrorSocketListen A listener could not listen
+ * @return @c fwErrorOutOfMemory A worker could not be started
+ * @return @c fwErrorUnimplemented The kernel lacks what the event loop settings need
+ * @note Steering and pinning are only requests, a server whose kernel refuses them still runs.
+ */ // PlatDepImp
+fwError fwServerCreate(
+    const fwServerInfo* info_p,
+    fwServer* server_p
+    );
+
+/**
+ * @brief Stops the workers and closes the listeners. Connections that are still watched by the
+ *        event loops stay open but lose their loop.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorInvalidParameter The server passed was not valid
+ * @note Must not be called from a worker.
+ */ // PlatDepImp
+fwError fwServerDestroy(
+    fwServer server
+    );
+
 //TODO: checkable socket connection status
 
 #endif //LPAF_FRAMEWORK_H
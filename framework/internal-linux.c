@@ -16,9 +16,21 @@
 
 #ifdef PLATFORM_LINUX
 
+// mremap is a GNU extension
+#define _GNU_SOURCE
+
 #include "internal.h"
 #include "linux.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 #include <wayland-client.h>
 
 static struct wl_display* display = {};
@@ -40,7 +52,7 @@ fwError fwiStopNativeModuleWindow(void) {
 }
 
 fwError fwiStartNativeModuleNetwork(void) {
-    fwiLogA(fwiLogLevelInfo, "Networking module was started");
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Networking module was started");
 
     // Because Linux is just better there is no state to be set before networking syscall can be
     // used
@@ -49,7 +61,7 @@ fwError fwiStartNativeModuleNetwork(void) {
 }
 
 fwError fwiStopNativeModuleNetwork(void) {
-    fwiLogA(fwiLogLevelInfo, "Networking module was stopped");
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Networking module was stopped");
 
     // Because Linux is just better there is no state to be set after networking syscalls are done
     // being used
@@ -73,4 +85,184 @@ fwError fwiStopNativeModuleMultimedia(void) {
     return fwErrorUnimplemented;
 }
 
+/**
+ * @brief State of the log segment that is currently being written.
+ */
+static struct {
+    char* mapping;
+    uint64_t capacity;
+    uint64_t offset;
+    uint64_t syncedOffset;
+    time_t openedAt;
+    time_t failedAt;
+    struct timespec syncedAt;
+    uint32_t sequence;
+    int32_t fileDescriptor;
+    bool binary;
+} logFile_s = {.fileDescriptor = -1};
+
+static uint64_t fwiLogFileSegmentSize(void) {
+    const uint64_t size = fwiGetState()->logSegmentSize;
+    return size != 0 ? size : 16 * 1024 * 1024;
+}
+
+static bool fwiLogFileOpen(const bool binary) {
+    const time_t now = time(nullptr);
+
+    // Do not hammer the file system when the log directory is not writable
+    if (logFile_s.failedAt == now) {
+        return false;
+    }
+
+    const char* directory = fwiGetState()->logDirectory[0] != '\0' ?
+                            fwiGetState()->logDirectory : "log";
+    if (mkdir(directory, 0755) == -1 && errno != EEXIST) {
+        logFile_s.failedAt = now;
+        return false;
+    }
+
+    struct tm time;
+    localtime_r(&now, &time);
+    char stamp[16] = {};
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &time);
+
+    char path[320];
+    snprintf(path, sizeof(path), "%s/lpaf-%s-%u.%s", directory, stamp, logFile_s.sequence++,
+             binary ? "lpbl" : "log");
+
+    const int32_t fileDescriptor = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fileDescriptor == -1) {
+        logFile_s.failedAt = now;
+        return false;
+    }
+
+    // Reserve the blocks up front, running out of disk space while writing to a mapping would
+    // raise SIGBUS instead of returning an error
+    const uint64_t capacity = fwiLogFileSegmentSize();
+    if (posix_fallocate(fileDescriptor, 0, (off_t)capacity) != 0) {
+        close(fileDescriptor);
+        unlink(path);
+        logFile_s.failedAt = now;
+        return false;
+    }
+
+    char* mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fileDescriptor, 0);
+    if (mapping == MAP_FAILED) {
+        close(fileDescriptor);
+        unlink(path);
+        logFile_s.failedAt = now;
+        return false;
+    }
+    madvise(mapping, capacity, MADV_SEQUENTIAL);
+
+    logFile_s.mapping        = mapping;
+    logFile_s.capacity       = capacity;
+    logFile_s.offset         = 0;
+    logFile_s.syncedOffset   = 0;
+    logFile_s.openedAt       = now;
+    logFile_s.fileDescriptor = fileDescriptor;
+    logFile_s.binary         = binary;
+    clock_gettime(CLOCK_MONOTONIC, &logFile_s.syncedAt);
+
+    if (binary) {
+        memcpy(mapping, FWI_LOG_BINARY_MAGIC, 8);
+        memset(mapping + 8, 0, 8);
+        logFile_s.offset = 16;
+    }
+    return true;
+}
+
+/**
+ * @brief Grows the current segment in place, the blocks are reserved before the mapping follows.
+ */
+static bool fwiLogFileGrow(const uint64_t capacity) {
+    if (posix_fallocate(logFile_s.fileDescriptor, 0, (off_t)capacity) != 0) {
+        return false;
+    }
+
+    char* mapping = mremap(logFile_s.mapping, logFile_s.capacity, capacity, MREMAP_MAYMOVE);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    madvise(mapping, capacity, MADV_SEQUENTIAL);
+
+    logFile_s.mapping  = mapping;
+    logFile_s.capacity = capacity;
+    return true;
+}
+
+void fwiLogFileClose(void) {
+    if (logFile_s.fileDescriptor == -1) {
+        return;
+    }
+
+    msync(logFile_s.mapping, logFile_s.offset, MS_SYNC);
+    munmap(logFile_s.mapping, logFile_s.capacity);
+
+    // Give back the preallocated space that was never written to
+    ftruncate(logFile_s.fileDescriptor, (off_t)logFile_s.offset);
+    fdatasync(logFile_s.fileDescriptor);
+    close(logFile_s.fileDescriptor);
+
+    logFile_s.mapping        = nullptr;
+    logFile_s.fileDescriptor = -1;
+}
+
+uint32_t fwiLogFilePrepare(const size_t size, const bool binary) {
+    // A record that would not fit into a fresh segment either grows the current one instead, a
+    // new segment for each of them would only leave a trail of single record files behind
+    const bool oversized = (binary ? 16 : 0) + size > fwiLogFileSegmentSize();
+    if (logFile_s.fileDescriptor != -1 && (logFile_s.binary != binary ||
+                                           (logFile_s.offset + size > logFile_s.capacity &&
+                                            !oversized))) {
+        fwiLogFileClose();
+    }
+    if (logFile_s.fileDescriptor == -1 && !fwiLogFileOpen(binary)) {
+        return UINT32_MAX;
+    }
+    if (logFile_s.offset + size > logFile_s.capacity &&
+        !fwiLogFileGrow(logFile_s.offset + size)) {
+        return UINT32_MAX;
+    }
+
+    return logFile_s.sequence;
+}
+
+void fwiLogFileWrite(const void* data_p, const size_t size) {
+    memcpy(logFile_s.mapping + logFile_s.offset, data_p, size);
+    logFile_s.offset += size;
+}
+
+void fwiLogFileSync(const bool force) {
+    if (logFile_s.fileDescriptor == -1) {
+        return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    const uint32_t rotationInterval = fwiGetState()->logRotationInterval != 0 ?
+                                      fwiGetState()->logRotationInterval : 3600;
+    if (time(nullptr) - logFile_s.openedAt >= rotationInterval) {
+        fwiLogFileClose();
+        return;
+    }
+
+    const uint32_t syncInterval = fwiGetState()->logSyncInterval != 0 ?
+                                  fwiGetState()->logSyncInterval : 1000;
+    const uint64_t elapsed = (now.tv_sec - logFile_s.syncedAt.tv_sec) * 1000 +
+                             (now.tv_nsec - logFile_s.syncedAt.tv_nsec) / 1'000'000;
+    if (logFile_s.offset == logFile_s.syncedOffset || (!force && elapsed < syncInterval)) {
+        return;
+    }
+
+    // msync wants a page aligned start, everything from the last synced page onwards is written
+    const uint64_t pageSize = sysconf(_SC_PAGESIZE);
+    const uint64_t start = logFile_s.syncedOffset & ~(pageSize - 1);
+    msync(logFile_s.mapping + start, logFile_s.offset - start, MS_SYNC);
+
+    logFile_s.syncedOffset = logFile_s.offset;
+    logFile_s.syncedAt     = now;
+}
+
 #endif // PLATFORM_LINUX
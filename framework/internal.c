@@ -14,185 +14,1068 @@
 
 // This implementation file contains implementations for platform independant, internal symbols
 
+#include <sched.h>
 #include <stdarg.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <time.h>
 #include <wchar.h>
 
 #include "internal.h"
 #include "framework.h"
 
-struct fwiState frameworkState_s = {0};
+struct fwiState frameworkState_s = {
+    .loggerMutex   = PTHREAD_MUTEX_INITIALIZER,
+    .loggerWake    = PTHREAD_COND_INITIALIZER,
+    .logThresholds = {fwiLogLevelBench, fwiLogLevelBench, fwiLogLevelBench, fwiLogLevelBench,
+                      fwiLogLevelBench}
+};
 
 struct fwiState* fwiGetState(void) {
     return &frameworkState_s;
 }
 
-void fwiLogA(const fwiLogLevel lll, const char* format_p,  ...) {
-#ifdef BUILD_DEBUG
-    const time_t rawTime  = time(nullptr);
-    const struct tm* time = localtime(&rawTime);
+fwiLogDomain fwiLogDomainOf(const fwModule module) {
+    switch (module) {
+        case fwModuleWindow: {
+            return fwiLogDomainWindow;
+        }
+        case fwModuleRender: {
+            return fwiLogDomainRender;
+        }
+        case fwModuleNetwork: {
+            return fwiLogDomainNetwork;
+        }
+        case fwModuleMultimedia: {
+            return fwiLogDomainMultimedia;
+        }
+        default: {
+            return fwiLogDomainCount;
+        }
+    }
+}
 
-    char buf[10] = {};
-    const size_t bytesWritten = strftime(buf, 10, "[%H:%M:%S", time);
-    if (bytesWritten == 0) {
-        printf("Failed to get local time");
-        return;
+static pthread_key_t logRingKey_s;
+static pthread_once_t logRingKeyOnce_s = PTHREAD_ONCE_INIT;
+static thread_local struct fwiLogRing* logRing_s = nullptr;
+
+static void fwiReleaseLogRing(void* ring_p) {
+    atomic_store_explicit(&((struct fwiLogRing*)ring_p)->owned, false, memory_order_release);
+}
+
+static void fwiCreateLogRingKey(void) {
+    pthread_key_create(&logRingKey_s, fwiReleaseLogRing);
+}
+
+static struct fwiLogRing* fwiAcquireLogRing(void) {
+    if (logRing_s != nullptr) {
+        return logRing_s;
     }
 
-    pthread_mutex_lock(&frameworkState_s.loggerMutex);
+    pthread_once(&logRingKeyOnce_s, fwiCreateLogRingKey);
+
+    // Rings of threads that have exited can be adopted, the ring stays single-producer since only
+    // one thread at a time can own it
+    struct fwiLogRing* ring = atomic_load_explicit(&frameworkState_s.logRings,
+                                                   memory_order_acquire);
+    for (; ring != nullptr; ring = ring->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&ring->owned, &expected, true)) {
+            break;
+        }
+    }
+
+    if (ring == nullptr) {
+        ring = aligned_alloc(alignof(struct fwiLogRing), sizeof(struct fwiLogRing));
+        if (ring == nullptr) {
+            return nullptr;
+        }
+        memset(ring, 0, sizeof(struct fwiLogRing));
+        atomic_store_explicit(&ring->owned, true, memory_order_relaxed);
+
+        struct fwiLogRing* head = atomic_load_explicit(&frameworkState_s.logRings,
+                                                       memory_order_relaxed);
+        do {
+            ring->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&frameworkState_s.logRings, &head, ring,
+                                                        memory_order_release,
+                                                        memory_order_relaxed));
+    }
+
+    ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+    pthread_setspecific(logRingKey_s, ring);
+    logRing_s = ring;
+    return ring;
+}
+
+/**
+ * @brief Reserves the next free record of the calling thread's ring.
+ * @return The record, or nullptr if the message has to be dropped
+ */
+static struct fwiLogRecord* fwiLogReserve(struct fwiLogRing* ring) {
+    const uint64_t head = atomic_load_explicit(&ring->head, memory_order_relaxed);
+
+    while (head - ring->cachedTail >= FWI_LOG_RING_CAPACITY) {
+        ring->cachedTail = atomic_load_explicit(&ring->tail, memory_order_acquire);
+        if (head - ring->cachedTail < FWI_LOG_RING_CAPACITY) {
+            break;
+        }
+
+        if (atomic_load_explicit(&frameworkState_s.logOverflowPolicy, memory_order_relaxed) ==
+            fwLogOverflowPolicyDrop ||
+            !atomic_load_explicit(&frameworkState_s.loggerIsUp, memory_order_acquire)) {
+            atomic_fetch_add_explicit(&ring->dropped, 1, memory_order_relaxed);
+            return nullptr;
+        }
+
+        pthread_cond_signal(&frameworkState_s.loggerWake);
+        sched_yield();
+    }
+
+    return &ring->records[head & (FWI_LOG_RING_CAPACITY - 1)];
+}
+
+static void fwiLogPublish(struct fwiLogRing* ring) {
+    atomic_store_explicit(&ring->head, atomic_load_explicit(&ring->head, memory_order_relaxed) + 1,
+                          memory_order_release);
+}
+
+static uint64_t fwiLogTimestamp(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+}
 
+const char* fwiLogLevelName(const fwiLogLevel lll) {
     switch (lll) {
         case fwiLogLevelError: {
-            printf("%s "FW_ESCAPE_RED"ERROR"FW_ESCAPE_NORMAL"]: ", buf);
-            break;
+            return "ERROR";
         }
         case fwiLogLevelWarning: {
-            printf("%s "FW_ESCAPE_YELLOW"WARNING"FW_ESCAPE_NORMAL"]: ", buf);
-            break;
+            return "WARNING";
         }
         case fwiLogLevelInfo: {
-            printf("%s "FW_ESCAPE_CYAN"INFO"FW_ESCAPE_NORMAL"]: ", buf);
-            break;
+            return "INFO";
         }
         case fwiLogLevelDebug: {
-            printf("%s "FW_ESCAPE_GREEN"DEBUG"FW_ESCAPE_NORMAL"]: ", buf);
-            break;
+            return "DEBUG";
+        }
+        case fwiLogLevelBench: {
+            return "BENCHMARK";
+        }
+        default: {
+            return "UNKNOWN";
+        }
+    }
+}
+
+#ifdef BUILD_DEBUG
+static const char* fwiLogLevelColor(const fwiLogLevel lll) {
+    switch (lll) {
+        case fwiLogLevelError: {
+            return FW_ESCAPE_RED;
+        }
+        case fwiLogLevelWarning: {
+            return FW_ESCAPE_YELLOW;
+        }
+        case fwiLogLevelInfo: {
+            return FW_ESCAPE_CYAN;
+        }
+        case fwiLogLevelDebug: {
+            return FW_ESCAPE_GREEN;
         }
         case fwiLogLevelBench: {
-            printf("%s "FW_ESCAPE_MAGENTA"BENCHMARK"FW_ESCAPE_NORMAL"]: ", buf);
+            return FW_ESCAPE_MAGENTA;
+        }
+        default: {
+            return FW_ESCAPE_NORMAL;
+        }
+    }
+}
+#endif // BUILD_DEBUG
+
+void fwiLogParseConversion(const char* spec_p, struct fwiLogConversion* conversion_p) {
+    const char* it = spec_p + 1;
+    conversion_p->stars = 0;
+    conversion_p->type  = fwiLogArgTypeUnsupported;
+
+    while (*it == '-' || *it == '+' || *it == ' ' || *it == '#' || *it == '0' || *it == '\'') {
+        it++;
+    }
+    if (*it == '*') {
+        conversion_p->stars++;
+        it++;
+    }
+    while (*it >= '0' && *it <= '9') {
+        it++;
+    }
+    if (*it == '.') {
+        it++;
+        if (*it == '*') {
+            conversion_p->stars++;
+            it++;
+        }
+        while (*it >= '0' && *it <= '9') {
+            it++;
+        }
+    }
+
+    uint8_t integer = fwiLogArgTypeInt;
+    bool wide = false, longDouble = false;
+    switch (*it) {
+        case 'h': {
+            it += it[1] == 'h' ? 2 : 1;
+            break;
+        }
+        case 'l': {
+            if (it[1] == 'l') {
+                integer = fwiLogArgTypeLongLong;
+                it += 2;
+            }
+            else {
+                integer = fwiLogArgTypeLong;
+                wide = true;
+                it++;
+            }
+            break;
+        }
+        case 'q': {
+            integer = fwiLogArgTypeLongLong;
+            it++;
+            break;
+        }
+        case 'j': {
+            integer = fwiLogArgTypeIntMax;
+            it++;
+            break;
+        }
+        case 'z': {
+            integer = fwiLogArgTypeSize;
+            it++;
+            break;
+        }
+        case 't': {
+            integer = fwiLogArgTypePtrDiff;
+            it++;
+            break;
+        }
+        case 'L': {
+            longDouble = true;
+            it++;
+            break;
+        }
+        default: {
             break;
         }
     }
 
-    va_list args = {0u};
-    va_start(args);
-    vprintf(format_p, args);
-    va_end(args);
-    printf("\n");
+    switch (*it) {
+        case 'd': case 'i': case 'o': case 'u': case 'x': case 'X': {
+            conversion_p->type = integer;
+            break;
+        }
+        case 'c': {
+            // wint_t and int are passed the same way
+            conversion_p->type = fwiLogArgTypeInt;
+            break;
+        }
+        case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A': {
+            conversion_p->type = longDouble ? fwiLogArgTypeLongDouble : fwiLogArgTypeDouble;
+            break;
+        }
+        case 'p': {
+            conversion_p->type = fwiLogArgTypePointer;
+            break;
+        }
+        case 's': {
+            conversion_p->type = wide ? fwiLogArgTypeUnsupported : fwiLogArgTypeString;
+            break;
+        }
+        case '%': {
+            conversion_p->type = fwiLogArgTypeNone;
+            break;
+        }
+        default: {
+            break;
+        }
+    }
+
+    conversion_p->length = *it == '\0' ? (uint8_t)(it - spec_p) : (uint8_t)(it - spec_p + 1);
+}
+
+/**
+ * @brief Copies the arguments of a message into the text of its record without formatting them.
+ * @return If the arguments could be captured, false if the message has to be formatted right away
+ */
+static bool fwiLogCaptureArguments(struct fwiLogRecord* record, const char* format_p,
+                                   va_list args) {
+    uint8_t* out = (uint8_t*)record->text;
+    size_t used = 0;
+
+#define FWI_CAPTURE(type) { \
+        const type value = va_arg(args, type); \
+        if (used + sizeof(type) > sizeof(record->text)) { return false; } \
+        memcpy(out + used, &value, sizeof(type)); \
+        used += sizeof(type); \
+    }
+
+    for (const char* it = format_p; *it != '\0'; it++) {
+        if (*it != '%') {
+            continue;
+        }
+
+        struct fwiLogConversion conversion;
+        fwiLogParseConversion(it, &conversion);
+        for (uint8_t i = 0; i < conversion.stars; i++) {
+            FWI_CAPTURE(int);
+        }
+
+        switch (conversion.type) {
+            case fwiLogArgTypeNone: {
+                break;
+            }
+            case fwiLogArgTypeInt: {
+                FWI_CAPTURE(int);
+                break;
+            }
+            case fwiLogArgTypeLong: {
+                FWI_CAPTURE(long);
+                break;
+            }
+            case fwiLogArgTypeLongLong: {
+                FWI_CAPTURE(long long);
+                break;
+            }
+            case fwiLogArgTypeIntMax: {
+                FWI_CAPTURE(intmax_t);
+                break;
+            }
+            case fwiLogArgTypeSize: {
+                FWI_CAPTURE(size_t);
+                break;
+            }
+            case fwiLogArgTypePtrDiff: {
+                FWI_CAPTURE(ptrdiff_t);
+                break;
+            }
+            case fwiLogArgTypeDouble: {
+                FWI_CAPTURE(double);
+                break;
+            }
+            case fwiLogArgTypeLongDouble: {
+                FWI_CAPTURE(long double);
+                break;
+            }
+            case fwiLogArgTypePointer: {
+                FWI_CAPTURE(void*);
+                break;
+            }
+            case fwiLogArgTypeString: {
+                const char* string = va_arg(args, const char*);
+                if (string == nullptr) {
+                    string = "(null)";
+                }
+                const size_t length = strlen(string);
+                if (used + sizeof(uint16_t) + length > sizeof(record->text)) {
+                    return false;
+                }
+                const uint16_t shortLength = (uint16_t)length;
+                memcpy(out + used, &shortLength, sizeof(uint16_t));
+                memcpy(out + used + sizeof(uint16_t), string, length);
+                used += sizeof(uint16_t) + length;
+                break;
+            }
+            default: {
+                return false;
+            }
+        }
+
+        it += conversion.length - 1;
+        if (*it == '\0') {
+            break;
+        }
+    }
+
+#undef FWI_CAPTURE
+
+    record->format_p = format_p;
+    record->length   = (uint16_t)used;
+    return true;
+}
+
+size_t fwiLogFormatBinary(char* buffer_p, const size_t size, const char* format_p,
+                          const uint8_t* arguments_p, const size_t argumentsLength) {
+    size_t written = 0, consumed = 0;
+
+#define FWI_APPEND(...) { \
+        const int32_t length = snprintf(buffer_p + written, size - written, __VA_ARGS__); \
+        if (length > 0) { \
+            written += (size_t)length < size - written ? (size_t)length : size - written - 1; \
+        } \
+    }
+#define FWI_REPLAY(type) { \
+        type value; \
+        if (consumed + sizeof(type) > argumentsLength) { goto truncated; } \
+        memcpy(&value, arguments_p + consumed, sizeof(type)); \
+        consumed += sizeof(type); \
+        FWI_APPEND(spec, value); \
+    }
+
+    if (size == 0) {
+        return 0;
+    }
+    buffer_p[0] = '\0';
+
+    for (const char* it = format_p; *it != '\0' && written + 1 < size; it++) {
+        if (*it != '%') {
+            buffer_p[written++] = *it;
+            buffer_p[written] = '\0';
+            continue;
+        }
+
+        struct fwiLogConversion conversion;
+        fwiLogParseConversion(it, &conversion);
+        if (conversion.type == fwiLogArgTypeNone) {
+            buffer_p[written++] = '%';
+            buffer_p[written] = '\0';
+            it += conversion.length - 1;
+            continue;
+        }
+
+        // Rebuild the specification with the '*' fields replaced by their captured values, this
+        // way every conversion is a single snprintf call with exactly one argument
+        char spec[64];
+        size_t specLength = 0;
+        bool precision = false;
+        for (uint8_t i = 0; i < conversion.length && specLength + 12 < sizeof(spec); i++) {
+            if (it[i] == '.') {
+                precision = true;
+            }
+            if (it[i] != '*') {
+                spec[specLength++] = it[i];
+                continue;
+            }
+
+            int32_t value = 0;
+            if (consumed + sizeof(int32_t) > argumentsLength) {
+                goto truncated;
+            }
+            memcpy(&value, arguments_p + consumed, sizeof(int32_t));
+            consumed += sizeof(int32_t);
+            if (precision && value < 0) {
+                // A negative precision is taken as if it was omitted
+                specLength--;
+                continue;
+            }
+            specLength += (size_t)sprintf(spec + specLength, "%d", value);
+        }
+        spec[specLength] = '\0';
+
+        switch (conversion.type) {
+            case fwiLogArgTypeInt: {
+                FWI_REPLAY(int);
+                break;
+            }
+            case fwiLogArgTypeLong: {
+                FWI_REPLAY(long);
+                break;
+            }
+            case fwiLogArgTypeLongLong: {
+                FWI_REPLAY(long long);
+                break;
+            }
+            case fwiLogArgTypeIntMax: {
+                FWI_REPLAY(intmax_t);
+                break;
+            }
+            case fwiLogArgTypeSize: {
+                FWI_REPLAY(size_t);
+                break;
+            }
+            case fwiLogArgTypePtrDiff: {
+                FWI_REPLAY(ptrdiff_t);
+                break;
+            }
+            case fwiLogArgTypeDouble: {
+                FWI_REPLAY(double);
+                break;
+            }
+            case fwiLogArgTypeLongDouble: {
+                FWI_REPLAY(long double);
+                break;
+            }
+            case fwiLogArgTypePointer: {
+                FWI_REPLAY(void*);
+                break;
+            }
+            case fwiLogArgTypeString: {
+                uint16_t length = 0;
+                if (consumed + sizeof(uint16_t) > argumentsLength) {
+                    goto truncated;
+                }
+                memcpy(&length, arguments_p + consumed, sizeof(uint16_t));
+                consumed += sizeof(uint16_t);
+                if (consumed + length > argumentsLength) {
+                    goto truncated;
+                }
+
+                // The length comes from the record, which the decoder reads from a file that may be
+                // corrupt, a longer string than a record can hold is cut
+                char string[FWI_LOG_RECORD_SIZE];
+                const uint16_t copied = length < sizeof(string) - 1 ? length : sizeof(string) - 1;
+                memcpy(string, arguments_p + consumed, copied);
+                string[copied] = '\0';
+                consumed += length;
+                FWI_APPEND(spec, string);
+                break;
+            }
+            default: {
+                goto truncated;
+            }
+        }
+
+        it += conversion.length - 1;
+        if (*it == '\0') {
+            break;
+        }
+    }
+
+#undef FWI_REPLAY
+#undef FWI_APPEND
+
+    return written;
+
+truncated:
+    // Arguments do not match the format string, output what could be reconstructed
+    return written;
+}
+
+/**
+ * @brief Returns the text of a record, formatting it first if it was logged in binary mode.
+ */
+static const char* fwiLogRecordText(const struct fwiLogRecord* record, char* buffer_p,
+                                    const size_t size, uint16_t* length_p) {
+    if (record->format_p == nullptr) {
+        *length_p = record->length;
+        return record->text;
+    }
+
+    *length_p = (uint16_t)fwiLogFormatBinary(buffer_p, size, record->format_p,
+                                             (const uint8_t*)record->text, record->length);
+    return buffer_p;
+}
 
-    pthread_mutex_unlock(&frameworkState_s.loggerMutex);
-#endif // BUILD_DEBUG
 #ifdef BUILD_RELEASE
-    // TODO: implement logging to file
-#endif // BUILD_RELEASE
+/**
+ * @brief Format strings that were already written to the current binary log segment, every
+ *        segment has to be decodable on its own.
+ */
+#define FWI_LOG_FORMAT_TABLE_SIZE 4096
+static const char* logFormats_s[FWI_LOG_FORMAT_TABLE_SIZE];
+static uint32_t logFormatCount_s = 0;
+static uint32_t logFormatSegment_s = UINT32_MAX;
+
+/**
+ * @brief Remembers a format string for the current segment.
+ * @return If the format string is new to the segment
+ */
+static bool fwiLogRememberFormat(const char* format_p) {
+    if (logFormatCount_s >= FWI_LOG_FORMAT_TABLE_SIZE / 4 * 3) {
+        // Forgetting formats only costs repeated format entries in the file
+        memset(logFormats_s, 0, sizeof(logFormats_s));
+        logFormatCount_s = 0;
+    }
+
+    uint32_t slot = (uint32_t)(((uintptr_t)format_p >> 3) * 0x9E37'79B9u) &
+                    (FWI_LOG_FORMAT_TABLE_SIZE - 1);
+    while (logFormats_s[slot] != nullptr) {
+        if (logFormats_s[slot] == format_p) {
+            return false;
+        }
+        slot = (slot + 1) & (FWI_LOG_FORMAT_TABLE_SIZE - 1);
+    }
+
+    logFormats_s[slot] = format_p;
+    logFormatCount_s++;
+    return true;
 }
 
-void fwiLogW(const fwiLogLevel lll, const wchar_t* format_p, ...) {
-#ifdef BUILD_DEBUG
-    const time_t rawTime  = time(nullptr);
-    const struct tm* time = localtime(&rawTime);
+/**
+ * @brief Writes a record to a binary log segment, preceded by its format string if the segment
+ *        does not contain it yet.
+ */
+static void fwiLogEmitBinary(const struct fwiLogRecord* record) {
+    uint8_t entry[2 * sizeof(struct fwiLogEntryHeader) + 2 * FWI_LOG_RECORD_SIZE];
+    size_t size = 0;
 
-    char buf[10]              = {};
-    const size_t bytesWritten = strftime(buf, 30, "[%H:%M:%S", time);
-    if (bytesWritten == 0) {
-        printf("Failed to get local time");
+    size_t formatLength = 0;
+    if (record->format_p != nullptr) {
+        formatLength = strnlen(record->format_p, FWI_LOG_RECORD_SIZE);
+    }
+
+    const size_t worstCase = 2 * sizeof(struct fwiLogEntryHeader) + formatLength + record->length;
+    const uint32_t segment = fwiLogFilePrepare(worstCase, true);
+    if (segment == UINT32_MAX) {
         return;
     }
+    if (segment != logFormatSegment_s) {
+        memset(logFormats_s, 0, sizeof(logFormats_s));
+        logFormatCount_s = 0;
+        logFormatSegment_s = segment;
+    }
 
-    pthread_mutex_lock(&frameworkState_s.loggerMutex);
+    if (record->format_p != nullptr && fwiLogRememberFormat(record->format_p)) {
+        struct fwiLogEntryHeader header = {};
+        header.type     = fwiLogEntryTypeFormat;
+        header.formatId = (uintptr_t)record->format_p;
+        header.length   = (uint16_t)formatLength;
+        memcpy(entry, &header, sizeof(header));
+        memcpy(entry + sizeof(header), record->format_p, formatLength);
+        size += sizeof(header) + formatLength;
+    }
 
-    switch (lll) {
-        case fwiLogLevelError: {
-            printf("%s ERROR]: ", buf);
+    struct fwiLogEntryHeader header = {};
+    header.type      = record->format_p != nullptr ? fwiLogEntryTypeMessage : fwiLogEntryTypeText;
+    header.timestamp = record->timestamp;
+    header.formatId  = (uintptr_t)record->format_p;
+    header.length    = record->length;
+    header.level     = record->level;
+    header.kind      = record->kind;
+    memcpy(entry + size, &header, sizeof(header));
+    memcpy(entry + size + sizeof(header), record->text, record->length);
+    size += sizeof(header) + record->length;
+
+    fwiLogFileWrite(entry, size);
+}
+#endif // BUILD_RELEASE
+
+/**
+ * @brief Turns records into their textual representation and hands them to the log sink.
+ * @note Must be called with the logger mutex held.
+ */
+static void fwiLogEmit(const struct fwiLogRecord* record) {
+    // Formatting the time is only done once per second instead of once per message
+    static time_t lastSecond_s = -1;
+    static char timeBuffer_s[10] = {};
+
+    if (record->kind == fwiLogRecordKindMessage) {
+        const time_t second = (time_t)(record->timestamp / 1'000'000'000);
+        if (second != lastSecond_s) {
+            struct tm time;
+            localtime_r(&second, &time);
+            if (strftime(timeBuffer_s, sizeof(timeBuffer_s), "[%H:%M:%S", &time) == 0) {
+                memcpy(timeBuffer_s, "[??:??:??", sizeof(timeBuffer_s));
+            }
+            lastSecond_s = second;
+        }
+    }
+
+#ifdef BUILD_RELEASE
+    if (atomic_load_explicit(&frameworkState_s.logMode, memory_order_relaxed) ==
+        fwLogModeBinary) {
+        fwiLogEmitBinary(record);
+        return;
+    }
+#endif // BUILD_RELEASE
+
+    char formatted[FWI_LOG_RECORD_SIZE];
+    uint16_t textLength = 0;
+    const char* text = fwiLogRecordText(record, formatted, sizeof(formatted), &textLength);
+
+#ifdef BUILD_DEBUG
+    switch (record->kind) {
+        case fwiLogRecordKindMessage: {
+            printf("%s %s%s"FW_ESCAPE_NORMAL"]: %.*s\n", timeBuffer_s,
+                   fwiLogLevelColor(record->level), fwiLogLevelName(record->level), textLength,
+                   text);
             break;
         }
-        case fwiLogLevelWarning: {
-            printf("%s WARNING]: ", buf);
+        case fwiLogRecordKindFollowup: {
+            printf("| - %.*s\n", textLength, text);
             break;
         }
-        case fwiLogLevelInfo: {
-            printf("%s INFO]: ", buf);
+        case fwiLogRecordKindFollowupLast: {
+            printf("\\ - %.*s\n", textLength, text);
             break;
         }
-        case fwiLogLevelDebug: {
-            printf("%s DEBUG]: ", buf);
+        default: {
             break;
         }
-        case fwiLogLevelBench: {
-            printf("%s BENCHMARK]: ", buf);
+    }
+#endif // BUILD_DEBUG
+#ifdef BUILD_RELEASE
+    char line[FWI_LOG_RECORD_SIZE + 32];
+    int32_t length = 0;
+
+    switch (record->kind) {
+        case fwiLogRecordKindMessage: {
+            length = snprintf(line, sizeof(line), "%s %s]: %.*s\n", timeBuffer_s,
+                              fwiLogLevelName(record->level), textLength, text);
+            break;
+        }
+        case fwiLogRecordKindFollowup: {
+            length = snprintf(line, sizeof(line), "| - %.*s\n", textLength, text);
+            break;
+        }
+        case fwiLogRecordKindFollowupLast: {
+            length = snprintf(line, sizeof(line), "\\ - %.*s\n", textLength, text);
+            break;
+        }
+        default: {
             break;
         }
     }
 
-    va_list args = {0u};
-    va_start(args);
-    vwprintf(format_p, args);
-    va_end(args);
-    printf("\n");
+    if (length > 0) {
+        const size_t size = length < (int32_t)sizeof(line) ? (size_t)length : sizeof(line) - 1;
+        if (fwiLogFilePrepare(size, false) != UINT32_MAX) {
+            fwiLogFileWrite(line, size);
+        }
+    }
+#endif // BUILD_RELEASE
+}
 
-    pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+/**
+ * @brief Pushes everything emitted so far towards its destination.
+ * @param force[in] Ignore the sync interval of the file sink and sync right away
+ * @note Must be called with the logger mutex held.
+ */
+static void fwiLogFlushSink(const bool force) {
+#ifdef BUILD_DEBUG
+    (void)force;
+    fflush(stdout);
 #endif // BUILD_DEBUG
 #ifdef BUILD_RELEASE
-    // TODO: implement logging to file
+    fwiLogFileSync(force);
 #endif // BUILD_RELEASE
 }
 
-void fwiLogFollowupA(const bool isLast, const char* format_p, ...) {
-#ifdef BUILD_DEBUG
-    va_list args = {0u};
-    va_start(args);
-    if (isLast) {
-        printf("\\ - ");
-        vprintf(format_p, args);
-        printf("\n");
+/**
+ * @brief Writes a record out directly, used when the flusher is not running.
+ */
+static void fwiLogEmitSynchronous(const struct fwiLogRecord* record) {
+    pthread_mutex_lock(&frameworkState_s.loggerMutex);
+    fwiLogEmit(record);
+    fwiLogFlushSink(false);
+    pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+}
+
+/**
+ * @brief Drains every ring once, merging the records of all threads by their timestamp.
+ * @return Number of records that were written
+ */
+static uint64_t fwiLogDrain(void) {
+    struct fwiLogRing* rings[64];
+    uint64_t heads[64];
+    uint64_t tails[64];
+    uint64_t written = 0;
+    uint64_t dropped = 0;
+
+    struct fwiLogRing* ring = atomic_load_explicit(&frameworkState_s.logRings,
+                                                   memory_order_acquire);
+    while (ring != nullptr) {
+        // Snapshot a bounded number of rings per pass, the rest is picked up by the next pass
+        uint32_t count = 0;
+        for (; ring != nullptr && count < 64; ring = ring->next) {
+            tails[count] = atomic_load_explicit(&ring->tail, memory_order_relaxed);
+            heads[count] = atomic_load_explicit(&ring->head, memory_order_acquire);
+
+            dropped += atomic_exchange_explicit(&ring->dropped, 0, memory_order_relaxed);
+
+            if (heads[count] != tails[count]) {
+                rings[count++] = ring;
+            }
+        }
+
+        pthread_mutex_lock(&frameworkState_s.loggerMutex);
+        for (;;) {
+            uint32_t oldest = UINT32_MAX;
+            for (uint32_t i = 0; i < count; i++) {
+                if (tails[i] == heads[i]) {
+                    continue;
+                }
+                const struct fwiLogRecord* record =
+                    &rings[i]->records[tails[i] & (FWI_LOG_RING_CAPACITY - 1)];
+                if (oldest == UINT32_MAX || record->timestamp <
+                    rings[oldest]->records[tails[oldest] & (FWI_LOG_RING_CAPACITY - 1)].timestamp) {
+                    oldest = i;
+                }
+            }
+            if (oldest == UINT32_MAX) {
+                break;
+            }
+
+            // Follow-ups stay glued to the message they belong to
+            do {
+                fwiLogEmit(&rings[oldest]->records[tails[oldest] & (FWI_LOG_RING_CAPACITY - 1)]);
+                tails[oldest]++;
+                written++;
+            } while (tails[oldest] != heads[oldest] &&
+                     rings[oldest]->records[tails[oldest] & (FWI_LOG_RING_CAPACITY - 1)].kind !=
+                     fwiLogRecordKindMessage);
+        }
+        fwiLogFlushSink(false);
+        pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+
+        for (uint32_t i = 0; i < count; i++) {
+            atomic_store_explicit(&rings[i]->tail, tails[i], memory_order_release);
+        }
     }
-    else {
-        printf("| - ");
-        vprintf(format_p, args);
-        printf("\n");
+
+    if (dropped != 0) {
+        atomic_fetch_add_explicit(&frameworkState_s.logDropped, dropped, memory_order_relaxed);
+
+        struct fwiLogRecord notice = {};
+        notice.timestamp = fwiLogTimestamp();
+        notice.kind      = fwiLogRecordKindMessage;
+        notice.level     = fwiLogLevelWarning;
+        notice.length    = (uint16_t)snprintf(notice.text, sizeof(notice.text),
+                                              "%lu log messages were dropped",
+                                              (unsigned long)dropped);
+        pthread_mutex_lock(&frameworkState_s.loggerMutex);
+        fwiLogEmit(&notice);
+        pthread_mutex_unlock(&frameworkState_s.loggerMutex);
     }
-    va_end(args);
-#endif // BUILD_DEBUG
+
+    return written;
+}
+
+static void* fwiLoggerThread(void* unused_p) {
+    (void)unused_p;
+
+    while (atomic_load_explicit(&frameworkState_s.loggerIsUp, memory_order_acquire)) {
+        if (fwiLogDrain() != 0) {
+            continue;
+        }
+
+        // Let the sink sync or rotate even when nothing is being logged
+        pthread_mutex_lock(&frameworkState_s.loggerMutex);
+        fwiLogFlushSink(false);
+        pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+
+        // Nothing to do, sleep for a millisecond or until a blocked caller wakes us up
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 1'000'000;
+        if (deadline.tv_nsec >= 1'000'000'000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1'000'000'000;
+        }
+        pthread_mutex_lock(&frameworkState_s.loggerMutex);
+        pthread_cond_timedwait(&frameworkState_s.loggerWake, &frameworkState_s.loggerMutex,
+                               &deadline);
+        pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+    }
+
+    fwiLogDrain();
+
+    pthread_mutex_lock(&frameworkState_s.loggerMutex);
+    fwiLogFlushSink(true);
 #ifdef BUILD_RELEASE
-    //TODO: implement follow-up logging to file
+    fwiLogFileClose();
 #endif // BUILD_RELEASE
+    pthread_mutex_unlock(&frameworkState_s.loggerMutex);
+    return nullptr;
 }
 
-void fwiLogFollowupW(const bool isLast, const wchar_t* format_p, ...) {
-#ifdef BUILD_DEBUG
+fwError fwiStartLogger(void) {
+    if (atomic_load(&frameworkState_s.loggerIsUp)) {
+        return fwErrorSuccess;
+    }
+
+    atomic_store(&frameworkState_s.loggerIsUp, true);
+    if (pthread_create(&frameworkState_s.loggerThread, nullptr, fwiLoggerThread, nullptr)) {
+        atomic_store(&frameworkState_s.loggerIsUp, false);
+        return fwErrorOutOfMemory;
+    }
+
+    return fwErrorSuccess;
+}
+
+fwError fwiStopLogger(void) {
+    if (!atomic_exchange(&frameworkState_s.loggerIsUp, false)) {
+        return fwErrorSuccess;
+    }
+
+    pthread_cond_signal(&frameworkState_s.loggerWake);
+    pthread_join(frameworkState_s.loggerThread, nullptr);
+
+    return fwErrorSuccess;
+}
+
+/**
+ * @brief Places a formatted record into the calling thread's ring, or writes it out right away
+ *        when the logger is not running.
+ */
+static void fwiLogCommit(struct fwiLogRing* ring, struct fwiLogRecord* record) {
+    if (ring != nullptr && atomic_load_explicit(&frameworkState_s.loggerIsUp,
+                                                memory_order_relaxed)) {
+        fwiLogPublish(ring);
+    }
+    else {
+        fwiLogEmitSynchronous(record);
+    }
+}
+
+/**
+ * @brief Picks the record a message is formatted into.
+ * @param fallback_p[in] Record on the caller's stack, used when the logger is not running
+ * @return The record to use, nullptr if the message is dropped
+ */
+static struct fwiLogRecord* fwiLogBegin(struct fwiLogRing** ring_pp,
+                                        struct fwiLogRecord* fallback_p) {
+    if (!atomic_load_explicit(&frameworkState_s.loggerIsUp, memory_order_relaxed) ||
+        (*ring_pp = fwiAcquireLogRing()) == nullptr) {
+        *ring_pp = nullptr;
+        return fallback_p;
+    }
+    return fwiLogReserve(*ring_pp);
+}
+
+static void fwiLogFormatA(struct fwiLogRecord* record, const struct fwiLogRing* ring,
+                          const char* format_p, va_list args) {
+    // Formatting can only be deferred when the record goes through the flusher
+    if (ring != nullptr && atomic_load_explicit(&frameworkState_s.logMode, memory_order_relaxed) ==
+        fwLogModeBinary) {
+        va_list capture;
+        va_copy(capture, args);
+        const bool captured = fwiLogCaptureArguments(record, format_p, capture);
+        va_end(capture);
+        if (captured) {
+            return;
+        }
+    }
+
+    record->format_p = nullptr;
+    const int32_t length = vsnprintf(record->text, sizeof(record->text), format_p, args);
+    if (length < 0) {
+        record->length = 0;
+    }
+    else {
+        record->length = length < (int32_t)sizeof(record->text) ?
+                         (uint16_t)length : (uint16_t)(sizeof(record->text) - 1);
+    }
+}
+
+static void fwiLogFormatW(struct fwiLogRecord* record, const wchar_t* format_p, va_list args) {
+    record->format_p = nullptr;
+
+    wchar_t wide[sizeof(record->text)];
+    if (vswprintf(wide, sizeof(wide) / sizeof(wchar_t), format_p, args) < 0) {
+        // vswprintf fails on truncation, keep what made it into the buffer
+        wide[sizeof(wide) / sizeof(wchar_t) - 1] = L'\0';
+    }
+
+    const size_t length = wcstombs(record->text, wide, sizeof(record->text) - 1);
+    record->length = length == (size_t)-1 ? 0 : (uint16_t)length;
+}
+
+void fwiLogA(const fwiLogLevel lll, const char* format_p,  ...) {
+    struct fwiLogRing* ring;
+    struct fwiLogRecord fallback;
+    struct fwiLogRecord* record = fwiLogBegin(&ring, &fallback);
+    if (record == nullptr) {
+        return;
+    }
+
+    record->timestamp = fwiLogTimestamp();
+    record->kind      = fwiLogRecordKindMessage;
+    record->level     = lll;
+
     va_list args = {0u};
     va_start(args);
-    if (isLast) {
-        wprintf(L"\\ - ");
-        vwprintf(format_p, args);
-        wprintf(L"\n");
+    fwiLogFormatA(record, ring, format_p, args);
+    va_end(args);
+
+    fwiLogCommit(ring, record);
+}
+
+void fwiLogW(const fwiLogLevel lll, const wchar_t* format_p, ...) {
+    struct fwiLogRing* ring;
+    struct fwiLogRecord fallback;
+    struct fwiLogRecord* record = fwiLogBegin(&ring, &fallback);
+    if (record == nullptr) {
+        return;
     }
-    else {
-        wprintf(L"| - ");
-        vwprintf(format_p, args);
-        wprintf(L"\n");
+
+    record->timestamp = fwiLogTimestamp();
+    record->kind      = fwiLogRecordKindMessage;
+    record->level     = lll;
+
+    va_list args = {0u};
+    va_start(args);
+    fwiLogFormatW(record, format_p, args);
+    va_end(args);
+
+    fwiLogCommit(ring, record);
+}
+
+void fwiLogFollowupA(const bool isLast, const char* format_p, ...) {
+    struct fwiLogRing* ring;
+    struct fwiLogRecord fallback;
+    struct fwiLogRecord* record = fwiLogBegin(&ring, &fallback);
+    if (record == nullptr) {
+        return;
     }
+
+    record->timestamp = fwiLogTimestamp();
+    record->kind      = isLast ? fwiLogRecordKindFollowupLast : fwiLogRecordKindFollowup;
+
+    va_list args = {0u};
+    va_start(args);
+    fwiLogFormatA(record, ring, format_p, args);
     va_end(args);
-#endif // BUILD_DEBUG
-#ifdef BUILD_RELEASE
-    //TODO: implement follow-up logging to file
-#endif // BUILD_RELEASE
+
+    fwiLogCommit(ring, record);
+}
+
+void fwiLogFollowupW(const bool isLast, const wchar_t* format_p, ...) {
+    struct fwiLogRing* ring;
+    struct fwiLogRecord fallback;
+    struct fwiLogRecord* record = fwiLogBegin(&ring, &fallback);
+    if (record == nullptr) {
+        return;
+    }
+
+    record->timestamp = fwiLogTimestamp();
+    record->kind      = isLast ? fwiLogRecordKindFollowupLast : fwiLogRecordKindFollowup;
+
+    va_list args = {0u};
+    va_start(args);
+    fwiLogFormatW(record, format_p, args);
+    va_end(args);
+
+    fwiLogCommit(ring, record);
 }
 
 fwError fwiStartNativeModuleBase(void) {
-    pthread_mutex_init(&frameworkState_s.loggerMutex, nullptr);
+    if (fwiStartLogger() != fwErrorSuccess) {
+        FWI_LOG_A(fwiLogDomainBase, fwiLogLevelWarning,
+                  "Failed to start the logging thread, logging synchronously");
+    }
 
     const time_t rawTime        = time(nullptr);
-    const struct tm* time       = localtime(&rawTime);
+    struct tm time;
+    localtime_r(&rawTime, &time);
     char buf[14]                = {};
-    const size_t bytesWritten   = strftime(buf, 14, "%d.%m.%Y", time);
+    const size_t bytesWritten   = strftime(buf, 14, "%d.%m.%Y", &time);
     if (bytesWritten == 0) {
-        fwiLogA(fwiLogLevelError, "Failed to get local time");
+        FWI_LOG_A(fwiLogDomainBase, fwiLogLevelError, "Failed to get local time");
     }
 
     fwiGetState()->baseIsUp = true;
 
-    fwiLogA(fwiLogLevelInfo, "Base module was started");
-    fwiLogA(fwiLogLevelInfo, "The current date is %s (D.M.Y)", buf);
+    FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo, "Base module was started");
+    FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo, "The current date is %s (D.M.Y)", buf);
 
     return fwErrorSuccess;
 }
 
 fwError fwiStopNativeModuleBase(void) {
     fwiGetState()->baseIsUp = false;
-    fwiLogA(fwiLogLevelInfo, "Base module was stopped");
-    pthread_mutex_destroy(&frameworkState_s.loggerMutex);
+    FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo, "Base module was stopped");
+    fwiStopLogger();
 
     return fwErrorSuccess;
 }
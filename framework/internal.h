@@ -18,6 +18,7 @@
 #define LPAF_INTERNAL_H
 
 #include <pthread.h>
+#include <stdatomic.h>
 #include <stdint.h>
 #include <wchar.h>
 
@@ -43,26 +44,373 @@
 #define FW_ESCAPE_CLEAR     "\x1B[2J" // clear entire screen
 
 typedef enum fwiLogLevel : uint8_t {
-    fwiLogLevelError,
-    fwiLogLevelWarning,
-    fwiLogLevelInfo,
-    fwiLogLevelDebug,
-    fwiLogLevelBench /*! Runtime benchmarking */
+    fwiLogLevelError = fwLogLevelError,
+    fwiLogLevelWarning = fwLogLevelWarning,
+    fwiLogLevelInfo = fwLogLevelInfo,
+    fwiLogLevelDebug = fwLogLevelDebug,
+    fwiLogLevelBench = fwLogLevelBench /*! Runtime benchmarking */
 } fwiLogLevel;
 
+/**
+ * @brief Part of the framework a message originates from, each has its own runtime threshold.
+ */
+typedef enum fwiLogDomain : uint8_t {
+    fwiLogDomainBase,
+    fwiLogDomainWindow,
+    fwiLogDomainRender,
+    fwiLogDomainNetwork,
+    fwiLogDomainMultimedia,
+    fwiLogDomainCount
+} fwiLogDomain;
+
+/**
+ * @brief Most verbose log level that is compiled in, set through the LPAF_LOG_LEVEL CMake option.
+ */
+#ifndef FWI_LOG_COMPILE_LEVEL
+#define FWI_LOG_COMPILE_LEVEL fwiLogLevelBench
+#endif
+
+/**
+ * @brief Checks if a message of the given level and domain would be logged. The compile time part
+ *        is constant folded, the runtime part is a single relaxed load.
+ */
+#define FWI_LOG_ENABLED(domain, lll) \
+    ((lll) <= FWI_LOG_COMPILE_LEVEL && \
+     (lll) < atomic_load_explicit(&frameworkState_s.logThresholds[domain], \
+                                  memory_order_relaxed) + 1)
+
+/**
+ * @brief Filtered front ends of the fwiLog functions, the arguments are only evaluated if the
+ *        message passes the filter.
+ */
+#define FWI_LOG_A(domain, lll, ...) do { \
+        if (FWI_LOG_ENABLED(domain, lll)) { fwiLogA(lll, __VA_ARGS__); } \
+    } while (0)
+#define FWI_LOG_W(domain, lll, ...) do { \
+        if (FWI_LOG_ENABLED(domain, lll)) { fwiLogW(lll, __VA_ARGS__); } \
+    } while (0)
+#define FWI_LOG_FOLLOWUP_A(domain, lll, isLast, ...) do { \
+        if (FWI_LOG_ENABLED(domain, lll)) { fwiLogFollowupA(isLast, __VA_ARGS__); } \
+    } while (0)
+#define FWI_LOG_FOLLOWUP_W(domain, lll, isLast, ...) do { \
+        if (FWI_LOG_ENABLED(domain, lll)) { fwiLogFollowupW(isLast, __VA_ARGS__); } \
+    } while (0)
+
+/**
+ * @brief Number of records each per-thread log ring can hold, must be a power of two
+ */
+#define FWI_LOG_RING_CAPACITY 512
+
+/**
+ * @brief Size of a single log record in bytes, messages longer than the text portion are truncated
+ */
+#define FWI_LOG_RECORD_SIZE 256
+
+typedef enum fwiLogRecordKind : uint8_t {
+    fwiLogRecordKindMessage /*! Regular message with timestamp and log level */,
+    fwiLogRecordKindFollowup /*! Continuation of the previous message of the same thread */,
+    fwiLogRecordKindFollowupLast /*! Last continuation of the previous message */
+} fwiLogRecordKind;
+
+/**
+ * @brief A single log message waiting to be written out by the flusher.
+ * @note If @c format_p is set, the message has not been formatted yet and @c text contains the
+ *       raw arguments as captured by @c fwiLogCaptureArguments .
+ */
+struct fwiLogRecord {
+    uint64_t timestamp; // Nanoseconds since the epoch
+    const char* format_p;
+    uint16_t length;
+    uint8_t kind;
+    uint8_t level;
+    char text[FWI_LOG_RECORD_SIZE - 20];
+};
+
+/**
+ * @brief Identifies a binary log file, followed by eight reserved bytes.
+ */
+#define FWI_LOG_BINARY_MAGIC "LPAFBLG1"
+
+typedef enum fwiLogEntryType : uint8_t {
+    fwiLogEntryTypeFormat = 1 /*! Format string, the payload is the string without terminator */,
+    fwiLogEntryTypeMessage /*! Unformatted message, the payload contains the raw arguments */,
+    fwiLogEntryTypeText /*! Already formatted message, the payload is the text */
+} fwiLogEntryType;
+
+/**
+ * @brief Header preceding every entry of a binary log file.
+ * @param timestamp Nanoseconds since the epoch, unused for format entries
+ * @param formatId Address of the format string in the process that wrote the log
+ * @param length Size of the payload following the header in bytes
+ * @note Binary logs are written in the native byte order and can only be decoded on a machine of
+ *       the same architecture.
+ */
+struct fwiLogEntryHeader {
+    uint64_t timestamp;
+    uint64_t formatId;
+    uint16_t length;
+    uint8_t type;
+    uint8_t level;
+    uint8_t kind;
+    uint8_t reserved[3];
+};
+
+typedef enum fwiLogArgType : uint8_t {
+    fwiLogArgTypeNone /*! Conversion without argument, like %% */,
+    fwiLogArgTypeInt,
+    fwiLogArgTypeLong,
+    fwiLogArgTypeLongLong,
+    fwiLogArgTypeIntMax,
+    fwiLogArgTypeSize,
+    fwiLogArgTypePtrDiff,
+    fwiLogArgTypeDouble,
+    fwiLogArgTypeLongDouble,
+    fwiLogArgTypePointer,
+    fwiLogArgTypeString /*! Stored as 16 bit length followed by the characters */,
+    fwiLogArgTypeUnsupported /*! Conversion that can not be deferred, like %n or %ls */
+} fwiLogArgType;
+
+/**
+ * @brief Result of parsing a single printf conversion specification.
+ * @param length Number of characters in the specification, including the percent sign
+ * @param stars Number of int arguments consumed by '*' width and precision fields
+ */
+struct fwiLogConversion {
+    uint8_t type;
+    uint8_t stars;
+    uint8_t length;
+};
+
+/**
+ * @brief Single-producer single-consumer ring of log records. Every thread that logs owns exactly
+ *        one ring, the background flusher is the only consumer of all of them.
+ * @note Rings are never freed, when a thread exits its ring is released and can be claimed by the
+ *       next thread that logs.
+ */
+struct fwiLogRing {
+    alignas(64) _Atomic uint64_t head; // Written by the owning thread only
+    alignas(64) _Atomic uint64_t tail; // Written by the flusher only
+    alignas(64) uint64_t cachedTail; // Owner-local copy of tail, avoids touching the flusher's line
+    _Atomic uint64_t dropped;
+    _Atomic bool owned;
+    struct fwiLogRing* next;
+    struct fwiLogRecord records[FWI_LOG_RING_CAPACITY];
+};
+
+/**
+ * @brief Number of sub-buckets per power of two in a histogram, sets its resolution
+ */
+#define FWI_HISTOGRAM_SUB_BUCKETS 8
+
+/**
+ * @brief Number of buckets in a histogram, values below 16 get a bucket each, above that every
+ *        power of two is split into @c FWI_HISTOGRAM_SUB_BUCKETS buckets
+ */
+#define FWI_HISTOGRAM_BUCKETS (16 + 60 * FWI_HISTOGRAM_SUB_BUCKETS)
+
+/**
+ * @brief Log-linear histogram of unsigned values.
+ */
+struct fwiHistogram {
+    _Atomic uint64_t count;
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+    _Atomic uint64_t buckets[FWI_HISTOGRAM_BUCKETS];
+};
+
+/**
+ * @brief Zones the framework measures itself, application zones are numbered after them.
+ */
+typedef enum fwiProfileZone : uint16_t {
+    fwiProfileZoneStartModule,
+    fwiProfileZoneLoadFile,
+    fwiProfileZoneMapFile,
+    fwiProfileZoneLoadFiles,
+    fwiProfileZoneWalkDirectory,
+    fwiProfileZoneSocketConnect,
+    fwiProfileZoneSocketAccept,
+    fwiProfileZoneSocketSend,
+    fwiProfileZoneSocketSendFile,
+    fwiProfileZoneSocketSendV,
+    fwiProfileZoneSocketReceive,
+    fwiProfileZoneSocketReceiveV,
+    fwiProfileZoneCount
+} fwiProfileZone;
+
+/**
+ * @brief Maximum number of profiling zones, including the framework's own.
+ */
+#define FWI_PROFILE_MAX_ZONES 256
+
+/**
+ * @brief Histograms of all zones that one thread has passed through, allocated on first use.
+ * @note Like log rings, these blocks are never freed and are adopted by new threads.
+ */
+struct fwiProfileThread {
+    struct fwiProfileThread* next;
+    _Atomic bool owned;
+    _Atomic(struct fwiHistogram*) zones[FWI_PROFILE_MAX_ZONES];
+};
+
+typedef enum fwiTraceType : uint8_t {
+    fwiTraceTypeZone /*! Pass through a profiling zone */,
+    fwiTraceTypeModuleStart,
+    fwiTraceTypeModuleStop,
+    fwiTraceTypeSocketCreate,
+    fwiTraceTypeSocketConnect,
+    fwiTraceTypeSocketAccept,
+    fwiTraceTypeSocketClose,
+    fwiTraceTypeSocketSend,
+    fwiTraceTypeSocketSendFile,
+    fwiTraceTypeSocketSendV,
+    fwiTraceTypeSocketReceive,
+    fwiTraceTypeSocketReceiveV,
+    fwiTraceTypeFileLoad,
+    fwiTraceTypeFileMap,
+    fwiTraceTypeCount
+} fwiTraceType;
+
+/**
+ * @brief A recorded event, times are in profiler ticks.
+ * @param object Module, socket or zone the event belongs to
+ * @param value Byte count or result of the call
+ */
+struct fwiTraceEvent {
+    uint64_t begin;
+    uint64_t end;
+    uint64_t object;
+    uint64_t value;
+    uint8_t type;
+};
+
+/**
+ * @brief Number of events per trace chunk and chunks per thread, events past that are dropped.
+ */
+#define FWI_TRACE_CHUNK_EVENTS 4096
+#define FWI_TRACE_MAX_CHUNKS 64
+
+struct fwiTraceChunk {
+    _Atomic(struct fwiTraceChunk*) next;
+    _Atomic uint32_t count; // Written by the owning thread, read by the exporter
+    struct fwiTraceEvent events[FWI_TRACE_CHUNK_EVENTS];
+};
+
+/**
+ * @brief Events recorded by one thread, adopted by new threads like log rings.
+ * @param first Chunks are kept across traces and only ever appended
+ * @param epoch Trace the recorded events belong to, the owner rewinds its chunks when it differs
+ */
+struct fwiTraceThread {
+    struct fwiTraceThread* next;
+    _Atomic(struct fwiTraceChunk*) first;
+    struct fwiTraceChunk* current;
+    _Atomic uint64_t dropped;
+    _Atomic uint32_t epoch;
+    uint32_t chunkCount;
+    uint32_t id;
+    _Atomic bool owned;
+};
+
+/**
+ * @brief Timestamp for the beginning of a traced call, zero when tracing is off.
+ */
+#define FWI_TRACE_BEGIN() \
+    (atomic_load_explicit(&frameworkState_s.tracingIsUp, memory_order_relaxed) ? \
+     fwiProfileTicks() : 0)
+
+/**
+ * @brief Traffic counters of a socket, or of the sockets used by one thread. Those of a socket are
+ *        written by any thread using it and updated atomically, those of a thread only by it.
+ */
+struct fwiSocketCounters {
+    _Atomic uint64_t bytes[2];
+    _Atomic uint64_t calls[2];
+    _Atomic uint64_t shortTransfers[2];
+    _Atomic uint64_t wouldBlock;
+    _Atomic uint64_t interrupted;
+    _Atomic uint64_t errors;
+};
+
+/**
+ * @brief Traffic of every socket one thread has sent or received on, summed over all threads when
+ *        read so that no two cores write the same counters.
+ * @param latency Histograms of send and receive call durations in profiler ticks
+ * @note Like log rings, these blocks are never freed and are adopted by new threads.
+ */
+struct fwiSocketThread {
+    struct fwiSocketThread* next;
+    _Atomic bool owned;
+    struct fwiSocketCounters counters;
+    struct fwiHistogram latency[2];
+};
+
+/**
+ * @brief Index into the per-direction fields of @c fwiSocketCounters .
+ */
+typedef enum fwiSocketDirection : uint8_t {
+    fwiSocketDirectionSend,
+    fwiSocketDirectionReceive
+} fwiSocketDirection;
+
 /**
  * @brief Do not instanciate
  */
 struct fwiState {
-    pthread_mutex_t loggerMutex;
+    pthread_mutex_t loggerMutex; // Serialises writes to the log sink, not taken by log callers
+    pthread_cond_t loggerWake; // Signaled by callers that are blocked on a full ring
+    pthread_t loggerThread;
+    _Atomic(struct fwiLogRing*) logRings;
+    _Atomic uint64_t logDropped;
+    _Atomic bool loggerIsUp;
+    _Atomic uint8_t logOverflowPolicy;
+    _Atomic uint8_t logMode;
+    _Atomic uint8_t logThresholds[fwiLogDomainCount];
+    _Atomic(struct fwiProfileThread*) profileThreads;
+    _Atomic uint16_t profileZoneCount;
+    _Atomic bool profilingIsUp;
+    _Atomic(struct fwiTraceThread*) traceThreads;
+    _Atomic uint32_t traceThreadCount;
+    _Atomic uint32_t traceEpoch;
+    uint64_t traceStart;
+    _Atomic bool tracingIsUp;
+    char traceFilename[256];
+    _Atomic(struct fwiSocketThread*) socketThreads; // Every socket ever used, even closed ones
+    _Atomic uint32_t openSockets;
+    _Atomic(const fwAllocator*) allocators[fwiLogDomainCount]; // nullptr selects malloc
+    char logDirectory[256];
+    uint64_t logSegmentSize;
+    uint32_t logRotationInterval;
+    uint32_t logSyncInterval;
     uint8_t activeModules;
     bool baseIsUp;
 };
 
+extern struct fwiState frameworkState_s;
+
 struct fwiState* fwiGetState(
     void
     );
 
+/**
+ * @brief Maps a module to the log domain of its messages.
+ * @return The domain, or @c fwiLogDomainCount if the module is not valid
+ */ // PlatIndepImp
+fwiLogDomain fwiLogDomainOf(
+    fwModule module
+    );
+
+/**
+ * @brief Allocates a buffer that is handed out to the caller of the framework, from the allocator
+ *        of the calling thread or of the domain. Released with @c fwFree .
+ * @param alignment[in] Power of two, at least 16 is used
+ * @return The buffer, nullptr when out of memory
+ */ // PlatIndepImp
+void* fwiAllocate(
+    fwiLogDomain domain,
+    uint64_t size,
+    uint64_t alignment
+    );
+
 // PlatIndepImp
 fwError fwiStartNativeModuleBase(
     void
@@ -113,11 +461,212 @@ fwError fwiStopNativeModuleRenderer(
     void
     );
 
+// PlatIndepImp
+fwError fwiStartLogger(
+    void
+    );
+
+// PlatIndepImp
+fwError fwiStopLogger(
+    void
+    );
+
+/**
+ * @brief Makes sure a log file segment of the right kind with enough room is open, starting a new
+ *        segment if needed.
+ * @param size[in] Number of bytes that are about to be written
+ * @param binary[in] If the segment has to be a binary log
+ * @return Sequence number of the segment, changes whenever a new segment was started, or
+ *         @c UINT32_MAX if no segment could be opened
+ * @note A record larger than a whole segment grows the current segment instead of starting one.
+ * @note Only called from the logger with the logger mutex held.
+ */ // PlatDepImp
+uint32_t fwiLogFilePrepare(
+    size_t size,
+    bool binary
+    );
+
+/**
+ * @brief Appends data to the current log file segment.
+ * @param data_p[in] Data to append
+ * @param size[in] Length of the data in bytes, must have been passed to @c fwiLogFilePrepare
+ * @note Only called from the logger with the logger mutex held.
+ */ // PlatDepImp
+void fwiLogFileWrite(
+    const void* data_p,
+    size_t size
+    );
+
+/**
+ * @brief Syncs the written part of the current segment to disk once the sync interval has passed
+ *        and rotates the segment once the rotation interval has passed.
+ * @param force[in] Sync regardless of the sync interval
+ */ // PlatDepImp
+void fwiLogFileSync(
+    bool force
+    );
+
+/**
+ * @brief Syncs, trims and closes the current log file segment.
+ */ // PlatDepImp
+void fwiLogFileClose(
+    void
+    );
+
+/**
+ * @brief Adds a value to a histogram that is only ever written by one thread.
+ */ // PlatIndepImp
+void fwiHistogramRecord(
+    struct fwiHistogram* histogram_p,
+    uint64_t value
+    );
+
+/**
+ * @brief Adds a value to a histogram that may be written by multiple threads at once.
+ */ // PlatIndepImp
+void fwiHistogramRecordShared(
+    struct fwiHistogram* histogram_p,
+    uint64_t value
+    );
+
+/**
+ * @brief Adds the contents of one histogram to another.
+ * @param into_p[in,out] Destination, must not be written concurrently
+ * @param from_p[in] Source, may be written concurrently
+ */ // PlatIndepImp
+void fwiHistogramMerge(
+    struct fwiHistogram* into_p,
+    const struct fwiHistogram* from_p
+    );
+
+/**
+ * @brief Estimates a percentile from a histogram.
+ * @param percentile[in] The percentile between 0 and 100
+ * @return Upper bound of the bucket the percentile falls into, never more than the maximum
+ */ // PlatIndepImp
+uint64_t fwiHistogramPercentile(
+    const struct fwiHistogram* histogram_p,
+    double percentile
+    );
+
+/**
+ * @brief Reads the time stamp counter, or the monotonic clock where there is none.
+ */ // PlatIndepImp
+uint64_t fwiProfileTicks(
+    void
+    );
+
+/**
+ * @brief Returns the name a profiling zone was registered with.
+ */ // PlatIndepImp
+const char* fwiProfileZoneName(
+    fwProfileZone zone
+    );
+
+/**
+ * @brief Records a traced call that started at @c begin and ends now.
+ * @param type[in] What kind of call it was
+ * @param begin[in] Value of @c FWI_TRACE_BEGIN at the start of the call, nothing is recorded if
+ *                  it is zero
+ * @param object[in] Module, socket or zone the call operated on
+ * @param value[in] Byte count or result of the call
+ */ // PlatIndepImp
+void fwiTraceEnd(
+    fwiTraceType type,
+    uint64_t begin,
+    uint64_t object,
+    uint64_t value
+    );
+
+/**
+ * @brief Fills statistics from a histogram of profiler ticks, in nanoseconds.
+ */ // PlatIndepImp
+void fwiProfileStatsOf(
+    const struct fwiHistogram* histogram_p,
+    struct fwProfileStats* stats_p
+    );
+
+/**
+ * @brief Fills the counter part of socket statistics, the kernel-side fields are left untouched.
+ * @param latency_p[in] Send and receive histograms, the latencies are left untouched if nullptr
+ */ // PlatIndepImp
+void fwiSocketStatsOf(
+    const struct fwiSocketCounters* counters_p,
+    const struct fwiHistogram* latency_p,
+    struct fwSocketStats* stats_p
+    );
+
+/**
+ * @brief Returns the socket counters of the calling thread, taking over those of an exited thread
+ *        or creating them on first use.
+ * @return nullptr when out of memory
+ */ // PlatIndepImp
+struct fwiSocketThread* fwiAcquireSocketThread(
+    void
+    );
+
+/**
+ * @brief Converts time stamp counter ticks, as returned by @c fwProfileBegin , to nanoseconds.
+ */ // PlatIndepImp
+uint64_t fwiProfileTicksToNanoseconds(
+    uint64_t ticks
+    );
+
+/**
+ * @brief Portable CRC-32C, used where the processor has no CRC instructions.
+ * @param crc[in] Running value, without the inversion applied at the start and the end
+ * @return The updated running value
+ */ // PlatIndepImp
+uint32_t fwiChecksumCrc32cSoftware(
+    uint32_t crc,
+    const uint8_t* data_p,
+    size_t size
+    );
+
+/**
+ * @brief Parses the printf conversion specification that starts at @c spec_p .
+ * @param spec_p[in] Pointer to the percent sign introducing the conversion
+ * @param conversion_p[out] Type of the argument and length of the specification
+ */ // PlatIndepImp
+void fwiLogParseConversion(
+    const char* spec_p,
+    struct fwiLogConversion* conversion_p
+    );
+
+/**
+ * @brief Formats a message from its format string and the raw arguments captured for it.
+ * @param buffer_p[out] Destination of the formatted, null-terminated text
+ * @param size[in] Capacity of the destination in bytes
+ * @param format_p[in] Format string the arguments were captured for
+ * @param arguments_p[in] Raw arguments
+ * @param argumentsLength[in] Size of the raw arguments in bytes
+ * @return Length of the formatted text, excluding the terminator
+ */ // PlatIndepImp
+size_t fwiLogFormatBinary(
+    char* buffer_p,
+    size_t size,
+    const char* format_p,
+    const uint8_t* arguments_p,
+    size_t argumentsLength
+    );
+
+/**
+ * @brief Returns the name of a log level as it appears in the log, for example @c "WARNING" .
+ */ // PlatIndepImp
+const char* fwiLogLevelName(
+    fwiLogLevel lll
+    );
+
 /**
  * @brief printf with added timestamp and log level color
  * @param lll[in] Log level of the message
  * @param format_p[in] Format string of the output message, mechanically the same as printf
  * @param ...[in] Replacement parameters for placeholders
+ * @note The message is formatted into the calling thread's log ring and written out by the
+ *       background flusher, the caller never touches the output stream. What happens when the
+ *       ring is full is decided by @c fwSetLogOverflowPolicy .
+ * @note In binary mode only the arguments are copied and formatting happens later, the format
+ *       string must therefore be a string literal or otherwise outlive the logger.
  */ // PlatIndepImp
 void fwiLogA(
     enum fwiLogLevel lll,
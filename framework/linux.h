@@ -17,8 +17,230 @@
 #ifndef LINUX_H
 #define LINUX_H
 
+#include <linux/io_uring.h>
+
 #include "framework.h"
 
 #define FWI_LOG_ERRNO fwiLogErrno(__func__, __LINE__)
 
+/**
+ * @brief State behind an @c fwFile handle.
+ * @param alignment Required alignment of reads, above 1 only for files opened for direct access
+ */
+struct fwiNativeFileState {
+    int32_t fileDescriptor;
+    uint32_t alignment;
+    uint64_t size;
+};
+
+/**
+ * @brief Size of the address buffer of every socket, enough for any supported family.
+ */
+#define FWI_SOCKET_ADDRESS_SIZE 108
+
+/**
+ * @brief State behind an @c fwSocket handle, kept in a slot of the socket table.
+ * @param targetAddress Address of the peer, points into the slot
+ * @param eventLoop Loop that watches the socket, zero if none does
+ * @param eventSlot Registration of the socket in that loop
+ * @param uring The loop is an io_uring one, accepts, sends and receives go through its queues
+ * @param connecting A non-blocking connect is underway or its outcome was not reported yet
+ * @param connectError Why that connect failed, @c EINPROGRESS until it is known
+ * @param latency_p Send and receive histograms, allocated on the first call. They stay with the
+ *                  slot when the socket is closed and are reused by the next socket in it.
+ */
+struct fwiNativeSocketState {
+    char* targetAddress;
+    int32_t addressFamily;
+    int32_t protocol;
+    int32_t fileDescriptor;
+    bool connected, connecting, bound, listening, nonBlocking, uring;
+    int32_t connectError;
+    fwEventLoop eventLoop;
+    uint32_t eventSlot;
+    struct fwiSocketCounters counters;
+    _Atomic(struct fwiHistogram*) latency_p;
+};
+
+/**
+ * @brief An io_uring instance, driven through the raw system calls.
+ * @param sqTail Tail of the submission queue as far as entries were handed out, published to the
+ *               kernel on submission
+ */
+struct fwiUring {
+    int32_t fileDescriptor;
+    uint32_t features;
+
+    _Atomic uint32_t* sqHead_p;
+    _Atomic uint32_t* sqKernelTail_p;
+    uint32_t* sqArray_p;
+    uint32_t sqMask;
+    uint32_t sqEntries;
+    uint32_t sqTail;
+    struct io_uring_sqe* sqes_p;
+
+    _Atomic uint32_t* cqHead_p;
+    _Atomic uint32_t* cqTail_p;
+    uint32_t cqMask;
+    struct io_uring_cqe* cqes_p;
+
+    void* sqRing_p;
+    size_t sqRingSize;
+    void* cqRing_p;
+    size_t cqRingSize;
+    size_t sqesSize;
+};
+
+/**
+ * @brief Sets up an io_uring instance with at least @c entries submission queue entries.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorUnimplemented The kernel does not support io_uring or it is disabled
+ * @return @c fwErrorOutOfMemory The rings could not be mapped
+ */
+fwError fwiUringCreate(
+    struct fwiUring* ring_p,
+    uint32_t entries,
+    uint32_t flags
+    );
+
+void fwiUringDestroy(
+    struct fwiUring* ring_p
+    );
+
+/**
+ * @brief Hands out a zeroed submission queue entry, or nullptr if the queue is full.
+ */
+struct io_uring_sqe* fwiUringGetSqe(
+    struct fwiUring* ring_p
+    );
+
+/**
+ * @brief Submits every entry the kernel has not consumed yet, including those a failed or partial
+ *        call left behind, and optionally waits for completions.
+ * @return Number of entries submitted, or a negative errno
+ */
+int32_t fwiUringSubmit(
+    struct fwiUring* ring_p,
+    uint32_t waitFor
+    );
+
+/**
+ * @brief Submits every entry handed out since the last call and waits for one completion.
+ * @param timeout[in] Longest wait in milliseconds, zero to only reap, -1 to wait without limit
+ * @return Number of entries submitted, or a negative errno, -ETIME when the wait timed out
+ */
+int32_t fwiUringWait(
+    struct fwiUring* ring_p,
+    int32_t timeout
+    );
+
+/**
+ * @brief Returns the oldest unseen completion without waiting, or nullptr if there is none.
+ */
+struct io_uring_cqe* fwiUringPeekCqe(
+    struct fwiUring* ring_p
+    );
+
+/**
+ * @brief Marks the completion returned by @c fwiUringPeekCqe as consumed.
+ */
+void fwiUringCqeSeen(
+    struct fwiUring* ring_p
+    );
+
+/**
+ * @brief Wraps io_uring_register.
+ * @return Zero or a negative errno
+ */
+int32_t fwiUringRegister(
+    struct fwiUring* ring_p,
+    uint32_t opcode,
+    const void* argument_p,
+    uint32_t count
+    );
+
+/**
+ * @brief Looks up the state behind a socket handle.
+ * @return The state, nullptr if the handle is not valid or the socket was closed since
+ */
+struct fwiNativeSocketState* fwiSocketResolve(
+    fwSocket sfdop
+    );
+
+/**
+ * @brief Learns how a non-blocking connect that was underway ended, called once the socket
+ *        reported being writable or an error.
+ * @param nativeSocket_p[in] Socket to look at, nothing happens if it is nullptr or not connecting
+ */
+void fwiSocketSettleConnect(
+    struct fwiNativeSocketState* nativeSocket_p
+    );
+
+/**
+ * @brief Puts a socket into the listening state unless it already is.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorSocketNotBound The socket was not bound
+ * @return @c fwErrorSocketListen The system call failed
+ */
+fwError fwiSocketListen(
+    struct fwiNativeSocketState* nativeSocket_p
+    );
+
+/**
+ * @brief Drops the registration of a socket from the loop that watches it, called while the
+ *        socket is still open.
+ */
+void fwiEventLoopForget(
+    struct fwiNativeSocketState* nativeSocket_p
+    );
+
+/**
+ * @brief Takes a connection that an io_uring event loop accepted for a listening socket.
+ * @param fileDescriptor_p[out] Descriptor of the connection
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorSocketWouldBlock Nothing was accepted yet
+ * @return @c fwErrorSocketAccept Accepting failed, the loop tries again
+ * @note Only for sockets with @c uring set, like the two below.
+ */
+fwError fwiEventLoopAccept(
+    struct fwiNativeSocketState* nativeSocket_p,
+    int32_t* fileDescriptor_p
+    );
+
+/**
+ * @brief Copies data an io_uring event loop received for a socket, giving back emptied buffers.
+ * @param received_p[out] Bytes copied, zero once the peer closed its side and all was taken
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorSocketWouldBlock Nothing was received yet
+ * @return @c fwErrorSocketReceive Receiving failed and everything before the failure was taken
+ */
+fwError fwiEventLoopReceive(
+    struct fwiNativeSocketState* nativeSocket_p,
+    void* buffer_p,
+    size_t size,
+    size_t* received_p
+    );
+
+/**
+ * @brief Queues a copy of data on the io_uring event loop that watches a socket, several buffers
+ *        are gathered into one copy.
+ * @return @c fwErrorSuccess No error occured
+ * @return @c fwErrorOutOfMemory The copy could not be allocated
+ * @return @c fwErrorSocketSend An earlier send failed
+ */
+fwError fwiEventLoopSend(
+    struct fwiNativeSocketState* nativeSocket_p,
+    const fwSocketBuffer* buffers_p,
+    uint32_t count
+    );
+
+/**
+ * @brief Reads the size of the default explicit huge pages and how many of them are free.
+ * @note Both are zero when the kernel has no hugetlbfs.
+ */
+void fwiReadHugePages(
+    uint64_t* size_p,
+    uint32_t* free_p
+    );
+
 #endif //LINUX_H
@@ -0,0 +1,285 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific large buffers, which
+// are mapped straight from the kernel and backed by huge pages where possible
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#ifndef MADV_POPULATE_WRITE
+#define MADV_POPULATE_WRITE 23 // Linux 5.14, older headers lack it
+#endif
+
+#define FWI_LARGE_DEFAULT_PMD_SIZE (2ull << 20)
+#define FWI_LARGE_MAX_NODES 1'024
+
+/**
+ * @brief Room in front of the buffers of the large allocator, holding the mapping they live in.
+ */
+#define FWI_LARGE_HEADER 64
+
+/**
+ * @brief What the kernel offers, read once.
+ * @param hugePageSize Size of the default explicit huge pages, zero without hugetlbfs
+ * @param pmdSize Size of a transparent huge page
+ * @param transparent Transparent huge pages are enabled, for every mapping or on request
+ */
+struct fwiLargePages {
+    uint64_t hugePageSize;
+    uint64_t pmdSize;
+    uint64_t pageSize;
+    bool transparent;
+};
+
+static struct fwiLargePages largePages_s = {};
+static pthread_once_t largePagesOnce_s = PTHREAD_ONCE_INIT;
+
+static void* fwiLargeAllocate(void* context_p, uint64_t size, uint64_t alignment);
+static void fwiLargeRelease(void* context_p, void* memory_p, uint64_t size, uint64_t alignment);
+
+static const fwAllocator largeAllocator_s = {
+    .allocate  = fwiLargeAllocate,
+    .release   = fwiLargeRelease,
+    .context_p = nullptr
+};
+
+void fwiReadHugePages(uint64_t* size_p, uint32_t* free_p) {
+    *size_p = 0;
+    *free_p = 0;
+
+    FILE* meminfo = fopen("/proc/meminfo", "r");
+    if (meminfo == nullptr) {
+        return;
+    }
+
+    char line[128];
+    unsigned long value;
+    while (fgets(line, sizeof(line), meminfo) != nullptr) {
+        if (sscanf(line, "HugePages_Free: %lu", &value) == 1) {
+            *free_p = (uint32_t)value;
+        }
+        else if (sscanf(line, "Hugepagesize: %lu kB", &value) == 1) {
+            *size_p = (uint64_t)value << 10;
+        }
+    }
+    fclose(meminfo);
+}
+
+static void fwiLargeInitialise(void) {
+    uint32_t freePages;
+    fwiReadHugePages(&largePages_s.hugePageSize, &freePages);
+    largePages_s.pageSize = sysconf(_SC_PAGESIZE);
+    largePages_s.pmdSize  = FWI_LARGE_DEFAULT_PMD_SIZE;
+
+    char text[64] = {};
+    FILE* file = fopen("/sys/kernel/mm/transparent_hugepage/hpage_pmd_size", "r");
+    if (file != nullptr) {
+        unsigned long value;
+        if (fscanf(file, "%lu", &value) == 1 && value != 0) {
+            largePages_s.pmdSize = value;
+        }
+        fclose(file);
+    }
+
+    // "always [madvise] never", the setting in use is the one in brackets
+    if ((file = fopen("/sys/kernel/mm/transparent_hugepage/enabled", "r")) != nullptr) {
+        if (fgets(text, sizeof(text), file) != nullptr) {
+            largePages_s.transparent = strstr(text, "[never]") == nullptr;
+        }
+        fclose(file);
+    }
+}
+
+/**
+ * @brief Maps anonymous memory aligned to @c alignment by mapping more and trimming both ends.
+ */
+static void* fwiLargeMapAligned(const uint64_t length, const uint64_t alignment) {
+    uint8_t* mapping = mmap(nullptr, length + alignment, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return nullptr;
+    }
+
+    uint8_t* aligned = (uint8_t*)(((uintptr_t)mapping + alignment - 1) &
+                                  ~(uintptr_t)(alignment - 1));
+    if (aligned != mapping) {
+        munmap(mapping, aligned - mapping);
+    }
+    if (aligned + length != mapping + length + alignment) {
+        munmap(aligned + length, mapping + alignment - aligned);
+    }
+    return aligned;
+}
+
+/**
+ * @brief Places a mapping on a NUMA node, before any page of it is touched.
+ */
+static fwError fwiLargeBind(void* memory_p, const uint64_t length, const int32_t node,
+                            const bool strict) {
+    unsigned long mask[FWI_LARGE_MAX_NODES / (8 * sizeof(unsigned long))] = {};
+    mask[node / (8 * sizeof(unsigned long))] = 1ul << (node % (8 * sizeof(unsigned long)));
+
+    if (syscall(SYS_mbind, memory_p, length, strict ? MPOL_BIND : MPOL_PREFERRED, mask,
+                FWI_LARGE_MAX_NODES, 0) == -1) {
+        FWI_LOG_ERRNO;
+        return strict ? fwErrorOutOfMemory : fwErrorSuccess;
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwAllocLarge(const uint64_t size, const fwLargeBufferInfo* info_p,
+                     fwLargeBuffer* buffer_p) {
+    pthread_once(&largePagesOnce_s, fwiLargeInitialise);
+
+    const uint32_t flags = info_p != nullptr ? info_p->flags : fwLargeFlagNone;
+    const int32_t node   = info_p != nullptr ? info_p->node : -1;
+    if (size == 0 || node >= FWI_LARGE_MAX_NODES - 1) {
+        return fwErrorInvalidParameter;
+    }
+    if (node >= 0) {
+        char path[64];
+        snprintf(path, sizeof(path), "/sys/devices/system/node/node%d", node);
+        if (access(path, F_OK) != 0) {
+            return fwErrorInvalidParameter;
+        }
+    }
+
+    // Explicit huge pages are reserved ahead, so mapping them fails right away when there are
+    // not enough left instead of later on a fault
+    const struct fwiLargePages* pages = &largePages_s;
+    uint8_t* memory = nullptr;
+    uint64_t length = 0;
+    fwLargePages kind = fwLargePagesNormal;
+
+    if (!(flags & (fwLargeFlagNoHuge | fwLargeFlagStrictNode)) && pages->hugePageSize != 0 &&
+        size >= pages->hugePageSize) {
+        length = (size + pages->hugePageSize - 1) & ~(pages->hugePageSize - 1);
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory == MAP_FAILED) {
+            memory = nullptr;
+        }
+        else {
+            kind = fwLargePagesHuge;
+        }
+    }
+
+    if (memory == nullptr && size >= pages->pmdSize) {
+        length = (size + pages->pmdSize - 1) & ~(pages->pmdSize - 1);
+        if ((memory = fwiLargeMapAligned(length, pages->pmdSize)) == nullptr) {
+            return fwErrorOutOfMemory;
+        }
+
+        // Opting out matters where the kernel merges the pages of every mapping on its own
+        if (!(flags & fwLargeFlagNoTransparent) && pages->transparent &&
+            madvise(memory, length, MADV_HUGEPAGE) == 0) {
+            kind = fwLargePagesTransparent;
+        }
+        else if (flags & fwLargeFlagNoTransparent) {
+            madvise(memory, length, MADV_NOHUGEPAGE);
+        }
+    }
+
+    if (memory == nullptr) {
+        length = (size + pages->pageSize - 1) & ~(pages->pageSize - 1);
+        memory = mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+        if (memory == MAP_FAILED) {
+            return fwErrorOutOfMemory;
+        }
+    }
+
+    if (node >= 0 &&
+        fwiLargeBind(memory, length, node, flags & fwLargeFlagStrictNode) != fwErrorSuccess) {
+        munmap(memory, length);
+        return fwErrorOutOfMemory;
+    }
+
+    if (flags & fwLargeFlagPopulate && madvise(memory, length, MADV_POPULATE_WRITE) != 0) {
+        // Before Linux 5.14, write to one byte of every page instead
+        const uint64_t step = kind == fwLargePagesHuge ? pages->hugePageSize : pages->pageSize;
+        for (uint64_t offset = 0; offset < length; offset += step) {
+            ((volatile uint8_t*)memory)[offset] = 0;
+        }
+    }
+
+    *buffer_p = (fwLargeBuffer){
+        .data_p = memory,
+        .size   = length,
+        .pages  = kind
+    };
+    return fwErrorSuccess;
+}
+
+fwError fwFreeLarge(const fwLargeBuffer* buffer_p) {
+    if (buffer_p == nullptr || buffer_p->data_p == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    if (munmap(buffer_p->data_p, buffer_p->size) == -1) {
+        FWI_LOG_ERRNO;
+        return fwErrorInvalidParameter;
+    }
+    return fwErrorSuccess;
+}
+
+static void* fwiLargeAllocate(void* context_p, const uint64_t size, const uint64_t alignment) {
+    (void)context_p;
+    if (size < largePages_s.pmdSize) {
+        return aligned_alloc(alignment, (size + alignment - 1) & ~(alignment - 1));
+    }
+
+    // The mapping is remembered in front of the buffer, where the alignment leaves room for it
+    const uint64_t offset = alignment > FWI_LARGE_HEADER ? alignment : FWI_LARGE_HEADER;
+    fwLargeBuffer buffer;
+    if (fwAllocLarge(offset + size, nullptr, &buffer) != fwErrorSuccess) {
+        return nullptr;
+    }
+    memcpy(buffer.data_p, &buffer, sizeof(fwLargeBuffer));
+    return (uint8_t*)buffer.data_p + offset;
+}
+
+static void fwiLargeRelease(void* context_p, void* memory_p, const uint64_t size,
+                            const uint64_t alignment) {
+    (void)context_p;
+    if (size < largePages_s.pmdSize) {
+        free(memory_p);
+        return;
+    }
+
+    const uint64_t offset = alignment > FWI_LARGE_HEADER ? alignment : FWI_LARGE_HEADER;
+    fwLargeBuffer buffer;
+    memcpy(&buffer, (uint8_t*)memory_p - offset, sizeof(fwLargeBuffer));
+    fwFreeLarge(&buffer);
+}
+
+fwError fwGetLargeAllocator(const fwAllocator** allocator_pp) {
+    // The threshold in the allocator depends on the page sizes, so read them before handing it out
+    pthread_once(&largePagesOnce_s, fwiLargeInitialise);
+    *allocator_pp = &largeAllocator_s;
+    return fwErrorSuccess;
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,366 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the platform independant profiler and
+// the histograms it is built on
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include "framework.h"
+#include "internal.h"
+
+static pthread_mutex_t profileZoneMutex_s = PTHREAD_MUTEX_INITIALIZER;
+static char profileZoneNames_s[FWI_PROFILE_MAX_ZONES][48] = {
+    [fwiProfileZoneStartModule]    = "fwStartModule",
+    [fwiProfileZoneLoadFile]       = "fwLoadFileToMem",
+    [fwiProfileZoneMapFile]        = "fwMapFile",
+    [fwiProfileZoneLoadFiles]      = "fwLoadFiles",
+    [fwiProfileZoneWalkDirectory]  = "fwWalkDirectory",
+    [fwiProfileZoneSocketConnect]  = "fwSocketConnect",
+    [fwiProfileZoneSocketAccept]   = "fwSocketAccept",
+    [fwiProfileZoneSocketSend]     = "fwSocketSend",
+    [fwiProfileZoneSocketSendFile] = "fwSocketSendFile",
+    [fwiProfileZoneSocketSendV]    = "fwSocketSendV",
+    [fwiProfileZoneSocketReceive]  = "fwSocketReceive",
+    [fwiProfileZoneSocketReceiveV] = "fwSocketReceiveV",
+};
+
+static pthread_key_t profileThreadKey_s;
+static pthread_once_t profileThreadKeyOnce_s = PTHREAD_ONCE_INIT;
+static thread_local struct fwiProfileThread* profileThread_s = nullptr;
+
+static pthread_once_t profileCalibrationOnce_s = PTHREAD_ONCE_INIT;
+static double profileNanosecondsPerTick_s = 1.0;
+
+static uint32_t fwiHistogramBucket(const uint64_t value) {
+    if (value < 16) {
+        return (uint32_t)value;
+    }
+
+    const uint32_t exponent = 63 - __builtin_clzll(value);
+    const uint32_t sub = (uint32_t)(value >> (exponent - 3)) & (FWI_HISTOGRAM_SUB_BUCKETS - 1);
+    return 16 + (exponent - 4) * FWI_HISTOGRAM_SUB_BUCKETS + sub;
+}
+
+static uint64_t fwiHistogramBucketUpperBound(const uint32_t bucket) {
+    if (bucket < 16) {
+        return bucket;
+    }
+
+    const uint32_t exponent = (bucket - 16) / FWI_HISTOGRAM_SUB_BUCKETS + 4;
+    const uint64_t sub = (bucket - 16) % FWI_HISTOGRAM_SUB_BUCKETS;
+    const uint64_t lower = (FWI_HISTOGRAM_SUB_BUCKETS + sub) << (exponent - 3);
+    return lower + (1ull << (exponent - 3)) - 1;
+}
+
+void fwiHistogramRecord(struct fwiHistogram* histogram_p, const uint64_t value) {
+    // Only the owning thread writes, plain load and store pairs are enough for concurrent readers
+    _Atomic uint64_t* bucket = &histogram_p->buckets[fwiHistogramBucket(value)];
+    atomic_store_explicit(bucket, atomic_load_explicit(bucket, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&histogram_p->count,
+                          atomic_load_explicit(&histogram_p->count, memory_order_relaxed) + 1,
+                          memory_order_relaxed);
+    atomic_store_explicit(&histogram_p->sum,
+                          atomic_load_explicit(&histogram_p->sum, memory_order_relaxed) + value,
+                          memory_order_relaxed);
+    if (value > atomic_load_explicit(&histogram_p->max, memory_order_relaxed)) {
+        atomic_store_explicit(&histogram_p->max, value, memory_order_relaxed);
+    }
+}
+
+void fwiHistogramRecordShared(struct fwiHistogram* histogram_p, const uint64_t value) {
+    atomic_fetch_add_explicit(&histogram_p->buckets[fwiHistogramBucket(value)], 1,
+                              memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram_p->count, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&histogram_p->sum, value, memory_order_relaxed);
+
+    uint64_t max = atomic_load_explicit(&histogram_p->max, memory_order_relaxed);
+    while (value > max && !atomic_compare_exchange_weak_explicit(&histogram_p->max, &max, value,
+                                                                  memory_order_relaxed,
+                                                                  memory_order_relaxed)) {}
+}
+
+void fwiHistogramMerge(struct fwiHistogram* into_p, const struct fwiHistogram* from_p) {
+    for (uint32_t i = 0; i < FWI_HISTOGRAM_BUCKETS; i++) {
+        const uint64_t count = atomic_load_explicit(&from_p->buckets[i], memory_order_relaxed);
+        if (count != 0) {
+            atomic_store_explicit(&into_p->buckets[i],
+                                  atomic_load_explicit(&into_p->buckets[i], memory_order_relaxed) +
+                                  count, memory_order_relaxed);
+        }
+    }
+
+    atomic_store_explicit(&into_p->count,
+                          atomic_load_explicit(&into_p->count, memory_order_relaxed) +
+                          atomic_load_explicit(&from_p->count, memory_order_relaxed),
+                          memory_order_relaxed);
+    atomic_store_explicit(&into_p->sum,
+                          atomic_load_explicit(&into_p->sum, memory_order_relaxed) +
+                          atomic_load_explicit(&from_p->sum, memory_order_relaxed),
+                          memory_order_relaxed);
+
+    const uint64_t max = atomic_load_explicit(&from_p->max, memory_order_relaxed);
+    if (max > atomic_load_explicit(&into_p->max, memory_order_relaxed)) {
+        atomic_store_explicit(&into_p->max, max, memory_order_relaxed);
+    }
+}
+
+uint64_t fwiHistogramPercentile(const struct fwiHistogram* histogram_p, const double percentile) {
+    const uint64_t count = atomic_load_explicit(&histogram_p->count, memory_order_relaxed);
+    const uint64_t max = atomic_load_explicit(&histogram_p->max, memory_order_relaxed);
+    if (count == 0) {
+        return 0;
+    }
+
+    uint64_t target = (uint64_t)((double)count * percentile / 100.0 + 0.5);
+    if (target == 0) {
+        target = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < FWI_HISTOGRAM_BUCKETS; i++) {
+        seen += atomic_load_explicit(&histogram_p->buckets[i], memory_order_relaxed);
+        if (seen >= target) {
+            const uint64_t bound = fwiHistogramBucketUpperBound(i);
+            return bound < max ? bound : max;
+        }
+    }
+    return max;
+}
+
+uint64_t fwiProfileTicks(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#elif defined(__aarch64__)
+    uint64_t ticks;
+    __asm__ volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+    return ticks;
+#else
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t)now.tv_sec * 1'000'000'000 + now.tv_nsec;
+#endif
+}
+
+static void fwiProfileCalibrate(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    // The TSC frequency is not exposed to user space, measure it against the monotonic clock
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    const uint64_t startTicks = fwiProfileTicks();
+
+    const struct timespec duration = {.tv_sec = 0, .tv_nsec = 20'000'000};
+    nanosleep(&duration, nullptr);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const uint64_t endTicks = fwiProfileTicks();
+
+    const double nanoseconds = (double)(end.tv_sec - start.tv_sec) * 1e9 +
+                               (double)(end.tv_nsec - start.tv_nsec);
+    profileNanosecondsPerTick_s = nanoseconds / (double)(endTicks - startTicks);
+#elif defined(__aarch64__)
+    uint64_t frequency;
+    __asm__ volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+    profileNanosecondsPerTick_s = 1e9 / (double)frequency;
+#endif
+}
+
+uint64_t fwiProfileTicksToNanoseconds(const uint64_t ticks) {
+    pthread_once(&profileCalibrationOnce_s, fwiProfileCalibrate);
+    return (uint64_t)((double)ticks * profileNanosecondsPerTick_s);
+}
+
+static void fwiReleaseProfileThread(void* thread_p) {
+    atomic_store_explicit(&((struct fwiProfileThread*)thread_p)->owned, false,
+                          memory_order_release);
+}
+
+static void fwiCreateProfileThreadKey(void) {
+    pthread_key_create(&profileThreadKey_s, fwiReleaseProfileThread);
+}
+
+static struct fwiProfileThread* fwiAcquireProfileThread(void) {
+    if (profileThread_s != nullptr) {
+        return profileThread_s;
+    }
+
+    pthread_once(&profileThreadKeyOnce_s, fwiCreateProfileThreadKey);
+
+    struct fwiProfileThread* thread = atomic_load_explicit(&fwiGetState()->profileThreads,
+                                                           memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&thread->owned, &expected, true)) {
+            break;
+        }
+    }
+
+    if (thread == nullptr) {
+        thread = calloc(1, sizeof(struct fwiProfileThread));
+        if (thread == nullptr) {
+            return nullptr;
+        }
+        atomic_store_explicit(&thread->owned, true, memory_order_relaxed);
+
+        struct fwiProfileThread* head = atomic_load_explicit(&fwiGetState()->profileThreads,
+                                                             memory_order_relaxed);
+        do {
+            thread->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&fwiGetState()->profileThreads, &head,
+                                                        thread, memory_order_release,
+                                                        memory_order_relaxed));
+    }
+
+    pthread_setspecific(profileThreadKey_s, thread);
+    profileThread_s = thread;
+    return thread;
+}
+
+const char* fwiProfileZoneName(const fwProfileZone zone) {
+    return zone < FWI_PROFILE_MAX_ZONES ? profileZoneNames_s[zone] : "";
+}
+
+void fwProfileEnable(const bool enable) {
+    atomic_store_explicit(&fwiGetState()->profilingIsUp, enable, memory_order_release);
+}
+
+fwError fwProfileZoneCreate(const char* name_p, fwProfileZone* zone_p) {
+    pthread_mutex_lock(&profileZoneMutex_s);
+
+    uint16_t zone = atomic_load_explicit(&fwiGetState()->profileZoneCount, memory_order_relaxed);
+    if (zone < fwiProfileZoneCount) {
+        zone = fwiProfileZoneCount;
+    }
+    if (zone >= FWI_PROFILE_MAX_ZONES) {
+        pthread_mutex_unlock(&profileZoneMutex_s);
+        return fwErrorOutOfMemory;
+    }
+
+    strncpy(profileZoneNames_s[zone], name_p, sizeof(profileZoneNames_s[zone]) - 1);
+    atomic_store_explicit(&fwiGetState()->profileZoneCount, zone + 1, memory_order_release);
+
+    pthread_mutex_unlock(&profileZoneMutex_s);
+
+    *zone_p = zone;
+    return fwErrorSuccess;
+}
+
+uint64_t fwProfileBegin(void) {
+    if (!atomic_load_explicit(&fwiGetState()->profilingIsUp, memory_order_relaxed)) {
+        return 0;
+    }
+    return fwiProfileTicks();
+}
+
+void fwProfileEnd(const fwProfileZone zone, const uint64_t begin) {
+    if (begin == 0 || zone >= FWI_PROFILE_MAX_ZONES) {
+        return;
+    }
+    const uint64_t ticks = fwiProfileTicks() - begin;
+
+    if (atomic_load_explicit(&fwiGetState()->tracingIsUp, memory_order_relaxed)) {
+        fwiTraceEnd(fwiTraceTypeZone, begin, zone, 0);
+    }
+
+    struct fwiProfileThread* thread = fwiAcquireProfileThread();
+    if (thread == nullptr) {
+        return;
+    }
+
+    struct fwiHistogram* histogram = atomic_load_explicit(&thread->zones[zone],
+                                                          memory_order_relaxed);
+    if (histogram == nullptr) {
+        if ((histogram = calloc(1, sizeof(struct fwiHistogram))) == nullptr) {
+            return;
+        }
+        atomic_store_explicit(&thread->zones[zone], histogram, memory_order_release);
+    }
+
+    fwiHistogramRecord(histogram, ticks);
+}
+
+void fwProfileScopeEnd(fwProfileScope* scope_p) {
+    fwProfileEnd(scope_p->zone, scope_p->begin);
+}
+
+/**
+ * @brief Merges the histograms of every thread for a zone.
+ */
+static void fwiProfileCollect(const fwProfileZone zone, struct fwiHistogram* merged_p) {
+    memset(merged_p, 0, sizeof(struct fwiHistogram));
+
+    struct fwiProfileThread* thread = atomic_load_explicit(&fwiGetState()->profileThreads,
+                                                           memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        const struct fwiHistogram* histogram = atomic_load_explicit(&thread->zones[zone],
+                                                                    memory_order_acquire);
+        if (histogram != nullptr) {
+            fwiHistogramMerge(merged_p, histogram);
+        }
+    }
+}
+
+void fwiProfileStatsOf(const struct fwiHistogram* histogram_p, struct fwProfileStats* stats_p) {
+    const uint64_t count = atomic_load_explicit(&histogram_p->count, memory_order_relaxed);
+
+    stats_p->count = count;
+    stats_p->p50   = fwiProfileTicksToNanoseconds(fwiHistogramPercentile(histogram_p, 50.0));
+    stats_p->p99   = fwiProfileTicksToNanoseconds(fwiHistogramPercentile(histogram_p, 99.0));
+    stats_p->max   = fwiProfileTicksToNanoseconds(
+        atomic_load_explicit(&histogram_p->max, memory_order_relaxed));
+    stats_p->mean  = count == 0 ? 0 : fwiProfileTicksToNanoseconds(
+        atomic_load_explicit(&histogram_p->sum, memory_order_relaxed) / count);
+}
+
+fwError fwProfileGetStats(const fwProfileZone zone, struct fwProfileStats* stats_p) {
+    if (zone >= fwiProfileZoneCount &&
+        zone >= atomic_load_explicit(&fwiGetState()->profileZoneCount, memory_order_acquire)) {
+        return fwErrorInvalidParameter;
+    }
+
+    struct fwiHistogram merged;
+    fwiProfileCollect(zone, &merged);
+    fwiProfileStatsOf(&merged, stats_p);
+    return fwErrorSuccess;
+}
+
+void fwProfileDump(void) {
+    uint16_t zoneCount = atomic_load_explicit(&fwiGetState()->profileZoneCount,
+                                              memory_order_acquire);
+    if (zoneCount < fwiProfileZoneCount) {
+        zoneCount = fwiProfileZoneCount;
+    }
+
+    for (fwProfileZone zone = 0; zone < zoneCount; zone++) {
+        struct fwiHistogram merged;
+        fwiProfileCollect(zone, &merged);
+        if (atomic_load_explicit(&merged.count, memory_order_relaxed) == 0) {
+            continue;
+        }
+
+        struct fwProfileStats stats;
+        fwiProfileStatsOf(&merged, &stats);
+        FWI_LOG_A(fwiLogDomainBase, fwiLogLevelBench,
+                  "Zone %s: %lu passes, p50 %lu ns, p99 %lu ns, max %lu ns, mean %lu ns",
+                  profileZoneNames_s[zone], (unsigned long)stats.count, (unsigned long)stats.p50,
+                  (unsigned long)stats.p99, (unsigned long)stats.max, (unsigned long)stats.mean);
+    }
+}
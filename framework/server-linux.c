@@ -0,0 +1,309 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific server, which shards
+// accepting over several listeners in one SO_REUSEPORT group
+
+#ifdef PLATFORM_LINUX
+
+// CPU affinity of threads is a GNU extension
+#define _GNU_SOURCE
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <time.h>
+#include <linux/filter.h>
+#include <sys/socket.h>
+
+#ifndef SO_INCOMING_CPU
+#define SO_INCOMING_CPU 49 // Linux 3.19, older headers lack it
+#endif
+#ifndef SO_ATTACH_REUSEPORT_CBPF
+#define SO_ATTACH_REUSEPORT_CBPF 51 // Linux 4.5
+#endif
+
+/**
+ * @brief Most workers the steering program tells apart by core, a jump can skip at most 255
+ *        instructions. Cores past these are spread by their number.
+ */
+#define FWI_SERVER_STEER_MAX 254
+
+/**
+ * @brief Pause of a worker after accepting failed for a reason other than an empty queue, such
+ *        as running out of file descriptors, so that the listener does not wake it right away.
+ */
+#define FWI_SERVER_ACCEPT_BACKOFF 10'000'000 // ns
+
+struct fwiServer;
+
+/**
+ * @brief A thread of a server with its listener and loop.
+ * @param cpu Core the worker belongs to, it is pinned there if the server asks for it
+ */
+struct fwiServerWorker {
+    struct fwiServer* server_p;
+    fwSocket listener;
+    fwEventLoop loop;
+    pthread_t thread;
+    uint32_t index;
+    int32_t cpu;
+    bool running;
+    bool failing;
+};
+
+/**
+ * @brief State behind an @c fwServer handle.
+ */
+struct fwiServer {
+    fwServerCallback callback;
+    void* user_p;
+    uint32_t workerCount;
+    struct fwiServerWorker workers[];
+};
+
+static void fwiServerAccept(const fwEventLoop loop, const fwSocket listener, const uint32_t events,
+                            void* worker_p) {
+    struct fwiServerWorker* worker = worker_p;
+    fwSocket connection;
+    fwError result = fwErrorSocketAccept;
+    if (!(events & fwEventError)) {
+        while ((result = fwSocketAccept(listener, &connection, nullptr)) == fwErrorSuccess) {
+            worker->server_p->callback(loop, connection, worker->index, worker->server_p->user_p);
+        }
+    }
+    if (result == fwErrorSocketWouldBlock) {
+        worker->failing = false;
+        return;
+    }
+
+    // The connection is still queued, the level-triggered listener would report it again at once
+    if (!worker->failing) {
+        FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelWarning,
+                  "Worker %u of server (ID: %lX) could not accept, backing off", worker->index,
+                  (unsigned long)worker->server_p);
+        worker->failing = true;
+    }
+    const struct timespec backoff = {.tv_nsec = FWI_SERVER_ACCEPT_BACKOFF};
+    nanosleep(&backoff, nullptr);
+}
+
+static void* fwiServerWork(void* worker_p) {
+    const struct fwiServerWorker* worker = worker_p;
+    fwEventLoopRun(worker->loop);
+    return nullptr;
+}
+
+/**
+ * @brief Spreads the workers over the cores the process may run on, in order.
+ * @return Number of cores the workers were spread over
+ */
+static uint32_t fwiServerAssignCores(struct fwiServer* server_p) {
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0) {
+        for (uint32_t i = 0; i < server_p->workerCount; i++) {
+            server_p->workers[i].cpu = (int32_t)i;
+        }
+        return server_p->workerCount;
+    }
+
+    int32_t cpu = -1;
+    for (uint32_t i = 0; i < server_p->workerCount; i++) {
+        do {
+            cpu = (cpu + 1) % CPU_SETSIZE;
+        } while (!CPU_ISSET(cpu, &allowed));
+        server_p->workers[i].cpu = cpu;
+    }
+    return (uint32_t)CPU_COUNT(&allowed);
+}
+
+/**
+ * @brief Attaches a program to the group of listeners that picks the worker of the core a
+ *        connection arrived on, by comparing the core with each worker in turn.
+ */
+static void fwiServerSteer(const struct fwiServer* server_p, const int32_t fileDescriptor) {
+    const uint32_t matched = server_p->workerCount > FWI_SERVER_STEER_MAX ?
+                             FWI_SERVER_STEER_MAX : server_p->workerCount;
+
+    // Load the core, one comparison per worker, spread what is left, then one return per worker
+    struct sock_filter* code = calloc(2 * matched + 3, sizeof(struct sock_filter));
+    if (code == nullptr) {
+        return;
+    }
+    code[0] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, SKF_AD_OFF + SKF_AD_CPU);
+    for (uint32_t i = 0; i < matched; i++) {
+        code[1 + i] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K,
+                                                   (uint32_t)server_p->workers[i].cpu,
+                                                   (uint8_t)(matched + 1), 0);
+        code[matched + 3 + i] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, i);
+    }
+    code[matched + 1] = (struct sock_filter)BPF_STMT(BPF_ALU | BPF_MOD | BPF_K,
+                                                      server_p->workerCount);
+    code[matched + 2] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_A, 0);
+
+    const struct sock_fprog program = {.len = (uint16_t)(2 * matched + 3), .filter = code};
+    if (setsockopt(fileDescriptor, SOL_SOCKET, SO_ATTACH_REUSEPORT_CBPF, &program,
+                   sizeof(program)) != 0) {
+        FWI_LOG_ERRNO;
+    }
+    free(code);
+}
+
+/**
+ * @brief Creates the listener of a worker and joins it to the group on the shared address.
+ */
+static fwError fwiServerListen(struct fwiServerWorker* worker_p, const fwServerInfo* info_p) {
+    fwError result = fwSocketCreate(&worker_p->listener, info_p->addressFamily,
+                                    fwSocketProtocolStream);
+    if (result != fwErrorSuccess) {
+        return result;
+    }
+
+    const struct fwiNativeSocketState* nativeSocket = fwiSocketResolve(worker_p->listener);
+    const int32_t enable = 1;
+    if (nativeSocket == nullptr ||
+        setsockopt(nativeSocket->fileDescriptor, SOL_SOCKET, SO_REUSEPORT, &enable,
+                   sizeof(enable)) != 0) {
+        FWI_LOG_ERRNO;
+        return fwErrorSocketBind;
+    }
+    if (info_p->flags & fwServerFlagIncomingCpu &&
+        setsockopt(nativeSocket->fileDescriptor, SOL_SOCKET, SO_INCOMING_CPU, &worker_p->cpu,
+                   sizeof(worker_p->cpu)) != 0) {
+        FWI_LOG_ERRNO;
+    }
+
+    if ((result = fwSocketBind(worker_p->listener, &info_p->address)) != fwErrorSuccess ||
+        (result = fwSocketSetNonBlocking(worker_p->listener, true)) != fwErrorSuccess ||
+        (result = fwEventLoopCreate(&info_p->loop, &worker_p->loop)) != fwErrorSuccess) {
+        return result;
+    }
+
+    // The group numbers its listeners in the order they start listening, which the steering
+    // program relies on
+    return fwEventLoopAdd(worker_p->loop, worker_p->listener, fwEventAccept, fwEventFlagNone,
+                          fwiServerAccept, worker_p);
+}
+
+fwError fwServerCreate(const fwServerInfo* info_p, fwServer* server_p) {
+    if (info_p == nullptr || info_p->callback == nullptr ||
+        (info_p->addressFamily != fwSocketAddressFamilyIPv4 &&
+         info_p->addressFamily != fwSocketAddressFamilyIPv6)) {
+        return fwErrorInvalidParameter;
+    }
+
+    uint32_t workerCount = info_p->workers;
+    if (workerCount == 0) {
+        fwSystemConfiguration system = {};
+        fwGetSystemConfiguration(&system);
+        workerCount = system.cores != 0 ? system.cores : 1;
+    }
+
+    struct fwiServer* server = calloc(1, sizeof(struct fwiServer) +
+                                         workerCount * sizeof(struct fwiServerWorker));
+    if (server == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    server->callback    = info_p->callback;
+    server->user_p      = info_p->user_p;
+    server->workerCount = workerCount;
+    const uint32_t cores = fwiServerAssignCores(server);
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        server->workers[i].server_p = server;
+        server->workers[i].index    = i;
+
+        const fwError result = fwiServerListen(&server->workers[i], info_p);
+        if (result != fwErrorSuccess) {
+            fwServerDestroy((uintptr_t)server);
+            return result;
+        }
+    }
+
+    // Workers that share a core would never be picked by the program, the kernel hashes instead
+    if (info_p->flags & fwServerFlagSteer && workerCount <= cores) {
+        fwiServerSteer(server, fwiSocketResolve(server->workers[0].listener)->fileDescriptor);
+    }
+
+    for (uint32_t i = 0; i < workerCount; i++) {
+        struct fwiServerWorker* worker = &server->workers[i];
+
+        // Pinned before it starts, so the loop never runs anywhere else
+        pthread_attr_t attributes;
+        pthread_attr_init(&attributes);
+        if (info_p->flags & fwServerFlagPin) {
+            cpu_set_t cpus;
+            CPU_ZERO(&cpus);
+            CPU_SET(worker->cpu, &cpus);
+            pthread_attr_setaffinity_np(&attributes, sizeof(cpus), &cpus);
+        }
+
+        int32_t created = pthread_create(&worker->thread, &attributes, fwiServerWork, worker);
+        if (created == EINVAL && info_p->flags & fwServerFlagPin) {
+            // The core went offline or is outside the cgroup, run unpinned instead
+            created = pthread_create(&worker->thread, nullptr, fwiServerWork, worker);
+        }
+        pthread_attr_destroy(&attributes);
+
+        if (created != 0) {
+            fwServerDestroy((uintptr_t)server);
+            return fwErrorOutOfMemory;
+        }
+        worker->running = true;
+    }
+
+    *server_p = (uintptr_t)server;
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo,
+              "New server (ID: %lX) was created with %u workers on %s",
+              (unsigned long)*server_p, workerCount, info_p->address.port_p);
+    return fwErrorSuccess;
+}
+
+fwError fwServerDestroy(const fwServer server) {
+    struct fwiServer* nativeServer = {(struct fwiServer*)server};
+    if (nativeServer == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    for (uint32_t i = 0; i < nativeServer->workerCount; i++) {
+        if (nativeServer->workers[i].running) {
+            fwEventLoopStop(nativeServer->workers[i].loop);
+        }
+    }
+
+    for (uint32_t i = 0; i < nativeServer->workerCount; i++) {
+        struct fwiServerWorker* worker = &nativeServer->workers[i];
+        if (worker->running) {
+            pthread_join(worker->thread, nullptr);
+        }
+        if (worker->loop != 0) {
+            fwEventLoopDestroy(worker->loop);
+        }
+        if (worker->listener != 0) {
+            fwSocketClose(worker->listener);
+        }
+    }
+    free(nativeServer);
+
+    FWI_LOG_A(fwiLogDomainNetwork, fwiLogLevelInfo, "Server (ID: %lX) was destroyed",
+              (unsigned long)server);
+    return fwErrorSuccess;
+}
+
+#endif // PLATFORM_LINUX
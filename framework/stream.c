@@ -0,0 +1,235 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the platform independant file stream,
+// which reads ahead through a file queue
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "framework.h"
+#include "internal.h"
+
+#define FWI_FILE_STREAM_DEFAULT_CHUNK (1u << 20)
+#define FWI_FILE_STREAM_DEFAULT_BUFFERS 2
+#define FWI_FILE_STREAM_DEFAULT_DIRECT_BUFFERS 4
+#define FWI_FILE_STREAM_ALIGNMENT 4'096
+
+/**
+ * @brief State behind an @c fwFileStream handle. Chunk n is read into buffer n % bufferCount.
+ * @param nextChunk The chunk handed out by the next call to @c fwFileStreamNext
+ * @param issuedChunk The chunk read next
+ * @param holding Whether the caller still holds the buffer of the chunk before @c nextChunk
+ * @param checksum Checksum of every chunk handed out so far
+ */
+struct fwiFileStream {
+    fwFile file;
+    fwFileQueue queue;
+    uint8_t* buffers_p;
+    uint64_t* bytes_p;
+    fwError* errors_p;
+    bool* ready_p;
+    uint64_t chunkCount;
+    uint64_t nextChunk;
+    uint64_t issuedChunk;
+    uint32_t chunkSize;
+    uint32_t bufferCount;
+    bool holding;
+    fwChecksum checksum;
+};
+
+/**
+ * @brief Starts reading into every buffer that is neither held by the caller nor being read.
+ */
+static fwError fwiFileStreamIssue(struct fwiFileStream* stream_p) {
+    const uint64_t limit = stream_p->nextChunk - stream_p->holding + stream_p->bufferCount;
+
+    while (stream_p->issuedChunk < stream_p->chunkCount && stream_p->issuedChunk < limit) {
+        const uint32_t slot = stream_p->issuedChunk % stream_p->bufferCount;
+        const fwFileRead read = {
+            .file     = stream_p->file,
+            .buffer_p = stream_p->buffers_p + (uint64_t)slot * stream_p->chunkSize,
+            .offset   = stream_p->issuedChunk * stream_p->chunkSize,
+            .size     = stream_p->chunkSize,
+            .userData = stream_p->issuedChunk
+        };
+
+        uint32_t submitted = 0;
+        const fwError result = fwFileQueueSubmit(stream_p->queue, &read, 1, &submitted);
+        if (result != fwErrorSuccess) {
+            return result;
+        }
+        if (submitted == 0) {
+            break;
+        }
+        stream_p->issuedChunk++;
+    }
+
+    return fwErrorSuccess;
+}
+
+fwError fwFileStreamOpen(const char* filename_p, const fwFileStreamInfo* info_p,
+                         fwFileStream* stream_p) {
+    struct fwiFileStream* stream = calloc(1, sizeof(struct fwiFileStream));
+    if (stream == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+
+    const fwChecksumType checksum = info_p != nullptr ? info_p->checksum : fwChecksumTypeNone;
+    if (fwChecksumBegin(&stream->checksum, checksum) != fwErrorSuccess) {
+        free(stream);
+        return fwErrorInvalidParameter;
+    }
+
+    const bool direct = info_p != nullptr && (info_p->flags & fwFileStreamFlagDirect);
+    stream->chunkSize   = info_p != nullptr && info_p->chunkSize != 0 ?
+                          info_p->chunkSize : FWI_FILE_STREAM_DEFAULT_CHUNK;
+    stream->bufferCount = info_p != nullptr && info_p->buffers != 0 ? info_p->buffers :
+                          direct ? FWI_FILE_STREAM_DEFAULT_DIRECT_BUFFERS :
+                                   FWI_FILE_STREAM_DEFAULT_BUFFERS;
+
+    fwError ret = fwFileOpen(filename_p, direct ? fwFileOpenFlagDirect : fwFileOpenFlagNone,
+                             &stream->file);
+    if (ret != fwErrorSuccess) {
+        free(stream);
+        return ret;
+    }
+
+    // Direct reads need aligned chunks, the last one then reads past the end and comes back short
+    uint32_t alignment;
+    fwFileGetAlignment(stream->file, &alignment);
+    stream->chunkSize = (stream->chunkSize + alignment - 1) / alignment * alignment;
+    const uint32_t bufferAlignment = alignment > FWI_FILE_STREAM_ALIGNMENT ?
+                                     alignment : FWI_FILE_STREAM_ALIGNMENT;
+
+    uint64_t size;
+    fwFileGetSize(stream->file, &size);
+    stream->chunkCount = (size + stream->chunkSize - 1) / stream->chunkSize;
+
+    // Page aligned so the kernel can read straight into them
+    const uint64_t bufferBytes = ((uint64_t)stream->chunkSize * stream->bufferCount +
+                                  bufferAlignment - 1) / bufferAlignment * bufferAlignment;
+    stream->buffers_p = fwiAllocate(fwiLogDomainBase, bufferBytes, bufferAlignment);
+    stream->bytes_p   = calloc(stream->bufferCount, sizeof(uint64_t));
+    stream->errors_p  = calloc(stream->bufferCount, sizeof(fwError));
+    stream->ready_p   = calloc(stream->bufferCount, sizeof(bool));
+
+    if (stream->buffers_p == nullptr || stream->bytes_p == nullptr ||
+        stream->errors_p == nullptr || stream->ready_p == nullptr) {
+        ret = fwErrorOutOfMemory;
+    }
+    else {
+        ret = fwFileQueueCreate(stream->bufferCount, fwFileQueueFlagNone, &stream->queue);
+    }
+
+    if (ret == fwErrorSuccess) {
+        // Registration only saves work per read, the stream works without it
+        const fwFileBuffer buffers = {stream->buffers_p, bufferBytes};
+        fwFileQueueRegisterBuffers(stream->queue, &buffers, 1);
+        fwFileQueueRegisterFiles(stream->queue, &stream->file, 1);
+
+        ret = fwiFileStreamIssue(stream);
+    }
+
+    if (ret != fwErrorSuccess) {
+        fwFileStreamClose((uintptr_t)stream);
+        return ret;
+    }
+
+    *stream_p = (uintptr_t)stream;
+    return fwErrorSuccess;
+}
+
+fwError fwFileStreamNext(const fwFileStream stream, const void** chunk_pp, uint64_t* size_p) {
+    struct fwiFileStream* fileStream = {(struct fwiFileStream*)stream};
+    if (fileStream == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // The chunk handed out last is done with, its buffer can be read into again
+    fileStream->holding = false;
+    fwError ret = fwiFileStreamIssue(fileStream);
+    if (ret != fwErrorSuccess) {
+        return ret;
+    }
+
+    *chunk_pp = nullptr;
+    *size_p   = 0;
+    if (fileStream->nextChunk >= fileStream->chunkCount) {
+        return fwErrorSuccess;
+    }
+
+    const uint32_t slot = fileStream->nextChunk % fileStream->bufferCount;
+    while (!fileStream->ready_p[slot]) {
+        fwFileCompletion completions[8];
+        uint32_t count = 0;
+        ret = fwFileQueueComplete(fileStream->queue, completions, 8, 1, &count);
+        if (ret != fwErrorSuccess) {
+            return ret;
+        }
+
+        for (uint32_t i = 0; i < count; i++) {
+            const uint32_t completedSlot = completions[i].userData % fileStream->bufferCount;
+            fileStream->bytes_p[completedSlot]  = completions[i].bytes;
+            fileStream->errors_p[completedSlot] = completions[i].error;
+            fileStream->ready_p[completedSlot]  = true;
+        }
+    }
+
+    fileStream->ready_p[slot] = false;
+    fileStream->holding = true;
+    fileStream->nextChunk++;
+
+    if (fileStream->errors_p[slot] != fwErrorSuccess) {
+        return fileStream->errors_p[slot];
+    }
+
+    *chunk_pp = fileStream->buffers_p + (uint64_t)slot * fileStream->chunkSize;
+    *size_p   = fileStream->bytes_p[slot];
+
+    // Summing pulls the chunk into the cache, the caller works on it while it is still there
+    fwChecksumUpdate(&fileStream->checksum, *chunk_pp, *size_p);
+    return fwErrorSuccess;
+}
+
+fwError fwFileStreamGetChecksum(const fwFileStream stream, uint64_t* value_p) {
+    const struct fwiFileStream* fileStream = {(const struct fwiFileStream*)stream};
+    if (fileStream == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    return fwChecksumEnd(&fileStream->checksum, value_p);
+}
+
+fwError fwFileStreamClose(const fwFileStream stream) {
+    struct fwiFileStream* fileStream = {(struct fwiFileStream*)stream};
+    if (fileStream == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Destroying the queue waits for reads that still write into the buffers
+    if (fileStream->queue != 0) {
+        fwFileQueueDestroy(fileStream->queue);
+    }
+    if (fileStream->file != 0) {
+        fwFileClose(fileStream->file);
+    }
+
+    free(fileStream->ready_p);
+    free(fileStream->errors_p);
+    free(fileStream->bytes_p);
+    fwFree(fileStream->buffers_p);
+    free(fileStream);
+    return fwErrorSuccess;
+}
@@ -0,0 +1,338 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the platform independant event tracer
+// and its export to the Chrome trace event format
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "framework.h"
+#include "internal.h"
+
+static pthread_once_t traceThreadKeyOnce_s = PTHREAD_ONCE_INIT;
+static pthread_key_t traceThreadKey_s;
+static thread_local struct fwiTraceThread* traceThread_s = nullptr;
+
+static void fwiReleaseTraceThread(void* thread_p) {
+    atomic_store_explicit(&((struct fwiTraceThread*)thread_p)->owned, false,
+                          memory_order_release);
+}
+
+static void fwiCreateTraceThreadKey(void) {
+    pthread_key_create(&traceThreadKey_s, fwiReleaseTraceThread);
+}
+
+static struct fwiTraceThread* fwiAcquireTraceThread(void) {
+    if (traceThread_s != nullptr) {
+        return traceThread_s;
+    }
+
+    pthread_once(&traceThreadKeyOnce_s, fwiCreateTraceThreadKey);
+
+    struct fwiTraceThread* thread = atomic_load_explicit(&fwiGetState()->traceThreads,
+                                                         memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&thread->owned, &expected, true)) {
+            break;
+        }
+    }
+
+    if (thread == nullptr) {
+        thread = calloc(1, sizeof(struct fwiTraceThread));
+        if (thread == nullptr) {
+            return nullptr;
+        }
+        thread->id = atomic_fetch_add(&fwiGetState()->traceThreadCount, 1) + 1;
+        atomic_store_explicit(&thread->owned, true, memory_order_relaxed);
+
+        struct fwiTraceThread* head = atomic_load_explicit(&fwiGetState()->traceThreads,
+                                                           memory_order_relaxed);
+        do {
+            thread->next = head;
+        } while (!atomic_compare_exchange_weak_explicit(&fwiGetState()->traceThreads, &head,
+                                                        thread, memory_order_release,
+                                                        memory_order_relaxed));
+    }
+
+    pthread_setspecific(traceThreadKey_s, thread);
+    traceThread_s = thread;
+    return thread;
+}
+
+/**
+ * @brief Rewinds the chunks of a thread if they still hold events of a previous trace.
+ */
+static void fwiTraceThreadRewind(struct fwiTraceThread* thread_p) {
+    const uint32_t epoch = atomic_load_explicit(&fwiGetState()->traceEpoch, memory_order_acquire);
+    if (atomic_load_explicit(&thread_p->epoch, memory_order_relaxed) == epoch) {
+        return;
+    }
+
+    struct fwiTraceChunk* chunk = atomic_load_explicit(&thread_p->first, memory_order_relaxed);
+    thread_p->current = chunk;
+    for (; chunk != nullptr; chunk = atomic_load_explicit(&chunk->next, memory_order_relaxed)) {
+        atomic_store_explicit(&chunk->count, 0, memory_order_relaxed);
+    }
+    atomic_store_explicit(&thread_p->dropped, 0, memory_order_relaxed);
+    atomic_store_explicit(&thread_p->epoch, epoch, memory_order_release);
+}
+
+/**
+ * @brief Returns a chunk with room for one more event, or nullptr if the thread is out of chunks.
+ */
+static struct fwiTraceChunk* fwiTraceChunkWithRoom(struct fwiTraceThread* thread_p) {
+    struct fwiTraceChunk* chunk = thread_p->current;
+    if (chunk != nullptr &&
+        atomic_load_explicit(&chunk->count, memory_order_relaxed) < FWI_TRACE_CHUNK_EVENTS) {
+        return chunk;
+    }
+
+    // Chunks of an earlier trace are reused before new ones are allocated
+    struct fwiTraceChunk* next = chunk == nullptr ?
+        atomic_load_explicit(&thread_p->first, memory_order_relaxed) :
+        atomic_load_explicit(&chunk->next, memory_order_relaxed);
+    if (next != nullptr) {
+        thread_p->current = next;
+        return next;
+    }
+
+    if (thread_p->chunkCount >= FWI_TRACE_MAX_CHUNKS ||
+        (next = calloc(1, sizeof(struct fwiTraceChunk))) == nullptr) {
+        return nullptr;
+    }
+    thread_p->chunkCount++;
+
+    if (chunk == nullptr) {
+        atomic_store_explicit(&thread_p->first, next, memory_order_release);
+    }
+    else {
+        atomic_store_explicit(&chunk->next, next, memory_order_release);
+    }
+    thread_p->current = next;
+    return next;
+}
+
+void fwiTraceEnd(const fwiTraceType type, const uint64_t begin, const uint64_t object,
+                 const uint64_t value) {
+    if (begin == 0) {
+        return;
+    }
+    const uint64_t end = fwiProfileTicks();
+
+    struct fwiTraceThread* thread = fwiAcquireTraceThread();
+    if (thread == nullptr) {
+        return;
+    }
+    fwiTraceThreadRewind(thread);
+
+    struct fwiTraceChunk* chunk = fwiTraceChunkWithRoom(thread);
+    if (chunk == nullptr) {
+        atomic_fetch_add_explicit(&thread->dropped, 1, memory_order_relaxed);
+        return;
+    }
+
+    const uint32_t count = atomic_load_explicit(&chunk->count, memory_order_relaxed);
+    chunk->events[count] = (struct fwiTraceEvent){
+        .begin = begin,
+        .end = end,
+        .object = object,
+        .value = value,
+        .type = type
+    };
+    atomic_store_explicit(&chunk->count, count + 1, memory_order_release);
+}
+
+fwError fwTraceStart(const char* filename_p) {
+    if (filename_p == nullptr || strlen(filename_p) >= sizeof(fwiGetState()->traceFilename)) {
+        return fwErrorInvalidParameter;
+    }
+
+    strcpy(fwiGetState()->traceFilename, filename_p);
+    fwiGetState()->traceStart = fwiProfileTicks();
+    atomic_fetch_add_explicit(&fwiGetState()->traceEpoch, 1, memory_order_release);
+    atomic_store_explicit(&fwiGetState()->tracingIsUp, true, memory_order_release);
+
+    return fwErrorSuccess;
+}
+
+static const char* fwiModuleName(const uint64_t module) {
+    switch (module) {
+        case fwModuleWindow: {
+            return "Window";
+        }
+        case fwModuleRender: {
+            return "Render";
+        }
+        case fwModuleNetwork: {
+            return "Network";
+        }
+        case fwModuleMultimedia: {
+            return "Multimedia";
+        }
+        default: {
+            return "Unknown";
+        }
+    }
+}
+
+/**
+ * @brief Writes a string as a quoted JSON string, zone names are chosen by the application and
+ *        may contain quotes, backslashes or control characters.
+ */
+static void fwiTraceWriteString(FILE* file_p, const char* string_p) {
+    fputc('"', file_p);
+    for (const char* it = string_p; *it != '\0'; it++) {
+        const unsigned char character = (unsigned char)*it;
+        if (character == '"' || character == '\\') {
+            fputc('\\', file_p);
+            fputc(character, file_p);
+        }
+        else if (character < 0x20) {
+            fprintf(file_p, "\\u%04x", character);
+        }
+        else {
+            fputc(character, file_p);
+        }
+    }
+    fputc('"', file_p);
+}
+
+/**
+ * @brief Writes one event as a complete ("X") event, the arguments depend on its type.
+ */
+static void fwiTraceWriteEvent(FILE* file_p, const struct fwiTraceEvent* event_p,
+                               const uint32_t tid, const int pid) {
+    static const char* names_s[fwiTraceTypeCount] = {
+        [fwiTraceTypeZone]           = "",
+        [fwiTraceTypeModuleStart]    = "Module start",
+        [fwiTraceTypeModuleStop]     = "Module stop",
+        [fwiTraceTypeSocketCreate]   = "Socket create",
+        [fwiTraceTypeSocketConnect]  = "Socket connect",
+        [fwiTraceTypeSocketAccept]   = "Socket accept",
+        [fwiTraceTypeSocketClose]    = "Socket close",
+        [fwiTraceTypeSocketSend]     = "Socket send",
+        [fwiTraceTypeSocketSendFile] = "Socket send file",
+        [fwiTraceTypeSocketSendV]    = "Socket send vector",
+        [fwiTraceTypeSocketReceive]  = "Socket receive",
+        [fwiTraceTypeSocketReceiveV] = "Socket receive vector",
+        [fwiTraceTypeFileLoad]       = "File load",
+        [fwiTraceTypeFileMap]        = "File map"
+    };
+
+    // Zones that began before the trace started are clamped to its start
+    const uint64_t start = fwiGetState()->traceStart;
+    const uint64_t begin = event_p->begin > start ? event_p->begin - start : 0;
+    const uint64_t end = event_p->end > start ? event_p->end - start : 0;
+    const double ts = (double)fwiProfileTicksToNanoseconds(begin) / 1000.0;
+    const double dur = (double)fwiProfileTicksToNanoseconds(end - begin) / 1000.0;
+
+    fprintf(file_p, ",\n{\"ph\":\"X\",\"pid\":%d,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f,", pid, tid,
+            ts, dur);
+
+    switch (event_p->type) {
+        case fwiTraceTypeZone: {
+            fputs("\"cat\":\"zone\",\"name\":", file_p);
+            fwiTraceWriteString(file_p, fwiProfileZoneName((fwProfileZone)event_p->object));
+            fputc('}', file_p);
+            break;
+        }
+        case fwiTraceTypeModuleStart:
+        case fwiTraceTypeModuleStop: {
+            fprintf(file_p, "\"cat\":\"module\",\"name\":\"%s\","
+                    "\"args\":{\"module\":\"%s\",\"result\":%lu}}", names_s[event_p->type],
+                    fwiModuleName(event_p->object), (unsigned long)event_p->value);
+            break;
+        }
+        case fwiTraceTypeSocketSend:
+        case fwiTraceTypeSocketSendFile:
+        case fwiTraceTypeSocketSendV:
+        case fwiTraceTypeSocketReceive:
+        case fwiTraceTypeSocketReceiveV: {
+            fprintf(file_p, "\"cat\":\"socket\",\"name\":\"%s\","
+                    "\"args\":{\"socket\":\"0x%lx\",\"bytes\":%lu}}", names_s[event_p->type],
+                    (unsigned long)event_p->object, (unsigned long)event_p->value);
+            break;
+        }
+        case fwiTraceTypeFileLoad:
+        case fwiTraceTypeFileMap: {
+            fprintf(file_p, "\"cat\":\"file\",\"name\":\"%s\",\"args\":{\"bytes\":%lu}}",
+                    names_s[event_p->type], (unsigned long)event_p->value);
+            break;
+        }
+        default: {
+            fprintf(file_p, "\"cat\":\"socket\",\"name\":\"%s\","
+                    "\"args\":{\"socket\":\"0x%lx\",\"result\":%lu}}", names_s[event_p->type],
+                    (unsigned long)event_p->object, (unsigned long)event_p->value);
+            break;
+        }
+    }
+}
+
+fwError fwTraceStop(void) {
+    if (!atomic_exchange(&fwiGetState()->tracingIsUp, false)) {
+        return fwErrorSuccess;
+    }
+
+    FILE* file = fopen(fwiGetState()->traceFilename, "w");
+    if (file == nullptr) {
+        FWI_LOG_A(fwiLogDomainBase, fwiLogLevelWarning, "Unable to write trace file %s",
+                  fwiGetState()->traceFilename);
+        return fwErrorFileUnableToOpen;
+    }
+
+    const int pid = (int)getpid();
+    const uint32_t epoch = atomic_load_explicit(&fwiGetState()->traceEpoch, memory_order_acquire);
+    uint64_t events = 0, dropped = 0;
+
+    fprintf(file, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n"
+            "{\"ph\":\"M\",\"pid\":%d,\"name\":\"process_name\",\"args\":{\"name\":\"LPAF\"}}",
+            pid);
+
+    struct fwiTraceThread* thread = atomic_load_explicit(&fwiGetState()->traceThreads,
+                                                         memory_order_acquire);
+    for (; thread != nullptr; thread = thread->next) {
+        if (atomic_load_explicit(&thread->epoch, memory_order_acquire) != epoch) {
+            continue;
+        }
+
+        fprintf(file, ",\n{\"ph\":\"M\",\"pid\":%d,\"tid\":%u,\"name\":\"thread_name\","
+                "\"args\":{\"name\":\"Thread %u\"}}", pid, thread->id, thread->id);
+
+        struct fwiTraceChunk* chunk = atomic_load_explicit(&thread->first, memory_order_acquire);
+        for (; chunk != nullptr; chunk = atomic_load_explicit(&chunk->next, memory_order_acquire)) {
+            const uint32_t count = atomic_load_explicit(&chunk->count, memory_order_acquire);
+            for (uint32_t i = 0; i < count; i++) {
+                fwiTraceWriteEvent(file, &chunk->events[i], thread->id, pid);
+            }
+            events += count;
+        }
+        dropped += atomic_load_explicit(&thread->dropped, memory_order_relaxed);
+    }
+
+    fprintf(file, "\n]}\n");
+    const bool failed = ferror(file) != 0;
+    if (fclose(file) != 0 || failed) {
+        FWI_LOG_A(fwiLogDomainBase, fwiLogLevelWarning, "Unable to write trace file %s",
+                  fwiGetState()->traceFilename);
+        return fwErrorFileUnableToOpen;
+    }
+
+    FWI_LOG_A(fwiLogDomainBase, fwiLogLevelInfo, "Wrote %lu trace events to %s, %lu dropped",
+              (unsigned long)events, fwiGetState()->traceFilename, (unsigned long)dropped);
+    return fwErrorSuccess;
+}
@@ -0,0 +1,188 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains a minimal io_uring wrapper on top of the raw system calls, so
+// that the framework does not depend on liburing
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+fwError fwiUringCreate(struct fwiUring* ring_p, const uint32_t entries, const uint32_t flags) {
+    memset(ring_p, 0, sizeof(struct fwiUring));
+
+    struct io_uring_params params = {};
+    params.flags = flags;
+
+    ring_p->fileDescriptor = (int32_t)syscall(__NR_io_uring_setup, entries, &params);
+    if (ring_p->fileDescriptor < 0) {
+        return errno == ENOMEM ? fwErrorOutOfMemory : fwErrorUnimplemented;
+    }
+    ring_p->features = params.features;
+
+    ring_p->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    ring_p->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    ring_p->sqesSize   = params.sq_entries * sizeof(struct io_uring_sqe);
+
+    // Newer kernels put both rings into a single mapping
+    if (ring_p->features & IORING_FEAT_SINGLE_MMAP) {
+        if (ring_p->cqRingSize > ring_p->sqRingSize) {
+            ring_p->sqRingSize = ring_p->cqRingSize;
+        }
+        ring_p->cqRingSize = ring_p->sqRingSize;
+    }
+
+    ring_p->sqRing_p = mmap(nullptr, ring_p->sqRingSize, PROT_READ | PROT_WRITE,
+                            MAP_SHARED | MAP_POPULATE, ring_p->fileDescriptor, IORING_OFF_SQ_RING);
+    if (ring_p->sqRing_p == MAP_FAILED) {
+        close(ring_p->fileDescriptor);
+        return fwErrorOutOfMemory;
+    }
+
+    if (ring_p->features & IORING_FEAT_SINGLE_MMAP) {
+        ring_p->cqRing_p = ring_p->sqRing_p;
+    }
+    else {
+        ring_p->cqRing_p = mmap(nullptr, ring_p->cqRingSize, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring_p->fileDescriptor,
+                                IORING_OFF_CQ_RING);
+        if (ring_p->cqRing_p == MAP_FAILED) {
+            munmap(ring_p->sqRing_p, ring_p->sqRingSize);
+            close(ring_p->fileDescriptor);
+            return fwErrorOutOfMemory;
+        }
+    }
+
+    ring_p->sqes_p = mmap(nullptr, ring_p->sqesSize, PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE, ring_p->fileDescriptor, IORING_OFF_SQES);
+    if (ring_p->sqes_p == MAP_FAILED) {
+        if (ring_p->cqRing_p != ring_p->sqRing_p) {
+            munmap(ring_p->cqRing_p, ring_p->cqRingSize);
+        }
+        munmap(ring_p->sqRing_p, ring_p->sqRingSize);
+        close(ring_p->fileDescriptor);
+        return fwErrorOutOfMemory;
+    }
+
+    uint8_t* sqRing = ring_p->sqRing_p;
+    ring_p->sqHead_p       = (_Atomic uint32_t*)(sqRing + params.sq_off.head);
+    ring_p->sqKernelTail_p = (_Atomic uint32_t*)(sqRing + params.sq_off.tail);
+    ring_p->sqArray_p      = (uint32_t*)(sqRing + params.sq_off.array);
+    ring_p->sqMask         = *(uint32_t*)(sqRing + params.sq_off.ring_mask);
+    ring_p->sqEntries      = *(uint32_t*)(sqRing + params.sq_off.ring_entries);
+    ring_p->sqTail         = atomic_load_explicit(ring_p->sqKernelTail_p, memory_order_relaxed);
+
+    uint8_t* cqRing = ring_p->cqRing_p;
+    ring_p->cqHead_p = (_Atomic uint32_t*)(cqRing + params.cq_off.head);
+    ring_p->cqTail_p = (_Atomic uint32_t*)(cqRing + params.cq_off.tail);
+    ring_p->cqMask   = *(uint32_t*)(cqRing + params.cq_off.ring_mask);
+    ring_p->cqes_p   = (struct io_uring_cqe*)(cqRing + params.cq_off.cqes);
+
+    return fwErrorSuccess;
+}
+
+void fwiUringDestroy(struct fwiUring* ring_p) {
+    munmap(ring_p->sqes_p, ring_p->sqesSize);
+    if (ring_p->cqRing_p != ring_p->sqRing_p) {
+        munmap(ring_p->cqRing_p, ring_p->cqRingSize);
+    }
+    munmap(ring_p->sqRing_p, ring_p->sqRingSize);
+    close(ring_p->fileDescriptor);
+    memset(ring_p, 0, sizeof(struct fwiUring));
+}
+
+struct io_uring_sqe* fwiUringGetSqe(struct fwiUring* ring_p) {
+    const uint32_t head = atomic_load_explicit(ring_p->sqHead_p, memory_order_acquire);
+    if (ring_p->sqTail - head >= ring_p->sqEntries) {
+        return nullptr;
+    }
+
+    const uint32_t index = ring_p->sqTail & ring_p->sqMask;
+    struct io_uring_sqe* sqe = &ring_p->sqes_p[index];
+    memset(sqe, 0, sizeof(struct io_uring_sqe));
+
+    // The indirection array maps one to one, it is filled here so that the kernel sees it in
+    // order with the entry
+    ring_p->sqArray_p[index] = index;
+    ring_p->sqTail++;
+    return sqe;
+}
+
+int32_t fwiUringSubmit(struct fwiUring* ring_p, const uint32_t waitFor) {
+    // Counted from what the kernel consumed, entries left over by a failed or partial call go in
+    // again
+    const uint32_t submitted = ring_p->sqTail -
+                               atomic_load_explicit(ring_p->sqHead_p, memory_order_acquire);
+    atomic_store_explicit(ring_p->sqKernelTail_p, ring_p->sqTail, memory_order_release);
+
+    if (submitted == 0 && waitFor == 0) {
+        return 0;
+    }
+
+    int32_t result;
+    do {
+        result = (int32_t)syscall(__NR_io_uring_enter, ring_p->fileDescriptor, submitted, waitFor,
+                                  waitFor != 0 ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+    } while (result < 0 && errno == EINTR);
+
+    return result < 0 ? -errno : result;
+}
+
+int32_t fwiUringWait(struct fwiUring* ring_p, const int32_t timeout) {
+    // Counted from what the kernel consumed, entries left over by a failed call go in again
+    const uint32_t submitted = ring_p->sqTail -
+                               atomic_load_explicit(ring_p->sqHead_p, memory_order_acquire);
+    atomic_store_explicit(ring_p->sqKernelTail_p, ring_p->sqTail, memory_order_release);
+
+    // Entering for completions also runs the work the kernel deferred to this thread, so it is
+    // done even when only looking
+    struct __kernel_timespec time = {.tv_sec  = timeout / 1'000,
+                                     .tv_nsec = (timeout % 1'000) * 1'000'000ll};
+    struct io_uring_getevents_arg argument = {.ts = (uint64_t)(uintptr_t)&time};
+    const bool limited = timeout > 0;
+
+    const int32_t result = (int32_t)syscall(
+        __NR_io_uring_enter, ring_p->fileDescriptor, submitted, timeout != 0 ? 1 : 0,
+        IORING_ENTER_GETEVENTS | (limited ? IORING_ENTER_EXT_ARG : 0),
+        limited ? &argument : nullptr, limited ? sizeof(argument) : 0);
+    return result < 0 ? -errno : result;
+}
+
+struct io_uring_cqe* fwiUringPeekCqe(struct fwiUring* ring_p) {
+    const uint32_t head = atomic_load_explicit(ring_p->cqHead_p, memory_order_relaxed);
+    if (head == atomic_load_explicit(ring_p->cqTail_p, memory_order_acquire)) {
+        return nullptr;
+    }
+    return &ring_p->cqes_p[head & ring_p->cqMask];
+}
+
+void fwiUringCqeSeen(struct fwiUring* ring_p) {
+    atomic_fetch_add_explicit(ring_p->cqHead_p, 1, memory_order_release);
+}
+
+int32_t fwiUringRegister(struct fwiUring* ring_p, const uint32_t opcode, const void* argument_p,
+                         const uint32_t count) {
+    const int32_t result = (int32_t)syscall(__NR_io_uring_register, ring_p->fileDescriptor, opcode,
+                                            argument_p, count);
+    return result < 0 ? -errno : result;
+}
+
+#endif // PLATFORM_LINUX
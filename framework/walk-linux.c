@@ -0,0 +1,530 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific directory walker, which
+// reads directories through getdents64 and spreads them over several threads
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+
+/**
+ * @brief Size of the buffer that one getdents64 call fills, a few hundred entries for typical
+ *        names.
+ */
+#define FWI_WALK_BUFFER_SIZE (64u << 10)
+
+/**
+ * @brief Upper bound for the threads of one walk.
+ */
+#define FWI_WALK_MAX_THREADS 32
+
+/**
+ * @brief Layout of the records returned by getdents64.
+ */
+struct fwiDirectoryEntry {
+    uint64_t inode;
+    int64_t offset;
+    uint16_t length;
+    uint8_t type;
+    char name[];
+};
+
+/**
+ * @brief A directory waiting to be read.
+ * @param length Length of the path without the terminator
+ */
+struct fwiWalkDirectory {
+    struct fwiWalkDirectory* next;
+    uint32_t depth;
+    uint32_t length;
+    char path[];
+};
+
+/**
+ * @brief Shared state of a walk.
+ * @param pending_p Directories not yet picked up, read last in first out to keep the list short
+ * @param active Directories that are either pending or being read, the walk is done at zero
+ * @param error First error of the walk, later ones are dropped
+ */
+struct fwiWalk {
+    const fwWalkInfo* info_p;
+    size_t extensionLength;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t workAvailable;
+    struct fwiWalkDirectory* pending_p;
+    uint32_t active;
+
+    _Atomic bool stop;
+    _Atomic fwError error;
+};
+
+/**
+ * @brief Buffers of one walking thread, reused for every directory it reads.
+ * @param text_p Paths of the current batch, one after the other with their terminators
+ * @param offsets_p Offset of every path within @c text_p , turned into pointers once the batch is
+ *                  complete since @c text_p may move while it grows
+ */
+struct fwiWalkThread {
+    struct fwiWalk* walk_p;
+    uint8_t* buffer_p;
+
+    char* text_p;
+    size_t textSize;
+    size_t textCapacity;
+
+    size_t* offsets_p;
+    const char** paths_p;
+    uint8_t* types_p;
+    fwLoadedFile* files_p;
+    uint32_t capacity;
+};
+
+static void fwiWalkFail(struct fwiWalk* walk_p, const fwError error) {
+    fwError expected = fwErrorSuccess;
+    atomic_compare_exchange_strong(&walk_p->error, &expected, error);
+
+    if (error == fwErrorOutOfMemory) {
+        pthread_mutex_lock(&walk_p->mutex);
+        atomic_store(&walk_p->stop, true);
+        pthread_cond_broadcast(&walk_p->workAvailable);
+        pthread_mutex_unlock(&walk_p->mutex);
+    }
+}
+
+/**
+ * @brief Hands directories found by one thread to every thread of the walk.
+ */
+static void fwiWalkPush(struct fwiWalk* walk_p, struct fwiWalkDirectory* first_p,
+                        struct fwiWalkDirectory* last_p, const uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    pthread_mutex_lock(&walk_p->mutex);
+    last_p->next = walk_p->pending_p;
+    walk_p->pending_p = first_p;
+    walk_p->active += count;
+    if (count == 1) {
+        pthread_cond_signal(&walk_p->workAvailable);
+    }
+    else {
+        pthread_cond_broadcast(&walk_p->workAvailable);
+    }
+    pthread_mutex_unlock(&walk_p->mutex);
+}
+
+static struct fwiWalkDirectory* fwiWalkCreateDirectory(const char* parent_p,
+                                                       const uint32_t parentLength,
+                                                       const char* name_p, const uint32_t depth) {
+    const size_t nameLength = strlen(name_p);
+    const bool separator = nameLength != 0 && parent_p[parentLength - 1] != '/';
+    const size_t length = parentLength + separator + nameLength;
+
+    struct fwiWalkDirectory* directory = malloc(sizeof(struct fwiWalkDirectory) + length + 1);
+    if (directory == nullptr) {
+        return nullptr;
+    }
+    directory->next   = nullptr;
+    directory->depth  = depth;
+    directory->length = (uint32_t)length;
+    memcpy(directory->path, parent_p, parentLength);
+    if (separator) {
+        directory->path[parentLength] = '/';
+    }
+    memcpy(directory->path + parentLength + separator, name_p, nameLength + 1);
+    return directory;
+}
+
+static bool fwiWalkAdd(struct fwiWalkThread* thread_p, const struct fwiWalkDirectory* directory_p,
+                       const char* name_p, const fwWalkType type, const uint32_t count) {
+    if (count == thread_p->capacity) {
+        const uint32_t capacity = thread_p->capacity == 0 ? 256 : thread_p->capacity * 2;
+        size_t* offsets = realloc(thread_p->offsets_p, capacity * sizeof(size_t));
+        if (offsets != nullptr) {
+            thread_p->offsets_p = offsets;
+        }
+        const char** paths = realloc(thread_p->paths_p, capacity * sizeof(const char*));
+        if (paths != nullptr) {
+            thread_p->paths_p = paths;
+        }
+        uint8_t* types = realloc(thread_p->types_p, capacity);
+        if (types != nullptr) {
+            thread_p->types_p = types;
+        }
+        fwLoadedFile* files = realloc(thread_p->files_p, capacity * sizeof(fwLoadedFile));
+        if (files != nullptr) {
+            thread_p->files_p = files;
+        }
+        if (offsets == nullptr || paths == nullptr || types == nullptr || files == nullptr) {
+            return false;
+        }
+        thread_p->capacity = capacity;
+    }
+
+    const size_t nameLength = strlen(name_p);
+    const bool separator = directory_p->path[directory_p->length - 1] != '/';
+    const size_t length = directory_p->length + separator + nameLength + 1;
+    if (thread_p->textSize + length > thread_p->textCapacity) {
+        size_t capacity = thread_p->textCapacity == 0 ? FWI_WALK_BUFFER_SIZE :
+                          thread_p->textCapacity * 2;
+        while (capacity < thread_p->textSize + length) {
+            capacity *= 2;
+        }
+        char* text = realloc(thread_p->text_p, capacity);
+        if (text == nullptr) {
+            return false;
+        }
+        thread_p->text_p       = text;
+        thread_p->textCapacity = capacity;
+    }
+
+    char* path = thread_p->text_p + thread_p->textSize;
+    memcpy(path, directory_p->path, directory_p->length);
+    if (separator) {
+        path[directory_p->length] = '/';
+    }
+    memcpy(path + directory_p->length + separator, name_p, nameLength + 1);
+
+    thread_p->offsets_p[count] = thread_p->textSize;
+    thread_p->types_p[count]   = type;
+    thread_p->textSize        += length;
+    return true;
+}
+
+/**
+ * @brief Hands one batch to the callback, loading its files first if asked to.
+ * @return false if the walk should end
+ */
+static bool fwiWalkDeliver(struct fwiWalkThread* thread_p,
+                           const struct fwiWalkDirectory* directory_p, const uint32_t count) {
+    const fwWalkInfo* info = thread_p->walk_p->info_p;
+
+    for (uint32_t i = 0; i < count; i++) {
+        thread_p->paths_p[i] = thread_p->text_p + thread_p->offsets_p[i];
+    }
+
+    fwWalkBatch batch = {
+        .directory_p = directory_p->path,
+        .paths_p     = thread_p->paths_p,
+        .types_p     = thread_p->types_p,
+        .count       = count,
+        .depth       = directory_p->depth
+    };
+
+    // Every thread loads what it found itself, the threads of the walk keep the disk busy
+    if (info->flags & fwWalkFlagLoad) {
+        batch.files_p = thread_p->files_p;
+        for (uint32_t i = 0; i < count; i++) {
+            fwLoadedFile* file = &thread_p->files_p[i];
+            *file = (fwLoadedFile){};
+            if (thread_p->types_p[i] == fwWalkTypeFile) {
+                file->error = fwLoadFileToMem(thread_p->paths_p[i], &file->buffer_p, &file->size);
+            }
+        }
+    }
+
+    const bool proceed = info->callback(&batch, info->user_p);
+
+    if (info->flags & fwWalkFlagLoad) {
+        for (uint32_t i = 0; i < count; i++) {
+            fwFree(thread_p->files_p[i].buffer_p);
+        }
+    }
+    thread_p->textSize = 0;
+    return proceed;
+}
+
+static fwWalkType fwiWalkGetType(const int32_t directoryDescriptor,
+                                 const struct fwiDirectoryEntry* entry_p, bool* known_p) {
+    *known_p = true;
+    switch (entry_p->type) {
+        case DT_REG: {
+            return fwWalkTypeFile;
+        }
+        case DT_DIR: {
+            return fwWalkTypeDirectory;
+        }
+        case DT_LNK: {
+            return fwWalkTypeLink;
+        }
+        case DT_UNKNOWN: {
+            // Only some file systems leave the kind out, those pay for a stat per entry
+            struct stat entryStats;
+            if (fstatat(directoryDescriptor, entry_p->name, &entryStats, AT_SYMLINK_NOFOLLOW)) {
+                *known_p = false; // gone since it was listed
+                return fwWalkTypeOther;
+            }
+            return S_ISREG(entryStats.st_mode) ? fwWalkTypeFile :
+                   S_ISDIR(entryStats.st_mode) ? fwWalkTypeDirectory :
+                   S_ISLNK(entryStats.st_mode) ? fwWalkTypeLink : fwWalkTypeOther;
+        }
+        default: {
+            return fwWalkTypeOther;
+        }
+    }
+}
+
+/**
+ * @brief Reads one directory, reports its entries and queues its subdirectories.
+ */
+static void fwiWalkRead(struct fwiWalkThread* thread_p,
+                        const struct fwiWalkDirectory* directory_p) {
+    struct fwiWalk* walk = thread_p->walk_p;
+    const fwWalkInfo* info = walk->info_p;
+    const bool descend = info->maxDepth == 0 || directory_p->depth + 1 < info->maxDepth;
+
+    const int32_t directoryDescriptor = open(directory_p->path,
+                                             O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (directoryDescriptor == -1) {
+        fwiWalkFail(walk, directory_p->depth == 0 ? fwErrorFileUnableToOpen : fwErrorFileStats);
+        return;
+    }
+
+    while (!atomic_load_explicit(&walk->stop, memory_order_relaxed)) {
+        const ssize_t filled = syscall(__NR_getdents64, directoryDescriptor, thread_p->buffer_p,
+                                     FWI_WALK_BUFFER_SIZE);
+        if (filled == -1 && errno == EINTR) {
+            continue;
+        }
+        if (filled == -1) {
+            FWI_LOG_ERRNO;
+            fwiWalkFail(walk, fwErrorFileStats);
+            break;
+        }
+        if (filled == 0) {
+            break;
+        }
+
+        struct fwiWalkDirectory* first = nullptr;
+        struct fwiWalkDirectory* last = nullptr;
+        uint32_t found = 0, count = 0;
+        bool failed = false;
+
+        for (ssize_t offset = 0; offset < filled && !failed;) {
+            const struct fwiDirectoryEntry* entry = (const void*)(thread_p->buffer_p + offset);
+            const char* name = entry->name;
+            offset += entry->length;
+
+            if (name[0] == '.' && (name[1] == '\0' || (name[1] == '.' && name[2] == '\0'))) {
+                continue;
+            }
+            if (name[0] == '.' && !(info->flags & fwWalkFlagHidden)) {
+                continue;
+            }
+
+            bool known;
+            const fwWalkType type = fwiWalkGetType(directoryDescriptor, entry, &known);
+            if (!known) {
+                continue;
+            }
+
+            bool report, enter = false;
+            if (type == fwWalkTypeFile) {
+                const size_t nameLength = strlen(name);
+                report = walk->extensionLength == 0 || (nameLength >= walk->extensionLength &&
+                         memcmp(name + nameLength - walk->extensionLength, info->extension_p,
+                                walk->extensionLength) == 0);
+            }
+            else if (type == fwWalkTypeDirectory) {
+                report = info->flags & fwWalkFlagDirectories;
+                enter  = descend;
+            }
+            else {
+                report = info->flags & fwWalkFlagOther;
+            }
+            if (!report && !enter) {
+                continue;
+            }
+            if (info->filter != nullptr &&
+                !info->filter(name, type, directory_p->depth, info->user_p)) {
+                continue;
+            }
+
+            if (enter) {
+                struct fwiWalkDirectory* subdirectory = fwiWalkCreateDirectory(
+                    directory_p->path, directory_p->length, name, directory_p->depth + 1);
+                if (subdirectory == nullptr) {
+                    failed = true;
+                    break;
+                }
+                if (last == nullptr) {
+                    last = subdirectory;
+                }
+                subdirectory->next = first;
+                first = subdirectory;
+                found++;
+            }
+            if (report) {
+                if (!fwiWalkAdd(thread_p, directory_p, name, type, count)) {
+                    failed = true;
+                    break;
+                }
+                count++;
+            }
+        }
+
+        // Subdirectories go out before the batch so that idle threads start on them right away
+        fwiWalkPush(walk, first, last, found);
+        if (failed) {
+            thread_p->textSize = 0;
+            fwiWalkFail(walk, fwErrorOutOfMemory);
+            break;
+        }
+        if (count != 0 && !fwiWalkDeliver(thread_p, directory_p, count)) {
+            pthread_mutex_lock(&walk->mutex);
+            atomic_store(&walk->stop, true);
+            pthread_cond_broadcast(&walk->workAvailable);
+            pthread_mutex_unlock(&walk->mutex);
+            break;
+        }
+    }
+
+    close(directoryDescriptor);
+}
+
+static void* fwiWalkWork(void* thread_p) {
+    struct fwiWalkThread* thread = thread_p;
+    struct fwiWalk* walk = thread->walk_p;
+
+    pthread_mutex_lock(&walk->mutex);
+    while (true) {
+        while (walk->pending_p == nullptr && walk->active != 0 && !atomic_load(&walk->stop)) {
+            pthread_cond_wait(&walk->workAvailable, &walk->mutex);
+        }
+        if (walk->pending_p == nullptr || atomic_load(&walk->stop)) {
+            break;
+        }
+
+        struct fwiWalkDirectory* directory = walk->pending_p;
+        walk->pending_p = directory->next;
+        pthread_mutex_unlock(&walk->mutex);
+
+        fwiWalkRead(thread, directory);
+        free(directory);
+
+        pthread_mutex_lock(&walk->mutex);
+        if (--walk->active == 0) {
+            pthread_cond_broadcast(&walk->workAvailable);
+        }
+    }
+    pthread_mutex_unlock(&walk->mutex);
+
+    return nullptr;
+}
+
+fwError fwWalkDirectory(const char* directory_p, const fwWalkInfo* info_p) {
+    FW_PROFILE_SCOPE(fwiProfileZoneWalkDirectory);
+
+    if (directory_p == nullptr || info_p == nullptr || info_p->callback == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    // Trailing slashes are dropped so that paths come out with exactly one separator
+    uint32_t length = (uint32_t)strlen(directory_p);
+    while (length > 1 && directory_p[length - 1] == '/') {
+        length--;
+    }
+    if (length == 0) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    struct fwiWalk walk = {
+        .info_p          = info_p,
+        .extensionLength = info_p->extension_p != nullptr ? strlen(info_p->extension_p) : 0,
+        .mutex           = PTHREAD_MUTEX_INITIALIZER,
+        .workAvailable   = PTHREAD_COND_INITIALIZER,
+        .active          = 1
+    };
+    atomic_init(&walk.stop, false);
+    atomic_init(&walk.error, fwErrorSuccess);
+
+    walk.pending_p = fwiWalkCreateDirectory(directory_p, length, "", 0);
+    if (walk.pending_p == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+
+    uint32_t threadCount = info_p->threads;
+    if (threadCount == 0) {
+        fwSystemConfiguration system = {};
+        fwGetSystemConfiguration(&system);
+        threadCount = system.cores < 1 ? 1 : system.cores;
+
+        // Loading mostly waits on the disk, more threads keep more requests in the device queue
+        if (info_p->flags & fwWalkFlagLoad) {
+            threadCount *= 2;
+        }
+    }
+    threadCount = threadCount > FWI_WALK_MAX_THREADS ? FWI_WALK_MAX_THREADS : threadCount;
+
+    struct fwiWalkThread threads[FWI_WALK_MAX_THREADS] = {};
+    pthread_t workers[FWI_WALK_MAX_THREADS];
+    uint32_t started = 0;
+    for (uint32_t i = 0; i < threadCount; i++) {
+        threads[i].walk_p = &walk;
+        if ((threads[i].buffer_p = aligned_alloc(8, FWI_WALK_BUFFER_SIZE)) == nullptr) {
+            threadCount = i;
+            break;
+        }
+    }
+
+    if (threadCount == 0) {
+        free(walk.pending_p);
+        return fwErrorOutOfMemory;
+    }
+
+    // The calling thread walks as well, so a single-threaded walk starts no thread at all
+    for (; started + 1 < threadCount; started++) {
+        if (pthread_create(&workers[started], nullptr, fwiWalkWork, &threads[started + 1]) != 0) {
+            break;
+        }
+    }
+    fwiWalkWork(&threads[0]);
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(workers[i], nullptr);
+    }
+
+    // Directories left over after the walk was ended early
+    while (walk.pending_p != nullptr) {
+        struct fwiWalkDirectory* next = walk.pending_p->next;
+        free(walk.pending_p);
+        walk.pending_p = next;
+    }
+
+    for (uint32_t i = 0; i < threadCount; i++) {
+        free(threads[i].buffer_p);
+        free(threads[i].text_p);
+        free(threads[i].offsets_p);
+        free(threads[i].paths_p);
+        free(threads[i].types_p);
+        free(threads[i].files_p);
+    }
+
+    pthread_mutex_destroy(&walk.mutex);
+    pthread_cond_destroy(&walk.workAvailable);
+    return atomic_load(&walk.error);
+}
+
+#endif // PLATFORM_LINUX
@@ -0,0 +1,446 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// This implementation file contains implementations for the Linux-specific, write-behind file
+// writer with group commit
+
+#ifdef PLATFORM_LINUX
+
+#include "internal.h"
+#include "linux.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#define FWI_FILE_WRITER_DEFAULT_BATCH (1u << 20)
+#define FWI_FILE_WRITER_MAX_VECTORS 1'024
+
+/**
+ * @brief Data of one append, linked into the writer's queue and later into its pending list. The
+ *        data follows right behind the node.
+ * @param offset Where in the file the data goes, reserved when it was appended
+ * @param following Next node of the pending list, ordered by offset
+ */
+struct fwiFileWriterNode {
+    _Atomic(struct fwiFileWriterNode*) next;
+    struct fwiFileWriterNode* following;
+    uint64_t offset;
+    uint64_t size;
+};
+
+/**
+ * @brief State behind an @c fwFileWriter handle.
+ * @param head Last node of the queue, producers swap themselves in here
+ * @param tail First node of the queue, touched by the writer thread only
+ * @param stub Keeps the queue from ever running empty, so producers never touch the tail
+ * @param reserved End of all data appended so far, appends reserve their range by advancing it
+ * @param written Everything before it is in the file
+ * @param durable Everything before it is synced to the device
+ * @param syncRequested Largest sequence number somebody waits for to be durable
+ * @param pending_p Nodes taken off the queue that wait for the gap in front of them to fill
+ * @note Appends that race each other may enter the queue in a different order than their ranges,
+ *       the writer only ever writes the range that continues @c written , so the file never has
+ *       holes.
+ */
+struct fwiFileWriter {
+    alignas(64) _Atomic(struct fwiFileWriterNode*) head;
+    alignas(64) _Atomic uint64_t reserved;
+    alignas(64) struct fwiFileWriterNode* tail;
+    struct fwiFileWriterNode stub;
+    struct fwiFileWriterNode* pending_p;
+    struct fwiFileWriterNode* pendingLast_p;
+
+    int32_t fileDescriptor;
+    uint32_t batchSize;
+    _Atomic bool idle;
+    _Atomic bool stopping;
+    _Atomic fwError error;
+    pthread_t thread;
+
+    pthread_mutex_t mutex;
+    pthread_cond_t wake;
+    pthread_cond_t progress;
+    uint64_t written;
+    uint64_t durable;
+    uint64_t syncRequested;
+};
+
+/**
+ * @brief Adds a node to the queue, wait-free apart from the exchange.
+ */
+static void fwiFileWriterPush(struct fwiFileWriter* writer_p, struct fwiFileWriterNode* node_p) {
+    atomic_store_explicit(&node_p->next, nullptr, memory_order_relaxed);
+    struct fwiFileWriterNode* previous = atomic_exchange_explicit(&writer_p->head, node_p,
+                                                                  memory_order_acq_rel);
+
+    // Between the exchange and this store the queue is briefly cut, the writer waits it out
+    atomic_store_explicit(&previous->next, node_p, memory_order_release);
+}
+
+/**
+ * @brief Takes the oldest node off the queue.
+ * @return The node, or nullptr if the queue is empty or a producer is halfway through a push
+ */
+static struct fwiFileWriterNode* fwiFileWriterPop(struct fwiFileWriter* writer_p) {
+    struct fwiFileWriterNode* tail = writer_p->tail;
+    struct fwiFileWriterNode* next = atomic_load_explicit(&tail->next, memory_order_acquire);
+
+    if (tail == &writer_p->stub) {
+        if (next == nullptr) {
+            return nullptr;
+        }
+        writer_p->tail = next;
+        tail = next;
+        next = atomic_load_explicit(&next->next, memory_order_acquire);
+    }
+
+    if (next != nullptr) {
+        writer_p->tail = next;
+        return tail;
+    }
+
+    if (tail != atomic_load_explicit(&writer_p->head, memory_order_acquire)) {
+        return nullptr;
+    }
+
+    // The last node can only leave once the stub is behind it
+    fwiFileWriterPush(writer_p, &writer_p->stub);
+    next = atomic_load_explicit(&tail->next, memory_order_acquire);
+    if (next != nullptr) {
+        writer_p->tail = next;
+        return tail;
+    }
+    return nullptr;
+}
+
+/**
+ * @brief Sorts a node into the pending list, nodes mostly arrive in order so the end is checked
+ *        first.
+ */
+static void fwiFileWriterKeep(struct fwiFileWriter* writer_p, struct fwiFileWriterNode* node_p) {
+    node_p->following = nullptr;
+
+    if (writer_p->pending_p == nullptr) {
+        writer_p->pending_p = writer_p->pendingLast_p = node_p;
+        return;
+    }
+    if (node_p->offset > writer_p->pendingLast_p->offset) {
+        writer_p->pendingLast_p->following = node_p;
+        writer_p->pendingLast_p = node_p;
+        return;
+    }
+
+    struct fwiFileWriterNode** link = &writer_p->pending_p;
+    while ((*link)->offset < node_p->offset) {
+        link = &(*link)->following;
+    }
+    node_p->following = *link;
+    *link = node_p;
+}
+
+/**
+ * @brief Writes the pending nodes that continue the file, a batch at a time.
+ * @return Whether anything was written
+ */
+static bool fwiFileWriterFlush(struct fwiFileWriter* writer_p, uint64_t* written_p) {
+    bool wroteAny = false;
+
+    while (writer_p->pending_p != nullptr && writer_p->pending_p->offset == *written_p) {
+        struct iovec vectors[FWI_FILE_WRITER_MAX_VECTORS];
+        uint32_t count = 0;
+        uint64_t bytes = 0, end = *written_p;
+
+        for (struct fwiFileWriterNode* node = writer_p->pending_p;
+             node != nullptr && node->offset == end && count < FWI_FILE_WRITER_MAX_VECTORS &&
+             (count == 0 || bytes + node->size <= writer_p->batchSize);
+             node = node->following) {
+            vectors[count].iov_base = node + 1;
+            vectors[count].iov_len  = node->size;
+            bytes += node->size;
+            end   += node->size;
+            count++;
+        }
+
+        // Short writes leave the vectors partially done, they are advanced past what went out
+        struct iovec* vector = vectors;
+        uint64_t offset = *written_p;
+        while (count != 0) {
+            const ssize_t result = pwritev(writer_p->fileDescriptor, vector, (int)count,
+                                           (off_t)offset);
+            if (result == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                FWI_LOG_ERRNO;
+                atomic_store_explicit(&writer_p->error, fwErrorFileWrite, memory_order_release);
+                return wroteAny;
+            }
+
+            offset += result;
+            size_t left = result;
+            while (count != 0 && left >= vector->iov_len) {
+                left -= vector->iov_len;
+                vector++;
+                count--;
+            }
+            if (count != 0) {
+                vector->iov_base = (uint8_t*)vector->iov_base + left;
+                vector->iov_len -= left;
+            }
+        }
+
+        while (writer_p->pending_p != nullptr && writer_p->pending_p->offset < end) {
+            struct fwiFileWriterNode* node = writer_p->pending_p;
+            writer_p->pending_p = node->following;
+            free(node);
+        }
+        *written_p = end;
+        wroteAny = true;
+    }
+
+    return wroteAny;
+}
+
+static void* fwiFileWriterWork(void* writer_p) {
+    struct fwiFileWriter* writer = writer_p;
+    uint64_t written = writer->written;
+
+    while (true) {
+        const bool stopping = atomic_load_explicit(&writer->stopping, memory_order_acquire);
+
+        struct fwiFileWriterNode* node;
+        while ((node = fwiFileWriterPop(writer)) != nullptr) {
+            fwiFileWriterKeep(writer, node);
+        }
+
+        bool progressed = false;
+        if (atomic_load_explicit(&writer->error, memory_order_acquire) == fwErrorSuccess) {
+            progressed = fwiFileWriterFlush(writer, &written);
+        }
+
+        // Closing syncs once everything is written, a sync with nothing new written is skipped
+        pthread_mutex_lock(&writer->mutex);
+        writer->written = written;
+        const bool sync = written > writer->durable && (writer->syncRequested > writer->durable ||
+                          (stopping && writer->pending_p == nullptr));
+        pthread_mutex_unlock(&writer->mutex);
+
+        // One sync covers every caller that asked for one while the previous sync was running
+        if (sync && atomic_load_explicit(&writer->error, memory_order_acquire) == fwErrorSuccess) {
+            int32_t result;
+            while ((result = fdatasync(writer->fileDescriptor)) == -1 && errno == EINTR) {}
+            if (result == -1) {
+                FWI_LOG_ERRNO;
+                atomic_store_explicit(&writer->error, fwErrorFileWrite, memory_order_release);
+            }
+            else {
+                pthread_mutex_lock(&writer->mutex);
+                writer->durable = written;
+                pthread_mutex_unlock(&writer->mutex);
+            }
+            progressed = true;
+        }
+
+        pthread_mutex_lock(&writer->mutex);
+        pthread_cond_broadcast(&writer->progress);
+        pthread_mutex_unlock(&writer->mutex);
+
+        // Everything that was appended before stopping is out once the queue and list are empty
+        if (stopping && (writer->pending_p == nullptr ||
+            atomic_load_explicit(&writer->error, memory_order_acquire) != fwErrorSuccess)) {
+            break;
+        }
+        if (progressed) {
+            continue;
+        }
+
+        // Nothing to do, sleep for a millisecond or until an append or a waiter wakes us up
+        struct timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_nsec += 1'000'000;
+        if (deadline.tv_nsec >= 1'000'000'000) {
+            deadline.tv_sec++;
+            deadline.tv_nsec -= 1'000'000'000;
+        }
+        pthread_mutex_lock(&writer->mutex);
+        atomic_store_explicit(&writer->idle, true, memory_order_seq_cst);
+        if (atomic_load_explicit(&writer->head, memory_order_seq_cst) == writer->tail &&
+            (writer->syncRequested <= writer->durable || writer->written == writer->durable) &&
+            !atomic_load_explicit(&writer->stopping, memory_order_acquire)) {
+            pthread_cond_timedwait(&writer->wake, &writer->mutex, &deadline);
+        }
+        atomic_store_explicit(&writer->idle, false, memory_order_relaxed);
+        pthread_mutex_unlock(&writer->mutex);
+    }
+
+    // Whatever is left after an error is dropped
+    struct fwiFileWriterNode* node;
+    while ((node = fwiFileWriterPop(writer)) != nullptr) {
+        fwiFileWriterKeep(writer, node);
+    }
+    while (writer->pending_p != nullptr) {
+        node = writer->pending_p;
+        writer->pending_p = node->following;
+        free(node);
+    }
+
+    return nullptr;
+}
+
+fwError fwFileWriterOpen(const char* filename_p, const fwFileWriterInfo* info_p,
+                         fwFileWriter* writer_p) {
+    const bool truncate = info_p != nullptr && (info_p->flags & fwFileWriterFlagTruncate);
+    const int32_t fileDescriptor = open(filename_p, O_WRONLY | O_CREAT | O_CLOEXEC |
+                                        (truncate ? O_TRUNC : 0), 0644);
+    if (fileDescriptor == -1) {
+        return fwErrorFileUnableToOpen;
+    }
+
+    struct stat fileStats;
+    if (fstat(fileDescriptor, &fileStats)) {
+        close(fileDescriptor);
+        return fwErrorFileStats;
+    }
+
+    struct fwiFileWriter* writer = aligned_alloc(alignof(struct fwiFileWriter),
+                                                 sizeof(struct fwiFileWriter));
+    if (writer == nullptr) {
+        close(fileDescriptor);
+        return fwErrorOutOfMemory;
+    }
+    memset(writer, 0, sizeof(struct fwiFileWriter));
+
+    writer->fileDescriptor = fileDescriptor;
+    writer->batchSize      = info_p != nullptr && info_p->batchSize != 0 ?
+                             info_p->batchSize : FWI_FILE_WRITER_DEFAULT_BATCH;
+    writer->written        = fileStats.st_size;
+    writer->durable        = fileStats.st_size;
+    writer->tail           = &writer->stub;
+    atomic_init(&writer->head, &writer->stub);
+    atomic_init(&writer->reserved, (uint64_t)fileStats.st_size);
+
+    pthread_mutex_init(&writer->mutex, nullptr);
+    pthread_cond_init(&writer->wake, nullptr);
+    pthread_cond_init(&writer->progress, nullptr);
+
+    if (pthread_create(&writer->thread, nullptr, fwiFileWriterWork, writer) != 0) {
+        pthread_cond_destroy(&writer->progress);
+        pthread_cond_destroy(&writer->wake);
+        pthread_mutex_destroy(&writer->mutex);
+        close(fileDescriptor);
+        free(writer);
+        return fwErrorOutOfMemory;
+    }
+
+    *writer_p = (uintptr_t)writer;
+    return fwErrorSuccess;
+}
+
+fwError fwFileWriterAppend(const fwFileWriter writer, const void* data_p, const uint64_t size,
+                           uint64_t* sequence_p) {
+    struct fwiFileWriter* fileWriter = {(struct fwiFileWriter*)writer};
+    if (fileWriter == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    const fwError error = atomic_load_explicit(&fileWriter->error, memory_order_acquire);
+    if (error != fwErrorSuccess) {
+        return error;
+    }
+
+    // Nothing to write, waiting on everything appended so far has the same effect
+    if (size == 0) {
+        if (sequence_p != nullptr) {
+            *sequence_p = atomic_load_explicit(&fileWriter->reserved, memory_order_relaxed);
+        }
+        return fwErrorSuccess;
+    }
+
+    struct fwiFileWriterNode* node = malloc(sizeof(struct fwiFileWriterNode) + size);
+    if (node == nullptr) {
+        return fwErrorOutOfMemory;
+    }
+    memcpy(node + 1, data_p, size);
+    node->size   = size;
+    node->offset = atomic_fetch_add_explicit(&fileWriter->reserved, size, memory_order_relaxed);
+
+    // Once pushed, the node belongs to the writer thread and may already be gone
+    const uint64_t sequence = node->offset + size;
+    fwiFileWriterPush(fileWriter, node);
+    if (sequence_p != nullptr) {
+        *sequence_p = sequence;
+    }
+
+    // Only a sleeping writer needs the syscall, a busy one finds the node on its next round
+    if (atomic_load_explicit(&fileWriter->idle, memory_order_seq_cst)) {
+        pthread_mutex_lock(&fileWriter->mutex);
+        pthread_cond_signal(&fileWriter->wake);
+        pthread_mutex_unlock(&fileWriter->mutex);
+    }
+    return fwErrorSuccess;
+}
+
+fwError fwFileWriterWait(const fwFileWriter writer, const uint64_t sequence, const bool durable) {
+    struct fwiFileWriter* fileWriter = {(struct fwiFileWriter*)writer};
+    if (fileWriter == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    pthread_mutex_lock(&fileWriter->mutex);
+    if (durable && sequence > fileWriter->syncRequested) {
+        fileWriter->syncRequested = sequence;
+        pthread_cond_signal(&fileWriter->wake);
+    }
+
+    fwError ret;
+    while ((ret = atomic_load_explicit(&fileWriter->error, memory_order_acquire)) ==
+           fwErrorSuccess && (durable ? fileWriter->durable : fileWriter->written) < sequence) {
+        pthread_cond_wait(&fileWriter->progress, &fileWriter->mutex);
+    }
+    pthread_mutex_unlock(&fileWriter->mutex);
+
+    return ret;
+}
+
+fwError fwFileWriterClose(const fwFileWriter writer) {
+    struct fwiFileWriter* fileWriter = {(struct fwiFileWriter*)writer};
+    if (fileWriter == nullptr) {
+        return fwErrorInvalidParameter;
+    }
+
+    pthread_mutex_lock(&fileWriter->mutex);
+    atomic_store_explicit(&fileWriter->stopping, true, memory_order_release);
+    pthread_cond_signal(&fileWriter->wake);
+    pthread_mutex_unlock(&fileWriter->mutex);
+    pthread_join(fileWriter->thread, nullptr);
+
+    fwError ret = atomic_load_explicit(&fileWriter->error, memory_order_acquire);
+    if (close(fileWriter->fileDescriptor) == -1 && ret == fwErrorSuccess) {
+        ret = fwErrorFileWrite;
+    }
+
+    pthread_cond_destroy(&fileWriter->progress);
+    pthread_cond_destroy(&fileWriter->wake);
+    pthread_mutex_destroy(&fileWriter->mutex);
+    free(fileWriter);
+    return ret;
+}
+
+#endif // PLATFORM_LINUX
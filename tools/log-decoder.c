@@ -0,0 +1,164 @@
+// LPAF - lightweight and performant application framework
+// Copyright (C) 2024 ToneXum (Toni Stein)
+//
+// This program is free software: you can redistribute it and/or modify it under the terms of the
+// GNU General Public License as published by the Free Software Foundation, either version 3 of
+// the License, or any later version.
+//
+// This program is distributed in the hope that it will be useful, but WITHOUT ANY WARRANTY;
+// without even the implied warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License along with this program. If
+// not, see <https://www.gnu.org/licenses/>.
+
+// Turns binary log segments (.lpbl), written in fwLogModeBinary, back into the text format of the
+// regular logs. Usage: lpafLogDecoder <segment>...
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "framework.h"
+#include "internal.h"
+
+#define FORMAT_TABLE_SIZE 8192
+
+struct format {
+    uint64_t id;
+    const char* string_p;
+};
+
+static struct format formats_s[FORMAT_TABLE_SIZE];
+
+static uint32_t slotOf(const uint64_t id) {
+    uint32_t slot = (uint32_t)((id >> 3) * 0x9E37'79B9u) & (FORMAT_TABLE_SIZE - 1);
+    while (formats_s[slot].id != 0 && formats_s[slot].id != id) {
+        slot = (slot + 1) & (FORMAT_TABLE_SIZE - 1);
+    }
+    return slot;
+}
+
+static bool decodeSegment(const char* filename_p) {
+    void* buffer = nullptr;
+    uint64_t size = 0;
+    if (fwLoadFileToMem(filename_p, &buffer, &size) != fwErrorSuccess) {
+        fprintf(stderr, "%s: could not be read\n", filename_p);
+        return false;
+    }
+
+    const uint8_t* data = buffer;
+    if (size < 16 || memcmp(data, FWI_LOG_BINARY_MAGIC, 8) != 0) {
+        fprintf(stderr, "%s: not a binary log\n", filename_p);
+        fwFree(buffer);
+        return false;
+    }
+
+    // Format ids are only meaningful within the segment that defines them
+    memset(formats_s, 0, sizeof(formats_s));
+
+    time_t lastSecond = -1;
+    char timeBuffer[10] = {};
+    char text[FWI_LOG_RECORD_SIZE];
+
+    uint64_t offset = 16;
+    while (offset + sizeof(struct fwiLogEntryHeader) <= size) {
+        struct fwiLogEntryHeader header;
+        memcpy(&header, data + offset, sizeof(header));
+        offset += sizeof(header);
+
+        if (header.type == 0 || offset + header.length > size) {
+            break; // End of the written part of a segment that was not closed cleanly
+        }
+        const uint8_t* payload = data + offset;
+        offset += header.length;
+
+        uint16_t length = 0;
+        const char* message = text;
+        switch (header.type) {
+            case fwiLogEntryTypeFormat: {
+                char* string = malloc(header.length + 1);
+                if (string == nullptr) {
+                    fwFree(buffer);
+                    return false;
+                }
+                memcpy(string, payload, header.length);
+                string[header.length] = '\0';
+
+                const uint32_t slot = slotOf(header.formatId);
+                free((void*)formats_s[slot].string_p);
+                formats_s[slot].id       = header.formatId;
+                formats_s[slot].string_p = string;
+                continue;
+            }
+            case fwiLogEntryTypeMessage: {
+                const struct format* format = &formats_s[slotOf(header.formatId)];
+                if (format->string_p == nullptr) {
+                    length = (uint16_t)snprintf(text, sizeof(text), "<unknown format %lX>",
+                                                (unsigned long)header.formatId);
+                    break;
+                }
+                length = (uint16_t)fwiLogFormatBinary(text, sizeof(text), format->string_p, payload,
+                                                      header.length);
+                break;
+            }
+            case fwiLogEntryTypeText: {
+                message = (const char*)payload;
+                length  = header.length;
+                break;
+            }
+            default: {
+                fprintf(stderr, "%s: unknown entry type %u\n", filename_p, header.type);
+                continue;
+            }
+        }
+
+        switch (header.kind) {
+            case fwiLogRecordKindMessage: {
+                const time_t second = (time_t)(header.timestamp / 1'000'000'000);
+                if (second != lastSecond) {
+                    struct tm time;
+                    localtime_r(&second, &time);
+                    strftime(timeBuffer, sizeof(timeBuffer), "[%H:%M:%S", &time);
+                    lastSecond = second;
+                }
+                printf("%s %s]: %.*s\n", timeBuffer, fwiLogLevelName(header.level), length,
+                       message);
+                break;
+            }
+            case fwiLogRecordKindFollowup: {
+                printf("| - %.*s\n", length, message);
+                break;
+            }
+            case fwiLogRecordKindFollowupLast: {
+                printf("\\ - %.*s\n", length, message);
+                break;
+            }
+            default: {
+                break;
+            }
+        }
+    }
+
+    for (uint32_t i = 0; i < FORMAT_TABLE_SIZE; i++) {
+        free((void*)formats_s[i].string_p);
+    }
+    fwFree(buffer);
+    return true;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 2) {
+        fprintf(stderr, "Usage: %s <segment>...\n", argv[0]);
+        return 1;
+    }
+
+    int ret = 0;
+    for (int i = 1; i < argc; i++) {
+        if (!decodeSegment(argv[i])) {
+            ret = 1;
+        }
+    }
+    return ret;
+}